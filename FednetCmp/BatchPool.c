@@ -0,0 +1,370 @@
+/*
+ *  FednetCmp - Fednet file compression/decompression
+ *  Ordered pool of worker threads for batch compression
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* Jobs are held in a ring buffer. Slots between 'head' and 'next' have been
+   handed to a worker (and may have finished); slots between 'next' and
+   'tail' are waiting for a worker. Only the submitting thread retires jobs,
+   and only from the head, so results are reported in submission order
+   regardless of which worker finishes first. */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+
+/* Local headers */
+#include "BatchPool.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#define BATCHPOOL_THREADS
+#elif defined(BATCHPOOL_PTHREADS)
+#include <pthread.h>
+#define BATCHPOOL_THREADS
+#endif
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  MaxThreads = 64,
+};
+
+typedef struct
+{
+  void *job;
+  bool finished;
+}
+BatchPoolSlot;
+
+#if defined(_WIN32)
+typedef CRITICAL_SECTION PoolMutex;
+typedef CONDITION_VARIABLE PoolCond;
+typedef HANDLE PoolThread;
+#elif defined(BATCHPOOL_PTHREADS)
+typedef pthread_mutex_t PoolMutex;
+typedef pthread_cond_t PoolCond;
+typedef pthread_t PoolThread;
+#endif
+
+struct BatchPool
+{
+  BatchPoolWorkFn *work;
+  BatchPoolDoneFn *done;
+  void *arg;
+  size_t queue_size;
+  size_t head, next, tail; /* free-running counts of jobs */
+  BatchPoolSlot *slots;
+#ifdef BATCHPOOL_THREADS
+  bool closing;
+  int nthreads;
+  PoolMutex lock;
+  PoolCond job_ready; /* signalled when a job is queued or pool closes */
+  PoolCond job_done; /* signalled when a worker finishes a job */
+  PoolThread threads[MaxThreads];
+#endif
+};
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+#ifdef BATCHPOOL_THREADS
+
+#if defined(_WIN32)
+
+static void mutex_init(PoolMutex *const m) { InitializeCriticalSection(m); }
+static void mutex_destroy(PoolMutex *const m) { DeleteCriticalSection(m); }
+static void mutex_lock(PoolMutex *const m) { EnterCriticalSection(m); }
+static void mutex_unlock(PoolMutex *const m) { LeaveCriticalSection(m); }
+static void cond_init(PoolCond *const c) { InitializeConditionVariable(c); }
+static void cond_destroy(PoolCond *const c) { (void)c; }
+static void cond_signal(PoolCond *const c) { WakeConditionVariable(c); }
+static void cond_broadcast(PoolCond *const c) { WakeAllConditionVariable(c); }
+
+static void cond_wait(PoolCond *const c, PoolMutex *const m)
+{
+  SleepConditionVariableCS(c, m, INFINITE);
+}
+
+#else
+
+static void mutex_init(PoolMutex *const m) { pthread_mutex_init(m, NULL); }
+static void mutex_destroy(PoolMutex *const m) { pthread_mutex_destroy(m); }
+static void mutex_lock(PoolMutex *const m) { pthread_mutex_lock(m); }
+static void mutex_unlock(PoolMutex *const m) { pthread_mutex_unlock(m); }
+static void cond_init(PoolCond *const c) { pthread_cond_init(c, NULL); }
+static void cond_destroy(PoolCond *const c) { pthread_cond_destroy(c); }
+static void cond_signal(PoolCond *const c) { pthread_cond_signal(c); }
+static void cond_broadcast(PoolCond *const c) { pthread_cond_broadcast(c); }
+
+static void cond_wait(PoolCond *const c, PoolMutex *const m)
+{
+  pthread_cond_wait(c, m);
+}
+
+#endif
+
+/* ----------------------------------------------------------------------- */
+
+static void worker_loop(BatchPool *const pool)
+{
+  assert(pool != NULL);
+
+  mutex_lock(&pool->lock);
+  for (;;)
+  {
+    while (pool->next == pool->tail && !pool->closing)
+    {
+      cond_wait(&pool->job_ready, &pool->lock);
+    }
+
+    if (pool->next == pool->tail)
+    {
+      break; /* closing and nothing left to do */
+    }
+
+    BatchPoolSlot *const slot = &pool->slots[pool->next++ % pool->queue_size];
+    mutex_unlock(&pool->lock);
+
+    pool->work(slot->job, pool->arg);
+
+    mutex_lock(&pool->lock);
+    slot->finished = true;
+    cond_signal(&pool->job_done);
+  }
+  mutex_unlock(&pool->lock);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI worker_main(LPVOID const arg)
+{
+  worker_loop(arg);
+  return 0;
+}
+
+static bool thread_start(PoolThread *const thread, BatchPool *const pool)
+{
+  *thread = CreateThread(NULL, 0, worker_main, pool, 0, NULL);
+  return *thread != NULL;
+}
+
+static void thread_join(PoolThread const thread)
+{
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+}
+#else
+static void *worker_main(void *const arg)
+{
+  worker_loop(arg);
+  return NULL;
+}
+
+static bool thread_start(PoolThread *const thread, BatchPool *const pool)
+{
+  return pthread_create(thread, NULL, worker_main, pool) == 0;
+}
+
+static void thread_join(PoolThread const thread)
+{
+  pthread_join(thread, NULL);
+}
+#endif
+
+/* ----------------------------------------------------------------------- */
+
+static bool retire_one(BatchPool *const pool, bool const wait)
+{
+  /* Retires the oldest job if it has finished (or once it has finished,
+     if 'wait' is true). Returns false if there was no job to retire. */
+  assert(pool != NULL);
+
+  mutex_lock(&pool->lock);
+  if (pool->head == pool->tail)
+  {
+    mutex_unlock(&pool->lock);
+    return false;
+  }
+
+  BatchPoolSlot *const slot = &pool->slots[pool->head % pool->queue_size];
+  while (wait && !slot->finished)
+  {
+    cond_wait(&pool->job_done, &pool->lock);
+  }
+  bool const finished = slot->finished;
+  mutex_unlock(&pool->lock);
+
+  if (finished)
+  {
+    /* The slot can't be reused until 'head' advances */
+    pool->done(slot->job, pool->arg);
+
+    mutex_lock(&pool->lock);
+    slot->finished = false;
+    pool->head++;
+    mutex_unlock(&pool->lock);
+  }
+  return finished;
+}
+
+#endif /* BATCHPOOL_THREADS */
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+_Optional BatchPool *batchpool_create(int nthreads, size_t const queue_size,
+  BatchPoolWorkFn *const work, BatchPoolDoneFn *const done, void *const arg)
+{
+  assert(nthreads >= 0);
+  assert(queue_size > 0);
+  assert(work != NULL);
+  assert(done != NULL);
+
+  _Optional BatchPool *const pool = malloc(sizeof(*pool));
+  if (!pool)
+  {
+    return NULL;
+  }
+
+  *pool = (BatchPool){
+    .work = work,
+    .done = done,
+    .arg = arg,
+    .queue_size = queue_size,
+  };
+
+#ifdef BATCHPOOL_THREADS
+  if (nthreads > MaxThreads)
+  {
+    nthreads = MaxThreads;
+  }
+
+  if (nthreads > 0)
+  {
+    _Optional BatchPoolSlot *const slots = malloc(sizeof(*slots) * queue_size);
+    if (!slots)
+    {
+      free(pool);
+      return NULL;
+    }
+    pool->slots = &*slots;
+
+    mutex_init(&pool->lock);
+    cond_init(&pool->job_ready);
+    cond_init(&pool->job_done);
+
+    for (; pool->nthreads < nthreads; pool->nthreads++)
+    {
+      if (!thread_start(&pool->threads[pool->nthreads], &*pool))
+      {
+        /* Carry on with fewer threads (possibly none) */
+        DEBUGF("Failed to start worker thread %d\n", pool->nthreads);
+        break;
+      }
+    }
+    DEBUGF("Started %d worker threads\n", pool->nthreads);
+  }
+#else
+  NOT_USED(nthreads);
+#endif
+
+  return pool;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void batchpool_submit(BatchPool *const pool, void *const job)
+{
+  assert(pool != NULL);
+
+#ifdef BATCHPOOL_THREADS
+  if (pool->nthreads > 0)
+  {
+    /* Report any jobs that finished whilst we were elsewhere, so that
+       results appear promptly. */
+    while (retire_one(pool, false))
+    {
+    }
+
+    while (pool->tail - pool->head >= pool->queue_size)
+    {
+      (void)retire_one(pool, true);
+    }
+
+    mutex_lock(&pool->lock);
+    pool->slots[pool->tail++ % pool->queue_size] = (BatchPoolSlot){
+      .job = job};
+    cond_signal(&pool->job_ready);
+    mutex_unlock(&pool->lock);
+    return;
+  }
+#endif
+
+  pool->work(job, pool->arg);
+  pool->done(job, pool->arg);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void batchpool_destroy(_Optional BatchPool *const pool)
+{
+  if (!pool)
+  {
+    return;
+  }
+
+#ifdef BATCHPOOL_THREADS
+  if (pool->slots)
+  {
+    if (pool->nthreads > 0)
+    {
+      while (retire_one(&*pool, true))
+      {
+      }
+
+      mutex_lock(&pool->lock);
+      pool->closing = true;
+      cond_broadcast(&pool->job_ready);
+      mutex_unlock(&pool->lock);
+
+      for (int t = 0; t < pool->nthreads; ++t)
+      {
+        thread_join(pool->threads[t]);
+      }
+    }
+
+    cond_destroy(&pool->job_done);
+    cond_destroy(&pool->job_ready);
+    mutex_destroy(&pool->lock);
+    free(pool->slots);
+  }
+#endif
+
+  free(pool);
+}
@@ -0,0 +1,39 @@
+/*
+ *  FednetCmp - Fednet file compression/decompression
+ *  Ordered pool of worker threads for batch compression
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef FNCBatchPool_h
+#define FNCBatchPool_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if !defined(USE_OPTIONAL) && !defined(_Optional)
+#define _Optional
+#endif
+
+typedef struct BatchPool BatchPool;
+
+/* Called on a worker thread (or the calling thread if there are none) to
+   process a job. Must not touch any state shared with other jobs. */
+typedef void BatchPoolWorkFn(void *job, void *arg);
+
+/* Called on the submitting thread after a job has been processed.
+   Jobs are retired in the order in which they were submitted. */
+typedef void BatchPoolDoneFn(void *job, void *arg);
+
+/* Returns NULL if there is not enough memory. If threads are not
+   supported on this platform then 'nthreads' is ignored and each job is
+   processed synchronously when it is submitted. */
+_Optional BatchPool *batchpool_create(int nthreads, size_t queue_size,
+  BatchPoolWorkFn *work, BatchPoolDoneFn *done, void *arg);
+
+/* Blocks whilst the queue is full, retiring finished jobs meanwhile. */
+void batchpool_submit(BatchPool *pool, void *job);
+
+/* Waits for all submitted jobs to be processed and retired. */
+void batchpool_destroy(_Optional BatchPool *pool);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ *  FednetCmp - Fednet file compression/decompression
+ *  Recognition of compressed file types
+ *  Copyright (C) 2001 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ANSI library files */
+#include <stdbool.h>
+#include <stddef.h>
+
+/* My library files */
+#include "SFFormats.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "CompType.h"
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+bool compressed_file_type(int file_type)
+{
+  static int const comp_types[] =
+  {
+    FileType_Fednet,
+    FileType_SFObjGfx,
+    FileType_SFBasMap,
+    FileType_SFBasObj,
+    FileType_SFOvrMap,
+    FileType_SFOvrObj,
+    FileType_SFSkyCol,
+    FileType_SFMissn,
+    FileType_SFSkyPic,
+    FileType_SFMapGfx,
+    FileType_SFMapAni
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE(comp_types); i++)
+  {
+    if (comp_types[i] == file_type)
+      return true; /* file type is compressed */
+  }
+
+  return false; /* unrecognised file type */
+}
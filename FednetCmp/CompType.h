@@ -0,0 +1,16 @@
+/*
+ *  FednetCmp - Fednet file compression/decompression
+ *  Recognition of compressed file types
+ *  Copyright (C) 2001 Christopher Bazley
+ */
+
+#ifndef FNCCompType_h
+#define FNCCompType_h
+
+#include <stdbool.h>
+
+/* Has no dependency on the RISC OS toolbox, so that the command-line batch
+   compressor can share it. */
+bool compressed_file_type(int file_type);
+
+#endif
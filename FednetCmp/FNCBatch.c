@@ -0,0 +1,914 @@
+/*
+ *  FednetCmp - Fednet file compression/decompression
+ *  Command-line batch compressor
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* Unlike the rest of FednetCmp, this program has no dependency on the
+   RISC OS toolbox or Wimp. It compresses or decompresses files below a
+   given root directory into the equivalent place below another, like a
+   directory scan in the desktop application. RISC OS file types are taken
+   from a ",xxx" suffix on each file name, as used by HostFS and NFS.
+   Files can be processed concurrently on a pool of worker threads, but
+   results are always reported in the order that files were found, and
+   each output file is the same as if the files had been processed one at
+   a time. */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
+
+/* My library files */
+#include "Macros.h"
+#include "SFFormats.h"
+#include "Debug.h"
+#include "ReaderRaw.h"
+#include "ReaderGKey.h"
+#include "WriterRaw.h"
+#include "WriterGKey.h"
+
+/* Local headers */
+#include "CompType.h"
+#include "BatchPool.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  FednetHistoryLog2 = 9, /* Base 2 logarithm of the history size used by
+                            the compression algorithm */
+  FileTypeSuffixLen = 4, /* Length of a ",xxx" file name suffix */
+  MaxPathLen = 1024,
+  QueueSlotsPerThread = 4, /* Files queued ahead of the workers */
+  StreamBufferSize = 4096,
+  MinListingSize = 16, /* Initial capacity of a directory listing */
+};
+
+typedef struct
+{
+  char const *load_root;
+  char const *save_root;
+  size_t make_path_offset; /* avoids creating directories that should already exist */
+  int comp_type; /* file type to give compressed output */
+  bool compress;
+  bool verbose;
+}
+BatchOptions;
+
+typedef struct
+{
+  unsigned long int num_checked;
+  unsigned long int num_output;
+  unsigned long int num_failed;
+}
+BatchStats;
+
+typedef enum
+{
+  BatchResult_Ignored,
+  BatchResult_Output,
+  BatchResult_NotInRoot,
+  BatchResult_StrOFlo,
+  BatchResult_DirFail,
+  BatchResult_OpenInFail,
+  BatchResult_OpenOutFail,
+  BatchResult_ReadFail,
+  BatchResult_BitStream,
+  BatchResult_WriteFail,
+  BatchResult_NoMem,
+  BatchResult_OpenDirFail,
+}
+BatchResult;
+
+typedef struct
+{
+  BatchOptions opts;
+  BatchStats stats; /* only updated on the main thread */
+}
+BatchContext;
+
+typedef struct
+{
+  char **names;
+  size_t count;
+  size_t size;
+}
+DirListing;
+
+typedef struct
+{
+  BatchResult result;
+  char load_path[MaxPathLen];
+  char save_path[MaxPathLen];
+}
+BatchJob;
+
+static char const *prog_name = "FednetCmpBatch";
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static char const *result_text(BatchResult const result)
+{
+  static char const *const ms_to_text[] = {
+    [BatchResult_NotInRoot] = "File is not in the input directory",
+    [BatchResult_StrOFlo] = "String too long",
+    [BatchResult_DirFail] = "Failed to create directory",
+    [BatchResult_OpenInFail] = "Failed to open input file",
+    [BatchResult_OpenOutFail] = "Failed to open output file",
+    [BatchResult_ReadFail] = "Failed to read from file",
+    [BatchResult_BitStream] = "Compressed bitstream is corrupt",
+    [BatchResult_WriteFail] = "Failed to write to file",
+    [BatchResult_NoMem] = "Not enough free memory",
+    [BatchResult_OpenDirFail] = "Failed to read directory",
+  };
+
+  char const *text = NULL;
+  if ((size_t)result < ARRAY_SIZE(ms_to_text))
+  {
+    text = ms_to_text[result];
+  }
+  return text ? text : "Unknown error";
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool is_separator(char const c)
+{
+  return c == '/' || c == '\\';
+}
+
+/* ----------------------------------------------------------------------- */
+
+static char *trim_separators(char *const path)
+{
+  /* Removes any trailing separators, except from a root directory */
+  assert(path != NULL);
+  size_t len = strlen(path);
+  while (len > 1 && is_separator(path[len - 1]))
+  {
+    path[--len] = '\0';
+  }
+  return path;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static size_t strip_file_type(char const *const name, size_t const len,
+  int *const file_type)
+{
+  /* Returns the length of the first 'len' characters of 'name' without
+     any ",xxx" file type suffix */
+  assert(name != NULL);
+
+  *file_type = FileType_Null;
+
+  if (len <= FileTypeSuffixLen || name[len - FileTypeSuffixLen] != ',')
+  {
+    return len;
+  }
+
+  int type = 0;
+  for (size_t i = len - FileTypeSuffixLen + 1; i < len; ++i)
+  {
+    if (!isxdigit((unsigned char)name[i]))
+    {
+      return len;
+    }
+    type = (type << 4) | (isdigit((unsigned char)name[i]) ?
+                          name[i] - '0' :
+                          tolower((unsigned char)name[i]) - 'a' + 10);
+  }
+
+  *file_type = type;
+  return len - FileTypeSuffixLen;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static BatchResult make_save_path(char *const save_path, size_t const size,
+  char const *const load_path, BatchOptions const *const opts,
+  int *const input_type)
+{
+  assert(save_path != NULL);
+  assert(load_path != NULL);
+  assert(opts != NULL);
+  assert(input_type != NULL);
+
+  /* The output path is the input path with its root replaced. A file
+     given as the root itself is saved as the output root. */
+  size_t const root_len = strlen(opts->load_root);
+  if (strncmp(load_path, opts->load_root, root_len) ||
+      (load_path[root_len] != '\0' && !is_separator(load_path[root_len])))
+  {
+    return BatchResult_NotInRoot;
+  }
+
+  char const *const sub_path = load_path + root_len;
+  size_t const sub_len = strip_file_type(sub_path, strlen(sub_path),
+                                         input_type);
+  if (sub_len == 0)
+  {
+    /* Only the root has a file type suffix to strip */
+    (void)strip_file_type(opts->load_root, root_len, input_type);
+  }
+
+  int save_root_type;
+  size_t const save_root_len = strip_file_type(opts->save_root,
+    strlen(opts->save_root), &save_root_type);
+
+  int const output_type = opts->compress ? opts->comp_type : FileType_Data;
+  int const nchars = snprintf(save_path, size, "%.*s%.*s,%03x",
+                              (int)save_root_len, opts->save_root,
+                              (int)sub_len, sub_path, output_type);
+
+  return nchars >= 0 && (size_t)nchars < size ?
+         BatchResult_Output : BatchResult_StrOFlo;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool make_dir(char const *const path)
+{
+#if defined(_WIN32)
+  return !_mkdir(path) || errno == EEXIST;
+#else
+  return !mkdir(path, 0777) || errno == EEXIST;
+#endif
+}
+
+/* ----------------------------------------------------------------------- */
+
+static BatchResult make_path(char *const save_path, size_t const offset)
+{
+  /* Creates any directories in the given path that are named after
+     'offset', but not the leaf (which is a file). */
+  assert(save_path != NULL);
+
+  for (size_t i = offset; save_path[i] != '\0'; ++i)
+  {
+    char const sep = save_path[i];
+    if (is_separator(sep))
+    {
+      save_path[i] = '\0';
+      bool const made = make_dir(save_path);
+      save_path[i] = sep;
+      if (!made)
+      {
+        return BatchResult_DirFail;
+      }
+    }
+  }
+  return BatchResult_Output;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static BatchResult copy_stream(Reader *const reader, Writer *const writer,
+  bool const compress)
+{
+  assert(reader != NULL);
+  assert(writer != NULL);
+
+  char buf[StreamBufferSize];
+  size_t n;
+  do
+  {
+    n = reader_fread(buf, 1, sizeof(buf), reader);
+    assert(n <= sizeof(buf));
+
+    if (reader_ferror(reader))
+    {
+      return compress ? BatchResult_ReadFail : BatchResult_BitStream;
+    }
+
+    if (writer_fwrite(buf, 1, n, writer) != n)
+    {
+      return BatchResult_WriteFail;
+    }
+  }
+  while (n == sizeof(buf));
+
+  return BatchResult_Output;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static BatchResult compress_file(BatchJob const *const bj,
+  bool const compress)
+{
+  assert(bj != NULL);
+
+  FILE *const in = fopen(bj->load_path, "rb");
+  if (!in)
+  {
+    return BatchResult_OpenInFail;
+  }
+
+  /* The compressor is told the input size so that its output buffer
+     can be allocated up front, as for a scan in the desktop. */
+  long int in_size = 0;
+  if (compress)
+  {
+    if (fseek(in, 0, SEEK_END) ||
+        (in_size = ftell(in)) < 0 ||
+        fseek(in, 0, SEEK_SET))
+    {
+      fclose(in);
+      return BatchResult_ReadFail;
+    }
+  }
+
+  Reader reader;
+  if (compress)
+  {
+    reader_raw_init(&reader, in);
+  }
+  else if (!reader_gkey_init(&reader, FednetHistoryLog2, in))
+  {
+    fclose(in);
+    return BatchResult_NoMem;
+  }
+
+  BatchResult result = BatchResult_Output;
+  FILE *const out = fopen(bj->save_path, "wb");
+  if (!out)
+  {
+    result = BatchResult_OpenOutFail;
+  }
+  else
+  {
+    Writer writer;
+    if (!compress)
+    {
+      writer_raw_init(&writer, out);
+    }
+    else if (!writer_gkey_init(&writer, FednetHistoryLog2, in_size, out))
+    {
+      result = BatchResult_NoMem;
+    }
+
+    if (result == BatchResult_Output)
+    {
+      result = copy_stream(&reader, &writer, compress);
+
+      if (writer_destroy(&writer) < 0 && result == BatchResult_Output)
+      {
+        result = BatchResult_WriteFail;
+      }
+    }
+
+    if (fclose(out) && result == BatchResult_Output)
+    {
+      result = BatchResult_WriteFail;
+    }
+
+    if (result != BatchResult_Output)
+    {
+      /* Don't leave a partial output file to be mistaken for a good one */
+      (void)remove(bj->save_path);
+    }
+  }
+
+  reader_destroy(&reader);
+  fclose(in);
+  return result;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void process_file(void *const job, void *const arg)
+{
+  /* May be called on a worker thread, so must only touch the job */
+  BatchJob *const bj = job;
+  BatchContext const *const context = arg;
+  assert(bj != NULL);
+  assert(context != NULL);
+
+  if (bj->result == BatchResult_Output)
+  {
+    bj->result = compress_file(bj, context->opts.compress);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void report_file(void *const job, void *const arg)
+{
+  /* Called in the same order as files were submitted */
+  BatchJob *const bj = job;
+  BatchContext *const context = arg;
+  assert(bj != NULL);
+  assert(context != NULL);
+  bool const verbose = context->opts.verbose;
+
+  if (bj->result != BatchResult_Ignored)
+  {
+    context->stats.num_checked++;
+  }
+
+  switch (bj->result)
+  {
+    case BatchResult_Ignored:
+      if (verbose)
+      {
+        printf("Ignoring %s\n", bj->load_path);
+      }
+      break;
+
+    case BatchResult_Output:
+      if (verbose)
+      {
+        printf("%s %s to %s\n",
+               context->opts.compress ? "Compressed" : "Decompressed",
+               bj->load_path, bj->save_path);
+      }
+      context->stats.num_output++;
+      break;
+
+    default:
+      fprintf(stderr, "%s: %s: %s\n", prog_name,
+              bj->result == BatchResult_OpenOutFail ||
+              bj->result == BatchResult_WriteFail ||
+              bj->result == BatchResult_DirFail ?
+                bj->save_path : bj->load_path,
+              result_text(bj->result));
+      context->stats.num_failed++;
+      break;
+  }
+
+  free(bj);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static BatchResult prepare_job(BatchJob *const bj,
+  BatchOptions const *const opts)
+{
+  assert(bj != NULL);
+  assert(opts != NULL);
+
+  int input_type;
+  BatchResult result = make_save_path(bj->save_path, sizeof(bj->save_path),
+                                      bj->load_path, opts, &input_type);
+  if (result != BatchResult_Output)
+  {
+    return result;
+  }
+
+  /* Check whether we should load the file */
+  if (compressed_file_type(input_type) != opts->compress)
+  {
+    /* Directories are created on this thread, in the same order as a
+       serial scan, so that workers never race to create them. */
+    result = make_path(bj->save_path, opts->make_path_offset);
+  }
+  else
+  {
+    result = BatchResult_Ignored;
+  }
+
+  return result;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool submit_file(BatchPool *const pool,
+  BatchOptions const *const opts, char const *const load_path)
+{
+  assert(pool != NULL);
+  assert(opts != NULL);
+  assert(load_path != NULL);
+
+  _Optional BatchJob *const bj = malloc(sizeof(*bj));
+  if (!bj)
+  {
+    fprintf(stderr, "%s: %s\n", prog_name, result_text(BatchResult_NoMem));
+    return false;
+  }
+
+  *bj = (BatchJob){.result = BatchResult_Ignored};
+
+  size_t const len = strlen(load_path);
+  if (len >= sizeof(bj->load_path))
+  {
+    /* Still submitted so that the error is reported in order */
+    bj->result = BatchResult_StrOFlo;
+    memcpy(bj->load_path, load_path, sizeof(bj->load_path) - 1);
+  }
+  else
+  {
+    memcpy(bj->load_path, load_path, len + 1);
+    bj->result = prepare_job(&*bj, opts);
+  }
+
+  batchpool_submit(pool, &*bj);
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool submit_list(BatchPool *const pool,
+  BatchOptions const *const opts, FILE *const list)
+{
+  assert(pool != NULL);
+  assert(opts != NULL);
+  assert(list != NULL);
+
+  /* One character more than fits in a job, to detect long lines */
+  char line[MaxPathLen + 1];
+  while (fgets(line, sizeof(line), list))
+  {
+    size_t len = strlen(line);
+    if (len == sizeof(line) - 1 && line[len - 1] != '\n')
+    {
+      /* Skip the rest of the line, instead of treating it as another file
+         name. The start of the line is submitted for the error to be
+         reported in order. */
+      int c;
+      do
+      {
+        c = fgetc(list);
+      }
+      while (c != EOF && c != '\n');
+    }
+    else
+    {
+      while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      {
+        line[--len] = '\0';
+      }
+    }
+
+    if (len > 0 && !submit_file(pool, opts, line))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool is_dir(char const *const path, bool const follow_link)
+{
+  assert(path != NULL);
+#if defined(_WIN32)
+  DWORD const attr = GetFileAttributesA(path);
+  return attr != INVALID_FILE_ATTRIBUTES &&
+         (attr & FILE_ATTRIBUTE_DIRECTORY) &&
+         (follow_link || !(attr & FILE_ATTRIBUTE_REPARSE_POINT));
+#else
+  struct stat info;
+  return !(follow_link ? stat(path, &info) : lstat(path, &info)) &&
+         S_ISDIR(info.st_mode);
+#endif
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool add_name(DirListing *const listing, char const *const name)
+{
+  assert(listing != NULL);
+  assert(name != NULL);
+
+  if (!strcmp(name, ".") || !strcmp(name, ".."))
+  {
+    return true;
+  }
+
+  if (listing->count == listing->size)
+  {
+    size_t const new_size = listing->size ? listing->size * 2 : MinListingSize;
+    _Optional char **const names = realloc(listing->names,
+                                           new_size * sizeof(*names));
+    if (!names)
+    {
+      return false;
+    }
+    listing->names = &*names;
+    listing->size = new_size;
+  }
+
+  size_t const len = strlen(name);
+  _Optional char *const copy = malloc(len + 1);
+  if (!copy)
+  {
+    return false;
+  }
+  memcpy(&*copy, name, len + 1);
+  listing->names[listing->count++] = &*copy;
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static BatchResult read_dir(char const *const path,
+  DirListing *const listing)
+{
+  assert(path != NULL);
+  assert(listing != NULL);
+
+  BatchResult result = BatchResult_Output;
+#if defined(_WIN32)
+  size_t const len = strlen(path);
+  _Optional char *const pattern = malloc(len + sizeof("\\*"));
+  if (!pattern)
+  {
+    return BatchResult_NoMem;
+  }
+  sprintf(&*pattern, "%s\\*", path);
+
+  WIN32_FIND_DATAA data;
+  HANDLE const find = FindFirstFileA(&*pattern, &data);
+  free(pattern);
+  if (find == INVALID_HANDLE_VALUE)
+  {
+    return BatchResult_OpenDirFail;
+  }
+
+  do
+  {
+    if (!add_name(listing, data.cFileName))
+    {
+      result = BatchResult_NoMem;
+    }
+  }
+  while (result == BatchResult_Output && FindNextFileA(find, &data));
+
+  FindClose(find);
+#else
+  _Optional DIR *const dir = opendir(path);
+  if (!dir)
+  {
+    return BatchResult_OpenDirFail;
+  }
+
+  for (_Optional struct dirent *entry = readdir(&*dir);
+       result == BatchResult_Output && entry != NULL;
+       entry = readdir(&*dir))
+  {
+    if (!add_name(listing, entry->d_name))
+    {
+      result = BatchResult_NoMem;
+    }
+  }
+
+  closedir(&*dir);
+#endif
+  return result;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int compare_names(void const *const a, void const *const b)
+{
+  /* Same order as a RISC OS directory, which ignores case */
+  char const *const name_a = *(char *const *)a;
+  char const *const name_b = *(char *const *)b;
+
+  for (size_t i = 0; name_a[i] != '\0' || name_b[i] != '\0'; ++i)
+  {
+    int const diff = tolower((unsigned char)name_a[i]) -
+                     tolower((unsigned char)name_b[i]);
+    if (diff)
+    {
+      return diff;
+    }
+  }
+  return strcmp(name_a, name_b);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool submit_tree(BatchPool *const pool,
+  BatchOptions const *const opts, char const *const path,
+  bool const follow_link)
+{
+  /* Submits every file below 'path' in the order of a directory scan,
+     or 'path' itself if it isn't a directory. Links found in a directory
+     are not followed, in case they lead back to the same directory. */
+  assert(pool != NULL);
+  assert(opts != NULL);
+  assert(path != NULL);
+
+  if (!is_dir(path, follow_link))
+  {
+    if (!follow_link && is_dir(path, true))
+    {
+      /* Ignore a link to a directory */
+      return true;
+    }
+    return submit_file(pool, opts, path);
+  }
+
+  DirListing listing = {.names = NULL};
+  BatchResult const result = read_dir(path, &listing);
+  bool ok = (result == BatchResult_Output);
+  if (!ok)
+  {
+    fprintf(stderr, "%s: %s: %s\n", prog_name, path, result_text(result));
+  }
+  else
+  {
+    qsort(listing.names, listing.count, sizeof(*listing.names),
+          compare_names);
+  }
+
+  size_t const len = strlen(path);
+  bool const add_sep = !is_separator(path[len - 1]);
+
+  for (size_t i = 0; ok && i < listing.count; ++i)
+  {
+    _Optional char *const child = malloc(len + 1 +
+                                         strlen(listing.names[i]) + 1);
+    if (!child)
+    {
+      fprintf(stderr, "%s: %s\n", prog_name, result_text(BatchResult_NoMem));
+      ok = false;
+    }
+    else
+    {
+      sprintf(&*child, "%s%s%s", path, add_sep ? "/" : "", listing.names[i]);
+      ok = submit_tree(pool, opts, &*child, false);
+      free(child);
+    }
+  }
+
+  for (size_t i = 0; i < listing.count; ++i)
+  {
+    free(listing.names[i]);
+  }
+  free(listing.names);
+  return ok;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: %s [options] in_root out_root [file...]\n"
+    "Compress or decompress files in the in_root directory, saving the\n"
+    "output in the equivalent place in the out_root directory.\n"
+    "Every file below in_root is processed unless files are named.\n"
+    "A file name of - reads a list of file names from the standard input.\n"
+    "Options:\n"
+    "  -d        Decompress files (the default is to compress them)\n"
+    "  -j n      Process up to n files at once\n"
+    "  -t type   Give compressed files this hexadecimal file type\n"
+    "  -v        Report the progress of each file\n"
+    "File types are taken from ',xxx' file name suffixes.\n",
+    prog_name);
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+int main(int argc, char *argv[])
+{
+  BatchContext context = {.opts = {.comp_type = FileType_Fednet,
+                                   .compress = true}};
+  BatchOptions *const opts = &context.opts;
+  int nthreads = 0;
+
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; ++arg)
+  {
+    char const *const opt = argv[arg];
+    if (!strcmp(opt, "-d"))
+    {
+      opts->compress = false;
+    }
+    else if (!strcmp(opt, "-v"))
+    {
+      opts->verbose = true;
+    }
+    else if (!strcmp(opt, "-t") && arg + 1 < argc)
+    {
+      char *endp;
+      long int const type = strtol(argv[++arg], &endp, 16);
+      if (*endp != '\0' || !compressed_file_type((int)type))
+      {
+        usage();
+        return EXIT_FAILURE;
+      }
+      opts->comp_type = (int)type;
+    }
+    else if (!strcmp(opt, "-j") && arg + 1 < argc)
+    {
+      char *endp;
+      long int const n = strtol(argv[++arg], &endp, 10);
+      if (*endp != '\0' || n < 1 || n > INT_MAX)
+      {
+        usage();
+        return EXIT_FAILURE;
+      }
+      /* The main thread only feeds the queue and reports results */
+      nthreads = n > 1 ? (int)n : 0;
+    }
+    else if (!strcmp(opt, "--"))
+    {
+      ++arg;
+      break;
+    }
+    else
+    {
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc - arg < 2)
+  {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  opts->load_root = trim_separators(argv[arg++]);
+  opts->save_root = trim_separators(argv[arg++]);
+
+  /* We want to create the root output directory and all of its descendants
+     but not any of its ancestors.
+   e.g. save_root = "/tmp/Landscapes", last_sep = "/Landscapes", make_path_offset = 5
+        makes "/tmp/Landscapes" and any descendants */
+  char const *last_sep = NULL;
+  for (char const *p = opts->save_root; *p != '\0'; ++p)
+  {
+    if (is_separator(*p))
+    {
+      last_sep = p;
+    }
+  }
+  opts->make_path_offset = (last_sep == NULL) ? 0 : last_sep - opts->save_root + 1;
+
+  _Optional BatchPool *const pool = batchpool_create(nthreads,
+    (size_t)(nthreads > 0 ? nthreads * QueueSlotsPerThread : 1),
+    process_file, report_file, &context);
+  if (!pool)
+  {
+    fprintf(stderr, "%s: %s\n", prog_name, result_text(BatchResult_NoMem));
+    return EXIT_FAILURE;
+  }
+
+  bool ok = true;
+  if (arg == argc)
+  {
+    ok = submit_tree(&*pool, opts, opts->load_root, true);
+  }
+
+  for (; ok && arg < argc; ++arg)
+  {
+    if (!strcmp(argv[arg], "-"))
+    {
+      ok = submit_list(&*pool, opts, stdin);
+    }
+    else
+    {
+      ok = submit_file(&*pool, opts, argv[arg]);
+    }
+  }
+
+  /* Waits for outstanding files to be processed */
+  batchpool_destroy(pool);
+
+  if (opts->verbose)
+  {
+    printf("%lu files checked, %lu output, %lu failed\n",
+           context.stats.num_checked, context.stats.num_output,
+           context.stats.num_failed);
+  }
+
+  return !ok || context.stats.num_failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
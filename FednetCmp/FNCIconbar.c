@@ -46,6 +46,7 @@
 
 /* Local headers */
 #include "Utils.h"
+#include "CompType.h"
 #include "SaveFile.h"
 #include "SaveComp.h"
 #include "SaveDir.h"
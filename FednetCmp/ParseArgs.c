@@ -42,6 +42,7 @@
 /* Local headers */
 #include "FNCIconbar.h"
 #include "Utils.h"
+#include "CompType.h"
 #include "ParseArgs.h"
 #include "Scan.h"
 
@@ -60,9 +60,16 @@
 #include "StringBuff.h"
 #include "UserData.h"
 #include "EventExtra.h"
+#include "ReaderRaw.h"
+#include "ReaderGKey.h"
+#include "WriterRaw.h"
+#include "WriterGKey.h"
 
 /* Local headers */
 #include "Utils.h"
+#include "CompType.h"
+#include "FNCInit.h"
+#include "ScanStats.h"
 #include "Scan.h"
 
 #ifdef USE_OPTIONAL
@@ -88,15 +95,41 @@ typedef enum
   ScanStatus_Error,
   ScanStatus_Paused,
   ScanStatus_ExamineObject,
-  ScanStatus_Load,
-  ScanStatus_MakePath,
-  ScanStatus_Save,
-  ScanStatus_SetFileType,
+  ScanStatus_Load, /* from ExamineObject */
+  ScanStatus_OpenInput, /* from ExamineObject */
+  ScanStatus_MakePath, /* from Load or OpenInput */
+  ScanStatus_Save, /* from Load or MakePath */
+  ScanStatus_OpenOutput, /* from OpenInput or MakePath */
+  ScanStatus_Stream, /* from OpenOutput */
+  ScanStatus_CloseOutput, /* from Stream */
+  ScanStatus_SetFileType, /* from Save or CloseOutput */
   ScanStatus_NextObject,
   ScanStatus_Finished
 }
 ScanStatus;
 
+/* Names of phases in the statistics */
+static char const *const phase_names[] =
+{
+  [ScanStatus_Error] = "Error",
+  [ScanStatus_Paused] = "Paused",
+  [ScanStatus_ExamineObject] = "ExamineObject",
+  [ScanStatus_Load] = "Load",
+  [ScanStatus_OpenInput] = "OpenInput",
+  [ScanStatus_MakePath] = "MakePath",
+  [ScanStatus_Save] = "Save",
+  [ScanStatus_OpenOutput] = "OpenOutput",
+  [ScanStatus_Stream] = "Stream",
+  [ScanStatus_CloseOutput] = "CloseOutput",
+  [ScanStatus_SetFileType] = "SetFileType",
+  [ScanStatus_NextObject] = "NextObject",
+  [ScanStatus_Finished] = "Finished",
+};
+
+/* Compile-time check that the statistics have room for every phase */
+typedef char phase_names_fit[ARRAY_SIZE(phase_names) <= ScanStatsMaxPhases ?
+                             1 : -1];
+
 /* Constant numeric values */
 enum
 {
@@ -108,7 +141,10 @@ enum
   ProgWindowXOffset = 60,
   Priority          = SchedulerPriority_Max,
   MaxDecimalLen     = 15,
-  MaxActionLen      = 15
+  MaxActionLen      = 15,
+  StreamBufferSize  = 4096,
+  FednetHistoryLog2 = 9, /* Base 2 logarithm of the history size used by
+                            the compression algorithm */
 };
 
 typedef struct
@@ -133,6 +169,20 @@ typedef struct
   char return_action[MaxActionLen + 1];
   StringBuffer load_path, save_path;
   size_t make_path_offset; /* avoids creating directories that should already exist */
+
+  /* Unless the input is to be replaced, each file is streamed through the
+     (de)compressor in small pieces instead of being loaded in full. */
+  bool replace_input;
+  bool has_reader;
+  bool has_writer;
+  _Optional FILE *in;
+  _Optional FILE *out;
+  Reader reader;
+  Writer writer;
+  int in_size;
+  unsigned int perc;
+  ScanStats stats;
+  char stream_buf[StreamBufferSize];
 } ScanData;
 
 static SchedulerIdleFunction do_scan_idle;
@@ -448,7 +498,8 @@ static _Optional const _kernel_oserror *examine_object(ScanData *const scan_data
         if ((is_comp && !scan_data->compress) ||
             (!is_comp && scan_data->compress))
         {
-          new_phase = ScanStatus_Load;
+          new_phase = scan_data->replace_input ?
+                      ScanStatus_Load : ScanStatus_OpenInput;
           skip = false;
 
           /* Remove the previous sub-path (does nothing if already undone) */
@@ -490,6 +541,25 @@ static _Optional const _kernel_oserror *examine_object(ScanData *const scan_data
 
 /* ----------------------------------------------------------------------- */
 
+static unsigned long int get_stats_file_size(ScanData const *const scan_data,
+  char const *const path)
+{
+  /* Whole files are loaded and saved without using a stream whose position
+     can be read, so their sizes are counted instead. */
+  assert(scan_data != NULL);
+  assert(path != NULL);
+
+  int size = 0;
+  if (!scan_stats_is_enabled(&scan_data->stats) ||
+      get_file_size(path, &size) != NULL || size < 0)
+  {
+    return 0;
+  }
+  return (unsigned)size;
+}
+
+/* ----------------------------------------------------------------------- */
+
 static _Optional const _kernel_oserror *scan_load_file(ScanData *const scan_data,
   volatile const bool *const time_up)
 {
@@ -534,6 +604,8 @@ static _Optional const _kernel_oserror *scan_load_file(ScanData *const scan_data
   {
     /* Have finished decompression */
     DEBUG("Have finished loading");
+    scan_stats_add_io(&scan_data->stats, get_stats_file_size(scan_data, path),
+                      0);
     ON_ERR_RPT(slider_set_value(
                    0,
                    scan_data->window_id,
@@ -612,6 +684,8 @@ static _Optional const _kernel_oserror *scan_save_file(ScanData *const scan_data
   {
     /* Have finished saving data */
     DEBUG("Have finished saving data");
+    scan_stats_add_io(&scan_data->stats, 0,
+                      get_stats_file_size(scan_data, path));
 
     ON_ERR_RPT(slider_set_value(
                    0,
@@ -649,6 +723,231 @@ static _Optional const _kernel_oserror *scan_save_file(ScanData *const scan_data
 
 /* ----------------------------------------------------------------------- */
 
+static void set_progress(ScanData *const scan_data, unsigned int const perc)
+{
+  assert(scan_data != NULL);
+
+  if (perc != scan_data->perc)
+  {
+    scan_data->perc = perc;
+    ON_ERR_RPT(slider_set_value(
+                   0,
+                   scan_data->window_id,
+                   ComponentId_Progress_Slider,
+                   perc));
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void scan_count_io(ScanData *const scan_data)
+{
+  assert(scan_data != NULL);
+  scan_stats_count_io(&scan_data->stats, scan_data->in, scan_data->out);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static long int scan_close_streams(ScanData *const scan_data)
+{
+  /* Returns the number of bytes written, or a negative value on failure */
+  assert(scan_data != NULL);
+
+  long int out_bytes = 0;
+  if (scan_data->has_reader)
+  {
+    scan_data->has_reader = false;
+    reader_destroy(&scan_data->reader);
+  }
+
+  if (scan_data->in != NULL)
+  {
+    scan_count_io(scan_data);
+    FILE *const f = &*scan_data->in;
+    scan_data->in = NULL;
+    fclose_dec(f);
+    scan_count_io(scan_data);
+  }
+
+  if (scan_data->has_writer)
+  {
+    scan_data->has_writer = false;
+    out_bytes = writer_destroy(&scan_data->writer);
+  }
+
+  if (scan_data->out != NULL)
+  {
+    scan_count_io(scan_data);
+    FILE *const f = &*scan_data->out;
+    scan_data->out = NULL;
+    if (fclose_dec(f))
+    {
+      out_bytes = -1;
+    }
+    scan_count_io(scan_data);
+  }
+
+  return out_bytes;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static _Optional const _kernel_oserror *scan_open_input(ScanData *const scan_data)
+{
+  assert(scan_data != NULL);
+  assert(scan_data->in == NULL);
+  assert(!scan_data->has_reader);
+
+  char * const path = stringbuffer_get_pointer(&scan_data->load_path);
+  update_window(scan_data, "ScanTLoad", path);
+
+  /* The progress slider shows how much of the input has been consumed */
+  scan_data->perc = 0;
+  ON_ERR_RPT(slider_set_value(
+                 0,
+                 scan_data->window_id,
+                 ComponentId_Progress_Slider,
+                 0));
+
+  ON_ERR_RPT(slider_set_colour(
+                 0,
+                 scan_data->window_id,
+                 ComponentId_Progress_Slider,
+                 WimpColour_LightGreen,
+                 0));
+
+  _Optional const _kernel_oserror *e = get_file_size(path, &scan_data->in_size);
+  if (e != NULL)
+  {
+    return e;
+  }
+
+  scan_data->in = fopen_inc(path, "rb");
+  if (scan_data->in == NULL)
+  {
+    return msgs_error_subn(DUMMY_ERRNO, "OpenInFail", 1, path);
+  }
+
+  if (scan_data->compress)
+  {
+    reader_raw_init(&scan_data->reader, &*scan_data->in);
+  }
+  else if (!reader_gkey_init(&scan_data->reader, FednetHistoryLog2,
+                             &*scan_data->in))
+  {
+    (void)scan_close_streams(scan_data);
+    return msgs_error(DUMMY_ERRNO, "NoMem");
+  }
+  scan_data->has_reader = true;
+
+  scan_data->phase = (scan_data->iterator == NULL) ?
+                     ScanStatus_OpenOutput : ScanStatus_MakePath;
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static _Optional const _kernel_oserror *scan_open_output(ScanData *const scan_data)
+{
+  assert(scan_data != NULL);
+  assert(scan_data->out == NULL);
+  assert(!scan_data->has_writer);
+
+  char * const path = stringbuffer_get_pointer(&scan_data->save_path);
+  update_window(scan_data, "ScanTSave", path);
+
+  scan_data->out = fopen_inc(path, "wb");
+  if (scan_data->out == NULL)
+  {
+    return msgs_error_subn(DUMMY_ERRNO, "OpenOutFail", 1, path);
+  }
+
+  if (!scan_data->compress)
+  {
+    writer_raw_init(&scan_data->writer, &*scan_data->out);
+  }
+  else if (!writer_gkey_init(&scan_data->writer, FednetHistoryLog2,
+                             scan_data->in_size, &*scan_data->out))
+  {
+    (void)scan_close_streams(scan_data);
+    return msgs_error(DUMMY_ERRNO, "NoMem");
+  }
+  scan_data->has_writer = true;
+
+  scan_data->phase = ScanStatus_Stream;
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static _Optional const _kernel_oserror *scan_stream(ScanData *const scan_data)
+{
+  assert(scan_data != NULL);
+  assert(scan_data->in != NULL);
+  assert(scan_data->has_reader);
+  assert(scan_data->has_writer);
+
+  /* Reading, (de)compression and writing are interleaved a piece at a
+     time, so memory usage doesn't depend on the size of the file. */
+  size_t const n = reader_fread(scan_data->stream_buf, 1,
+                                sizeof(scan_data->stream_buf),
+                                &scan_data->reader);
+  assert(n <= sizeof(scan_data->stream_buf));
+
+  if (reader_ferror(&scan_data->reader))
+  {
+    return scan_data->compress ?
+           msgs_error_subn(DUMMY_ERRNO, "ReadFail", 1,
+                           stringbuffer_get_pointer(&scan_data->load_path)) :
+           msgs_error(DUMMY_ERRNO, "BitStream");
+  }
+
+  if (writer_fwrite(scan_data->stream_buf, 1, n, &scan_data->writer) != n)
+  {
+    return msgs_error_subn(DUMMY_ERRNO, "WriteFail", 1,
+                           stringbuffer_get_pointer(&scan_data->save_path));
+  }
+
+  if (reader_feof(&scan_data->reader))
+  {
+    scan_data->phase = ScanStatus_CloseOutput;
+  }
+  else if (scan_data->in_size > 0)
+  {
+    long int const fpos = ftell(&*scan_data->in);
+    if (fpos >= 0 && fpos <= scan_data->in_size)
+    {
+      set_progress(scan_data, (unsigned)((fpos * 100) / scan_data->in_size));
+    }
+  }
+
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static _Optional const _kernel_oserror *scan_close_output(ScanData *const scan_data)
+{
+  assert(scan_data != NULL);
+
+  if (scan_close_streams(scan_data) < 0)
+  {
+    return msgs_error_subn(DUMMY_ERRNO, "WriteFail", 1,
+                           stringbuffer_get_pointer(&scan_data->save_path));
+  }
+
+  set_progress(scan_data, 100);
+
+  /* Update count of files output */
+  scan_data->num_output++;
+  display_nout(scan_data);
+
+  scan_data->phase = ScanStatus_SetFileType;
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
 static void scan_finished(ScanData *const scan_data)
 {
   if (scan_data != NULL)
@@ -679,6 +978,13 @@ static void scan_finished(ScanData *const scan_data)
     if (scan_data->buffer != NULL)
       flex_free(&scan_data->buffer);
 
+    (void)scan_close_streams(scan_data);
+
+    scan_stats_next_file(&scan_data->stats,
+                         stringbuffer_get_pointer(&scan_data->load_path));
+    (void)scan_stats_dump(&scan_data->stats);
+    scan_stats_destroy(&scan_data->stats);
+
     stringbuffer_destroy(&scan_data->load_path);
     stringbuffer_destroy(&scan_data->save_path);
     free(scan_data);
@@ -699,6 +1005,8 @@ static SchedulerTime do_scan_idle(void *const handle, SchedulerTime new_time,
   while (e == NULL && !*time_up && scan_data->phase != ScanStatus_Finished)
   {
     DEBUGF("Idle handler, phase %d\n", scan_data->phase);
+    scan_stats_begin(&scan_data->stats, scan_data->phase);
+
     switch (scan_data->phase)
     {
       case ScanStatus_ExamineObject:
@@ -718,7 +1026,8 @@ static SchedulerTime do_scan_idle(void *const handle, SchedulerTime new_time,
         }
         else
         {
-          scan_data->phase = ScanStatus_Save;
+          scan_data->phase = scan_data->replace_input ?
+                             ScanStatus_Save : ScanStatus_OpenOutput;
         }
         break;
 
@@ -726,6 +1035,22 @@ static SchedulerTime do_scan_idle(void *const handle, SchedulerTime new_time,
         e = scan_save_file(scan_data, time_up);
         break;
 
+      case ScanStatus_OpenInput:
+        e = scan_open_input(scan_data);
+        break;
+
+      case ScanStatus_OpenOutput:
+        e = scan_open_output(scan_data);
+        break;
+
+      case ScanStatus_Stream:
+        e = scan_stream(scan_data);
+        break;
+
+      case ScanStatus_CloseOutput:
+        e = scan_close_output(scan_data);
+        break;
+
       case ScanStatus_SetFileType:
         e = set_file_type(stringbuffer_get_pointer(&scan_data->save_path),
                           scan_data->compress ? scan_data->comp_type : FileType_Data);
@@ -736,6 +1061,9 @@ static SchedulerTime do_scan_idle(void *const handle, SchedulerTime new_time,
         break;
 
       case ScanStatus_NextObject:
+        scan_stats_next_file(&scan_data->stats,
+                             stringbuffer_get_pointer(&scan_data->load_path));
+
         if (scan_data->iterator == NULL)
         {
           scan_data->phase = ScanStatus_Finished;
@@ -756,6 +1084,8 @@ static SchedulerTime do_scan_idle(void *const handle, SchedulerTime new_time,
         assert("Unexpected state" == NULL);
         break;
     }
+
+    scan_stats_end(&scan_data->stats, scan_data->in, scan_data->out);
   }
 
   if (e != NULL)
@@ -768,6 +1098,8 @@ static SchedulerTime do_scan_idle(void *const handle, SchedulerTime new_time,
     assert(scan_data->phase != ScanStatus_Paused);
     assert(scan_data->file_op == NULL);
 
+    (void)scan_close_streams(scan_data);
+
     /* turn progress window into error box */
     display_error(scan_data, error.errmess);
     scheduler_deregister(do_scan_idle, handle); /* cease null-polling */
@@ -950,7 +1282,8 @@ static bool examine_root(ScanData * const scan_data, char const *const load_root
         RPT_ERR("NoMem");
         return false;
       }
-      scan_data->phase = ScanStatus_Load;
+      scan_data->phase = scan_data->replace_input ?
+                         ScanStatus_Load : ScanStatus_OpenInput;
       break;
 
     default: /* assume object is accessible like a directory */
@@ -1024,6 +1357,7 @@ void Scan_create(char *const load_root, char const *const save_root,
     .iterator = NULL,
     .file_op = NULL,
     .return_action[0] = '\0',
+    .replace_input = !stricmp(load_root, save_root),
   };
 
   /* We want to create the root output directory and all of its descendants
@@ -1036,6 +1370,10 @@ void Scan_create(char *const load_root, char const *const save_root,
   stringbuffer_init(&scan_data->load_path);
   stringbuffer_init(&scan_data->save_path);
 
+  /* Statistics are gathered only if a file name was given for them */
+  scan_stats_init(&scan_data->stats, getenv(APP_NAME "$ScanStats"),
+                  phase_names, ARRAY_SIZE(phase_names));
+
   if (!E(toolbox_create_object(0, "Scan", &scan_data->window_id)))
   {
     if (scan_add_to_menu(&*scan_data, load_root))
@@ -1062,7 +1400,8 @@ void Scan_create(char *const load_root, char const *const save_root,
         /* Set up the contents of the progress window */
         scan_set_title(&*scan_data);
         update_window(&*scan_data,
-                      scan_data->phase == ScanStatus_Load ?
+                      scan_data->phase == ScanStatus_Load ||
+                      scan_data->phase == ScanStatus_OpenInput ?
                            "ScanTLoad" : "ScanTOpen",
                       load_root);
         display_nout(&*scan_data);
@@ -1092,5 +1431,6 @@ void Scan_create(char *const load_root, char const *const save_root,
   diriterator_destroy(scan_data->iterator);
   stringbuffer_destroy(&scan_data->load_path);
   stringbuffer_destroy(&scan_data->save_path);
+  scan_stats_destroy(&scan_data->stats);
   free(scan_data);
 }
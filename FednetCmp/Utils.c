@@ -40,6 +40,7 @@
 #include "ReaderGKey.h"
 #include "WriterFlex.h"
 #include "WriterGKey.h"
+#include "WriterGKC.h"
 #include "NoBudge.h"
 #include "FOpenCount.h"
 #include "ReaderFlex.h"
@@ -63,6 +64,9 @@ enum
   FednetHistoryLog2 = 9, /* Base 2 logarithm of the history size used by
                             the compression algorithm */
   WorstBitsPerChar = 9,
+  SampleBlockSize = 2048, /* Much bigger than the history size, so that
+                             the cold start of each block matters little */
+  SampleBlockCount = 16,
   OSByte_RWEscapeKeyStatus    = 229, /* _kernel_osbyte reason code */
   OSByte_ClearEscapeCondition = 124  /* _kernel_osbyte reason code */
 };
@@ -70,34 +74,6 @@ enum
 /* ----------------------------------------------------------------------- */
 /*                         Public functions                                */
 
-bool compressed_file_type(int file_type)
-{
-  static int const comp_types[] =
-  {
-    FileType_Fednet,
-    FileType_SFObjGfx,
-    FileType_SFBasMap,
-    FileType_SFBasObj,
-    FileType_SFOvrMap,
-    FileType_SFOvrObj,
-    FileType_SFSkyCol,
-    FileType_SFMissn,
-    FileType_SFSkyPic,
-    FileType_SFMapGfx,
-    FileType_SFMapAni
-  };
-
-  for (size_t i = 0; i < ARRAY_SIZE(comp_types); i++)
-  {
-    if (comp_types[i] == file_type)
-      return true; /* file type is compressed */
-  }
-
-  return false; /* unrecognised file type */
-}
-
-/* ----------------------------------------------------------------------- */
-
 typedef enum
 {
   Copy_OK,
@@ -292,11 +268,111 @@ bool copy_to_buf(void *const handle, Reader *const src,
 
 /* ----------------------------------------------------------------------- */
 
+static long int count_comp_size(Reader *const reader, long int const nbytes)
+{
+  /* Returns the size of the next 'nbytes' from the reader, compressed on
+     their own, or -1 on failure. */
+  assert(reader != NULL);
+  assert(nbytes >= 0);
+
+  Writer counter;
+  long int out_size = 0;
+  if (!writer_gkc_init(&counter, FednetHistoryLog2, &out_size))
+  {
+    return -1;
+  }
+
+  char buf[SampleBlockSize];
+  bool ok = true;
+  for (long int done = 0; ok && done < nbytes; )
+  {
+    size_t const n = (size_t)LOWEST(nbytes - done, (long int)sizeof(buf));
+    ok = (reader_fread(buf, 1, n, reader) == n) &&
+         (writer_fwrite(buf, 1, n, &counter) == n);
+    done += (long int)n;
+  }
+
+  /* writer_destroy returns the uncompressed size, not the compressed size */
+  if (writer_destroy(&counter) < 0)
+  {
+    ok = false;
+  }
+  return ok ? out_size : -1;
+}
+
+/* ----------------------------------------------------------------------- */
+
 int get_comp_size(flex_ptr buffer)
 {
-  /* Worst-case estimate */
-  return sizeof(int32_t) +
-    ((flex_size(buffer) * WorstBitsPerChar) / CHAR_BIT);
+  /* Exact for small inputs. Larger inputs are estimated by compressing a
+     fixed number of sample blocks, so that the time taken is bounded.
+     See Utils.h for the error bound and cap. */
+  int const size = *buffer ? flex_size(buffer) : 0;
+  long int const worst = sizeof(int32_t) +
+    (((long int)size * WorstBitsPerChar) / CHAR_BIT);
+  long int estimate = worst;
+
+  Reader reader;
+  reader_flex_init(&reader, buffer);
+
+  if (size <= SampleBlockSize * SampleBlockCount)
+  {
+    /* Cheap enough to compress everything */
+    long int const comp_size = count_comp_size(&reader, size);
+    if (comp_size >= 0)
+    {
+      estimate = comp_size;
+    }
+  }
+  else
+  {
+    /* Compress blocks spread evenly across the input and extrapolate
+       from their total size. The per-file overhead is found by compressing
+       nothing, so that it isn't counted once per block. */
+    long int const overhead = count_comp_size(&reader, 0);
+    long int total = 0, min = LONG_MAX, max = 0;
+    bool ok = (overhead >= 0);
+
+    long int const step = (size - SampleBlockSize) / (SampleBlockCount - 1);
+    for (int b = 0; ok && b < SampleBlockCount; ++b)
+    {
+      long int const offset = step * b;
+
+      long int comp_size = -1;
+      if (!reader_fseek(&reader, offset, SEEK_SET))
+      {
+        comp_size = count_comp_size(&reader, SampleBlockSize);
+      }
+
+      if (comp_size < overhead)
+      {
+        ok = false;
+      }
+      else
+      {
+        comp_size -= overhead;
+        total += comp_size;
+        min = LOWEST(min, comp_size);
+        max = HIGHEST(max, comp_size);
+      }
+    }
+
+    if (ok)
+    {
+      double const scale = (double)size / (SampleBlockSize * SampleBlockCount);
+      estimate = overhead + (long int)((total * scale) + 0.5);
+
+      /* If every unsampled block compresses no better than the best sampled
+         block and no worse than the worst then this bounds the error. */
+      DEBUGF("Estimated compressed size %ld +/- %ld\n", estimate,
+             (long int)((max - min) * SampleBlockCount * (scale - 1)));
+    }
+  }
+
+  reader_destroy(&reader);
+
+  /* Never more than the worst case, which was the old estimate */
+  return (int)LOWEST(estimate, worst);
 }
 
 /* ----------------------------------------------------------------------- */
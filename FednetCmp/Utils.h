@@ -13,12 +13,20 @@
 #include "Reader.h"
 #include "Writer.h"
 
-bool compressed_file_type(int file_type);
-
 bool copy_to_buf(void *handle, Reader *src,
   int src_size, char const *filename);
 
 int get_decomp_size(flex_ptr buffer);
+
+/* Returns the compressed size of the given data, which is exact for up to
+   32 KiB. Beyond that, it is only an estimate, extrapolated from 16 blocks
+   of 2 KiB sampled evenly across the data, so it may be too high or too
+   low. If no unsampled block compresses better than the best sampled block
+   or worse than the worst then the error is at most
+   (max - min) * (size / 2048 - 16) bytes, where min and max are the
+   compressed sizes of the best and worst sampled blocks. The result is
+   capped at the worst case, 4 + (size * 9 / 8) bytes, which is also
+   returned if the data can't be read. */
 int get_comp_size(flex_ptr buffer);
 
 bool decomp_from_buf(Writer *dst, void *handle,
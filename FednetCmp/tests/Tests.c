@@ -22,6 +22,7 @@
 
 /* ANSI library files */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <time.h>
@@ -53,10 +54,13 @@
 #include "msgtrans.h"
 #include "Hourglass.h"
 #include "FileRWInt.h"
+#include "WriterFlex.h"
+#include "WriterGKC.h"
 
 /* Local header files */
 #include "../FNCInit.h"
 #include "../FNCSaveBox.h"
+#include "../Utils.h"
 
 #ifdef FORTIFY
 #include "Fortify.h"
@@ -112,8 +116,17 @@ enum
   OS_FSControl_Wipe = 27,
   OS_FSControl_Flag_Recurse = 1,
   //OS_FSControl = 0x29,
+  WorstBitsPerChar = 9, /* as assumed by get_comp_size */
+  SampleBlockSize = 2048,
+  SampleBlockCount = 16,
+  ExactCompSizeMax = SampleBlockSize * SampleBlockCount,
+  LargeBlockCount = 76, /* Sampled blocks are 5 blocks apart */
+  SmallAlphabet = 16,
+  FullAlphabet = 256,
 };
 
+static char comp_size_data[SampleBlockSize * LargeBlockCount];
+
 static void wipe(char const *path_name)
 {
   _kernel_swi_regs regs;
@@ -1565,6 +1578,145 @@ static void test17(void)
   assert(limit != FortifyAllocationLimit);
 }
 
+static void make_comp_size_data(size_t const size, int const alphabet)
+{
+  /* Pseudo-random characters from the given number of codes */
+  assert(size <= sizeof(comp_size_data));
+  unsigned long state = 1;
+  for (size_t i = 0; i < size; ++i)
+  {
+    state = (state * 1103515245 + 12345) & 0x7fffffff;
+    comp_size_data[i] = (char)((state >> 16) % alphabet);
+  }
+}
+
+static long int worst_comp_size(size_t const size)
+{
+  return sizeof(int32_t) + (((long int)size * WorstBitsPerChar) / CHAR_BIT);
+}
+
+static long int count_comp_size(char const *const data, size_t const size)
+{
+  Writer writer;
+  long int out_size = 0;
+  bool const ok = writer_gkc_init(&writer, FednetHistoryLog2, &out_size);
+  assert(ok);
+  size_t const n = writer_fwrite(data, 1, size, &writer);
+  assert(n == size);
+  long int const len = writer_destroy(&writer);
+  assert(len >= 0);
+  return out_size;
+}
+
+static int estimate_comp_size(size_t const size)
+{
+  void *anchor = NULL;
+  if (size > 0)
+  {
+    bool const ok = flex_alloc(&anchor, (int)size);
+    assert(ok);
+    memcpy(anchor, comp_size_data, size);
+  }
+
+  int const comp_size = get_comp_size(&anchor);
+
+  if (anchor != NULL)
+  {
+    flex_free(&anchor);
+  }
+  return comp_size;
+}
+
+static long int real_comp_size(size_t const size)
+{
+  void *in = NULL, *out = NULL;
+  bool ok = flex_alloc(&in, (int)size);
+  assert(ok);
+  memcpy(in, comp_size_data, size);
+
+  Writer writer;
+  writer_flex_init(&writer, &out);
+  ok = comp_from_buf(&writer, &in, TEST_LEAFNAME);
+  assert(ok);
+  long int const comp_size = writer_destroy(&writer);
+  assert(comp_size >= 0);
+
+  flex_free(&in);
+  if (out != NULL)
+  {
+    flex_free(&out);
+  }
+  return comp_size;
+}
+
+static void test18(void)
+{
+  /* Exact compressed size of small data */
+  static size_t const sizes[] = {1, TestDataSize, 1000, ExactCompSizeMax};
+  static int const alphabets[] = {SmallAlphabet, FullAlphabet};
+
+  for (size_t a = 0; a < ARRAY_SIZE(alphabets); ++a)
+  {
+    for (size_t i = 0; i < ARRAY_SIZE(sizes); ++i)
+    {
+      make_comp_size_data(sizes[i], alphabets[a]);
+      int const estimate = estimate_comp_size(sizes[i]);
+      long int const comp_size = real_comp_size(sizes[i]);
+      DEBUGF("Size %zu: estimated %d, actual %ld\n", sizes[i], estimate,
+             comp_size);
+      assert(estimate == comp_size);
+    }
+  }
+}
+
+static void test19(void)
+{
+  /* Estimated compressed size of large data */
+  size_t const size = sizeof(comp_size_data);
+  make_comp_size_data(size, SmallAlphabet);
+
+  /* The estimate is extrapolated from every fifth block compressed on its
+     own, so its error is bounded by the range of sizes of all blocks
+     compressed on their own. */
+  long int const overhead = count_comp_size(comp_size_data, 0);
+  long int total = overhead, min = LONG_MAX, max = 0;
+  for (size_t b = 0; b < LargeBlockCount; ++b)
+  {
+    long int const comp_size = count_comp_size(
+                       comp_size_data + (b * SampleBlockSize),
+                       SampleBlockSize) - overhead;
+    total += comp_size;
+    min = LOWEST(min, comp_size);
+    max = HIGHEST(max, comp_size);
+  }
+
+  long int const bound = ((max - min) * (LargeBlockCount - SampleBlockCount)) + 1;
+  int const estimate = estimate_comp_size(size);
+  DEBUGF("Estimated %d, blocks total %ld +/- %ld\n", estimate, total,
+         bound);
+
+  assert(labs(estimate - total) <= bound);
+  assert(estimate <= worst_comp_size(size));
+}
+
+static void test20(void)
+{
+  /* Compressed size estimate is never more than the worst case */
+  static size_t const sizes[] = {0, 1, ExactCompSizeMax,
+                                 ExactCompSizeMax + 1,
+                                 sizeof(comp_size_data)};
+
+  for (size_t i = 0; i < ARRAY_SIZE(sizes); ++i)
+  {
+    make_comp_size_data(sizes[i], FullAlphabet);
+    int const estimate = estimate_comp_size(sizes[i]);
+    DEBUGF("Size %zu: estimated %d, worst %ld\n", sizes[i], estimate,
+           worst_comp_size(sizes[i]));
+    assert(estimate > 0);
+    assert(estimate <= worst_comp_size(sizes[i]));
+  }
+}
+
 #ifdef FORTIFY
 static bool fortify_detected = false;
 
@@ -1621,7 +1773,10 @@ int main(int argc, char *argv[])
     { "Uncompressed file from app", test14 },
     { "Compressed file from app", test15 },
     { "Uncompressed file from app with bounce", test16 },
-    { "Uncompressed file from app with broken RAM transfer", test17 }
+    { "Uncompressed file from app with broken RAM transfer", test17 },
+    { "Exact compressed size", test18 },
+    { "Estimated compressed size", test19 },
+    { "Compressed size never more than worst case", test20 }
   };
 
   initialise();
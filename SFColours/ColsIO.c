@@ -56,7 +56,6 @@
 #include "WimpExtra.h"
 #include "msgtrans.h"
 #include "Loader3.h"
-#include "CSV.h"
 #include "ScreenSize.h"
 #include "SFFormats.h"
 #include "DragAnObj.h"
@@ -74,6 +73,7 @@
 #include "EditWin.h"
 #include "Utils.h"
 #include "Menus.h"
+#include "CSVReader.h"
 
 #ifdef USE_OPTIONAL
 #include "Optional.h"
@@ -177,22 +177,13 @@ static int read_csv(int values[], size_t const max, Reader *const reader)
 
   hourglass_on();
 
-  char str[256];
-  size_t const nchars = reader_fread(str, 1, sizeof(str)-1, reader);
-  str[nchars] = '\0';
-
-  _Optional char *endp;
-  size_t nvals = csv_parse_as_int(str, &endp, values, max);
+  /* Only the first record is used */
+  CSVReader csv;
+  csvreader_init(&csv, reader);
+  size_t nvals = csvreader_read_ints(&csv, values, max);
 
   hourglass_off();
 
-  if (endp == NULL && nchars == sizeof(str)-1)
-  {
-    /* We filled the buffer but didn't find the end of the record */
-    WARN("BufOFlo");
-    return -1;
-  }
-
   nvals = LOWEST(nvals, max);
   assert(nvals <= INT_MAX);
   return (int)nvals;
@@ -237,11 +228,6 @@ static bool import_csv(EditWin *const edit_win, Reader *const reader,
   int csv_values[EditWin_MaxSize];
   int const n = read_csv(csv_values, ARRAY_SIZE(csv_values), reader);
 
-  if (n < 0)
-  {
-    return false;
-  }
-
   if (reader_ferror(reader))
   {
     read_fail(src_name);
@@ -163,6 +163,8 @@ struct EditWin
   bool can_paste:1;
 };
 
+GradientStyle gradient_style = GradientStyle_RGB; /* for new files */
+
 static enum
 {
   DragType_None,
@@ -1894,6 +1896,8 @@ _Optional ColMapFile *ColMapFile_create(_Optional Reader *const reader,
                               sizeof(SFObjectColours);
   ColMapState state = edit_colmap_init(&file->edit_colmap, reader, size,
                                        redraw_entry);
+
+  edit_colmap_set_gradient_style(&file->edit_colmap, gradient_style);
   ColMap *const colmap = edit_colmap_get_colmap(&file->edit_colmap);
   bool success = IO_report_read(colmap, state);
 
@@ -18,6 +18,7 @@
 
 #include "ColMap.h"
 #include "ExpColFile.h"
+#include "Gradient.h"
 
 #if !defined(USE_OPTIONAL) && !defined(_Optional)
 #define _Optional
@@ -35,6 +36,8 @@ enum
 typedef struct ColMapFile ColMapFile;
 typedef struct EditWin EditWin;
 
+extern GradientStyle gradient_style;
+
 _Optional ColMapFile *ColMapFile_find_by_file_name(char const *load_path);
 _Optional ColMapFile *ColMapFile_create(_Optional Reader *reader, _Optional char const *load_path,
   bool is_safe, bool hillcols);
@@ -13,10 +13,10 @@
 #include "Macros.h"
 #include "Reader.h"
 #include "PalEntry.h"
-#include "LinkedList.h"
 
 #include "Editor.h"
 #include "ColMap.h"
+#include "UndoRing.h"
 
 #ifdef USE_OPTIONAL
 #include "Optional.h"
@@ -27,6 +27,7 @@ enum
 {
   NPixelColours = 256,
   InvalidColour = 0,
+  UndoBudget = 64 * 1024, /* bytes per file */
 };
 
 typedef struct {
@@ -36,7 +37,6 @@ typedef struct {
 
 
 typedef struct EditRecord {
-  LinkedListItem link;
   int size;
   EditSubrecord subrec[];
 } EditRecord;
@@ -88,56 +88,73 @@ static inline bool get_is_selected(Editor const *const editor, int const pos)
   return editor->selected[offset] & mask;
 }
 
-static _Optional LinkedListItem *get_redo_item(EditColMap *const edit_colmap)
+static _Optional EditRecord *get_redo_record(EditColMap *const edit_colmap)
 {
   assert(edit_colmap != NULL);
 
-  _Optional LinkedListItem *redo_item = NULL;
+  _Optional EditRecord *redo_rec = NULL;
   if (edit_colmap->next_undo)
   {
-    redo_item = linkedlist_get_next(&*edit_colmap->next_undo);
+    redo_rec = undo_ring_get_next(&edit_colmap->undo_ring,
+                                  &*edit_colmap->next_undo);
   }
   else
   {
-    redo_item = linkedlist_get_head(&edit_colmap->undo_list);
+    redo_rec = undo_ring_get_oldest(&edit_colmap->undo_ring);
   }
-  return redo_item;
+  return redo_rec;
 }
 
-static bool destroy_record(LinkedList *const list, LinkedListItem *const item,
-  void *const arg)
+static void discard_oldest(EditColMap *const edit_colmap)
 {
-  NOT_USED(arg);
-  EditRecord *const rec = CONTAINER_OF(item, EditRecord, link);
+  assert(edit_colmap != NULL);
+
+  _Optional EditRecord *const rec =
+    undo_ring_get_oldest(&edit_colmap->undo_ring);
+  assert(rec != NULL);
+
   DEBUGF("Discarding undo record %p\n", (void *)rec);
-  linkedlist_remove(list, item);
-  free(rec);
-  return false; /* continue */
+  if (edit_colmap->next_undo == rec)
+  {
+    edit_colmap->next_undo = NULL;
+    edit_colmap->merge_undo = false;
+  }
+  undo_ring_free_oldest(&edit_colmap->undo_ring);
 }
 
 static _Optional EditRecord *make_record(EditColMap *const edit_colmap, int const size)
 {
   assert(edit_colmap != NULL);
+  assert(size >= 0);
 
-  _Optional EditRecord *const rec = malloc(sizeof(*rec) + (sizeof(rec->subrec[0]) * size));
-  if (rec)
+  /* Records are stored in the order they were made, so the redo history
+     can be discarded all at once. */
+  if (edit_colmap->next_undo)
   {
-    *rec = (EditRecord){.size = 0};
-
-    _Optional LinkedListItem *const redo_item = get_redo_item(edit_colmap);
-    _Optional LinkedListItem *next = NULL;
+    undo_ring_free_after(&edit_colmap->undo_ring, &*edit_colmap->next_undo);
+  }
+  else
+  {
+    undo_ring_free_all(&edit_colmap->undo_ring);
+  }
 
-    for (_Optional LinkedListItem *item = redo_item; item != NULL; item = next)
+  _Optional EditRecord *rec = NULL;
+  for (;;)
+  {
+    rec = undo_ring_alloc(&edit_colmap->undo_ring,
+                          sizeof(*rec) + (sizeof(rec->subrec[0]) * size));
+    if (rec || undo_ring_is_empty(&edit_colmap->undo_ring))
     {
-      next = linkedlist_get_next(&*item);
-      destroy_record(&edit_colmap->undo_list, &*item, edit_colmap);
+      break;
     }
+    discard_oldest(edit_colmap);
+  }
 
-    linkedlist_insert(&edit_colmap->undo_list, edit_colmap->next_undo,
-      &rec->link);
-
+  if (rec)
+  {
+    *rec = (EditRecord){.size = 0};
     DEBUGF("Created undo record %p\n", (void *)rec);
-    edit_colmap->next_undo = &rec->link;
+    edit_colmap->next_undo = rec;
   }
   else
   {
@@ -147,6 +164,40 @@ static _Optional EditRecord *make_record(EditColMap *const edit_colmap, int cons
   return rec;
 }
 
+static void finish_record(EditColMap *const edit_colmap, EditRecord *const rec)
+{
+  assert(edit_colmap != NULL);
+  assert(rec != NULL);
+  assert(edit_colmap->next_undo == rec);
+
+  /* Release space reserved for colours that were not changed */
+  undo_ring_shrink_newest(&edit_colmap->undo_ring, sizeof(*rec) +
+                          (sizeof(rec->subrec[0]) * (size_t)rec->size));
+
+  /* Merge consecutive changes to the same colour (e.g. while dragging)
+     so that they are undone in one step */
+  bool const merge = edit_colmap->merge_undo;
+  edit_colmap->merge_undo = (rec->size == 1);
+  if (!merge || rec->size != 1)
+  {
+    return;
+  }
+
+  _Optional EditRecord *const prev = undo_ring_get_prev(
+                                       &edit_colmap->undo_ring, rec);
+  assert(prev != NULL);
+  assert(prev->size == 1);
+  if (prev->subrec[0].pos != rec->subrec[0].pos)
+  {
+    return;
+  }
+
+  DEBUGF("Merging undo record %p into %p\n", (void *)rec, (void *)prev);
+  prev->subrec[0].rep = rec->subrec[0].rep;
+  undo_ring_free_newest(&edit_colmap->undo_ring);
+  edit_colmap->next_undo = prev;
+}
+
 ColMapState edit_colmap_init(EditColMap *const edit_colmap,
   _Optional Reader *const reader, int const size,
   void (*redraw_entry_cb)(EditColMap *, int))
@@ -166,8 +217,11 @@ ColMapState edit_colmap_init(EditColMap *const edit_colmap,
   edit_colmap->redraw_entry_cb = redraw_entry_cb ?
     &*redraw_entry_cb : dummy_redraw;
 
-  linkedlist_init(&edit_colmap->undo_list);
+  undo_ring_init(&edit_colmap->undo_ring, UndoBudget);
   edit_colmap->next_undo = NULL;
+  edit_colmap->merge_undo = false;
+  edit_colmap->pal_lookup = NULL;
+  edit_colmap->gradient_style = GradientStyle_RGB;
 
   return state;
 }
@@ -175,7 +229,16 @@ ColMapState edit_colmap_init(EditColMap *const edit_colmap,
 void edit_colmap_destroy(EditColMap *const edit_colmap)
 {
   assert(edit_colmap != NULL);
-  (void)linkedlist_for_each(&edit_colmap->undo_list, destroy_record, edit_colmap);
+  undo_ring_destroy(&edit_colmap->undo_ring);
+  pal_lookup_destroy(edit_colmap->pal_lookup);
+}
+
+void edit_colmap_set_gradient_style(EditColMap *const edit_colmap,
+  GradientStyle const style)
+{
+  assert(edit_colmap != NULL);
+  DEBUGF("Gradient style for %p is %d\n", (void *)edit_colmap, (int)style);
+  edit_colmap->gradient_style = style;
 }
 
 ColMap *edit_colmap_get_colmap(EditColMap *const edit_colmap)
@@ -198,7 +261,7 @@ bool editor_can_redo(Editor const *const editor)
   EditColMap *const edit_colmap = editor->edit_colmap;
   assert(edit_colmap != NULL);
   return edit_colmap->next_undo !=
-         linkedlist_get_tail(&edit_colmap->undo_list);
+         undo_ring_get_newest(&edit_colmap->undo_ring);
 }
 
 bool editor_undo(Editor const *const editor)
@@ -212,10 +275,11 @@ bool editor_undo(Editor const *const editor)
 
   EditColMap *const edit_colmap = editor->edit_colmap;
   assert(edit_colmap != NULL);
-  EditRecord *const undo = CONTAINER_OF(edit_colmap->next_undo,
-    EditRecord, link);
+  assert(edit_colmap->next_undo != NULL);
+  EditRecord *const undo = &*edit_colmap->next_undo;
 
-  edit_colmap->next_undo = linkedlist_get_prev(&undo->link);
+  edit_colmap->next_undo = undo_ring_get_prev(&edit_colmap->undo_ring, undo);
+  edit_colmap->merge_undo = false;
 
   bool changed = false;
   int const size = undo->size;
@@ -243,10 +307,11 @@ bool editor_redo(Editor const *const editor)
 
   EditColMap *const edit_colmap = editor->edit_colmap;
   assert(edit_colmap != NULL);
-  _Optional LinkedListItem *const redo_item = get_redo_item(edit_colmap);
-  assert(redo_item != NULL);
-  EditRecord *const redo = CONTAINER_OF(redo_item, EditRecord, link);
-  edit_colmap->next_undo = redo_item;
+  _Optional EditRecord *const redo_rec = get_redo_record(edit_colmap);
+  assert(redo_rec != NULL);
+  EditRecord *const redo = &*redo_rec;
+  edit_colmap->next_undo = redo;
+  edit_colmap->merge_undo = false;
 
   bool changed = false;
   int const size = redo->size;
@@ -495,9 +560,32 @@ EditResult editor_set_plain(Editor *const editor, ColMapEntry const colour)
     }
   }
 
+  finish_record(editor->edit_colmap, &*rec);
   return changed;
 }
 
+static _Optional PalLookup *get_pal_lookup(EditColMap *const edit_colmap,
+  PaletteEntry const palette[])
+{
+  /* Rebuild the inverse colour map if the palette has changed */
+  assert(edit_colmap != NULL);
+  assert(palette != NULL);
+
+  if (edit_colmap->pal_lookup &&
+      !pal_lookup_matches(&*edit_colmap->pal_lookup, palette, NPixelColours))
+  {
+    pal_lookup_destroy(edit_colmap->pal_lookup);
+    edit_colmap->pal_lookup = NULL;
+  }
+
+  if (!edit_colmap->pal_lookup)
+  {
+    edit_colmap->pal_lookup = pal_lookup_create(palette, NPixelColours);
+  }
+
+  return edit_colmap->pal_lookup;
+}
+
 EditResult editor_interpolate(Editor *const editor,
   PaletteEntry const palette[])
 {
@@ -515,6 +603,7 @@ EditResult editor_interpolate(Editor *const editor,
   if (num_selected < 2)
   {
     DEBUGF("Too few (%d) to interpolate\n", num_selected);
+    finish_record(editor->edit_colmap, &*rec);
     return EditResult_Unchanged;
   }
 
@@ -547,24 +636,14 @@ EditResult editor_interpolate(Editor *const editor,
   DEBUGF("Smoothing transitions between %d..%d (%d steps) in file %p\n",
          first, last, steps, (void *)colmap);
 
-  PaletteEntry const
-    first_BGR0 = palette[colmap_get_colour(colmap, first)],
-    last_BGR0 = palette[colmap_get_colour(colmap, last)];
+  /* Without an inverse colour map, search the whole palette instead */
+  _Optional PalLookup *const lookup = get_pal_lookup(editor->edit_colmap,
+                                                     palette);
 
-  uint8_t const r = PALETTE_GET_RED(first_BGR0);
-  int const red_diff = PALETTE_GET_RED(last_BGR0) - r;
-  float red_component = r;
-  float const red_inc = (float)red_diff / steps;
-
-  uint8_t const g = PALETTE_GET_GREEN(first_BGR0);
-  int const green_diff = PALETTE_GET_GREEN(last_BGR0) - g;
-  float green_component = g;
-  float const green_inc = (float)green_diff / steps;
-
-  uint8_t const b = PALETTE_GET_BLUE(first_BGR0);
-  int const blue_diff = PALETTE_GET_BLUE(last_BGR0) - b;
-  float blue_component = b;
-  float const blue_inc = (float)blue_diff / steps;
+  Gradient gradient;
+  gradient_init(&gradient, editor->edit_colmap->gradient_style, palette,
+                NPixelColours, lookup, colmap_get_colour(colmap, first),
+                colmap_get_colour(colmap, last), steps);
 
   EditResult changed = EditResult_Unchanged;
   for (int pos = first + 1; pos < last; ++pos)
@@ -574,15 +653,8 @@ EditResult editor_interpolate(Editor *const editor,
       continue;
     }
 
-    /* Calculate transitional colour */
-    red_component += red_inc;
-    green_component += green_inc;
-    blue_component += blue_inc;
-
     /* Find nearest to ideal colour in default mode 13 palette */
-    int const nearest_colour = nearest_palette_entry_rgb(
-      palette, NPixelColours, (int)(red_component + 0.5f),
-      (int)(green_component + 0.5f), (int)(blue_component + 0.5f));
+    int const nearest_colour = (int)gradient_next(&gradient);
 
     assert(nearest_colour >= 0);
     assert(nearest_colour < NPixelColours);
@@ -594,6 +666,7 @@ EditResult editor_interpolate(Editor *const editor,
     }
   }
 
+  finish_record(editor->edit_colmap, &*rec);
   return changed;
 }
 
@@ -641,5 +714,6 @@ EditResult editor_set_array(Editor *const editor, int const *const colours,
     }
   }
 
+  finish_record(editor->edit_colmap, &*rec);
   return changed;
 }
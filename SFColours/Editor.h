@@ -13,7 +13,9 @@
 #include "Reader.h"
 #include "ColMap.h"
 #include "PalEntry.h"
-#include "LinkedList.h"
+#include "PalLookup.h"
+#include "Gradient.h"
+#include "UndoRing.h"
 
 #if !defined(USE_OPTIONAL) && !defined(_Optional)
 #define _Optional
@@ -22,8 +24,11 @@
 typedef struct EditColMap {
   ColMap colmap;
   void (*redraw_entry_cb)(struct EditColMap *, int);
-  LinkedList undo_list;
-  _Optional LinkedListItem *next_undo;
+  UndoRing undo_ring; /* oldest to newest undo records */
+  _Optional struct EditRecord *next_undo;
+  bool merge_undo; /* next_undo may absorb a change to the same colour */
+  _Optional PalLookup *pal_lookup; /* built from the last palette used */
+  GradientStyle gradient_style;
 } EditColMap;
 
 typedef struct Editor {
@@ -47,6 +52,11 @@ ColMapState edit_colmap_init(EditColMap *edit_colmap, _Optional Reader *reader,
 /* Destroy an editing session for a colmap file. */
 void edit_colmap_destroy(EditColMap *edit_colmap);
 
+/* Set how subsequent gradient fills are approximated
+   (GradientStyle_RGB by default). */
+void edit_colmap_set_gradient_style(EditColMap *edit_colmap,
+  GradientStyle style);
+
 /* Get the colmap file in an editing session */
 ColMap *edit_colmap_get_colmap(EditColMap *edit_colmap);
 
@@ -0,0 +1,60 @@
+/*
+ *  SFColours - Star Fighter 3000 colours editor
+ *  Gradient fills approximated using palette colours
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFCGradient_h
+#define SFCGradient_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "PalEntry.h"
+#include "PalLookup.h"
+#include "OKLab.h"
+
+#if !defined(USE_OPTIONAL) && !defined(_Optional)
+#define _Optional
+#endif
+
+typedef enum
+{
+  GradientStyle_RGB,     /* Linear in sRGB (the original behaviour) */
+  GradientStyle_OKLab,   /* Linear in OKLab perceptual colour space */
+  GradientStyle_Diffuse, /* As GradientStyle_OKLab, but the difference
+                            between the ideal and actual colour of each
+                            step is carried forward to the next step */
+}
+GradientStyle;
+
+typedef struct
+{
+  GradientStyle style;
+  PaletteEntry const *palette;
+  size_t ncols;
+  _Optional PalLookup const *lookup;
+  float value[3];
+  float inc[3];
+  OKLab error;
+}
+Gradient;
+
+/* Prepare to generate a gradient fill of 'steps' transitions between two
+   palette entries. 'lookup' is optional but should be built from the
+   same palette if given; without it, each step searches the whole
+   palette (and converts it to OKLab, if required). */
+void gradient_init(Gradient *gradient, GradientStyle style,
+  PaletteEntry const palette[], size_t ncols,
+  _Optional PalLookup const *lookup,
+  unsigned int start_colour, unsigned int end_colour, int steps);
+
+/* Get the palette entry nearest to the next colour of a gradient fill.
+   The first call gives the colour after the start colour. */
+unsigned int gradient_next(Gradient *gradient);
+
+/* Interpret "rgb", "oklab" or "diffuse" (case-insensitive) as a gradient
+   style. Returns false if the string is not recognised. */
+bool gradient_style_from_string(char const *string, GradientStyle *style);
+
+#endif
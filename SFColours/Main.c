@@ -36,6 +36,7 @@
 
 /* Local headers */
 #include "SFCInit.h"
+#include "ParseArgs.h"
 
 #ifdef USE_OPTIONAL
 #include "Optional.h"
@@ -79,10 +80,6 @@ static void fortify_output(char const *text)
 
 int main(int argc, char *argv[])
 {
-  /* CLI parameters are ignored, as we claim no filetypes */
-  NOT_USED(argc);
-  NOT_USED(argv);
-
   DEBUG_SET_OUTPUT(DebugOutput_StdErr, APP_NAME);
 
 #ifdef FORTIFY
@@ -113,6 +110,8 @@ int main(int argc, char *argv[])
   fortify_in_scope = true;
 #endif
 
+  parse_arguments(argc, argv);
+
   /*
    * poll loop
    */
@@ -0,0 +1,93 @@
+/*
+ *  SFColours - Star Fighter 3000 colours editor
+ *  Conversion to the OKLab perceptual colour space
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* The conversion is Bjorn Ottosson's: sRGB is first converted to linear
+   light, then to approximate cone responses, which are cube-rooted
+   before being combined into lightness and two opponent colour axes. */
+
+/* ISO library headers */
+#include <stddef.h>
+#include <math.h>
+#include <assert.h>
+
+/* My library files */
+#include "PalEntry.h"
+
+/* Local headers */
+#include "OKLab.h"
+
+/* Constant numeric values */
+enum
+{
+  MaxComponent = 255,
+};
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static float to_linear(int const component)
+{
+  /* Remove the sRGB transfer function ('gamma') */
+  float const c = (float)component / MaxComponent;
+  return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+OKLab oklab_from_rgb(int const red, int const green, int const blue)
+{
+  float const r = to_linear(red), g = to_linear(green), b = to_linear(blue);
+
+  float const l = cbrtf(0.4122214708f * r + 0.5363325363f * g +
+                        0.0514459929f * b),
+              m = cbrtf(0.2119034982f * r + 0.6806995451f * g +
+                        0.1073969566f * b),
+              s = cbrtf(0.0883024619f * r + 0.2817188376f * g +
+                        0.6299787005f * b);
+
+  return (OKLab){
+    .l = 0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+    .a = 1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+    .b = 0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s,
+  };
+}
+
+/* ----------------------------------------------------------------------- */
+
+OKLab oklab_from_palette(PaletteEntry const entry)
+{
+  return oklab_from_rgb(PALETTE_GET_RED(entry), PALETTE_GET_GREEN(entry),
+                        PALETTE_GET_BLUE(entry));
+}
+
+/* ----------------------------------------------------------------------- */
+
+float oklab_distance(OKLab const *const x, OKLab const *const y)
+{
+  assert(x != NULL);
+  assert(y != NULL);
+
+  float const l_diff = x->l - y->l,
+              a_diff = x->a - y->a,
+              b_diff = x->b - y->b;
+
+  return (l_diff * l_diff) + (a_diff * a_diff) + (b_diff * b_diff);
+}
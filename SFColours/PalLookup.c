@@ -0,0 +1,305 @@
+/*
+ *  SFColours - Star Fighter 3000 colours editor
+ *  Inverse colour map for nearest palette entry search
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* The RGB cube is divided into cells. For each cell, a list is made of
+   the palette entries that could be nearest to any colour in that cell:
+   an entry can only be nearest if its distance from the closest point of
+   the cell is no greater than the distance of some other entry from the
+   farthest point of the cell. Searching a cell's list in order of
+   increasing palette index, keeping the first of any equally near
+   entries, gives the same result as searching the whole palette. */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+#include "PalEntry.h"
+
+/* Local headers */
+#include "PalLookup.h"
+#include "OKLab.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  MaxColours = 256,
+  MaxComponent = 255,
+  CellSizeLog2 = 5,
+  CellSize = 1 << CellSizeLog2, /* Width of a cell in each dimension */
+  CellsPerAxis = (MaxComponent >> CellSizeLog2) + 1,
+  NCells = CellsPerAxis * CellsPerAxis * CellsPerAxis,
+};
+
+struct PalLookup
+{
+  size_t ncols;
+  PaletteEntry palette[MaxColours];
+  OKLab oklab[MaxColours];  /* palette converted to OKLab */
+  size_t first[NCells + 1]; /* index in 'cands' of each cell's list */
+  uint8_t cands[];          /* palette indices, in increasing order */
+};
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static long int distance(PaletteEntry const entry, int const red,
+  int const green, int const blue)
+{
+  /* Squared Euclidean distance, as used by nearest_palette_entry_rgb */
+  long int const red_diff = (long)PALETTE_GET_RED(entry) - red,
+                 green_diff = (long)PALETTE_GET_GREEN(entry) - green,
+                 blue_diff = (long)PALETTE_GET_BLUE(entry) - blue;
+
+  return (red_diff * red_diff) + (green_diff * green_diff) +
+         (blue_diff * blue_diff);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static long int axis_min(int const value, int const low)
+{
+  /* Distance from a component value to the nearest edge of a cell */
+  long int const diff = value < low ? low - value :
+                        value > low + CellSize - 1 ?
+                        value - (low + CellSize - 1) : 0;
+  return diff * diff;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static long int axis_max(int const value, int const low)
+{
+  /* Distance from a component value to the farthest edge of a cell */
+  long int const diff = HIGHEST(value - low, low + CellSize - 1 - value);
+  return diff * diff;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static size_t find_cands(PaletteEntry const palette[], size_t const ncols,
+  int const r, int const g, int const b, _Optional uint8_t *const cands)
+{
+  /* Find the candidates for the cell with the given lower bounds.
+     Returns the number found, and stores them if 'cands' isn't null. */
+  assert(palette != NULL);
+
+  long int limit = LONG_MAX;
+  for (size_t i = 0; i < ncols; ++i)
+  {
+    PaletteEntry const entry = palette[i];
+    long int const far = axis_max(PALETTE_GET_RED(entry), r) +
+                         axis_max(PALETTE_GET_GREEN(entry), g) +
+                         axis_max(PALETTE_GET_BLUE(entry), b);
+    limit = LOWEST(limit, far);
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < ncols; ++i)
+  {
+    PaletteEntry const entry = palette[i];
+    long int const near = axis_min(PALETTE_GET_RED(entry), r) +
+                          axis_min(PALETTE_GET_GREEN(entry), g) +
+                          axis_min(PALETTE_GET_BLUE(entry), b);
+    if (near <= limit)
+    {
+      if (cands)
+      {
+        cands[count] = (uint8_t)i;
+      }
+      ++count;
+    }
+  }
+
+  assert(count > 0);
+  return count;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static size_t cell_index(int const red, int const green, int const blue)
+{
+  return ((((size_t)(red >> CellSizeLog2) * CellsPerAxis) +
+           (size_t)(green >> CellSizeLog2)) * CellsPerAxis) +
+         (size_t)(blue >> CellSizeLog2);
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+_Optional PalLookup *pal_lookup_create(PaletteEntry const palette[],
+  size_t const ncols)
+{
+  assert(palette != NULL);
+  assert(ncols > 0);
+  assert(ncols <= MaxColours);
+
+  /* Count the candidates for every cell to find the size needed */
+  size_t total = 0;
+  for (int r = 0; r <= MaxComponent; r += CellSize)
+  {
+    for (int g = 0; g <= MaxComponent; g += CellSize)
+    {
+      for (int b = 0; b <= MaxComponent; b += CellSize)
+      {
+        total += find_cands(palette, ncols, r, g, b, NULL);
+      }
+    }
+  }
+
+  _Optional PalLookup *const lookup = malloc(sizeof(*lookup) + total);
+  if (!lookup)
+  {
+    DEBUGF("Not enough memory for inverse colour map\n");
+    return NULL;
+  }
+
+  lookup->ncols = ncols;
+  memcpy(lookup->palette, palette, sizeof(palette[0]) * ncols);
+
+  for (size_t i = 0; i < ncols; ++i)
+  {
+    lookup->oklab[i] = oklab_from_palette(palette[i]);
+  }
+
+  size_t next = 0;
+  for (int r = 0; r <= MaxComponent; r += CellSize)
+  {
+    for (int g = 0; g <= MaxComponent; g += CellSize)
+    {
+      for (int b = 0; b <= MaxComponent; b += CellSize)
+      {
+        size_t const cell = cell_index(r, g, b);
+        lookup->first[cell] = next;
+        next += find_cands(palette, ncols, r, g, b, lookup->cands + next);
+      }
+    }
+  }
+  assert(next == total);
+  lookup->first[NCells] = next;
+
+  DEBUGF("Inverse colour map has %zu candidates in %d cells\n",
+         total, NCells);
+
+  return lookup;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void pal_lookup_destroy(_Optional PalLookup *const lookup)
+{
+  free(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+bool pal_lookup_matches(PalLookup const *const lookup,
+  PaletteEntry const palette[], size_t const ncols)
+{
+  assert(lookup != NULL);
+  assert(palette != NULL);
+
+  return lookup->ncols == ncols &&
+         !memcmp(lookup->palette, palette, sizeof(palette[0]) * ncols);
+}
+
+/* ----------------------------------------------------------------------- */
+
+unsigned int pal_lookup_nearest(PalLookup const *const lookup,
+  int const red, int const green, int const blue)
+{
+  assert(lookup != NULL);
+
+  size_t start = 0, end = lookup->ncols;
+  bool const in_cube = red >= 0 && red <= MaxComponent &&
+                       green >= 0 && green <= MaxComponent &&
+                       blue >= 0 && blue <= MaxComponent;
+  if (in_cube)
+  {
+    size_t const cell = cell_index(red, green, blue);
+    start = lookup->first[cell];
+    end = lookup->first[cell + 1];
+  }
+
+  /* Colours outside the cube fall back to searching the whole palette */
+  unsigned int best = 0;
+  long int best_dist = LONG_MAX;
+  for (size_t i = start; i < end; ++i)
+  {
+    unsigned int const index = in_cube ? lookup->cands[i] : (unsigned)i;
+    long int const dist = distance(lookup->palette[index], red, green, blue);
+    if (dist < best_dist)
+    {
+      best = index;
+      best_dist = dist;
+      if (dist == 0)
+      {
+        break;
+      }
+    }
+  }
+
+  return best;
+}
+
+/* ----------------------------------------------------------------------- */
+
+OKLab const *pal_lookup_get_oklab(PalLookup const *const lookup,
+  unsigned int const index)
+{
+  assert(lookup != NULL);
+  assert(index < lookup->ncols);
+  return &lookup->oklab[index];
+}
+
+/* ----------------------------------------------------------------------- */
+
+unsigned int pal_lookup_nearest_oklab(PalLookup const *const lookup,
+  OKLab const *const colour)
+{
+  assert(lookup != NULL);
+  assert(colour != NULL);
+
+  unsigned int best = 0;
+  float best_dist = oklab_distance(&lookup->oklab[0], colour);
+
+  for (size_t i = 1; i < lookup->ncols && best_dist > 0.0f; ++i)
+  {
+    float const dist = oklab_distance(&lookup->oklab[i], colour);
+    if (dist < best_dist)
+    {
+      best = (unsigned)i;
+      best_dist = dist;
+    }
+  }
+
+  return best;
+}
@@ -0,0 +1,49 @@
+/*
+ *  SFColours - Star Fighter 3000 colours editor
+ *  Inverse colour map for nearest palette entry search
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFCPalLookup_h
+#define SFCPalLookup_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "PalEntry.h"
+#include "OKLab.h"
+
+#if !defined(USE_OPTIONAL) && !defined(_Optional)
+#define _Optional
+#endif
+
+typedef struct PalLookup PalLookup;
+
+/* Build an inverse colour map of up to 256 palette entries.
+   Returns NULL if there is not enough memory. */
+_Optional PalLookup *pal_lookup_create(PaletteEntry const palette[],
+  size_t ncols);
+
+void pal_lookup_destroy(_Optional PalLookup *lookup);
+
+/* Returns false if the map was built from a different palette. */
+bool pal_lookup_matches(PalLookup const *lookup,
+  PaletteEntry const palette[], size_t ncols);
+
+/* Gives the same result as nearest_palette_entry_rgb for the palette from
+   which the map was built, but only compares the palette entries that
+   could be nearest to colours in the same region of the RGB cube. */
+unsigned int pal_lookup_nearest(PalLookup const *lookup,
+  int red, int green, int blue);
+
+/* Get the OKLab colour of a palette entry, converted when the map was
+   built. */
+OKLab const *pal_lookup_get_oklab(PalLookup const *lookup,
+  unsigned int index);
+
+/* Find the palette entry nearest to a colour in OKLab space, keeping the
+   first of any equally near entries. */
+unsigned int pal_lookup_nearest_oklab(PalLookup const *lookup,
+  OKLab const *colour);
+
+#endif
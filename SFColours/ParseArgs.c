@@ -0,0 +1,69 @@
+/*
+ *  SFColours - Star Fighter 3000 colours editor
+ *  Command line parser
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ISO library files */
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/* My library files */
+#include "Err.h"
+#include "Debug.h"
+#include "Macros.h"
+#include "StrExtra.h"
+#include "msgtrans.h"
+
+/* Local headers */
+#include "ParseArgs.h"
+#include "EditWin.h"
+#include "Gradient.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+void parse_arguments(int argc, char *argv[])
+{
+  /*
+   * Interpret any command-line arguments (there are no files to load,
+   * as we claim no filetypes)
+   */
+  assert(argc == 0 || argv != NULL);
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (stricmp(argv[i], "-gradient") == 0 && i + 1 < argc)
+    {
+      /* How to approximate gradient fills using the palette */
+      if (!gradient_style_from_string(argv[++i], &gradient_style))
+      {
+        err_complain_fatal(DUMMY_ERRNO, msgs_lookup("BadParm"));
+      }
+    }
+    else
+    {
+      err_complain_fatal(DUMMY_ERRNO, msgs_lookup("BadParm"));
+    }
+  } /* next parameter */
+}
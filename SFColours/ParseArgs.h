@@ -0,0 +1,12 @@
+/*
+ *  SFColours - Star Fighter 3000 colours editor
+ *  Command line parser
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFCParseArgs_h
+#define SFCParseArgs_h
+
+void parse_arguments(int argc, char *argv[]);
+
+#endif
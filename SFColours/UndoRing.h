@@ -0,0 +1,77 @@
+/*
+ *  SFColours - Star Fighter 3000 colours editor
+ *  Ring buffer of variable-sized undo records
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFCUndoRing_h
+#define SFCUndoRing_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if !defined(USE_OPTIONAL) && !defined(_Optional)
+#define _Optional
+#endif
+
+/* Blocks are allocated at the newest end of the ring and freed from
+   either end, so that the oldest undo records can be discarded to make
+   room for new ones and the redo history can be discarded when a new
+   edit is made. The buffer is allocated when first needed. */
+typedef struct
+{
+  _Optional char *buffer;
+  size_t size;   /* Capacity of the buffer, in bytes */
+  size_t oldest; /* Offset of the oldest block */
+  size_t newest; /* Offset of the newest block */
+  size_t end;    /* Offset one beyond the newest block */
+  size_t wrap;   /* Offset one beyond the last block before the start of
+                    the buffer is reused, or 0 if not wrapped */
+  bool is_empty;
+}
+UndoRing;
+
+/* Initialize a ring with a capacity of 'size' bytes. */
+void undo_ring_init(UndoRing *ring, size_t size);
+
+/* Free the buffer and all blocks in it. */
+void undo_ring_destroy(UndoRing *ring);
+
+/* Get the number of bytes needed to store a block of the given size,
+   including overheads. */
+size_t undo_ring_block_size(size_t size);
+
+/* Allocate a block at the newest end of the ring. Returns NULL if there
+   isn't enough contiguous free space (or the buffer can't be allocated);
+   the caller may free the oldest block and try again. */
+_Optional void *undo_ring_alloc(UndoRing *ring, size_t size);
+
+/* Free the oldest or newest block. The ring must not be empty. */
+void undo_ring_free_oldest(UndoRing *ring);
+void undo_ring_free_newest(UndoRing *ring);
+
+/* Free all blocks newer than the given block, or all blocks (without
+   freeing the buffer). Takes the same time however many are freed. */
+void undo_ring_free_after(UndoRing *ring, void const *block);
+void undo_ring_free_all(UndoRing *ring);
+
+/* Reduce the size of the newest block. */
+void undo_ring_shrink_newest(UndoRing *ring, size_t size);
+
+/* Get the oldest or newest block, or null if the ring is empty. */
+_Optional void *undo_ring_get_oldest(UndoRing const *ring);
+_Optional void *undo_ring_get_newest(UndoRing const *ring);
+
+/* Get the next older or newer block, or null if there is none. */
+_Optional void *undo_ring_get_prev(UndoRing const *ring, void const *block);
+_Optional void *undo_ring_get_next(UndoRing const *ring, void const *block);
+
+/* Get the number of bytes used by blocks, including overheads. */
+size_t undo_ring_get_used(UndoRing const *ring);
+
+static inline bool undo_ring_is_empty(UndoRing const *const ring)
+{
+  return ring->is_empty;
+}
+
+#endif
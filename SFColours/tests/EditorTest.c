@@ -1068,6 +1068,114 @@ static void test16(void)
   edit_colmap_destroy(&edit_colmap);
 }
 
+static void test17(void)
+{
+  /* Merge repeated changes to one colour */
+  EditColMap edit_colmap;
+  edit_colmap_init(&edit_colmap, NULL, ColMap_MaxSize, redraw_entry_cb);
+  ColMap *const colmap = edit_colmap_get_colmap(&edit_colmap);
+
+  Editor editor;
+  editor_init(&editor, &edit_colmap, redraw_select_cb);
+
+  ColMapEntry const first = colmap_get_colour(colmap, SelectStart),
+                    second = colmap_get_colour(colmap, SelectEnd);
+
+  assert(editor_exc_select(&editor, SelectStart));
+  for (int i = 0; i < NSelect; ++i)
+  {
+    assert(editor_set_plain(&editor, (ColMapEntry)(Colour + i)) ==
+           EditResult_Changed);
+  }
+
+  /* Changes to a different colour are not merged */
+  assert(editor_exc_select(&editor, SelectEnd));
+  assert(editor_set_plain(&editor, Marker) == EditResult_Changed);
+
+  assert(editor_undo(&editor));
+  assert(colmap_get_colour(colmap, SelectEnd) == second);
+  assert(colmap_get_colour(colmap, SelectStart) == Colour + NSelect - 1);
+
+  assert(editor_undo(&editor));
+  assert(colmap_get_colour(colmap, SelectStart) == first);
+  assert(!editor_can_undo(&editor));
+
+  assert(editor_redo(&editor));
+  assert(colmap_get_colour(colmap, SelectStart) == Colour + NSelect - 1);
+
+  /* Changes are not merged with one that was undone */
+  assert(editor_exc_select(&editor, SelectStart));
+  assert(editor_set_plain(&editor, Marker) == EditResult_Changed);
+  assert(!editor_can_redo(&editor));
+
+  assert(editor_undo(&editor));
+  assert(colmap_get_colour(colmap, SelectStart) == Colour + NSelect - 1);
+  assert(colmap_get_colour(colmap, SelectEnd) == second);
+
+  edit_colmap_destroy(&edit_colmap);
+}
+
+static void test18(void)
+{
+  /* Discard oldest undo history */
+  enum { NEdits = 5000 };
+  static ColMapEntry history[NEdits + 1][2];
+  static int const pos[ARRAY_SIZE(history[0])] = {SelectStart, SelectEnd};
+
+  EditColMap edit_colmap;
+  edit_colmap_init(&edit_colmap, NULL, ColMap_MaxSize, redraw_entry_cb);
+  ColMap *const colmap = edit_colmap_get_colmap(&edit_colmap);
+
+  Editor editor;
+  editor_init(&editor, &edit_colmap, redraw_select_cb);
+
+  for (size_t p = 0; p < ARRAY_SIZE(pos); ++p)
+  {
+    history[0][p] = colmap_get_colour(colmap, pos[p]);
+  }
+
+  for (int i = 0; i < NEdits; ++i)
+  {
+    /* Alternate between colours so that no changes are merged */
+    size_t const p = (size_t)i % ARRAY_SIZE(pos);
+    ColMapEntry const colour = (ColMapEntry)(history[i][p] + 1);
+
+    select_count = entry_count = 0;
+    assert(editor_exc_select(&editor, pos[p]));
+    assert(editor_set_plain(&editor, colour) == EditResult_Changed);
+
+    history[i + 1][p] = colour;
+    history[i + 1][!p] = history[i][!p];
+  }
+
+  int nundo = 0;
+  while (editor_can_undo(&editor))
+  {
+    entry_count = 0;
+    assert(editor_undo(&editor));
+    ++nundo;
+    for (size_t p = 0; p < ARRAY_SIZE(pos); ++p)
+    {
+      assert(colmap_get_colour(colmap, pos[p]) == history[NEdits - nundo][p]);
+    }
+  }
+  assert(nundo > 0);
+  assert(nundo < NEdits);
+
+  for (int i = nundo; i > 0; --i)
+  {
+    entry_count = 0;
+    assert(editor_redo(&editor));
+  }
+  assert(!editor_can_redo(&editor));
+  for (size_t p = 0; p < ARRAY_SIZE(pos); ++p)
+  {
+    assert(colmap_get_colour(colmap, pos[p]) == history[NEdits][p]);
+  }
+
+  edit_colmap_destroy(&edit_colmap);
+}
+
 void Editor_tests(void)
 {
   static const struct
@@ -1093,6 +1201,8 @@ void Editor_tests(void)
     { "Set array", test14 },
     { "Set invalid", test15 },
     { "Get next selected", test16 },
+    { "Merge repeated changes to one colour", test17 },
+    { "Discard oldest undo history", test18 },
   };
 
   for (size_t count = 0; count < ARRAY_SIZE(unit_tests); ++count)
@@ -159,6 +159,8 @@ struct EditWin
 };
 
 bool trap_caret = true;
+GradientStyle gradient_style = GradientStyle_RGB; /* for new files */
+size_t undo_budget = EditSkyDefaultUndoBudget; /* for new files */
 
 static enum
 {
@@ -976,6 +978,11 @@ static void redraw_bands(EditSky *const edit_sky, int const start,
 
   SkyFile *const file = CONTAINER_OF(edit_sky, SkyFile, edit_sky);
   (void)for_each_view(file, redraw_bbox_cb, &redraw_box);
+
+  if (file->preview_data != NULL)
+  {
+    Preview_invalidate_bands(&*file->preview_data, start, end);
+  }
 }
 
 /* ----------------------------------------------------------------------- */
@@ -987,6 +994,11 @@ static void redraw_render_offset(EditSky *const edit_sky)
 
   SkyFile *const file = CONTAINER_OF(edit_sky, SkyFile, edit_sky);
   (void)for_each_view(file, set_render_offset_cb, file);
+
+  if (file->preview_data != NULL)
+  {
+    Preview_invalidate(&*file->preview_data);
+  }
 }
 
 /* ----------------------------------------------------------------------- */
@@ -998,6 +1010,11 @@ static void redraw_stars_height(EditSky *const edit_sky)
 
   SkyFile *const file = CONTAINER_OF(edit_sky, SkyFile, edit_sky);
   (void)for_each_view(file, set_star_height_cb, file);
+
+  if (file->preview_data != NULL)
+  {
+    Preview_invalidate(&*file->preview_data);
+  }
 }
 
 /* ----------------------------------------------------------------------- */
@@ -2312,6 +2329,9 @@ _Optional SkyFile *SkyFile_create(_Optional Reader *const reader,
   SkyState state = edit_sky_init(&file->edit_sky, reader, redraw_bands,
     redraw_render_offset, redraw_stars_height);
 
+  edit_sky_set_gradient_style(&file->edit_sky, gradient_style);
+  edit_sky_set_undo_budget(&file->edit_sky, undo_budget);
+
   bool success = IO_report_read(state);
 
   if (success)
@@ -8,6 +8,7 @@
 #define SFSEditWin_h
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "wimp.h"
 
@@ -15,6 +16,7 @@
 #include "Writer.h"
 
 #include "Sky.h"
+#include "Gradient.h"
 
 #if !defined(USE_OPTIONAL) && !defined(_Optional)
 #define _Optional
@@ -35,6 +37,8 @@ EditWin *SkyFile_get_win(SkyFile *file);
 void SkyFile_show(SkyFile *file);
 
 extern bool trap_caret;
+extern GradientStyle gradient_style;
+extern size_t undo_budget;
 
 void EditWin_initialise(void);
 
@@ -22,6 +22,8 @@
 #include "stdlib.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
+#include <limits.h>
 #include <assert.h>
 
 /* My library files */
@@ -35,6 +37,8 @@
 /* Local headers */
 #include "Editor.h"
 #include "Sky.h"
+#include "Gradient.h"
+#include "UndoRing.h"
 
 #ifdef USE_OPTIONAL
 #include "Optional.h"
@@ -44,6 +48,8 @@
 enum {
   BadPixelColour = 0, /* black */
   ExtendPixelColour = 0,
+  MaxStoreSize = NColourBands * 2, /* replacement and replaced colours */
+  MaxRunLength = UCHAR_MAX,
 };
 
 typedef struct {
@@ -79,6 +85,9 @@ typedef struct EditFill {
   /* Whether or not to include the end colour (only for
      EditRecordType_InsertGradient) */
   bool inc_end;
+  /* How to approximate gradients (only for EditRecordType_Smooth,
+     EditRecordType_Interpolate or EditRecordType_InsertGradient) */
+  GradientStyle style;
 } EditFill;
 
 /* # = budge_lost
@@ -110,6 +119,10 @@ typedef struct EditFill {
 typedef struct EditRecord {
   LinkedListItem link;
   EditRecordType type;
+  /* Size of the store if its content was run-length encoded as pairs of
+     run length and colour, otherwise 0. The newest record isn't encoded
+     until the next is added because its content may be incomplete. */
+  size_t packed_size;
   union {
     /* For EditRecordType_SetStarsHeight, EditRecordType_SetRenderOffset or
        EditRecordType_AddRenderOffset */
@@ -250,15 +263,187 @@ static void redraw_move(EditSky *const edit_sky, EditRecord const *const rec)
   redraw_bands(edit_sky, LOWEST(rec->data.edit.src_start, dst_start), redraw_end);
 }
 
-static bool destroy_record(LinkedList *const list, LinkedListItem *const item,
-  void *const arg)
+static int get_fresh_size(EditRecord const *const rec)
 {
-  NOT_USED(arg);
-  EditRecord *const rec = CONTAINER_OF(item, EditRecord, link);
-  DEBUGF("Discarding undo record %p\n", (void *)rec);
-  linkedlist_remove(list, item);
-  free(rec);
-  return false; /* continue */
+  assert(rec != NULL);
+
+  int fresh_size = 0;
+  if (rec->type == EditRecordType_Move || rec->type == EditRecordType_Copy ||
+      rec->type == EditRecordType_InsertArray)
+  {
+    fresh_size = rec->data.edit.new_dst_end - rec->data.edit.dst_start;
+  }
+  return fresh_size;
+}
+
+static size_t get_store_size(EditRecord const *const rec)
+{
+  assert(rec != NULL);
+
+  switch (rec->type)
+  {
+  case EditRecordType_SetStarsHeight:
+  case EditRecordType_SetRenderOffset:
+  case EditRecordType_AddRenderOffset:
+    return 0;
+
+  default:
+    break;
+  }
+
+  int const fresh_size = get_fresh_size(rec);
+  int const budge_size = abs(rec->data.edit.old_dst_end -
+                             rec->data.edit.new_dst_end);
+
+  return (size_t)fresh_size + (size_t)rec->data.edit.lsize +
+         (size_t)budge_size;
+}
+
+static void set_store_ptrs(EditRecord *const rec, SkyColour *const store)
+{
+  assert(rec != NULL);
+  assert(store != NULL);
+
+  int const fresh_size = get_fresh_size(rec);
+  rec->data.edit.fresh = store;
+  rec->data.edit.lost = store + fresh_size;
+  rec->data.edit.budge_lost = store + fresh_size + rec->data.edit.lsize;
+}
+
+static size_t rle_encode(SkyColour const *const src, size_t const src_size,
+  SkyColour *const dst, size_t const dst_size)
+{
+  assert(src != NULL || src_size == 0);
+  assert(dst != NULL);
+
+  size_t out = 0;
+  for (size_t i = 0; i < src_size; )
+  {
+    size_t run = 1;
+    while (i + run < src_size && run < MaxRunLength &&
+           src[i + run] == src[i])
+    {
+      ++run;
+    }
+
+    if (out + 2 > dst_size)
+    {
+      return 0; /* no smaller than the input */
+    }
+    dst[out++] = (SkyColour)run;
+    dst[out++] = src[i];
+    i += run;
+  }
+  return out;
+}
+
+static void rle_decode(SkyColour const *const src, size_t const src_size,
+  SkyColour *const dst, size_t const dst_size)
+{
+  assert(src != NULL);
+  assert(src_size % 2 == 0);
+  assert(dst != NULL);
+
+  size_t out = 0;
+  for (size_t i = 0; i < src_size; i += 2)
+  {
+    size_t const run = src[i];
+    assert(run > 0);
+    assert(out + run <= dst_size);
+    memset(dst + out, src[i + 1], run);
+    out += run;
+  }
+  assert(out == dst_size);
+  NOT_USED(dst_size);
+}
+
+static void pack_record(EditSky *const edit_sky, EditRecord *const rec)
+{
+  assert(edit_sky != NULL);
+  assert(rec != NULL);
+
+  size_t const store_size = get_store_size(rec);
+  if (rec->packed_size != 0 || store_size == 0)
+  {
+    return;
+  }
+
+  assert(store_size <= MaxStoreSize);
+  SkyColour packed[MaxStoreSize];
+  size_t const packed_size = rle_encode(rec->store, store_size, packed,
+                                        LOWEST(store_size - 1, sizeof(packed)));
+  if (packed_size == 0)
+  {
+    DEBUGF("Undo record %p is incompressible\n", (void *)rec);
+    return;
+  }
+
+  DEBUGF("Packed undo record %p from %zu to %zu bytes\n",
+         (void *)rec, store_size, packed_size);
+
+  memcpy(rec->store, packed, packed_size);
+  rec->packed_size = packed_size;
+  undo_ring_shrink_newest(&edit_sky->undo_ring,
+                          sizeof(*rec) + packed_size);
+}
+
+static EditRecord const *unpack_record(EditRecord const *const rec,
+  EditRecord *const copy, SkyColour (*const store)[MaxStoreSize])
+{
+  assert(rec != NULL);
+  assert(copy != NULL);
+  assert(store != NULL);
+
+  if (rec->packed_size == 0)
+  {
+    return rec;
+  }
+
+  *copy = *rec;
+  size_t const store_size = get_store_size(rec);
+  assert(store_size <= sizeof(*store));
+  rle_decode(rec->store, rec->packed_size, *store, store_size);
+  set_store_ptrs(copy, *store);
+  return copy;
+}
+
+static void discard_oldest(EditSky *const edit_sky)
+{
+  assert(edit_sky != NULL);
+
+  _Optional LinkedListItem *const item =
+    linkedlist_get_head(&edit_sky->undo_list);
+  assert(item != NULL);
+
+  DEBUGF("Discarding oldest undo record %p\n", (void *)item);
+  if (edit_sky->next_undo == item)
+  {
+    edit_sky->next_undo = NULL;
+  }
+  linkedlist_remove(&edit_sky->undo_list, &*item);
+  undo_ring_free_oldest(&edit_sky->undo_ring);
+}
+
+static void discard_newest(EditSky *const edit_sky)
+{
+  assert(edit_sky != NULL);
+
+  _Optional LinkedListItem *const item =
+    linkedlist_get_tail(&edit_sky->undo_list);
+  assert(item != NULL);
+  assert(item != edit_sky->next_undo);
+
+  DEBUGF("Discarding newest undo record %p\n", (void *)item);
+  linkedlist_remove(&edit_sky->undo_list, &*item);
+  undo_ring_free_newest(&edit_sky->undo_ring);
+}
+
+static void discard_all(EditSky *const edit_sky)
+{
+  assert(edit_sky != NULL);
+  undo_ring_destroy(&edit_sky->undo_ring);
+  linkedlist_init(&edit_sky->undo_list);
+  edit_sky->next_undo = NULL;
 }
 
 static _Optional LinkedListItem *get_redo_item(EditSky *const edit_sky)
@@ -277,20 +462,49 @@ static _Optional LinkedListItem *get_redo_item(EditSky *const edit_sky)
   return redo_item;
 }
 
-static void add_undo_item(EditSky *const edit_sky, LinkedListItem *const new_item)
+static _Optional EditRecord *alloc_undo_record(EditSky *const edit_sky,
+  size_t const store_size)
 {
   assert(edit_sky != NULL);
-  assert(new_item != NULL);
 
-  _Optional LinkedListItem *const redo_item = get_redo_item(edit_sky);
-  _Optional LinkedListItem *next = NULL;
+  /* Records are allocated in the same order as they are listed, so
+     the redo history is at the newest end of the ring. */
+  while (edit_sky->next_undo != linkedlist_get_tail(&edit_sky->undo_list))
+  {
+    discard_newest(edit_sky);
+  }
 
-  for (_Optional LinkedListItem *item = redo_item; item != NULL; item = next)
+  _Optional LinkedListItem *const tail =
+    linkedlist_get_tail(&edit_sky->undo_list);
+  if (tail)
   {
-    next = linkedlist_get_next(&*item);
-    destroy_record(&edit_sky->undo_list, &*item, edit_sky);
+    pack_record(edit_sky, CONTAINER_OF(tail, EditRecord, link));
   }
 
+  _Optional EditRecord *rec = NULL;
+  for (;;)
+  {
+    rec = undo_ring_alloc(&edit_sky->undo_ring, sizeof(*rec) + store_size);
+    if (rec || !linkedlist_get_head(&edit_sky->undo_list))
+    {
+      break;
+    }
+    discard_oldest(edit_sky);
+  }
+
+  if (!rec)
+  {
+    DEBUGF("Not enough memory for undo\n");
+  }
+  return rec;
+}
+
+static void add_undo_item(EditSky *const edit_sky, LinkedListItem *const new_item)
+{
+  assert(edit_sky != NULL);
+  assert(new_item != NULL);
+  assert(edit_sky->next_undo == linkedlist_get_tail(&edit_sky->undo_list));
+
   linkedlist_insert(&edit_sky->undo_list, edit_sky->next_undo, new_item);
 
   DEBUGF("Added undo record %p\n", (void *)new_item);
@@ -301,16 +515,12 @@ static _Optional EditRecord *make_undo_values(EditSky *const edit_sky,
   EditRecordType const type)
 {
   assert(edit_sky != NULL);
-  _Optional EditRecord *const rec = malloc(sizeof(*rec));
+  _Optional EditRecord *const rec = alloc_undo_record(edit_sky, 0);
   if (rec != NULL)
   {
     *rec = (EditRecord){.type = type};
     add_undo_item(edit_sky, &rec->link);
   }
-  else
-  {
-    DEBUGF("Not enough memory for undo\n");
-  }
   return rec;
 }
 
@@ -341,8 +551,8 @@ static _Optional EditRecord *make_undo_edit(EditSky *const edit_sky,
   {
     fresh_size = trim_src_size;
   }
-  _Optional EditRecord *const rec = malloc(sizeof(*rec) + lost_size + fresh_size +
-                                           budge_size);
+  _Optional EditRecord *const rec = alloc_undo_record(edit_sky,
+    (size_t)lost_size + (size_t)fresh_size + (size_t)budge_size);
   if (rec != NULL)
   {
     *rec = (EditRecord){
@@ -364,10 +574,6 @@ static _Optional EditRecord *make_undo_edit(EditSky *const edit_sky,
 
     add_undo_item(edit_sky, &rec->link);
   }
-  else
-  {
-    DEBUGF("Not enough memory for undo\n");
-  }
   return rec;
 }
 
@@ -414,7 +620,7 @@ static inline _Optional EditRecord *make_undo_smooth(EditSky *const edit_sky,
   int const start, int const end)
 {
   return make_undo_edit(edit_sky, EditRecordType_Smooth, start, end, 0,
-    (EditFill){.len = end - start});
+    (EditFill){.len = end - start, .style = edit_sky->gradient_style});
 }
 
 static inline _Optional EditRecord *make_undo_set_plain(EditSky *const edit_sky,
@@ -433,7 +639,8 @@ static inline _Optional EditRecord *make_undo_interpolate(EditSky *const edit_sk
                .start = start_colour,
                .end = end_colour,
                .inc_start = true,
-               .inc_end = true});
+               .inc_end = true,
+               .style = edit_sky->gradient_style});
 }
 
 static bool s_set_colour(Sky *const sky, int const pos, SkyColour const rep,
@@ -893,12 +1100,34 @@ static bool delete_range(Editor *const editor, int const start,
   return changed;
 }
 
-static bool s_interpolate(Sky *const sky, PaletteEntry const palette[],
-  int const start, int const end, const EditFill fill,
-  _Optional SkyColour *const lost, int const lsize)
+static _Optional PalLookup *get_pal_lookup(EditSky *const edit_sky,
+  PaletteEntry const palette[])
+{
+  /* Rebuild the inverse colour map if the palette has changed */
+  assert(edit_sky != NULL);
+  assert(palette != NULL);
+
+  if (edit_sky->pal_lookup &&
+      !pal_lookup_matches(&*edit_sky->pal_lookup, palette, NPixelColours))
+  {
+    pal_lookup_destroy(edit_sky->pal_lookup);
+    edit_sky->pal_lookup = NULL;
+  }
+
+  if (!edit_sky->pal_lookup)
+  {
+    edit_sky->pal_lookup = pal_lookup_create(palette, NPixelColours);
+  }
+
+  return edit_sky->pal_lookup;
+}
+
+static bool s_interpolate(EditSky *const edit_sky,
+  PaletteEntry const palette[], int const start, int const end,
+  const EditFill fill, _Optional SkyColour *const lost, int const lsize)
 {
   /* Write gradient fill between specified colours */
-  assert(sky != NULL);
+  assert(edit_sky != NULL);
   assert(palette != NULL);
   assert(start >= 0);
   assert(start <= end);
@@ -909,6 +1138,8 @@ static bool s_interpolate(Sky *const sky, PaletteEntry const palette[],
   assert(lsize <= end - start);
   assert(lost != NULL || lsize == 0);
 
+  Sky *const sky = &edit_sky->sky;
+
   DEBUGF("Interpolating %d bands %d..%d\n"
          "start colour:%d (%s) end colour:%d (%s)\n",
          fill.len, start, end,
@@ -964,6 +1195,9 @@ static bool s_interpolate(Sky *const sky, PaletteEntry const palette[],
     return changed;
   }
 
+  /* Without an inverse colour map, search the whole palette instead */
+  _Optional PalLookup *const lookup = get_pal_lookup(edit_sky, palette);
+
   /* No. of transitions is one less than the no. of colours */
   assert(dist > 1);
   --dist;
@@ -974,50 +1208,18 @@ static bool s_interpolate(Sky *const sky, PaletteEntry const palette[],
     effective_end = end;
   }
 
-  /* Get 24-bit palette entries for start/end colours */
-  const PaletteEntry start_palette = palette[fill.start],
-                     end_palette = palette[fill.end];
-
-  /* Calculate initial R/G/B values and increments for smooth gradient */
+  /* Calculate initial colour and increments for smooth gradient */
   assert(dist != 0);
-  int col = PALETTE_GET_RED(start_palette);
-  int diff = PALETTE_GET_RED(end_palette) - col;
-  const float red_inc = (float)diff / dist;
-  float red_frac = (float)col;
-  assert(red_frac == col);
-  DEBUGF("RED start=%d diff=%d dist=%d increment=%f\n", col, diff, dist, red_inc);
-
-  col = PALETTE_GET_GREEN(start_palette);
-  diff = PALETTE_GET_GREEN(end_palette) - col;
-  const float green_inc = (float)diff / dist;
-  float green_frac = (float)col;
-  assert(green_frac == col);
-  DEBUGF("GREEN start=%d diff=%d dist=%d increment=%f\n", col, diff, dist, green_inc);
-
-  col = PALETTE_GET_BLUE(start_palette);
-  diff = PALETTE_GET_BLUE(end_palette) - col;
-  const float blue_inc = (float)diff / dist;
-  float blue_frac = (float)col;
-  assert(blue_frac == col);
-  DEBUGF("BLUE start=%d diff=%d dist=%d increment=%f\n", col, diff, dist, blue_inc);
+  Gradient gradient;
+  gradient_init(&gradient, fill.style, palette, NPixelColours, lookup,
+                fill.start, fill.end, dist);
 
   /* Write middle part of colour gradient (this loop never draws the
      start and end colours, even if one or both is 'included') */
   for (int pos = effective_start; pos < effective_end; pos++)
   {
-    /* Calculate transitional colour */
-    red_frac += red_inc;
-    green_frac += green_inc;
-    blue_frac += blue_inc;
-    DEBUG_VERBOSEF("Ideal colour for band %d is R=%f G=%f B=%f\n",
-                  pos, red_frac, green_frac, blue_frac);
-
-    int const near = nearest_palette_entry_rgb(
-      palette, NPixelColours, (int)(red_frac + 0.5f),
-      (int)(green_frac + 0.5f), (int)(blue_frac + 0.5f));
-
-    DEBUG_VERBOSEF("Nearest mode 13 colour:%d (palette 0x%08x)\n",
-                   near, palette[near]);
+    int const near = (int)gradient_next(&gradient);
+    DEBUG_VERBOSEF("Nearest mode 13 colour for band %d:%d\n", pos, near);
 
     int const idx = pos - start;
     assert((SkyColour)near == near);
@@ -1031,7 +1233,7 @@ static bool s_interpolate(Sky *const sky, PaletteEntry const palette[],
 }
 
 static bool do_smooth(EditSky *const edit_sky, int const start, int const end,
-  PaletteEntry const palette[])
+  PaletteEntry const palette[], GradientStyle const style)
 {
   assert(edit_sky != NULL);
   assert(start >= 0);
@@ -1074,13 +1276,14 @@ static bool do_smooth(EditSky *const edit_sky, int const start, int const end,
       assert(centre >= last_centre);
       if (centre - last_centre >= 2)
       {
-        if (s_interpolate(&edit_sky->sky, palette,
+        if (s_interpolate(edit_sky, palette,
           last_centre + 1, centre,
           (EditFill){.len = centre - last_centre - 1,
                      .start = sky_get_colour(sky, last_centre),
                      .end = sky_get_colour(sky, centre),
                      .inc_start = false,
-                     .inc_end = false}, NULL, 0))
+                     .inc_end = false,
+                     .style = style}, NULL, 0))
         {
           redraw_bands(edit_sky, last_centre + 1, centre);
           changed = true;
@@ -1105,13 +1308,14 @@ static bool do_smooth(EditSky *const edit_sky, int const start, int const end,
     DEBUGF("Last row is %d, last centre is %d\n", end - 1, last_centre);
     if (end - last_centre >= 3)
     {
-      if (s_interpolate(&edit_sky->sky, palette,
+      if (s_interpolate(edit_sky, palette,
         last_centre + 1, end - 1,
         (EditFill){.len = end - last_centre - 2,
                    .start = sky_get_colour(sky, last_centre),
                    .end = sky_get_colour(sky, end - 1),
                    .inc_start = false,
-                   .inc_end = false}, NULL, 0))
+                   .inc_end = false,
+                   .style = style}, NULL, 0))
       {
         redraw_bands(edit_sky, last_centre + 1, end - 1);
         changed = true;
@@ -1139,25 +1343,25 @@ static bool prepare_import(Editor *const editor, EditRecord *const rec)
   return changed;
 }
 
-static void caret_after_insert(Editor *const editor, EditRecord *const rec)
+static void caret_after_insert(Editor *const editor, EditRecord const *const rec)
 {
   assert(rec != NULL);
   (void)set_selection(editor, rec->data.edit.new_dst_end, rec->data.edit.new_dst_end);
 }
 
-static void select_inserted(Editor *const editor, EditRecord *const rec)
+static void select_inserted(Editor *const editor, EditRecord const *const rec)
 {
   assert(rec != NULL);
   (void)set_selection(editor, rec->data.edit.dst_start, rec->data.edit.new_dst_end);
 }
 
-static void select_replaced(Editor *const editor, EditRecord *const rec)
+static void select_replaced(Editor *const editor, EditRecord const *const rec)
 {
   assert(rec != NULL);
   (void)set_selection(editor, rec->data.edit.dst_start, rec->data.edit.old_dst_end);
 }
 
-static void select_move_dst(Editor *const editor, EditRecord *const rec)
+static void select_move_dst(Editor *const editor, EditRecord const *const rec)
 {
   assert(rec != NULL);
   int const src_size = rec->data.edit.new_dst_end -
@@ -1297,7 +1501,7 @@ static bool redo_insert(Editor *const editor, EditRecord const *const rec,
     }
     break;
   case EditRecordType_InsertGradient:
-    if (s_interpolate(&edit_sky->sky, palette,
+    if (s_interpolate(edit_sky, palette,
                       rec->data.edit.dst_start, rec->data.edit.new_dst_end,
                       rec->data.edit.fill, NULL, 0))
     {
@@ -1413,6 +1617,9 @@ SkyState edit_sky_init(EditSky *const edit_sky, _Optional Reader *const reader,
 
   linkedlist_init(&edit_sky->undo_list);
   edit_sky->next_undo = NULL;
+  undo_ring_init(&edit_sky->undo_ring, EditSkyDefaultUndoBudget);
+  edit_sky->pal_lookup = NULL;
+  edit_sky->gradient_style = GradientStyle_RGB;
 
   return state;
 }
@@ -1420,7 +1627,33 @@ SkyState edit_sky_init(EditSky *const edit_sky, _Optional Reader *const reader,
 void edit_sky_destroy(EditSky *const edit_sky)
 {
   assert(edit_sky != NULL);
-  (void)linkedlist_for_each(&edit_sky->undo_list, destroy_record, edit_sky);
+  discard_all(edit_sky);
+  pal_lookup_destroy(edit_sky->pal_lookup);
+}
+
+void edit_sky_set_undo_budget(EditSky *const edit_sky, size_t budget)
+{
+  assert(edit_sky != NULL);
+
+  size_t const min_budget = undo_ring_block_size(sizeof(EditRecord) +
+                                                 MaxStoreSize);
+  if (budget < min_budget)
+  {
+    DEBUGF("Rounded up undo budget %zu\n", budget);
+    budget = min_budget;
+  }
+
+  DEBUGF("Undo budget for %p is %zu\n", (void *)edit_sky, budget);
+  discard_all(edit_sky);
+  undo_ring_init(&edit_sky->undo_ring, budget);
+}
+
+void edit_sky_set_gradient_style(EditSky *const edit_sky,
+  GradientStyle const style)
+{
+  assert(edit_sky != NULL);
+  DEBUGF("Gradient style for %p is %d\n", (void *)edit_sky, (int)style);
+  edit_sky->gradient_style = style;
 }
 
 Sky *edit_sky_get_sky(EditSky *const edit_sky)
@@ -1457,10 +1690,14 @@ bool editor_undo(Editor *const editor)
 
   EditSky *const edit_sky = editor->edit_sky;
   assert(edit_sky != NULL);
-  EditRecord *const rec = CONTAINER_OF(edit_sky->next_undo,
+  EditRecord const *const packed = CONTAINER_OF(edit_sky->next_undo,
     EditRecord, link);
 
-  edit_sky->next_undo = linkedlist_get_prev(&rec->link);
+  edit_sky->next_undo = linkedlist_get_prev(&packed->link);
+
+  EditRecord copy;
+  SkyColour store[MaxStoreSize];
+  EditRecord const *const rec = unpack_record(packed, &copy, &store);
 
   bool changed = false;
   DEBUGF("Undo of type %d\n", (int)rec->type);
@@ -1542,9 +1779,13 @@ bool editor_redo(Editor *const editor, PaletteEntry const palette[])
   assert(edit_sky != NULL);
   _Optional LinkedListItem *const redo_item = get_redo_item(edit_sky);
   assert(redo_item != NULL);
-  EditRecord *const rec = CONTAINER_OF(redo_item, EditRecord, link);
+  EditRecord const *const packed = CONTAINER_OF(redo_item, EditRecord, link);
   edit_sky->next_undo = redo_item;
 
+  EditRecord copy;
+  SkyColour store[MaxStoreSize];
+  EditRecord const *const rec = unpack_record(packed, &copy, &store);
+
   bool changed = false;
   DEBUGF("Redo of type %d\n", (int)rec->type);
   switch (rec->type)
@@ -1575,10 +1816,10 @@ bool editor_redo(Editor *const editor, PaletteEntry const palette[])
     break;
   case EditRecordType_Smooth:
     changed = do_smooth(edit_sky, rec->data.edit.dst_start,
-                rec->data.edit.old_dst_end, palette);
+                rec->data.edit.old_dst_end, palette, rec->data.edit.fill.style);
     break;
   case EditRecordType_Interpolate:
-    if (s_interpolate(&edit_sky->sky, palette,
+    if (s_interpolate(edit_sky, palette,
       rec->data.edit.dst_start, rec->data.edit.old_dst_end,
       rec->data.edit.fill, NULL, 0))
     {
@@ -1931,7 +2172,7 @@ EditResult editor_smooth(Editor *const editor, PaletteEntry const palette[])
   Sky *const sky = edit_sky_get_sky(edit_sky);
   s_get_barray(sky, start, end, rec->data.edit.lost);
 
-  return do_smooth(edit_sky, start, end, palette) ?
+  return do_smooth(edit_sky, start, end, palette, edit_sky->gradient_style) ?
     EditResult_Changed : EditResult_Unchanged;
 }
 
@@ -1981,13 +2222,14 @@ EditResult editor_interpolate(Editor *const editor,
     return EditResult_NoMem;
   }
 
-  if (!s_interpolate(&edit_sky->sky, palette,
+  if (!s_interpolate(edit_sky, palette,
                      sel_low, sel_high,
                      (EditFill){.len = sel_high - sel_low,
                                 .start = start_col,
                                 .end = end_col,
                                 .inc_start = true,
-                                .inc_end = true},
+                                .inc_end = true,
+                                .style = edit_sky->gradient_style},
                      rec->data.edit.lost, rec->data.edit.lsize))
   {
     return EditResult_Unchanged;
@@ -2140,7 +2382,8 @@ EditResult editor_insert_gradient(Editor *const editor,
                          .start = start_col,
                          .end = end_col,
                          .inc_start = inc_start,
-                         .inc_end = inc_end};
+                         .inc_end = inc_end,
+                         .style = edit_sky->gradient_style};
   _Optional EditRecord *const rec = make_undo_insert_gradient(edit_sky,
     dst_start, dst_end, fill);
 
@@ -2151,7 +2394,7 @@ EditResult editor_insert_gradient(Editor *const editor,
 
   bool changed = prepare_import(editor, &*rec);
 
-  if (s_interpolate(&edit_sky->sky, palette, dst_start,
+  if (s_interpolate(edit_sky, palette, dst_start,
       rec->data.edit.new_dst_end, fill,
       rec->data.edit.lost, rec->data.edit.lsize))
   {
@@ -8,11 +8,15 @@
 #define SFSEditor_h
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "LinkedList.h"
 #include "Reader.h"
 #include "Sky.h"
 #include "PalEntry.h"
+#include "PalLookup.h"
+#include "Gradient.h"
+#include "UndoRing.h"
 
 #if !defined(USE_OPTIONAL) && !defined(_Optional)
 #define _Optional
@@ -24,6 +28,10 @@ typedef enum {
   EditResult_NoMem,
 } EditResult;
 
+enum {
+  EditSkyDefaultUndoBudget = 64 * 1024, /* bytes */
+};
+
 typedef struct EditSky {
   Sky sky;
   LinkedList editors;
@@ -32,6 +40,9 @@ typedef struct EditSky {
   void (*redraw_stars_height_cb)(struct EditSky *);
   LinkedList undo_list;
   _Optional LinkedListItem *next_undo;
+  UndoRing undo_ring; /* storage for the records in undo_list */
+  _Optional PalLookup *pal_lookup; /* built from the last palette used */
+  GradientStyle gradient_style;
 } EditSky;
 
 typedef struct Editor {
@@ -60,6 +71,17 @@ SkyState edit_sky_init(EditSky *edit_sky, _Optional Reader *reader,
 /* Destroy an editing session for a sky file. */
 void edit_sky_destroy(EditSky *edit_sky);
 
+/* Set how subsequent smoothing and gradient fills are approximated
+   (GradientStyle_RGB by default). Undone edits are redone the same way
+   as they were originally done. */
+void edit_sky_set_gradient_style(EditSky *edit_sky, GradientStyle style);
+
+/* Limit the memory used to store undo history (EditSkyDefaultUndoBudget
+   by default). The oldest history is discarded to make room for new edits.
+   Budgets too small to store any edit are rounded up. Any existing
+   history is discarded. */
+void edit_sky_set_undo_budget(EditSky *edit_sky, size_t budget);
+
 /* Get the sky file in an editing session */
 Sky *edit_sky_get_sky(EditSky *edit_sky);
 
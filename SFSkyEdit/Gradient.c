@@ -0,0 +1,226 @@
+/*
+ *  SFSkyEdit - Star Fighter 3000 sky colours editor
+ *  Gradient fills approximated using palette colours
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ISO library headers */
+#include <stdbool.h>
+#include <stddef.h>
+#include <float.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+#include "StrExtra.h"
+#include "PalEntry.h"
+
+/* Local headers */
+#include "Gradient.h"
+#include "PalLookup.h"
+#include "OKLab.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static OKLab get_oklab(Gradient const *const gradient,
+  unsigned int const index)
+{
+  assert(gradient != NULL);
+  assert(index < gradient->ncols);
+
+  return gradient->lookup ?
+    *pal_lookup_get_oklab(&*gradient->lookup, index) :
+    oklab_from_palette(gradient->palette[index]);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static unsigned int nearest_oklab(Gradient const *const gradient,
+  OKLab const *const colour)
+{
+  assert(gradient != NULL);
+  assert(colour != NULL);
+
+  if (gradient->lookup)
+  {
+    return pal_lookup_nearest_oklab(&*gradient->lookup, colour);
+  }
+
+  /* Slow because the palette must be converted for every step */
+  unsigned int best = 0;
+  float best_dist = FLT_MAX;
+  for (size_t i = 0; i < gradient->ncols; ++i)
+  {
+    OKLab const entry = oklab_from_palette(gradient->palette[i]);
+    float const dist = oklab_distance(&entry, colour);
+    if (dist < best_dist)
+    {
+      best = (unsigned)i;
+      best_dist = dist;
+    }
+  }
+  return best;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+void gradient_init(Gradient *const gradient, GradientStyle const style,
+  PaletteEntry const palette[], size_t const ncols,
+  _Optional PalLookup const *const lookup,
+  unsigned int const start_colour, unsigned int const end_colour,
+  int const steps)
+{
+  assert(gradient != NULL);
+  assert(palette != NULL);
+  assert(start_colour < ncols);
+  assert(end_colour < ncols);
+  assert(steps > 0);
+
+  *gradient = (Gradient){
+    .style = style,
+    .palette = palette,
+    .ncols = ncols,
+    .lookup = lookup,
+    .error = {0.0f, 0.0f, 0.0f},
+  };
+
+  float start[3], end[3];
+  if (style == GradientStyle_RGB)
+  {
+    PaletteEntry const start_entry = palette[start_colour],
+                       end_entry = palette[end_colour];
+
+    start[0] = (float)PALETTE_GET_RED(start_entry);
+    end[0] = (float)PALETTE_GET_RED(end_entry);
+    start[1] = (float)PALETTE_GET_GREEN(start_entry);
+    end[1] = (float)PALETTE_GET_GREEN(end_entry);
+    start[2] = (float)PALETTE_GET_BLUE(start_entry);
+    end[2] = (float)PALETTE_GET_BLUE(end_entry);
+  }
+  else
+  {
+    OKLab const start_oklab = get_oklab(gradient, start_colour),
+                end_oklab = get_oklab(gradient, end_colour);
+
+    start[0] = start_oklab.l;
+    end[0] = end_oklab.l;
+    start[1] = start_oklab.a;
+    end[1] = end_oklab.a;
+    start[2] = start_oklab.b;
+    end[2] = end_oklab.b;
+  }
+
+  for (size_t i = 0; i < ARRAY_SIZE(gradient->value); ++i)
+  {
+    gradient->value[i] = start[i];
+    gradient->inc[i] = (end[i] - start[i]) / (float)steps;
+    DEBUGF("Gradient component %zu start=%f end=%f steps=%d increment=%f\n",
+           i, start[i], end[i], steps, gradient->inc[i]);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+unsigned int gradient_next(Gradient *const gradient)
+{
+  assert(gradient != NULL);
+
+  /* Calculate transitional colour */
+  for (size_t i = 0; i < ARRAY_SIZE(gradient->value); ++i)
+  {
+    gradient->value[i] += gradient->inc[i];
+  }
+
+  unsigned int nearest = 0;
+  if (gradient->style == GradientStyle_RGB)
+  {
+    int const red = (int)(gradient->value[0] + 0.5f),
+              green = (int)(gradient->value[1] + 0.5f),
+              blue = (int)(gradient->value[2] + 0.5f);
+
+    nearest = gradient->lookup ?
+      pal_lookup_nearest(&*gradient->lookup, red, green, blue) :
+      (unsigned)nearest_palette_entry_rgb(gradient->palette, gradient->ncols,
+                                          red, green, blue);
+  }
+  else
+  {
+    OKLab ideal = {
+      .l = gradient->value[0],
+      .a = gradient->value[1],
+      .b = gradient->value[2],
+    };
+
+    if (gradient->style == GradientStyle_Diffuse)
+    {
+      ideal.l += gradient->error.l;
+      ideal.a += gradient->error.a;
+      ideal.b += gradient->error.b;
+    }
+
+    nearest = nearest_oklab(gradient, &ideal);
+
+    if (gradient->style == GradientStyle_Diffuse)
+    {
+      OKLab const actual = get_oklab(gradient, nearest);
+      gradient->error = (OKLab){
+        .l = ideal.l - actual.l,
+        .a = ideal.a - actual.a,
+        .b = ideal.b - actual.b,
+      };
+    }
+  }
+
+  DEBUG_VERBOSEF("Nearest colour:%u (palette 0x%08x)\n",
+                 nearest, gradient->palette[nearest]);
+
+  assert(nearest < gradient->ncols);
+  return nearest;
+}
+
+/* ----------------------------------------------------------------------- */
+
+bool gradient_style_from_string(char const *const string,
+  GradientStyle *const style)
+{
+  assert(string != NULL);
+  assert(style != NULL);
+
+  static char const *const names[] =
+  {
+    [GradientStyle_RGB] = "rgb",
+    [GradientStyle_OKLab] = "oklab",
+    [GradientStyle_Diffuse] = "diffuse",
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE(names); ++i)
+  {
+    if (stricmp(string, names[i]) == 0)
+    {
+      *style = (GradientStyle)i;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,30 @@
+/*
+ *  SFSkyEdit - Star Fighter 3000 sky colours editor
+ *  Conversion to the OKLab perceptual colour space
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFSOKLab_h
+#define SFSOKLab_h
+
+#include "PalEntry.h"
+
+/* Equal distances in OKLab space look roughly equally different, unlike
+   in RGB space. 'l' is lightness (0 to 1), 'a' is green to red and 'b'
+   is blue to yellow. */
+typedef struct
+{
+  float l, a, b;
+}
+OKLab;
+
+/* Convert 8-bit sRGB components to OKLab. */
+OKLab oklab_from_rgb(int red, int green, int blue);
+
+/* Convert a palette entry to OKLab. */
+OKLab oklab_from_palette(PaletteEntry entry);
+
+/* Square of the distance between two colours. */
+float oklab_distance(OKLab const *x, OKLab const *y);
+
+#endif
@@ -21,6 +21,8 @@
 /* ISO library files */
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
 
 /* My library files */
 #include "Err.h"
@@ -35,6 +37,9 @@
 #include "SFSIconbar.h"
 #include "ParseArgs.h"
 #include "EditWin.h"
+#include "Preview.h"
+#include "Scene.h"
+#include "Gradient.h"
 
 #ifdef USE_OPTIONAL
 #include "Optional.h"
@@ -66,6 +71,36 @@ void parse_arguments(int argc, char *argv[])
       {
         trap_caret = false;
       }
+      else if (stricmp(argv[i], "-stars") == 0 && i + 1 < argc)
+      {
+        /* Number of stars to plot in previews (for stress testing) */
+        char *endp;
+        long int const n = strtol(argv[++i], &endp, 10);
+        if (*endp != '\0' || n < 0 || n > MaxStars)
+        {
+          err_complain_fatal(DUMMY_ERRNO, msgs_lookup("BadParm"));
+        }
+        preview_stars = (int)n;
+      }
+      else if (stricmp(argv[i], "-gradient") == 0 && i + 1 < argc)
+      {
+        /* How to approximate gradient fills using the palette */
+        if (!gradient_style_from_string(argv[++i], &gradient_style))
+        {
+          err_complain_fatal(DUMMY_ERRNO, msgs_lookup("BadParm"));
+        }
+      }
+      else if (stricmp(argv[i], "-undo") == 0 && i + 1 < argc)
+      {
+        /* Memory budget for each file's undo history, in bytes */
+        char *endp;
+        unsigned long int const n = strtoul(argv[++i], &endp, 10);
+        if (*endp != '\0' || *argv[i] == '-' || n > SIZE_MAX)
+        {
+          err_complain_fatal(DUMMY_ERRNO, msgs_lookup("BadParm"));
+        }
+        undo_budget = (size_t)n;
+      }
       else
       {
         err_complain_fatal(DUMMY_ERRNO, msgs_lookup("BadParm"));
@@ -47,7 +47,6 @@
 #include "NoBudge.h"
 #include "Entity2.h"
 #include "WimpExtra.h"
-#include "TrigTable.h"
 #include "Debug.h"
 #include "Hourglass.h"
 #include "ClrTrans.h"
@@ -59,7 +58,7 @@
 /* Local headers */
 #include "Utils.h"
 #include "EditWin.h"
-#include "Render.h"
+#include "Scene.h"
 #include "Preview.h"
 #include "SFSInit.h"
 #include "OurEvents.h"
@@ -86,8 +85,8 @@ enum
 /* Constant numeric values */
 enum
 {
-  Screen_Width      = 320,  /* Width of sprite (in pixels) */
-  Screen_Height     = 256,  /* Height of sprite (in pixels) */
+  Screen_Width      = SceneWidth,  /* Width of sprite (in pixels) */
+  Screen_Height     = SceneHeight, /* Height of sprite (in pixels) */
   Screen_Eigen      = 2,    /* Log 2 of the no. of pixels per OS unit */
   Screen_Log2BPP    = 3,    /* Number of colours in sprite's palette */
   BitsPerPixel      = 1 << Screen_Log2BPP,
@@ -106,55 +105,11 @@ enum
   Angle_Max         = 60,
   Angle_Step        = 1,
   Angle_Default     = 0,
-  Degrees           = 90,    /* Degrees per quarter turn (PI/2 in radians) */
-  SineMultiplier    = 1024,  /* Scaler applied to make sine values whole
-                                (SF3K uses 1023, which seems wrong) */
-  QuarterTurn       = 128,   /* No. of sine values to pre-calculate for a
-                                quarter turn (from SF3000) */
-  HorizonDist       = 16384, /* Distance from camera of a point to be rotated
-                                to calculate vertical position of horizon. */
-  NStars            = 255,
-  MaxStarSize       = 16,
-  NStarColours      = 16,
-  MaxStarBright     = 8192,
-  Colour_Red        = 23,
-  Colour_Cyan       = 235,
-  Colour_Blue       = 139,
-  Colour_Yellow     = 119,
-  Colour_White      = 255,
-  StarHeightScaler  = 32,
-  MinStarDist       = 32768, /* Stars closer than this are assumed to be
-                                outside the viewable volume */
-  StarDist          = 8192, /* Distance from camera to stars */
-  MinStarHeight     = 128,
-  PerspDividend     = 1<<28,
-  PerspDivisorBase  = -45,
-  PerspDivisorStep  = 768,
-  PerspTableLen     = StarDist > HorizonDist ? StarDist : HorizonDist,
-  ScreenScaler      = 2048,
-  PostRotateScaler  = 8,
-  DistScaler        = 12,
-  PreExpandHeap     = 512 /* Number of bytes to pre-allocate before disabling
-                             flex budging (and thus heap expansion). */
+  PreExpandHeap     = 512, /* Number of bytes to pre-allocate before disabling
+                              flex budging (and thus heap expansion). */
+  StarSeed_Default  = 1,
 };
 
-typedef struct
-{
-  int x;
-  int y;
-  int z;
-}
-Point3D;
-
-typedef struct
-{
-  Point3D        pos;
-  uint8_t        colour;
-  uint8_t        size;
-  unsigned short bright;
-}
-StarData;
-
 struct PreviewData
 {
   ObjectId      window_id;
@@ -169,105 +124,89 @@ struct PreviewData
   bool          toolbars;
   bool          no_scale;
   bool          plot_err;
+  bool          dirty_all;   /* whole sky changed since last update */
+  int           dirty_start; /* range of colour bands changed since */
+  int           dirty_end;   /* last update (empty if none) */
   void         *cached_image; /* flex anchor */
   void         *export; /* flex anchor */
   SkyFile      *file;
-  void         *stars;    /* flex anchor */
+  _Optional StarField *stars;
+  _Optional StarCache *star_cache; /* screen positions of stars */
+  unsigned long star_seed;
 };
 
 static bool translate_cols = true;
 static _Optional void *col_trans_table = NULL; /* table of colour numbers for drawing
                                                   sprite in desktop */
-static _Optional TrigTable *trig_table = NULL; /* table of (co)sine values */
 static bool def_toolbars = true; /* default toolbar show state */
 static int def_scale = Scale_Default; /* default percentage scale */
-static _Optional int *persp_table = NULL; /* table of reciprocal values for perspective
-                                             projection */
+int preview_stars = NStars; /* number of stars in new previews */
 
 /* ----------------------------------------------------------------------- */
 /*                          Private functions                              */
 
-static void cam_rotate(Point3D *const p, int const x_angle, int const y_angle)
+static void *get_screen(const PreviewData *const preview_data)
 {
-  /* Use the trigonometric look-up table to rotate a point in 3D space
-     and apply perspective division to convert to screen coordinates */
-  assert(p != NULL);
-
-  DEBUGF("About to rotate %d,%d,%d by %d,%d\n",
-         p->x, p->y, p->z, x_angle, y_angle);
-
-  int const x_in = p->x;
-  int y_in = p->y;
-  int const z_in = p->z;
-
-  if (!trig_table) {
-    return;
-  }
-  const TrigTable *const tt = &*trig_table;
-
-  /* Apply X rotation */
-  int cos = TrigTable_look_up_cosine(tt, x_angle),
-      sin = TrigTable_look_up_sine(tt, x_angle);
-
-  p->x = (x_in * cos) / (SineMultiplier / PostRotateScaler) -
-         (y_in * sin) / (SineMultiplier / PostRotateScaler);
-
-  y_in = (x_in * sin) / SineMultiplier +
-         (y_in * cos) / SineMultiplier;
-
-  /* Apply Y rotation */
-  cos = TrigTable_look_up_cosine(tt, y_angle);
-  sin = TrigTable_look_up_sine(tt, y_angle);
-
-  p->y = (y_in * cos) / (SineMultiplier / PostRotateScaler) -
-         (z_in * sin) / (SineMultiplier / PostRotateScaler);
-
-  p->z = (y_in * sin) / (SineMultiplier / PostRotateScaler) +
-         (z_in * cos) / (SineMultiplier / PostRotateScaler);
+  /* Find the image of the sprite in which the sky is rendered */
+  assert(preview_data != NULL);
+  assert(preview_data->cached_image != NULL);
+  SpriteHeader *const first_spr =
+    (SpriteHeader *)((char *)preview_data->cached_image +
+    ((SpriteAreaHeader *)preview_data->cached_image)->first);
 
-  DEBUGF("Rotated point is %d,%d,%d\n", p->x, p->y, p->z);
+  return (char *)first_spr + first_spr->image;
 }
 
 /* ----------------------------------------------------------------------- */
 
-static void persp_project(const Point3D *const p, _Optional int *const screen_x,
-  _Optional int *const screen_y)
+static void render_bands(PreviewData *const preview_data)
 {
-  int scr_x, scr_y;
+  assert(preview_data != NULL);
+  assert(preview_data->export != NULL);
+  assert(preview_data->dirty_start < preview_data->dirty_end);
+
+  nobudge_register(PreExpandHeap);
 
-  assert(p != NULL);
+  /* Re-render only the scan lines of the image cache on which the
+     changed colour bands are plotted */
+  void *const screen = get_screen(preview_data);
+  int first_line = 0, end_line = 0;
+
+  assert(preview_data->stars != NULL);
+  assert(preview_data->star_cache != NULL);
+  scene_render_bands(preview_data->export, &*preview_data->stars,
+                     &*preview_data->star_cache, screen,
+                     preview_data->render_height,
+                     preview_data->render_direction,
+                     preview_data->render_angle,
+                     preview_data->dirty_start, preview_data->dirty_end,
+                     &first_line, &end_line);
 
-  int const index = p->y / (PerspDivisorStep / DistScaler);
-  if (index <= 0 || persp_table == NULL)
-  {
-    /* Don't attempt perspective projection of coordinates behind the camera */
-    scr_x = p->x;
-    scr_y = p->z;
-  }
-  else
+  nobudge_deregister();
+
+  if (first_line >= end_line)
   {
-    /* Calculate screen coordinates by multiplying by the reciprocal of a
-       value derived from the distance. */
-    assert(index < PerspTableLen);
-    int const reciprocal = persp_table[index];
-    assert(reciprocal == PerspDividend /
-                         (PerspDivisorBase + PerspDivisorStep * index));
-
-    scr_x = (p->x * reciprocal) / (PerspDividend / ScreenScaler);
-    scr_y = (p->z * reciprocal) / (PerspDividend / ScreenScaler);
+    DEBUGF("Changed bands are not visible\n");
+    return;
   }
-  DEBUGF("Screen coordinates are %d,%d\n", scr_x, scr_y);
 
-  if (screen_x != NULL)
-    *screen_x = scr_x;
+  /* Redraw only the part of the window showing those scan lines,
+     rounded outwards to whole OS units */
+  BBox redraw_box;
+  if (!E(window_get_extent(0, preview_data->window_id, &redraw_box)))
+  {
+    int const height = redraw_box.ymax - redraw_box.ymin;
+    redraw_box.ymin = redraw_box.ymax -
+      ((end_line * height) + Screen_Height - 1) / Screen_Height;
+    redraw_box.ymax -= (first_line * height) / Screen_Height;
 
-  if (screen_y != NULL)
-    *screen_y = scr_y;
+    ON_ERR_RPT(window_force_redraw(0, preview_data->window_id, &redraw_box));
+  }
 }
 
 /* ----------------------------------------------------------------------- */
 
-void render_scene(const PreviewData *const preview_data)
+void render_scene(PreviewData *const preview_data)
 {
   BBox redraw_box;
 
@@ -278,72 +217,19 @@ void render_scene(const PreviewData *const preview_data)
     return;
   }
 
-  /* Convert the camera angles from degrees to internal angle units */
-  int const x_rot = (preview_data->render_direction * QuarterTurn) / Degrees;
-  int const y_rot = (preview_data->render_angle * QuarterTurn) / Degrees;
-
-  /* Rotate a 3D point to find the position of the horizon relative to the
-     camera */
-  Point3D tmp = {
-    .x = 0,
-    .y = HorizonDist,
-    .z = 0
-  };
-  cam_rotate(&tmp, 0, y_rot);
-
-  /* Project the rotated 3D point onto the 2D screen to find the
-     vertical offset of the horizon from the vanishing point */
-  int screen_y = 0;
-  persp_project(&tmp, NULL, &screen_y);
-
   nobudge_register(PreExpandHeap);
 
-  /* Render sky to image cache at current height */
-  assert(preview_data->cached_image != NULL);
-  SpriteHeader *const first_spr =
-    (SpriteHeader *)((char *)preview_data->cached_image +
-    ((SpriteAreaHeader *)preview_data->cached_image)->first);
+  /* Render sky to image cache at current height (the stars are only
+     projected again if the direction or angle changed) */
+  void *const screen = get_screen(preview_data);
 
-  void *const screen = (char *)first_spr + first_spr->image;
-
-  /* Final argument is the offset to the first word to be plotted! (4 bytes
-     before the end of the lowest scan line to be filled from right to left) */
-  sky_drawsky(preview_data->render_height, preview_data->export, screen,
-              (Screen_Height * Screen_Width) - 4 + (screen_y * Screen_Width));
-
-  SFSky const *const sky = (SFSky *)preview_data->export;
-  int star_tint = preview_data->render_height - sky->min_stars_height;
-  DEBUGF("Stars tint (based on height) is %d\n", star_tint);
-  const StarData *star = preview_data->stars;
-  assert(star != NULL);
-
-  if (star_tint >= 0)
-  {
-    star_tint *= StarHeightScaler;
-
-    for (int s = 0; s < NStars; s++, star++)
-    {
-      /* Rotate the 3D coordinates of the star to find its position relative
-         to the camera */
-      tmp = star->pos;
-      cam_rotate(&tmp, x_rot, y_rot);
-      if (tmp.y < MinStarDist)
-      {
-        DEBUGF("Star is too close to render (%d < %d)\n", tmp.y, MinStarDist);
-        continue;
-      }
-
-      /* Project the rotated 3D coordinates onto the 2D screen */
-      int screen_x = 0;
-      persp_project(&tmp, &screen_x, &screen_y);
-
-      /* Plot a star of the appropriate colour and brightness at the screen
-         coordinates */
-      star_plot(star_tint, screen,
-                Screen_Width/2 + screen_x, Screen_Height + screen_y,
-                star->colour, star->bright, star->size);
-    }
-  }
+  assert(preview_data->stars != NULL);
+  assert(preview_data->star_cache != NULL);
+  scene_render_cached(preview_data->export, &*preview_data->stars,
+                      &*preview_data->star_cache, screen,
+                      preview_data->render_height,
+                      preview_data->render_direction,
+                      preview_data->render_angle);
 
   nobudge_deregister();
 
@@ -933,105 +819,7 @@ static void cleanup(void)
 {
   DEBUGF("Cleaning up on exit\n");
   free(col_trans_table);
-  free(persp_table);
-  TrigTable_destroy(trig_table);
-}
-
-/* ----------------------------------------------------------------------- */
-
-static void generate_stars(StarData *stars)
-{
-  assert(stars != NULL);
-
-  if (!trig_table) {
-    return;
-  }
-  const TrigTable *const tt = &*trig_table;
-
-  for (int s = 0; s < NStars; s++, stars++)
-  {
-    static const uint8_t star_colours[] =
-    {
-      Colour_Red,
-      Colour_Cyan,
-      Colour_Blue,
-      Colour_Yellow,
-      Colour_White
-    };
-
-    /* Generate two random angles:
-       1. Angle from directly in front (z rotation)
-       2. Angle from the vertical (x rotation) */
-    int const angle1 = (unsigned)rand() % (QuarterTurn * 4);
-    int const angle2 = (unsigned)rand() % (QuarterTurn * 4);
-
-    /* Get length of the adjacent side of a right-angle triangle with a
-       hypotenuse of length SineMultiplier. Assume adjacent is codirectional
-       with z axis and use as the elevation of a star. */
-    int z = TrigTable_look_up_cosine(tt, angle2);
-    if (z > 0)
-    {
-      z = -z; /* Force point above ground level by sign reversal */
-    }
-    z = z - MinStarHeight; /* Ensure minimum elevation */
-
-    /* Get length of opposite side of same triangle. Assume opposite is
-       codirectional with y axis and use as horizontal distance to the star. */
-    int y = TrigTable_look_up_sine(tt, angle2);
-    if (y < 0)
-    {
-      y = -y;
-    }
-
-    /* Rotate the vector (0, y, z) around the z axis by a random angle, to
-       make it three-dimensional. Standard rotation formula is simplified
-       because the x coordinate is always 0. */
-    int const x = (y * TrigTable_look_up_cosine(tt, angle1)) /
-                  SineMultiplier;
-    y = (y * TrigTable_look_up_sine(tt, angle1)) / SineMultiplier;
-
-    stars->pos.x = x * (StarDist / SineMultiplier);
-    stars->pos.y = y * (StarDist / SineMultiplier);
-    stars->pos.z = z * (StarDist / SineMultiplier);
-
-    /* Choose a random star colour from the array (biased towards the last) */
-    assert(NStarColours >= ARRAY_SIZE(star_colours));
-    size_t c = (unsigned)rand() % NStarColours;
-    if (c >= ARRAY_SIZE(star_colours))
-    {
-      c = ARRAY_SIZE(star_colours) - 1;
-    }
-    stars->colour = star_colours[c];
-
-    stars->bright = (unsigned)rand() % MaxStarBright;
-    stars->size = (unsigned)rand() % MaxStarSize;
-  }
-}
-
-/* ----------------------------------------------------------------------- */
-
-static bool generate_persp(void)
-{
-  /* Pre-calculate reciprocals to be used for perspective projection */
-  _Optional int *const pt = malloc(sizeof(*pt) * PerspTableLen);
-  if (pt == NULL)
-  {
-    return false; /* failure */
-  }
-
-  DEBUGF("Making reciprocal table with %d entries\n", PerspTableLen);
-  int divisor = PerspDivisorBase;
-
-  for (int r = 0; r < PerspTableLen; r++)
-  {
-    pt[r] = PerspDividend / divisor;
-    DEBUG_VERBOSEF("%d: %d / %d = %d\n", r, PerspDividend, divisor,
-                   pt[r]);
-    divisor += PerspDivisorStep;
-  }
-  persp_table = pt;
-
-  return true; /* success */
+  scene_finalise();
 }
 
 /* ----------------------------------------------------------------------- */
@@ -1212,9 +1000,10 @@ static int misc_tb_event(int const event_code, ToolboxEvent *const event,
     case EventCode_PreviewNewStars:
     {
       /* Generate a different set of pseudo-random stars */
-      nobudge_register(PreExpandHeap);
-      generate_stars(preview_data->stars);
-      nobudge_deregister();
+      assert(preview_data->stars != NULL);
+      assert(preview_data->star_cache != NULL);
+      scene_make_stars(&*preview_data->stars, ++preview_data->star_seed);
+      scene_invalidate_stars(&*preview_data->star_cache);
 
       render_scene(preview_data);
       break;
@@ -1253,11 +1042,7 @@ void Preview_initialise(void)
 {
   atexit(cleanup);
 
-  /* Generate trigonometric look-up tables and reciprocals for
-     perspective projection */
-  trig_table = TrigTable_make(SineMultiplier, QuarterTurn);
-
-  if (trig_table == NULL || !generate_persp())
+  if (!scene_initialise())
   {
     err_complain_fatal(DUMMY_ERRNO, msgs_lookup("NoMem"));
   }
@@ -1286,7 +1071,9 @@ _Optional PreviewData *Preview_create(SkyFile *const file, char const *const tit
     .no_scale = false,
     .have_caret = false,
     .plot_err = false,
+    .dirty_all = true, /* nothing has been rendered yet */
     .file = file,
+    .star_seed = StarSeed_Default,
   };
 
   /* Create Window object */
@@ -1306,8 +1093,14 @@ _Optional PreviewData *Preview_create(SkyFile *const file, char const *const tit
       {
         /* Allocate memory for a sprite in which to render the sky
            and for stars data */
-        if (!flex_alloc(&preview_data->stars,
-                        sizeof(StarData) * NStars))
+        preview_data->stars = scene_create_stars(preview_stars);
+        if (preview_data->stars != NULL)
+        {
+          preview_data->star_cache = scene_create_cache(
+                                       &*preview_data->stars);
+        }
+
+        if (preview_data->star_cache == NULL)
         {
           RPT_ERR("NoMem");
         }
@@ -1353,7 +1146,7 @@ _Optional PreviewData *Preview_create(SkyFile *const file, char const *const tit
                   break;
                 }
 
-                nobudge_register(PreExpandHeap); /* protect cached_image & stars */
+                nobudge_register(PreExpandHeap); /* protect cached_image */
 
                 /* Create a sprite in which to render the sky */
                 spritearea_init(preview_data->cached_image, sprite_area_size);
@@ -1373,11 +1166,13 @@ _Optional PreviewData *Preview_create(SkyFile *const file, char const *const tit
                 sprite->mask = sizeof(*sprite);
                 sprite->type = Screen_Mode;
 
-                /* Generate a set of pseudo-random stars */
-                generate_stars(preview_data->stars);
-
                 nobudge_deregister();
 
+                /* Generate a set of pseudo-random stars (the same for
+                   every new preview) */
+                scene_make_stars(&*preview_data->stars,
+                                 preview_data->star_seed);
+
                 /* Start at horizontal ground level */
                 set_height(&*preview_data, Height_Default);
                 set_direction(&*preview_data, Direction_Default);
@@ -1396,8 +1191,9 @@ _Optional PreviewData *Preview_create(SkyFile *const file, char const *const tit
             }
             flex_free(&preview_data->cached_image);
           }
-          flex_free(&preview_data->stars);
         }
+        scene_destroy_cache(preview_data->star_cache);
+        scene_destroy_stars(preview_data->stars);
         (void)event_deregister_message_handler(-1, message_handler,
             &*preview_data);
       }
@@ -1454,10 +1250,8 @@ void Preview_destroy(_Optional PreviewData *const preview_data)
   }
 
   /* Free array of random stars */
-  if (preview_data->stars)
-  {
-    flex_free(&preview_data->stars);
-  }
+  scene_destroy_cache(preview_data->star_cache);
+  scene_destroy_stars(preview_data->stars);
 
   /* Free file being previewed */
   if (preview_data->export)
@@ -1562,11 +1356,61 @@ void Preview_update(PreviewData *const preview_data)
   if (!success && preview_data->export)
   {
     flex_free(&preview_data->export);
+    preview_data->dirty_all = true; /* image cache is now out of date */
+    return;
+  }
+
+  /* Only the scan lines showing changed colour bands need to be drawn
+     again, unless something else changed (or we don't know what did) */
+  if (!preview_data->dirty_all &&
+      preview_data->dirty_start < preview_data->dirty_end)
+  {
+    render_bands(preview_data);
   }
   else
   {
     render_scene(preview_data);
   }
+
+  preview_data->dirty_all = false;
+  preview_data->dirty_start = preview_data->dirty_end = 0;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void Preview_invalidate(PreviewData *const preview_data)
+{
+  assert(preview_data != NULL);
+  preview_data->dirty_all = true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void Preview_invalidate_bands(PreviewData *const preview_data,
+  int const start, int const end)
+{
+  assert(preview_data != NULL);
+  assert(start >= 0);
+  assert(start <= end);
+
+  if (start == end)
+  {
+    return;
+  }
+
+  if (preview_data->dirty_start >= preview_data->dirty_end)
+  {
+    preview_data->dirty_start = start;
+    preview_data->dirty_end = end;
+  }
+  else
+  {
+    preview_data->dirty_start = LOWEST(preview_data->dirty_start, start);
+    preview_data->dirty_end = HIGHEST(preview_data->dirty_end, end);
+  }
+  DEBUGF("Colour bands %d to %d of preview %p need redrawing\n",
+         preview_data->dirty_start, preview_data->dirty_end,
+         (void *)preview_data);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -20,12 +20,20 @@
 
 typedef struct PreviewData PreviewData;
 
+extern int preview_stars;
+
 void Preview_initialise(void);
 _Optional PreviewData *Preview_create(SkyFile *file, char const *title);
 void Preview_destroy(_Optional PreviewData *preview_data);
 void Preview_show(PreviewData *preview_data, ObjectId parent_id);
 void Preview_set_title(PreviewData *preview_data, char const *title);
 void Preview_update(PreviewData *preview_data);
+
+/* Record that the whole sky or colour bands start to end-1 have changed,
+   so that the next update knows what to redraw. */
+void Preview_invalidate(PreviewData *preview_data);
+void Preview_invalidate_bands(PreviewData *preview_data, int start, int end);
+
 bool Preview_get_toolbars(const PreviewData *prev_data);
 void Preview_set_scale(PreviewData *preview_data, int scale);
 int Preview_get_scale(const PreviewData *preview_data);
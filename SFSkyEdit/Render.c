@@ -0,0 +1,398 @@
+/*
+ *  SFSkyEdit - Star Fighter 3000 sky colours editor
+ *  Sky renderer (portable version of Render.s)
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* This produces exactly the same pixels as the original ARM code, but can
+   be built for any platform. Instead of storing four registers at a time,
+   each scan line is filled by copying a word-sized pattern into a span of
+   doubling length, which lets the C library use the widest stores that the
+   target supports. Writes that the ARM code would have made outside the
+   frame buffer are discarded rather than corrupting memory. */
+
+/* ISO library files */
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "SFFormats.h"
+#include "Debug.h"
+
+/* Local headers */
+#include "Render.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  ScreenWidth = 320, /* Bytes per scan line (8 bits per pixel) */
+  ScreenHeight = 256,
+  ScreenSize = ScreenWidth * ScreenHeight,
+  WordSize = 4,
+  SkyHeaderWords = 2, /* render offset and stars height */
+  MaxColourIndex = 255,
+  MinColourCap = 48,
+  StarMinX = 2,
+  StarMaxX = 315,
+  StarMinY = 2,
+  StarMaxY = 253,
+  StarThreshold = 4096,
+  StarShadeLog2 = 9,
+  StarRingStep = 4, /* Decrease in shade for each ring of the star */
+};
+
+static uint8_t const star_colours[] =
+{
+  0x00, 0x01, 0x02, 0x03,
+  0x2c, 0x2d, 0x2e, 0x2f,
+  0xd0, 0xd1, 0xd2, 0xd3,
+  0xfc, 0xfd, 0xfe, 0xff
+};
+
+typedef struct
+{
+  int32_t first_row; /* range of rows of the sky to be drawn */
+  int32_t end_row;
+  int32_t first_line; /* range of scan lines drawn (empty if none) */
+  int32_t end_line;
+}
+SkyRows;
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static inline int32_t asr(int32_t const value, int const shift)
+{
+  /* Arithmetic shift right, as performed by the ARM's barrel shifter */
+  return value >= 0 ? value >> shift : -1 - ((-1 - value) >> shift);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static inline int32_t floor_div(int32_t const num, int32_t const den)
+{
+  /* Division rounding towards minus infinity */
+  assert(den > 0);
+  return num >= 0 ? num / den : -1 - ((-1 - num) / den);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int32_t get_sky_row(int32_t const colour_pos, int32_t const cap)
+{
+  /* Get the index of the row of the sky to be plotted */
+  int32_t index = asr(colour_pos, 10);
+  if (index > cap)
+  {
+    index = cap;
+  }
+
+  /* The ARM code doesn't check for negative indices, which would read the
+     file header; nothing before that is addressable here. */
+  if (index < -SkyHeaderWords)
+  {
+    index = -SkyHeaderWords;
+  }
+
+  return index;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void fill_line(uint8_t *const screen, int32_t const last_word,
+  uint8_t const *const word, int const rotate)
+{
+  /* Fill the scan line ending with the word at offset 'last_word', as
+     if by STMDA from that address. */
+  assert(screen != NULL);
+  assert(rotate >= 0);
+  assert(rotate < WordSize);
+
+  int32_t start = last_word + WordSize - ScreenWidth;
+  int32_t end = last_word + WordSize;
+  if (start >= ScreenSize || end <= 0)
+  {
+    return;
+  }
+
+  /* Keep the phase of the pattern when clipping the start of the span */
+  int phase = rotate;
+  if (start < 0)
+  {
+    phase = (int)((rotate - start) % WordSize);
+    start = 0;
+  }
+  end = LOWEST(end, (int32_t)ScreenSize);
+
+  uint8_t *const span = screen + start;
+  size_t const len = (size_t)(end - start);
+  size_t done = LOWEST(len, (size_t)WordSize);
+  for (size_t i = 0; i < done; ++i)
+  {
+    span[i] = word[(phase + i) % WordSize];
+  }
+
+  /* Double the filled part of the span until it covers the whole line */
+  while (done < len)
+  {
+    size_t const n = LOWEST(done, len - done);
+    memcpy(span + done, span, n);
+    done += n;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void draw_line(uint8_t const *const sky, uint8_t *const screen,
+  int32_t const last_word, int32_t const colour_pos, int32_t const cap,
+  int const rotate, SkyRows *const rows)
+{
+  /* Fill one scan line, unless the row of the sky to be plotted there
+     is outside the range to be drawn */
+  assert(rows != NULL);
+
+  int32_t const index = get_sky_row(colour_pos, cap);
+  if (index < rows->first_row || index >= rows->end_row)
+  {
+    return;
+  }
+
+  uint8_t word[WordSize];
+  memcpy(word, sky + ((SkyHeaderWords + index) * WordSize), WordSize);
+  fill_line(screen, last_word, word, rotate);
+
+  /* Record which scan lines were touched (within the screen) */
+  int32_t const first_line = HIGHEST(
+    floor_div(last_word + WordSize - ScreenWidth, ScreenWidth), 0);
+  int32_t const end_line = LOWEST(
+    floor_div(last_word + WordSize - 1, ScreenWidth) + 1, ScreenHeight);
+
+  if (first_line < end_line)
+  {
+    if (rows->first_line >= rows->end_line)
+    {
+      rows->first_line = first_line;
+      rows->end_line = end_line;
+    }
+    else
+    {
+      rows->first_line = LOWEST(rows->first_line, first_line);
+      rows->end_line = HIGHEST(rows->end_line, end_line);
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void draw_sky(int32_t const height_scaler, uint8_t const *const file,
+  uint8_t *const screen, int32_t const scrstart_offset, SkyRows *const rows)
+{
+  assert(file != NULL);
+  assert(screen != NULL);
+  assert(rows != NULL);
+  assert(scrstart_offset % WordSize == 0);
+
+  /* Calculate height-related cap for colour index (48 to 255) */
+  int32_t cap = asr(height_scaler, 7);
+  cap += asr(cap, 1) + MinColourCap;
+  if (cap > MaxColourIndex)
+  {
+    cap = MaxColourIndex;
+  }
+
+  int32_t render_offset;
+  memcpy(&render_offset, file, sizeof(render_offset));
+
+  int32_t step = height_scaler + render_offset;
+  int32_t colour_pos = 0;
+  int32_t pos = scrstart_offset;
+
+  DEBUGF("Drawing sky with step %ld, cap %ld, from offset %ld\n",
+         (long)step, (long)cap, (long)pos);
+
+  if (pos >= ScreenSize)
+  {
+    /* Skip lines below the bottom of the screen, in pairs like the main
+       loop below, but stop as soon as a line is within the screen. */
+    for (;;)
+    {
+      colour_pos += step; /* the higher you are, the narrower the bands */
+      step -= asr(step, 5); /* the later bands also change slower */
+      pos -= ScreenWidth;
+      if (pos < ScreenSize)
+      {
+        break;
+      }
+
+      colour_pos += step * 2;
+      step -= asr(step, 4);
+      pos -= ScreenWidth;
+      if (pos < ScreenSize)
+      {
+        break;
+      }
+    }
+  }
+  else if (pos <= 0)
+  {
+    return; /* clip for top of screen */
+  }
+
+  do
+  {
+    draw_line(file, screen, pos, colour_pos, cap, 0, rows);
+    pos -= ScreenWidth;
+    if (pos <= 0)
+    {
+      break;
+    }
+
+    colour_pos += step;
+    step -= asr(step, 5);
+
+    /* Rotate the pattern on alternate lines to prevent stripes in
+       the dithering */
+    draw_line(file, screen, pos, colour_pos, cap, 1, rows);
+    pos -= ScreenWidth;
+
+    colour_pos += step * 2;
+    step -= asr(step, 4);
+  }
+  while (pos > 0);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static inline void star_point(uint8_t *const screen, int32_t const offset,
+  uint8_t const colour)
+{
+  assert(offset >= 0);
+  assert(offset < ScreenSize);
+  screen[offset] |= colour;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+void sky_drawsky(int height_scaler, const SFSky *const sky,
+  void *const screen_address, int const scrstart_offset)
+{
+  assert(sky != NULL);
+  assert(screen_address != NULL);
+
+  SkyRows rows = {
+    .first_row = -SkyHeaderWords,
+    .end_row = MaxColourIndex + 1
+  };
+  draw_sky(height_scaler, (uint8_t const *)sky, screen_address,
+           scrstart_offset, &rows);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void sky_drawsky_rows(int height_scaler, const SFSky *const sky,
+  void *const screen_address, int const scrstart_offset,
+  int const first_row, int const end_row, int *const first_line,
+  int *const end_line)
+{
+  assert(sky != NULL);
+  assert(screen_address != NULL);
+  assert(first_row <= end_row);
+  assert(first_line != NULL);
+  assert(end_line != NULL);
+
+  SkyRows rows = {
+    .first_row = first_row,
+    .end_row = end_row
+  };
+  draw_sky(height_scaler, (uint8_t const *)sky, screen_address,
+           scrstart_offset, &rows);
+
+  *first_line = (int)rows.first_line;
+  *end_line = (int)rows.end_line;
+  DEBUGF("Drew sky rows %d..%d on scan lines %d..%d\n",
+         first_row, end_row, *first_line, *end_line);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void star_plot(int height, void *const screen_address, int const x,
+  int const y, int const colour, int const bright, int const size)
+{
+  assert(screen_address != NULL);
+
+  if (x < StarMinX || y < StarMinY || x > StarMaxX || y > StarMaxY)
+  {
+    return; /* cannot plot */
+  }
+
+  uint8_t *const screen = screen_address;
+  int32_t const offset = x + (y * ScreenWidth);
+
+  int32_t shade = height + bright - StarThreshold;
+  if (shade < 0)
+  {
+    return;
+  }
+
+  shade = asr(shade, StarShadeLog2);
+  if (shade > size)
+  {
+    shade = size;
+  }
+
+  /* The ARM code would read outside its colour table */
+  assert(shade >= 0);
+  assert(shade < (int32_t)ARRAY_SIZE(star_colours));
+  shade = HIGHEST(LOWEST(shade, (int32_t)ARRAY_SIZE(star_colours) - 1), 0);
+
+  /* Centre (maximum brightness) */
+  star_point(screen, offset, star_colours[shade]);
+
+  /* Inner ring (medium brightness) */
+  shade -= StarRingStep;
+  if (shade < 0)
+  {
+    return;
+  }
+
+  uint8_t tint = star_colours[shade] & (uint8_t)colour;
+  star_point(screen, offset - 1, tint);
+  star_point(screen, offset + 1, tint);
+  star_point(screen, offset - ScreenWidth, tint);
+  star_point(screen, offset + ScreenWidth, tint);
+
+  /* Outer ring (low brightness) */
+  shade -= StarRingStep;
+  if (shade < 0)
+  {
+    return;
+  }
+
+  tint = star_colours[shade] & (uint8_t)colour;
+  star_point(screen, offset - 2, tint);
+  star_point(screen, offset + 2, tint);
+  star_point(screen, offset - (ScreenWidth * 2), tint);
+  star_point(screen, offset + (ScreenWidth * 2), tint);
+}
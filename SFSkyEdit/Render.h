@@ -10,9 +10,19 @@
 #include "SFFormats.h"
 
 /* Final argument is the offset to the first word to be plotted! (4 bytes
-   before the end of the lowest scan line to be filled from right to left) */
+   before the end of the lowest scan line to be filled from right to left)
+   It must be a multiple of 4. */
 void sky_drawsky(int height_scaler, const SFSky *sky, void *screen_address, int scrstart_offset);
 
+/* As sky_drawsky, but only fills scan lines on which rows first_row to
+   end_row-1 of the sky would be plotted, leaving the others unchanged.
+   Outputs the range of scan lines (counting from the top of the screen)
+   that were filled, or an empty range if none. Render.s fills every scan
+   line that sky_drawsky would fill and outputs the whole screen instead. */
+void sky_drawsky_rows(int height_scaler, const SFSky *sky, void *screen_address,
+  int scrstart_offset, int first_row, int end_row, int *first_line,
+  int *end_line);
+
 void star_plot(int height, void *screen_address, int x, int y, int colour, int bright, int size);
 
 #endif
@@ -22,12 +22,14 @@
 ; 13.07.01 CJB Modified for APCS-32 compliance
 ; 16.10.03 CJB Tweaked stack check to check for -ve rather than signed lower
 ; 21.09.09 CJB Added star plotting routine
+; 16.10.26 CJB Added partial sky drawing routine (draws the whole sky)
 
 ; Area name C$$code advisable if wanted to link with C output
 
         AREA    |C$$code|, CODE, READONLY
 
         EXPORT  |sky_drawsky|
+        EXPORT  |sky_drawsky_rows|
         EXPORT  |star_plot|
         IMPORT  |__rt_stkovf_split_small|
 
@@ -194,6 +196,44 @@ sky_clipskyagain
 
 ; -----------------------------------------------------------------------
 
+; C prototype :
+;   void sky_drawsky_rows(int    height_scaler,
+;                         SFSky *sky,
+;                         void  *screen_address,
+;                         int    scrstart_offset,
+;                         int    first_row,
+;                         int    end_row,
+;                         int   *first_line,
+;                         int   *end_line);
+
+; a1-a4 as for sky_drawsky
+; sp    -> First row of sky to draw
+; sp+4  -> End row of sky to draw (exclusive)
+; sp+8  -> Address at which to store first scan line filled
+; sp+12 -> Address at which to store end scan line filled (exclusive)
+
+; Rather than drawing only the requested rows, this draws the whole sky
+; (unless no rows were requested) and reports the whole screen as filled.
+; -----------------------------------------------------------------------
+
+|sky_drawsky_rows|
+  STMFD  sp!, {v1-v4}
+  ADD    ip, sp, #16
+  LDMIA  ip, {v1-v4}          ; load the stacked arguments
+
+  MOV    ip, #0
+  STR    ip, [v3]             ; filled from the top of the screen
+  CMP    v1, v2
+    STRGE  ip, [v4]           ; to the top of the screen if no rows
+    MOVLT  ip, #256
+    STRLT  ip, [v4]           ; otherwise to the bottom of the screen
+
+  LDMFD  sp!, {v1-v4}         ; doesn't change the flags
+    MOVGE  pc, lr             ; nothing to draw
+  B      |sky_drawsky|        ; draw the whole sky and return to caller
+
+; -----------------------------------------------------------------------
+
 ; C prototype :
 ;   void star_plot(int           height,
 ;                  void         *screen_address,
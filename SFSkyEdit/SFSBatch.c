@@ -0,0 +1,733 @@
+/*
+ *  SFSkyEdit - Star Fighter 3000 sky colours editor
+ *  Command-line batch renderer for sky previews
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* Unlike the rest of SFSkyEdit, this program has no dependency on the
+   RISC OS toolbox or Wimp. It renders the same view of a sky file as the
+   preview window, but for every combination of a range of heights,
+   directions and angles, to make a contact sheet. Frames can be rendered
+   concurrently on a pool of worker threads, but they are always written
+   in order. The output is either a sprite file with one sprite per frame
+   or the raw frames (one byte per pixel, top row first) one after another.
+   The same pseudo-random star field is used for every frame.
+
+   The frames can also be compared with those in a reference file written
+   earlier with the same options, to check that changes to the renderer
+   don't change its output, and the time taken to fill the sky and plot
+   the stars can be reported for each frame. */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <assert.h>
+#include <limits.h>
+#include <time.h>
+
+/* My library files */
+#include "Macros.h"
+#include "SFFormats.h"
+#include "SprFormats.h"
+#include "Debug.h"
+#include "Reader.h"
+#include "Writer.h"
+#include "ReaderGKey.h"
+#include "WriterMem.h"
+#include "WriterRaw.h"
+
+/* Local headers */
+#include "Sky.h"
+#include "Scene.h"
+#include "BatchPool.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  FednetHistoryLog2 = 9, /* Base 2 logarithm of the history size used by
+                            the compression algorithm */
+  Height_Min        = 0,    /* Ground level (in internal units) */
+  Height_Max        = 3648, /* observed limit */
+  Direction_Min     = 0,    /* North (in degrees clockwise) */
+  Direction_Max     = 359,
+  Angle_Min         = 0,    /* Horizontal (in degrees) */
+  Angle_Max         = 60,
+  SpriteType        = 13,   /* Mode number (45 dpi, 8 bits per pixel) */
+  SprAreaHdrSize    = sizeof(int32_t) * 4,
+  SprHdrSize        = sizeof(int32_t) * 11,
+  SprNameSize       = 12,
+  SprSize           = SprHdrSize + SceneSize,
+  MaxFrames         = (INT32_MAX - SprAreaHdrSize) / SprSize,
+  QueueSlotsPerThread = 4, /* Frames queued ahead of the workers */
+  DefaultSeed       = 1,
+};
+
+typedef struct
+{
+  int first;
+  int last;
+  int step;
+}
+BatchRange;
+
+typedef struct
+{
+  BatchRange heights;
+  BatchRange directions;
+  BatchRange angles;
+  bool raw;
+  bool verbose;
+  int repeats; /* no. of times to render each frame when timing, or 0 */
+}
+BatchOptions;
+
+typedef struct
+{
+  BatchOptions opts;
+  SFSky sky;
+  StarField *stars;
+  Writer writer;
+  _Optional FILE *ref; /* reference file to compare with, or NULL */
+  uint8_t ref_image[SceneSize];
+  /* The following are only updated on the main thread */
+  unsigned long int num_output;
+  unsigned long int num_differ;
+  clock_t sky_time;
+  clock_t star_time;
+}
+BatchContext;
+
+typedef struct
+{
+  int height;
+  int direction;
+  int angle;
+  clock_t sky_time; /* only if timing */
+  clock_t star_time;
+  uint8_t image[SceneSize];
+}
+BatchJob;
+
+static char const *prog_name = "SFSkyEditBatch";
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static char const *sky_state_text(SkyState const state)
+{
+  static char const *const ss_to_text[] = {
+    [SkyState_OK] = "No error",
+    [SkyState_ReadFail] = "Failed to read from file",
+    [SkyState_BadLen] = "File is truncated",
+    [SkyState_BadRend] = "Bad sky render offset",
+    [SkyState_BadStar] = "Bad minimum stars height",
+    [SkyState_BadDither] = "Bad sky colour dithering",
+  };
+
+  char const *text = NULL;
+  if ((size_t)state < ARRAY_SIZE(ss_to_text))
+  {
+    text = ss_to_text[state];
+  }
+  return text ? text : "Unknown error";
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int range_count(BatchRange const *const range)
+{
+  assert(range != NULL);
+  assert(range->step > 0);
+  assert(range->last >= range->first);
+  return ((range->last - range->first) / range->step) + 1;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool parse_range(char const *const str, int const min, int const max,
+  BatchRange *const range)
+{
+  /* Accepts "first" or "first,last" or "first,last,step" */
+  assert(str != NULL);
+  assert(range != NULL);
+
+  long int values[3] = {0, 0, 1};
+  size_t n = 0;
+  char const *p = str;
+  do
+  {
+    char *endp;
+    values[n++] = strtol(p, &endp, 10);
+    if (endp == p || (*endp != '\0' && *endp != ','))
+    {
+      return false;
+    }
+    p = endp;
+  }
+  while (*p++ == ',' && n < ARRAY_SIZE(values));
+
+  if (p[-1] != '\0')
+  {
+    return false; /* too many values */
+  }
+
+  if (n == 1)
+  {
+    values[1] = values[0];
+  }
+
+  if (values[0] < min || values[1] > max || values[0] > values[1] ||
+      values[2] < 1 || values[2] > max - min + 1)
+  {
+    return false;
+  }
+
+  *range = (BatchRange){(int)values[0], (int)values[1], (int)values[2]};
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool load_sky(char const *const load_path, SFSky *const sky)
+{
+  assert(load_path != NULL);
+  assert(sky != NULL);
+
+  FILE *const in = fopen(load_path, "rb");
+  if (!in)
+  {
+    fprintf(stderr, "%s: %s: Failed to open input file\n", prog_name,
+            load_path);
+    return false;
+  }
+
+  Reader reader;
+  if (!reader_gkey_init(&reader, FednetHistoryLog2, in))
+  {
+    fclose(in);
+    fprintf(stderr, "%s: Not enough free memory\n", prog_name);
+    return false;
+  }
+
+  /* Read the sky in the same way as the editor, then export it in the
+     game's format for rendering, as the preview window does. */
+  Sky edit_sky;
+  SkyState const state = sky_read_file(&edit_sky, &reader);
+  reader_destroy(&reader);
+  fclose(in);
+
+  if (state != SkyState_OK)
+  {
+    fprintf(stderr, "%s: %s: %s\n", prog_name, load_path,
+            sky_state_text(state));
+    return false;
+  }
+
+  Writer writer;
+  if (!writer_mem_init(&writer, sky, sizeof(*sky)))
+  {
+    fprintf(stderr, "%s: Not enough free memory\n", prog_name);
+    return false;
+  }
+
+  sky_write_file(&edit_sky, &writer);
+  long int const size = writer_destroy(&writer);
+  assert(size == (long)sizeof(*sky));
+  NOT_USED(size);
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void write_sprite_area_hdr(int32_t const sprite_count,
+  Writer *const writer)
+{
+  assert(sprite_count >= 0);
+  assert(sprite_count <= MaxFrames);
+
+  /* The first word of a sprite area isn't stored in files. */
+  writer_fwrite_int32(sprite_count, writer);
+  writer_fwrite_int32(SprAreaHdrSize, writer);
+  writer_fwrite_int32(SprAreaHdrSize + (sprite_count * SprSize), writer);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void write_spr_header(BatchJob const *const bj, Writer *const writer)
+{
+  char namebuf[SprNameSize + 1];
+
+  assert(bj != NULL);
+
+  /* Note: sprite names of maximum length needn't be terminated. */
+  int const nchars = sprintf(namebuf, "h%04dd%03da%02d", bj->height,
+                             bj->direction, bj->angle);
+  assert(nchars == SprNameSize);
+  NOT_USED(nchars);
+
+  writer_fwrite_int32(SprSize, writer);
+  writer_fwrite(namebuf, SprNameSize, 1, writer);
+  writer_fwrite_int32(WORD_ALIGN(SceneWidth) / 4 - 1, writer);
+  writer_fwrite_int32(SceneHeight - 1, writer);
+  writer_fwrite_int32(0, writer); /* left bit */
+  writer_fwrite_int32(SPRITE_RIGHT_BIT(SceneWidth, 8), writer);
+  writer_fwrite_int32(SprHdrSize, writer);
+  writer_fwrite_int32(SprHdrSize, writer);
+  writer_fwrite_int32(SpriteType, writer);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void render_frame(void *const job, void *const arg)
+{
+  /* May be called on a worker thread, so must only touch the job */
+  BatchJob *const bj = job;
+  BatchContext const *const context = arg;
+  assert(bj != NULL);
+  assert(context != NULL);
+
+  assert(context->stars != NULL);
+  if (context->opts.repeats == 0)
+  {
+    scene_render(&context->sky, context->stars, bj->image, bj->height,
+                 bj->direction, bj->angle);
+    return;
+  }
+
+  /* clock() measures processor time for the whole program, so this is
+     only meaningful if no other frames are being rendered at once.
+     The sky must be filled again before each star pass because the
+     stars are OR-ed with it. */
+  bj->sky_time = bj->star_time = 0;
+  for (int r = 0; r < context->opts.repeats; ++r)
+  {
+    clock_t const start = clock();
+    scene_render_sky(&context->sky, bj->image, bj->height, bj->angle);
+    clock_t const mid = clock();
+    scene_render_stars(&context->sky, context->stars, bj->image, bj->height,
+                       bj->direction, bj->angle);
+    clock_t const end = clock();
+
+    bj->sky_time += mid - start;
+    bj->star_time += end - mid;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static double clock_to_us(clock_t const time, int const repeats)
+{
+  /* Convert a total time to microseconds per repetition */
+  assert(repeats > 0);
+  return (double)time * 1e6 / CLOCKS_PER_SEC / repeats;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void compare_frame(BatchJob const *const bj,
+  BatchContext *const context)
+{
+  assert(bj != NULL);
+  assert(context != NULL);
+  assert(context->ref != NULL);
+
+  /* Find the same frame in the reference file, which must have been
+     written with the same options */
+  long int offset = (long)context->num_output * SceneSize;
+  if (!context->opts.raw)
+  {
+    /* The first word of a sprite area isn't stored in files. */
+    offset = (SprAreaHdrSize - (long)sizeof(int32_t)) +
+             ((long)context->num_output * SprSize) + SprHdrSize;
+  }
+
+  long int ndiff = SceneSize;
+  if (!fseek(&*context->ref, offset, SEEK_SET) &&
+      fread(context->ref_image, sizeof(context->ref_image), 1,
+            &*context->ref) == 1)
+  {
+    ndiff = 0;
+    for (size_t i = 0; i < sizeof(bj->image); ++i)
+    {
+      if (bj->image[i] != context->ref_image[i])
+      {
+        ++ndiff;
+      }
+    }
+  }
+
+  if (ndiff > 0)
+  {
+    printf("Height %d, direction %d, angle %d: %ld pixels differ from "
+           "reference\n", bj->height, bj->direction, bj->angle, ndiff);
+    context->num_differ++;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void write_frame(void *const job, void *const arg)
+{
+  /* Called in the same order as frames were submitted */
+  BatchJob *const bj = job;
+  BatchContext *const context = arg;
+  assert(bj != NULL);
+  assert(context != NULL);
+
+  if (!context->opts.raw)
+  {
+    write_spr_header(bj, &context->writer);
+  }
+  writer_fwrite(bj->image, sizeof(bj->image), 1, &context->writer);
+
+  if (context->ref)
+  {
+    compare_frame(bj, context);
+  }
+
+  if (context->opts.repeats > 0)
+  {
+    int const repeats = context->opts.repeats;
+    printf("Height %d, direction %d, angle %d: %.1f us "
+           "(sky %.1f us, stars %.1f us)\n",
+           bj->height, bj->direction, bj->angle,
+           clock_to_us(bj->sky_time + bj->star_time, repeats),
+           clock_to_us(bj->sky_time, repeats),
+           clock_to_us(bj->star_time, repeats));
+
+    context->sky_time += bj->sky_time;
+    context->star_time += bj->star_time;
+  }
+  else if (context->opts.verbose)
+  {
+    printf("Rendered height %d, direction %d, angle %d\n",
+           bj->height, bj->direction, bj->angle);
+  }
+  context->num_output++;
+  free(bj);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool submit_frames(BatchPool *const pool,
+  BatchOptions const *const opts, Writer *const writer)
+{
+  assert(pool != NULL);
+  assert(opts != NULL);
+  assert(writer != NULL);
+
+  for (int height = opts->heights.first;
+       height <= opts->heights.last;
+       height += opts->heights.step)
+  {
+    for (int direction = opts->directions.first;
+         direction <= opts->directions.last;
+         direction += opts->directions.step)
+    {
+      for (int angle = opts->angles.first;
+           angle <= opts->angles.last;
+           angle += opts->angles.step)
+      {
+        if (writer_ferror(writer))
+        {
+          return false; /* no point rendering any more frames */
+        }
+
+        _Optional BatchJob *const bj = malloc(sizeof(*bj));
+        if (!bj)
+        {
+          fprintf(stderr, "%s: Not enough free memory\n", prog_name);
+          return false;
+        }
+
+        bj->height = height;
+        bj->direction = direction;
+        bj->angle = angle;
+        batchpool_submit(pool, &*bj);
+      }
+    }
+  }
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: %s [options] sky_file out_file\n"
+    "Render a Star Fighter 3000 sky file as seen from a range of viewpoints.\n"
+    "Each range is given as first[,last[,step]].\n"
+    "Options:\n"
+    "  -a range  Angles from horizontal to render (%d to %d degrees)\n"
+    "  -c file   Compare frames with a file written with the same options\n"
+    "  -d range  Directions clockwise from north (%d to %d degrees)\n"
+    "  -h range  Heights above ground level (%d to %d)\n"
+    "  -j n      Render up to n frames at once\n"
+    "  -n count  Number of stars (0 to %d, default %d)\n"
+    "  -r        Write raw frames instead of a sprite file\n"
+    "  -s seed   Seed for the pseudo-random stars\n"
+    "  -t n      Time each frame, averaged over n renders (one thread only)\n"
+    "  -v        Report the progress of each frame\n"
+    "Frames are ordered by height, then direction, then angle.\n",
+    prog_name, Angle_Min, Angle_Max, Direction_Min, Direction_Max,
+    Height_Min, Height_Max, MaxStars, NStars);
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+int main(int argc, char *argv[])
+{
+  static BatchContext context = {
+    .opts = {
+      .heights = {Height_Min, Height_Max, 512},
+      .directions = {Direction_Min, Direction_Max, 90},
+      .angles = {Angle_Min, Angle_Max, 20},
+    }
+  };
+  BatchOptions *const opts = &context.opts;
+  int nthreads = 0;
+  _Optional char const *ref_path = NULL;
+  unsigned long int seed = DefaultSeed;
+  int nstars = NStars;
+
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; ++arg)
+  {
+    char const *const opt = argv[arg];
+    bool ok = true;
+    if (!strcmp(opt, "-r"))
+    {
+      opts->raw = true;
+    }
+    else if (!strcmp(opt, "-v"))
+    {
+      opts->verbose = true;
+    }
+    else if (!strcmp(opt, "-a") && arg + 1 < argc)
+    {
+      ok = parse_range(argv[++arg], Angle_Min, Angle_Max, &opts->angles);
+    }
+    else if (!strcmp(opt, "-d") && arg + 1 < argc)
+    {
+      ok = parse_range(argv[++arg], Direction_Min, Direction_Max,
+                       &opts->directions);
+    }
+    else if (!strcmp(opt, "-h") && arg + 1 < argc)
+    {
+      ok = parse_range(argv[++arg], Height_Min, Height_Max, &opts->heights);
+    }
+    else if (!strcmp(opt, "-s") && arg + 1 < argc)
+    {
+      char *endp;
+      seed = strtoul(argv[++arg], &endp, 10);
+      ok = (*endp == '\0');
+    }
+    else if (!strcmp(opt, "-n") && arg + 1 < argc)
+    {
+      char *endp;
+      long int const n = strtol(argv[++arg], &endp, 10);
+      ok = (*endp == '\0' && n >= 0 && n <= MaxStars);
+      nstars = (int)n;
+    }
+    else if (!strcmp(opt, "-c") && arg + 1 < argc)
+    {
+      ref_path = argv[++arg];
+    }
+    else if (!strcmp(opt, "-t") && arg + 1 < argc)
+    {
+      char *endp;
+      long int const n = strtol(argv[++arg], &endp, 10);
+      ok = (*endp == '\0' && n >= 1 && n <= INT_MAX);
+      opts->repeats = (int)n;
+    }
+    else if (!strcmp(opt, "-j") && arg + 1 < argc)
+    {
+      char *endp;
+      long int const n = strtol(argv[++arg], &endp, 10);
+      ok = (*endp == '\0' && n >= 1 && n <= INT_MAX);
+      /* The main thread only feeds the queue and writes frames */
+      nthreads = ok && n > 1 ? (int)n : 0;
+    }
+    else if (!strcmp(opt, "--"))
+    {
+      ++arg;
+      break;
+    }
+    else
+    {
+      ok = false;
+    }
+
+    if (!ok)
+    {
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc - arg != 2 || (opts->repeats > 0 && nthreads > 0))
+  {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  char const *const load_path = argv[arg++];
+  char const *const save_path = argv[arg++];
+
+  if (ref_path && !strcmp(&*ref_path, save_path))
+  {
+    fprintf(stderr, "%s: Output would overwrite the reference file\n",
+            prog_name);
+    return EXIT_FAILURE;
+  }
+
+  long int const nframes = (long)range_count(&opts->heights) *
+                           range_count(&opts->directions) *
+                           range_count(&opts->angles);
+  if (!opts->raw && nframes > MaxFrames)
+  {
+    fprintf(stderr, "%s: Too many frames for a sprite file\n", prog_name);
+    return EXIT_FAILURE;
+  }
+
+  if (!load_sky(load_path, &context.sky))
+  {
+    return EXIT_FAILURE;
+  }
+
+  if (!scene_initialise())
+  {
+    fprintf(stderr, "%s: Not enough free memory\n", prog_name);
+    return EXIT_FAILURE;
+  }
+
+  _Optional StarField *const stars = scene_create_stars(nstars);
+  if (!stars)
+  {
+    fprintf(stderr, "%s: Not enough free memory\n", prog_name);
+    scene_finalise();
+    return EXIT_FAILURE;
+  }
+  context.stars = &*stars;
+  scene_make_stars(context.stars, seed);
+
+  if (ref_path)
+  {
+    context.ref = fopen(&*ref_path, "rb");
+    if (!context.ref)
+    {
+      fprintf(stderr, "%s: %s: Failed to open reference file\n", prog_name,
+              &*ref_path);
+      scene_destroy_stars(stars);
+      scene_finalise();
+      return EXIT_FAILURE;
+    }
+  }
+
+  FILE *const out = fopen(save_path, "wb");
+  if (!out)
+  {
+    fprintf(stderr, "%s: %s: Failed to open output file\n", prog_name,
+            save_path);
+    if (context.ref)
+    {
+      fclose(&*context.ref);
+    }
+    scene_destroy_stars(stars);
+    scene_finalise();
+    return EXIT_FAILURE;
+  }
+
+  writer_raw_init(&context.writer, out);
+  if (!opts->raw)
+  {
+    write_sprite_area_hdr((int32_t)nframes, &context.writer);
+  }
+
+  bool ok = false;
+  _Optional BatchPool *const pool = batchpool_create(nthreads,
+    (size_t)(nthreads > 0 ? nthreads * QueueSlotsPerThread : 1),
+    render_frame, write_frame, &context);
+  if (!pool)
+  {
+    fprintf(stderr, "%s: Not enough free memory\n", prog_name);
+  }
+  else
+  {
+    ok = submit_frames(&*pool, opts, &context.writer);
+
+    /* Waits for outstanding frames to be rendered and written */
+    batchpool_destroy(pool);
+  }
+
+  bool const write_fail = writer_destroy(&context.writer) < 0;
+  if (fclose(out) || write_fail)
+  {
+    fprintf(stderr, "%s: %s: Failed to write to file\n", prog_name,
+            save_path);
+    ok = false;
+  }
+
+  if (!ok)
+  {
+    /* Don't leave a partial output file to be mistaken for a good one */
+    (void)remove(save_path);
+  }
+  else
+  {
+    if (opts->verbose)
+    {
+      printf("%lu frames output\n", context.num_output);
+    }
+
+    if (opts->repeats > 0 && context.num_output > 0)
+    {
+      int const repeats = (int)context.num_output * opts->repeats;
+      printf("Average per frame: %.1f us (sky %.1f us, stars %.1f us)\n",
+             clock_to_us(context.sky_time + context.star_time, repeats),
+             clock_to_us(context.sky_time, repeats),
+             clock_to_us(context.star_time, repeats));
+    }
+
+    if (context.ref)
+    {
+      printf("%lu of %lu frames differ from reference\n",
+             context.num_differ, context.num_output);
+
+      /* Keep the output for comparison with the reference */
+      ok = (context.num_differ == 0);
+    }
+  }
+
+  if (context.ref)
+  {
+    fclose(&*context.ref);
+  }
+
+  scene_destroy_stars(stars);
+  scene_finalise();
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,734 @@
+/*
+ *  SFSkyEdit - Star Fighter 3000 sky colours editor
+ *  3D scene rendering for the sky preview
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ISO library headers */
+#include <assert.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* My library files */
+#include "Macros.h"
+#include "SFFormats.h"
+#include "TrigTable.h"
+#include "Debug.h"
+
+/* Local headers */
+#include "Render.h"
+#include "Scene.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  Degrees           = 90,    /* Degrees per quarter turn (PI/2 in radians) */
+  SineMultiplier    = 1024,  /* Scaler applied to make sine values whole
+                                (SF3K uses 1023, which seems wrong) */
+  QuarterTurn       = 128,   /* No. of sine values to pre-calculate for a
+                                quarter turn (from SF3000) */
+  HorizonDist       = 16384, /* Distance from camera of a point to be rotated
+                                to calculate vertical position of horizon. */
+  MaxStarSize       = 16,
+  NStarColours      = 16,
+  MaxStarBright     = 8192,
+  Colour_Red        = 23,
+  Colour_Cyan       = 235,
+  Colour_Blue       = 139,
+  Colour_Yellow     = 119,
+  Colour_White      = 255,
+  StarHeightScaler  = 32,
+  MinStarDist       = 32768, /* Stars closer than this are assumed to be
+                                outside the viewable volume */
+  StarDist          = 8192, /* Distance from camera to stars */
+  MinStarHeight     = 128,
+  PerspDividend     = 1<<28,
+  PerspDivisorBase  = -45,
+  PerspDivisorStep  = 768,
+  PerspTableLen     = StarDist > HorizonDist ? StarDist : HorizonDist,
+  ScreenScaler      = 2048,
+  PostRotateScaler  = 8,
+  DistScaler        = 12,
+  StarBatch         = 64,    /* No. of stars to transform at a time */
+  DefaultSeed       = 1,     /* Substituted for a seed of zero, which
+                                would stop the generator */
+};
+
+typedef struct
+{
+  int x;
+  int y;
+  int z;
+}
+Point3D;
+
+struct StarCache
+{
+  bool valid;
+  int  direction;
+  int  angle;
+  int  count;  /* number of visible stars */
+  int *index;  /* of each visible star in the field */
+  int *x;      /* screen coordinates of each visible star */
+  int *y;
+};
+
+static _Optional TrigTable *trig_table = NULL; /* table of (co)sine values */
+static _Optional int *persp_table = NULL; /* table of reciprocal values for perspective
+                                             projection */
+
+/* ----------------------------------------------------------------------- */
+/*                          Private functions                              */
+
+static void cam_rotate(Point3D *const p, int const x_angle, int const y_angle)
+{
+  /* Use the trigonometric look-up table to rotate a point in 3D space
+     and apply perspective division to convert to screen coordinates */
+  assert(p != NULL);
+
+  DEBUGF("About to rotate %d,%d,%d by %d,%d\n",
+         p->x, p->y, p->z, x_angle, y_angle);
+
+  int const x_in = p->x;
+  int y_in = p->y;
+  int const z_in = p->z;
+
+  if (!trig_table) {
+    return;
+  }
+  const TrigTable *const tt = &*trig_table;
+
+  /* Apply X rotation */
+  int cos = TrigTable_look_up_cosine(tt, x_angle),
+      sin = TrigTable_look_up_sine(tt, x_angle);
+
+  p->x = (x_in * cos) / (SineMultiplier / PostRotateScaler) -
+         (y_in * sin) / (SineMultiplier / PostRotateScaler);
+
+  y_in = (x_in * sin) / SineMultiplier +
+         (y_in * cos) / SineMultiplier;
+
+  /* Apply Y rotation */
+  cos = TrigTable_look_up_cosine(tt, y_angle);
+  sin = TrigTable_look_up_sine(tt, y_angle);
+
+  p->y = (y_in * cos) / (SineMultiplier / PostRotateScaler) -
+         (z_in * sin) / (SineMultiplier / PostRotateScaler);
+
+  p->z = (y_in * sin) / (SineMultiplier / PostRotateScaler) +
+         (z_in * cos) / (SineMultiplier / PostRotateScaler);
+
+  DEBUGF("Rotated point is %d,%d,%d\n", p->x, p->y, p->z);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void persp_project(const Point3D *const p, _Optional int *const screen_x,
+  _Optional int *const screen_y)
+{
+  int scr_x, scr_y;
+
+  assert(p != NULL);
+
+  int const index = p->y / (PerspDivisorStep / DistScaler);
+  if (index <= 0 || persp_table == NULL)
+  {
+    /* Don't attempt perspective projection of coordinates behind the camera */
+    scr_x = p->x;
+    scr_y = p->z;
+  }
+  else
+  {
+    /* Calculate screen coordinates by multiplying by the reciprocal of a
+       value derived from the distance. */
+    assert(index < PerspTableLen);
+    int const reciprocal = persp_table[index];
+    assert(reciprocal == PerspDividend /
+                         (PerspDivisorBase + PerspDivisorStep * index));
+
+    scr_x = (p->x * reciprocal) / (PerspDividend / ScreenScaler);
+    scr_y = (p->z * reciprocal) / (PerspDividend / ScreenScaler);
+  }
+  DEBUGF("Screen coordinates are %d,%d\n", scr_x, scr_y);
+
+  if (screen_x != NULL)
+    *screen_x = scr_x;
+
+  if (screen_y != NULL)
+    *screen_y = scr_y;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool generate_persp(void)
+{
+  /* Pre-calculate reciprocals to be used for perspective projection */
+  _Optional int *const pt = malloc(sizeof(*pt) * PerspTableLen);
+  if (pt == NULL)
+  {
+    return false; /* failure */
+  }
+
+  DEBUGF("Making reciprocal table with %d entries\n", PerspTableLen);
+  int divisor = PerspDivisorBase;
+
+  for (int r = 0; r < PerspTableLen; r++)
+  {
+    pt[r] = PerspDividend / divisor;
+    DEBUG_VERBOSEF("%d: %d / %d = %d\n", r, PerspDividend, divisor,
+                   pt[r]);
+    divisor += PerspDivisorStep;
+  }
+  persp_table = pt;
+
+  return true; /* success */
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int sky_start_offset(int const angle)
+{
+  /* Convert the camera angle from degrees to internal angle units */
+  int const y_rot = (angle * QuarterTurn) / Degrees;
+
+  /* Rotate a 3D point to find the position of the horizon relative to the
+     camera */
+  Point3D tmp = {
+    .x = 0,
+    .y = HorizonDist,
+    .z = 0
+  };
+  cam_rotate(&tmp, 0, y_rot);
+
+  /* Project the rotated 3D point onto the 2D screen to find the
+     vertical offset of the horizon from the vanishing point */
+  int screen_y = 0;
+  persp_project(&tmp, NULL, &screen_y);
+
+  return (SceneHeight * SceneWidth) - 4 + (screen_y * SceneWidth);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void rotate_stars(int const n, int *const xs, int *const ys,
+  int *const zs, int const x_angle, int const y_angle)
+{
+  /* Same as cam_rotate but for arrays of coordinates, which lets the
+     compiler vectorise each loop because the angles are the same for
+     every point. */
+  assert(n >= 0);
+  assert(xs != NULL);
+  assert(ys != NULL);
+  assert(zs != NULL);
+
+  if (!trig_table) {
+    return;
+  }
+  const TrigTable *const tt = &*trig_table;
+
+  /* Apply X rotation */
+  int cos = TrigTable_look_up_cosine(tt, x_angle),
+      sin = TrigTable_look_up_sine(tt, x_angle);
+
+  for (int s = 0; s < n; s++)
+  {
+    int const x_in = xs[s], y_in = ys[s];
+
+    xs[s] = (x_in * cos) / (SineMultiplier / PostRotateScaler) -
+            (y_in * sin) / (SineMultiplier / PostRotateScaler);
+
+    ys[s] = (x_in * sin) / SineMultiplier +
+            (y_in * cos) / SineMultiplier;
+  }
+
+  /* Apply Y rotation */
+  cos = TrigTable_look_up_cosine(tt, y_angle);
+  sin = TrigTable_look_up_sine(tt, y_angle);
+
+  for (int s = 0; s < n; s++)
+  {
+    int const y_in = ys[s], z_in = zs[s];
+
+    ys[s] = (y_in * cos) / (SineMultiplier / PostRotateScaler) -
+            (z_in * sin) / (SineMultiplier / PostRotateScaler);
+
+    zs[s] = (y_in * sin) / (SineMultiplier / PostRotateScaler) +
+            (z_in * cos) / (SineMultiplier / PostRotateScaler);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static uint32_t next_random(uint32_t *const state)
+{
+  /* Marsaglia's xorshift generator, which gives the same sequence on
+     every platform (unlike rand) */
+  assert(state != NULL);
+  assert(*state != 0);
+
+  uint32_t x = *state;
+  x ^= (x << 13) & UINT32_C(0xffffffff);
+  x ^= x >> 17;
+  x ^= (x << 5) & UINT32_C(0xffffffff);
+  *state = x;
+  return x;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void get_rotation(int const direction, int const angle,
+  int *const x_rot, int *const y_rot)
+{
+  /* Convert the camera angles from degrees to internal angle units */
+  assert(x_rot != NULL);
+  assert(y_rot != NULL);
+  *x_rot = (direction * QuarterTurn) / Degrees;
+  *y_rot = (angle * QuarterTurn) / Degrees;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int project_batch(StarField const *const stars, int const first,
+  int const n, int const x_rot, int const y_rot, int *const index,
+  int *const screen_x, int *const screen_y)
+{
+  /* Find the screen coordinates of a batch of up to StarBatch stars,
+     starting with the given one. Outputs the indices and coordinates of
+     the stars that are visible, and returns how many there are. */
+  assert(stars != NULL);
+  assert(first >= 0);
+  assert(n >= 0);
+  assert(n <= StarBatch);
+  assert(first + n <= stars->count);
+  assert(index != NULL);
+  assert(screen_x != NULL);
+  assert(screen_y != NULL);
+
+  /* Rotate the 3D coordinates of the stars to find their positions
+     relative to the camera */
+  int xs[StarBatch], ys[StarBatch], zs[StarBatch];
+  size_t const size = sizeof(xs[0]) * (size_t)n;
+  memcpy(xs, stars->x + first, size);
+  memcpy(ys, stars->y + first, size);
+  memcpy(zs, stars->z + first, size);
+
+  rotate_stars(n, xs, ys, zs, x_rot, y_rot);
+
+  int count = 0;
+  for (int s = 0; s < n; s++)
+  {
+    if (ys[s] < MinStarDist)
+    {
+      DEBUG_VERBOSEF("Star is too close to render (%d < %d)\n", ys[s],
+                     MinStarDist);
+      continue;
+    }
+
+    /* Project the rotated 3D coordinates onto the 2D screen */
+    Point3D const tmp = {.x = xs[s], .y = ys[s], .z = zs[s]};
+    int scr_x = 0, scr_y = 0;
+    persp_project(&tmp, &scr_x, &scr_y);
+
+    index[count] = first + s;
+    screen_x[count] = SceneWidth/2 + scr_x;
+    screen_y[count] = SceneHeight + scr_y;
+    count++;
+  }
+
+  return count;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void project_stars(StarField const *const stars,
+  StarCache *const cache, int const direction, int const angle)
+{
+  assert(stars != NULL);
+  assert(cache != NULL);
+
+  if (cache->valid && cache->direction == direction &&
+      cache->angle == angle)
+  {
+    DEBUGF("Star positions for %d,%d are cached\n", direction, angle);
+    return;
+  }
+
+  int x_rot, y_rot;
+  get_rotation(direction, angle, &x_rot, &y_rot);
+
+  int count = 0;
+  for (int first = 0; first < stars->count; first += StarBatch)
+  {
+    count += project_batch(stars, first,
+                           LOWEST(StarBatch, stars->count - first),
+                           x_rot, y_rot, cache->index + count,
+                           cache->x + count, cache->y + count);
+  }
+
+  cache->count = count;
+  cache->direction = direction;
+  cache->angle = angle;
+  cache->valid = true;
+  DEBUGF("%d stars are visible from %d,%d\n", count, direction, angle);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int get_star_tint(SFSky const *const sky, int const height)
+{
+  /* Returns a negative value if no stars are visible */
+  assert(sky != NULL);
+
+  int const star_tint = height - sky->min_stars_height;
+  DEBUGF("Stars tint (based on height) is %d\n", star_tint);
+  return star_tint < 0 ? star_tint : star_tint * StarHeightScaler;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void plot_visible(StarField const *const stars, int const star_tint,
+  void *const screen, int const n, int const *const index,
+  int const *const screen_x, int const *const screen_y)
+{
+  assert(stars != NULL);
+  assert(star_tint >= 0);
+  assert(n >= 0);
+  assert(index != NULL);
+  assert(screen_x != NULL);
+  assert(screen_y != NULL);
+
+  for (int v = 0; v < n; v++)
+  {
+    /* Plot a star of the appropriate colour and brightness at the screen
+       coordinates */
+    int const s = index[v];
+    assert(s >= 0);
+    assert(s < stars->count);
+    star_plot(star_tint, screen, screen_x[v], screen_y[v],
+              stars->colour[s], stars->bright[s], stars->size[s]);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void plot_stars(SFSky const *const sky, StarField const *const stars,
+  StarCache *const cache, void *const screen, int const height,
+  int const direction, int const angle)
+{
+  assert(cache != NULL);
+
+  int const star_tint = get_star_tint(sky, height);
+  if (star_tint < 0)
+  {
+    return;
+  }
+
+  project_stars(stars, cache, direction, angle);
+
+  plot_visible(stars, star_tint, screen, cache->count, cache->index,
+               cache->x, cache->y);
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+bool scene_initialise(void)
+{
+  /* Generate trigonometric look-up tables and reciprocals for
+     perspective projection */
+  trig_table = TrigTable_make(SineMultiplier, QuarterTurn);
+
+  return trig_table != NULL && generate_persp();
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_finalise(void)
+{
+  free(persp_table);
+  persp_table = NULL;
+  TrigTable_destroy(trig_table);
+  trig_table = NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+_Optional StarField *scene_create_stars(int const count)
+{
+  assert(count >= 0);
+  assert(count <= MaxStars);
+
+  /* Allocate all of the arrays in the same block as the header, in
+     order of decreasing alignment */
+  size_t const n = (size_t)count;
+  _Optional StarField *const stars = malloc(sizeof(*stars) +
+    ((sizeof(*stars->x) * 3) + sizeof(*stars->bright) +
+     sizeof(*stars->colour) + sizeof(*stars->size)) * n);
+
+  if (stars == NULL)
+  {
+    DEBUGF("Failed to allocate %d stars\n", count);
+    return NULL;
+  }
+
+  int *const coords = (int *)(&*stars + 1);
+  stars->count = count;
+  stars->x = coords;
+  stars->y = coords + n;
+  stars->z = coords + (n * 2);
+  stars->bright = (unsigned short *)(coords + (n * 3));
+  stars->colour = (uint8_t *)(stars->bright + n);
+  stars->size = stars->colour + n;
+
+  return stars;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_destroy_stars(_Optional StarField *const stars)
+{
+  free(stars);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_make_stars(StarField *const stars, unsigned long const seed)
+{
+  assert(stars != NULL);
+
+  if (!trig_table) {
+    return;
+  }
+  const TrigTable *const tt = &*trig_table;
+
+  uint32_t state = (uint32_t)(seed & UINT32_C(0xffffffff));
+  if (state == 0)
+  {
+    state = DefaultSeed;
+  }
+  DEBUGF("Generating %d stars from seed %lu\n", stars->count, seed);
+
+  for (int s = 0; s < stars->count; s++)
+  {
+    static const uint8_t star_colours[] =
+    {
+      Colour_Red,
+      Colour_Cyan,
+      Colour_Blue,
+      Colour_Yellow,
+      Colour_White
+    };
+
+    /* Generate two random angles:
+       1. Angle from directly in front (z rotation)
+       2. Angle from the vertical (x rotation) */
+    int const angle1 = next_random(&state) % (QuarterTurn * 4);
+    int const angle2 = next_random(&state) % (QuarterTurn * 4);
+
+    /* Get length of the adjacent side of a right-angle triangle with a
+       hypotenuse of length SineMultiplier. Assume adjacent is codirectional
+       with z axis and use as the elevation of a star. */
+    int z = TrigTable_look_up_cosine(tt, angle2);
+    if (z > 0)
+    {
+      z = -z; /* Force point above ground level by sign reversal */
+    }
+    z = z - MinStarHeight; /* Ensure minimum elevation */
+
+    /* Get length of opposite side of same triangle. Assume opposite is
+       codirectional with y axis and use as horizontal distance to the star. */
+    int y = TrigTable_look_up_sine(tt, angle2);
+    if (y < 0)
+    {
+      y = -y;
+    }
+
+    /* Rotate the vector (0, y, z) around the z axis by a random angle, to
+       make it three-dimensional. Standard rotation formula is simplified
+       because the x coordinate is always 0. */
+    int const x = (y * TrigTable_look_up_cosine(tt, angle1)) /
+                  SineMultiplier;
+    y = (y * TrigTable_look_up_sine(tt, angle1)) / SineMultiplier;
+
+    stars->x[s] = x * (StarDist / SineMultiplier);
+    stars->y[s] = y * (StarDist / SineMultiplier);
+    stars->z[s] = z * (StarDist / SineMultiplier);
+
+    /* Choose a random star colour from the array (biased towards the last) */
+    assert(NStarColours >= ARRAY_SIZE(star_colours));
+    size_t c = next_random(&state) % NStarColours;
+    if (c >= ARRAY_SIZE(star_colours))
+    {
+      c = ARRAY_SIZE(star_colours) - 1;
+    }
+    stars->colour[s] = star_colours[c];
+
+    stars->bright[s] = next_random(&state) % MaxStarBright;
+    stars->size[s] = next_random(&state) % MaxStarSize;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+_Optional StarCache *scene_create_cache(StarField const *const stars)
+{
+  assert(stars != NULL);
+
+  /* Allocate all of the arrays in the same block as the header */
+  size_t const n = (size_t)stars->count;
+  _Optional StarCache *const cache = malloc(sizeof(*cache) +
+    (sizeof(*cache->x) * 3 * n));
+
+  if (cache == NULL)
+  {
+    DEBUGF("Failed to allocate cache for %d stars\n", stars->count);
+    return NULL;
+  }
+
+  int *const arrays = (int *)(&*cache + 1);
+  *cache = (StarCache){
+    .valid = false,
+    .index = arrays,
+    .x = arrays + n,
+    .y = arrays + (n * 2),
+  };
+
+  return cache;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_destroy_cache(_Optional StarCache *const cache)
+{
+  free(cache);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_render(SFSky const *const sky, StarField const *const stars,
+  void *const screen, int const height, int const direction, int const angle)
+{
+  scene_render_sky(sky, screen, height, angle);
+  scene_render_stars(sky, stars, screen, height, direction, angle);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_render_sky(SFSky const *const sky, void *const screen,
+  int const height, int const angle)
+{
+  assert(sky != NULL);
+  assert(screen != NULL);
+
+  /* Final argument is the offset to the first word to be plotted! (4 bytes
+     before the end of the lowest scan line to be filled from right to left) */
+  sky_drawsky(height, sky, screen, sky_start_offset(angle));
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_render_stars(SFSky const *const sky, StarField const *const stars,
+  void *const screen, int const height, int const direction, int const angle)
+{
+  assert(sky != NULL);
+  assert(stars != NULL);
+  assert(screen != NULL);
+
+  int const star_tint = get_star_tint(sky, height);
+  if (star_tint < 0)
+  {
+    return;
+  }
+
+  int x_rot, y_rot;
+  get_rotation(direction, angle, &x_rot, &y_rot);
+
+  /* Transform and plot the stars in batches small enough to keep on the
+     stack, because this function may be running on many threads at once */
+  for (int first = 0; first < stars->count; first += StarBatch)
+  {
+    int index[StarBatch], screen_x[StarBatch], screen_y[StarBatch];
+    int const n = project_batch(stars, first,
+                                LOWEST(StarBatch, stars->count - first),
+                                x_rot, y_rot, index, screen_x, screen_y);
+
+    plot_visible(stars, star_tint, screen, n, index, screen_x, screen_y);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_invalidate_stars(StarCache *const cache)
+{
+  assert(cache != NULL);
+  cache->valid = false;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_render_cached(SFSky const *const sky, StarField const *const stars,
+  StarCache *const cache, void *const screen, int const height,
+  int const direction, int const angle)
+{
+  assert(sky != NULL);
+  assert(stars != NULL);
+  assert(cache != NULL);
+  assert(screen != NULL);
+
+  scene_render_sky(sky, screen, height, angle);
+  plot_stars(sky, stars, cache, screen, height, direction, angle);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scene_render_bands(SFSky const *const sky, StarField const *const stars,
+  StarCache *const cache, void *const screen, int const height,
+  int const direction, int const angle, int const start, int const end,
+  int *const first_line, int *const end_line)
+{
+  assert(sky != NULL);
+  assert(stars != NULL);
+  assert(cache != NULL);
+  assert(screen != NULL);
+  assert(start >= 0);
+  assert(start <= end);
+  assert(first_line != NULL);
+  assert(end_line != NULL);
+
+  /* Each colour band has a plain row and a row dithered with the
+     preceding band, so a band also affects the row after its own. */
+  int const first_row = start * 2;
+  int const end_row = start == end ?
+                      first_row : LOWEST((end * 2) + 1, SFSky_Height);
+
+  sky_drawsky_rows(height, sky, screen, sky_start_offset(angle),
+                   first_row, end_row, first_line, end_line);
+
+  if (*first_line < *end_line)
+  {
+    /* Stars are plotted by OR-ing them with the sky, so plotting them
+       again leaves any that weren't overwritten unchanged. */
+    plot_stars(sky, stars, cache, screen, height, direction, angle);
+  }
+}
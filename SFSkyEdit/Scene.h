@@ -0,0 +1,101 @@
+/*
+ *  SFSkyEdit - Star Fighter 3000 sky colours editor
+ *  3D scene rendering for the sky preview
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFSScene_h
+#define SFSScene_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SFFormats.h"
+
+#if !defined(USE_OPTIONAL) && !defined(_Optional)
+#define _Optional
+#endif
+
+enum
+{
+  SceneWidth  = 320, /* Width of a rendered frame (in pixels) */
+  SceneHeight = 256, /* Height of a rendered frame (in pixels) */
+  SceneSize   = SceneWidth * SceneHeight, /* one byte per pixel */
+  NStars      = 255,   /* Default number of stars */
+  MaxStars    = 65535, /* Enough for stress testing */
+};
+
+/* A field of stars, stored as one array per attribute so that their
+   positions can be transformed in batches. */
+typedef struct
+{
+  int             count;
+  int            *x;      /* 3D coordinates of each star */
+  int            *y;
+  int            *z;
+  unsigned short *bright;
+  uint8_t        *colour;
+  uint8_t        *size;
+}
+StarField;
+
+/* Screen positions of the stars that are visible from a given direction
+   and angle. These don't depend on the height, so they only need to be
+   calculated again when the camera turns or the stars are regenerated. */
+typedef struct StarCache StarCache;
+
+/* Generate the look-up tables shared by all scenes. Returns false if
+   there is not enough memory. */
+bool scene_initialise(void);
+
+void scene_finalise(void);
+
+/* Allocate or free a field of the given number of stars (0 to MaxStars).
+   The stars are not generated. */
+_Optional StarField *scene_create_stars(int count);
+void scene_destroy_stars(_Optional StarField *stars);
+
+/* Generate pseudo-random stars. The same seed always gives the same
+   stars, independent of rand() and the platform. */
+void scene_make_stars(StarField *stars, unsigned long seed);
+
+/* Allocate or free a cache big enough for the positions of the given
+   field of stars. A new cache is invalid. */
+_Optional StarCache *scene_create_cache(StarField const *stars);
+void scene_destroy_cache(_Optional StarCache *cache);
+
+/* Forget the star positions held in a cache, e.g. because the stars
+   were regenerated. */
+void scene_invalidate_stars(StarCache *cache);
+
+/* Render the sky and stars as seen from the given height (in sky plotter
+   units), direction (in degrees clockwise from north) and angle (in
+   degrees from horizontal) into an 8 bits-per-pixel frame of SceneWidth
+   by SceneHeight pixels. Safe to call concurrently once the look-up
+   tables have been generated. */
+void scene_render(SFSky const *sky, StarField const *stars, void *screen,
+  int height, int direction, int angle);
+
+/* The two passes of scene_render, which can be called separately (e.g. to
+   time them): the first fills the whole frame with the sky, then the
+   second plots the stars over it. */
+void scene_render_sky(SFSky const *sky, void *screen, int height, int angle);
+void scene_render_stars(SFSky const *sky, StarField const *stars,
+  void *screen, int height, int direction, int angle);
+
+/* As scene_render, except that the positions of the stars are taken from
+   the given cache unless the direction or angle differ from when it was
+   last updated. */
+void scene_render_cached(SFSky const *sky, StarField const *stars,
+  StarCache *cache, void *screen, int height, int direction, int angle);
+
+/* Update a frame previously rendered by scene_render_cached from the same
+   viewpoint and stars, after colour bands start to end-1 of the sky were
+   changed. Only the scan lines on which those bands are plotted are
+   redrawn. Outputs the range of scan lines (counting from the top) that
+   were redrawn, or an empty range if none. */
+void scene_render_bands(SFSky const *sky, StarField const *stars,
+  StarCache *cache, void *screen, int height, int direction, int angle,
+  int start, int end, int *first_line, int *end_line);
+
+#endif
@@ -63,7 +63,6 @@
 #include "WriterRaw.h"
 #include "WriterNull.h"
 #include "Hourglass.h"
-#include "CSV.h"
 #include "FOpenCount.h"
 
 /* Local headers */
@@ -74,6 +73,7 @@
 #include "Menus.h"
 #include "Utils.h"
 #include "SFSInit.h"
+#include "CSVReader.h"
 
 #ifdef USE_OPTIONAL
 #include "Optional.h"
@@ -159,19 +159,10 @@ static int read_csv(int values[], size_t const max, Reader *const reader)
   assert(!reader_ferror(reader));
   assert(values != NULL);
 
-  char str[256];
-  size_t const nchars = reader_fread(str, 1, sizeof(str)-1, reader);
-  str[nchars] = '\0';
-
-  _Optional char *endp;
-  size_t nvals = csv_parse_as_int(str, &endp, values, max);
-
-  if (endp == NULL && nchars == sizeof(str)-1)
-  {
-    /* We filled the buffer but didn't find the end of the record */
-    WARN("BufOFlo");
-    return -1;
-  }
+  /* Only the first record is used */
+  CSVReader csv;
+  csvreader_init(&csv, reader);
+  size_t nvals = csvreader_read_ints(&csv, values, max);
 
   nvals = LOWEST(nvals, max);
   assert(nvals <= INT_MAX);
@@ -191,12 +182,7 @@ static bool import_csv(EditWin *const edit_win, Reader *const reader,
   DEBUGF("About to import CSV %s into view %p\n", src_name, (void *)edit_win);
 
   int csv_values[NColourBands];
-  int n = read_csv(csv_values, ARRAY_SIZE(csv_values), reader);
-
-  if (n < 0)
-  {
-    return false;
-  }
+  int const n = read_csv(csv_values, ARRAY_SIZE(csv_values), reader);
 
   if (reader_ferror(reader))
   {
@@ -0,0 +1,354 @@
+/*
+ *  SFSkyEdit - Star Fighter 3000 sky colours editor
+ *  Ring buffer of variable-sized undo records
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+
+/* Local headers */
+#include "UndoRing.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Strictest alignment required for a block's contents */
+typedef union
+{
+  long int l;
+  double d;
+  void *p;
+}
+Align;
+
+/* Each block is preceded by a header. The offset of the previous block
+   is needed to free the newest block. */
+typedef union
+{
+  struct
+  {
+    size_t size; /* including the header */
+    size_t prev;
+  } h;
+  Align align;
+}
+BlockHeader;
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static BlockHeader *get_header(UndoRing const *const ring,
+  size_t const offset)
+{
+  assert(ring != NULL);
+  assert(ring->buffer != NULL);
+  assert(offset + sizeof(BlockHeader) <= ring->size);
+  return (BlockHeader *)(void *)(&*ring->buffer + offset);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static size_t get_offset(UndoRing const *const ring, void const *const block)
+{
+  assert(ring != NULL);
+  assert(ring->buffer != NULL);
+  assert(block != NULL);
+  assert(!undo_ring_is_empty(ring));
+
+  size_t const offset = (size_t)((char const *)block - &*ring->buffer) -
+                        sizeof(BlockHeader);
+  assert(offset < ring->size);
+  return offset;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void *get_block(UndoRing const *const ring, size_t const offset)
+{
+  return get_header(ring, offset) + 1;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void reset(UndoRing *const ring)
+{
+  assert(ring != NULL);
+  ring->oldest = ring->newest = ring->end = ring->wrap = 0;
+  ring->is_empty = true;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+void undo_ring_init(UndoRing *const ring, size_t const size)
+{
+  assert(ring != NULL);
+  ring->buffer = NULL;
+  ring->size = size;
+  reset(ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void undo_ring_destroy(UndoRing *const ring)
+{
+  assert(ring != NULL);
+  FREE_SAFE(ring->buffer);
+  reset(ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+size_t undo_ring_block_size(size_t const size)
+{
+  size_t const align = sizeof(Align);
+  return sizeof(BlockHeader) + ((size + align - 1) / align) * align;
+}
+
+/* ----------------------------------------------------------------------- */
+
+_Optional void *undo_ring_alloc(UndoRing *const ring, size_t const size)
+{
+  assert(ring != NULL);
+
+  size_t const block_size = undo_ring_block_size(size);
+  if (block_size > ring->size)
+  {
+    DEBUGF("Block of %zu bytes can never fit in ring of %zu\n",
+           block_size, ring->size);
+    return NULL;
+  }
+
+  if (!ring->buffer)
+  {
+    ring->buffer = malloc(ring->size);
+    if (!ring->buffer)
+    {
+      DEBUGF("Not enough memory for undo ring\n");
+      return NULL;
+    }
+  }
+
+  size_t offset = 0;
+  if (!undo_ring_is_empty(ring))
+  {
+    if (ring->wrap != 0)
+    {
+      /* Free space is between the newest and oldest blocks */
+      if (ring->end + block_size > ring->oldest)
+      {
+        return NULL;
+      }
+      offset = ring->end;
+    }
+    else if (ring->end + block_size <= ring->size)
+    {
+      /* Free space after the newest block */
+      offset = ring->end;
+    }
+    else if (block_size <= ring->oldest)
+    {
+      /* Free space before the oldest block */
+      ring->wrap = ring->end;
+      offset = 0;
+    }
+    else
+    {
+      return NULL;
+    }
+  }
+
+  BlockHeader *const header = get_header(ring, offset);
+  header->h.size = block_size;
+  header->h.prev = ring->newest;
+
+  if (undo_ring_is_empty(ring))
+  {
+    ring->oldest = offset;
+    ring->is_empty = false;
+  }
+  ring->newest = offset;
+  ring->end = offset + block_size;
+
+  DEBUG_VERBOSEF("Allocated %zu bytes at %zu in ring %p\n",
+                 block_size, offset, (void *)ring);
+
+  return header + 1;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void undo_ring_free_oldest(UndoRing *const ring)
+{
+  assert(ring != NULL);
+  assert(!undo_ring_is_empty(ring));
+
+  if (ring->oldest == ring->newest)
+  {
+    reset(ring);
+    return;
+  }
+
+  BlockHeader const *const header = get_header(ring, ring->oldest);
+  ring->oldest += header->h.size;
+
+  if (ring->oldest == ring->wrap)
+  {
+    /* The next oldest block is at the start of the buffer */
+    ring->oldest = ring->wrap = 0;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+void undo_ring_free_newest(UndoRing *const ring)
+{
+  assert(ring != NULL);
+  assert(!undo_ring_is_empty(ring));
+
+  if (ring->oldest == ring->newest)
+  {
+    reset(ring);
+    return;
+  }
+
+  if (ring->newest == 0 && ring->wrap != 0)
+  {
+    /* The next newest block is at the end of the buffer */
+    ring->end = ring->wrap;
+    ring->wrap = 0;
+  }
+  else
+  {
+    ring->end = ring->newest;
+  }
+  ring->newest = get_header(ring, ring->newest)->h.prev;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void undo_ring_free_after(UndoRing *const ring, void const *const block)
+{
+  assert(ring != NULL);
+
+  size_t const offset = get_offset(ring, block);
+  if (ring->wrap != 0 && offset >= ring->oldest)
+  {
+    /* Blocks at the start of the buffer are all newer */
+    ring->wrap = 0;
+  }
+  ring->newest = offset;
+  ring->end = offset + get_header(ring, offset)->h.size;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void undo_ring_free_all(UndoRing *const ring)
+{
+  reset(ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void undo_ring_shrink_newest(UndoRing *const ring, size_t const size)
+{
+  assert(ring != NULL);
+  assert(!undo_ring_is_empty(ring));
+
+  BlockHeader *const header = get_header(ring, ring->newest);
+  size_t const block_size = undo_ring_block_size(size);
+  assert(block_size <= header->h.size);
+
+  header->h.size = block_size;
+  ring->end = ring->newest + block_size;
+}
+
+/* ----------------------------------------------------------------------- */
+
+_Optional void *undo_ring_get_oldest(UndoRing const *const ring)
+{
+  assert(ring != NULL);
+  return undo_ring_is_empty(ring) ? NULL : get_block(ring, ring->oldest);
+}
+
+/* ----------------------------------------------------------------------- */
+
+_Optional void *undo_ring_get_newest(UndoRing const *const ring)
+{
+  assert(ring != NULL);
+  return undo_ring_is_empty(ring) ? NULL : get_block(ring, ring->newest);
+}
+
+/* ----------------------------------------------------------------------- */
+
+_Optional void *undo_ring_get_prev(UndoRing const *const ring,
+  void const *const block)
+{
+  size_t const offset = get_offset(ring, block);
+  if (offset == ring->oldest)
+  {
+    return NULL;
+  }
+  return get_block(ring, get_header(ring, offset)->h.prev);
+}
+
+/* ----------------------------------------------------------------------- */
+
+_Optional void *undo_ring_get_next(UndoRing const *const ring,
+  void const *const block)
+{
+  size_t const offset = get_offset(ring, block);
+  if (offset == ring->newest)
+  {
+    return NULL;
+  }
+
+  size_t next = offset + get_header(ring, offset)->h.size;
+  if (next == ring->wrap)
+  {
+    next = 0;
+  }
+  return get_block(ring, next);
+}
+
+/* ----------------------------------------------------------------------- */
+
+size_t undo_ring_get_used(UndoRing const *const ring)
+{
+  assert(ring != NULL);
+
+  if (undo_ring_is_empty(ring))
+  {
+    return 0;
+  }
+
+  if (ring->wrap != 0)
+  {
+    return (ring->wrap - ring->oldest) + ring->end;
+  }
+
+  return ring->end - ring->oldest;
+}
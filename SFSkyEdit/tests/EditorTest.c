@@ -4156,6 +4156,141 @@ static void test77(void)
   edit_sky_destroy(&edit_sky);
 }
 
+static void check_redo_style(EditSky *const edit_sky, Editor *const editor,
+  PaletteEntry const palette[])
+{
+  /* Redo the last edit after changing the gradient style */
+  SkyColour done[NColourBands];
+  get_all(editor, &done);
+
+  edit_sky_set_gradient_style(edit_sky, GradientStyle_RGB);
+
+  assert(editor_undo(editor));
+  assert(editor_redo(editor, palette));
+
+  SkyColour redone[NColourBands];
+  get_all(editor, &redone);
+  assert(!memcmp(done, redone, sizeof(done)));
+  bands_count = 0;
+}
+
+static void test78(void)
+{
+  /* Redo gradients in their original style */
+  PaletteEntry palette[NumColours] = {0};
+  pal_init(&palette);
+
+  static GradientStyle const styles[] =
+  {
+    GradientStyle_OKLab, GradientStyle_Diffuse
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE(styles); ++i)
+  {
+    EditSky edit_sky;
+    edit_sky_init(&edit_sky, NULL, redraw_bands_cb, redraw_render_offset_cb,
+      redraw_stars_height_cb);
+
+    Editor editor;
+    editor_init(&editor, &edit_sky, redraw_select_cb);
+
+    set_plain_blocks(&edit_sky, &editor);
+    editor_set_caret_pos(&editor, 0);
+    editor_set_selection_end(&editor, NColourBands);
+
+    edit_sky_set_gradient_style(&edit_sky, styles[i]);
+    assert(editor_smooth(&editor, palette) == EditResult_Changed);
+    check_redo_style(&edit_sky, &editor, palette);
+
+    edit_sky_set_gradient_style(&edit_sky, styles[i]);
+    assert(editor_interpolate(&editor, palette, StartCol, Colour) ==
+           EditResult_Changed);
+    check_redo_style(&edit_sky, &editor, palette);
+
+    edit_sky_set_gradient_style(&edit_sky, styles[i]);
+    editor_set_caret_pos(&editor, InsertPos);
+    assert(editor_insert_gradient(&editor, palette, MaxInsertLen, Colour,
+                                  StartCol, true, true) ==
+           EditResult_Changed);
+    check_redo_style(&edit_sky, &editor, palette);
+
+    editor_destroy(&editor);
+    edit_sky_destroy(&edit_sky);
+  }
+}
+
+static void test79(void)
+{
+  /* Discard oldest undo history over budget */
+  enum { NEdits = 200, UndoBudget = 2048 };
+  static SkyColour history[NEdits + 1][NColourBands];
+  PaletteEntry palette[NumColours] = {0};
+  pal_init(&palette);
+
+  EditSky edit_sky;
+  edit_sky_init(&edit_sky, NULL, redraw_bands_cb, redraw_render_offset_cb,
+    redraw_stars_height_cb);
+
+  Editor editor;
+  editor_init(&editor, &edit_sky, redraw_select_cb);
+
+  set_plain_blocks(&edit_sky, &editor);
+  edit_sky_set_undo_budget(&edit_sky, UndoBudget);
+  assert(!editor_can_undo(&editor));
+
+  Sky *const sky = edit_sky_get_sky(&edit_sky);
+  memcpy(history[0], sky->bands, sizeof(history[0]));
+
+  for (int i = 0; i < NEdits; ++i)
+  {
+    SkyColour const colour = (SkyColour)(i % NumColours);
+
+    switch (i % 3)
+    {
+    case 0:
+      editor_set_caret_pos(&editor, SelectStart);
+      editor_set_selection_end(&editor, SelectEnd);
+      assert(editor_set_plain(&editor, colour) != EditResult_NoMem);
+      break;
+    case 1:
+      editor_set_caret_pos(&editor, InsertPos);
+      assert(editor_insert_plain(&editor, MaxInsertLen, colour) !=
+             EditResult_NoMem);
+      break;
+    default:
+      editor_set_caret_pos(&editor, InsertPos);
+      editor_set_selection_end(&editor, InsertPos + BlockSize);
+      assert(editor_delete_colours(&editor) != EditResult_NoMem);
+      break;
+    }
+    memcpy(history[i + 1], sky->bands, sizeof(history[i + 1]));
+  }
+
+  /* Only the newest edits can be undone */
+  int nundo = 0;
+  while (editor_can_undo(&editor))
+  {
+    (void)editor_undo(&editor);
+    ++nundo;
+    assert(!memcmp(sky->bands, history[NEdits - nundo],
+                   sizeof(history[0])));
+  }
+  assert(nundo > 2);
+  assert(nundo < NEdits);
+
+  for (int i = nundo; i > 0; --i)
+  {
+    assert(editor_can_redo(&editor));
+    (void)editor_redo(&editor, palette);
+    assert(!memcmp(sky->bands, history[NEdits - i + 1],
+                   sizeof(history[0])));
+  }
+  assert(!editor_can_redo(&editor));
+
+  editor_destroy(&editor);
+  edit_sky_destroy(&edit_sky);
+}
+
 void Editor_tests(void)
 {
   static const struct
@@ -4229,6 +4364,8 @@ void Editor_tests(void)
     { "Add render offset", test75 },
     { "Set render offset (no callback)", test76 },
     { "Set stars height (no callback)", test77 },
+    { "Redo gradients in original style", test78 },
+    { "Discard oldest undo history over budget", test79 },
   };
 
   for (size_t count = 0; count < ARRAY_SIZE(unit_tests); ++count)
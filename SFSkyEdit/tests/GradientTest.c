@@ -0,0 +1,417 @@
+/*
+ *  SFSkyEdit test: Gradient fills approximated using palette colours
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#undef NDEBUG
+
+/* ANSI library files */
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+#include "PalEntry.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "../Gradient.h"
+#include "../PalLookup.h"
+#include "../OKLab.h"
+
+#ifdef FORTIFY
+#include "Fortify.h"
+#endif
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+enum
+{
+  NumColours = 256,
+  MaxComponent = 255,
+  MaxSteps = 40,
+  ColourStep = 37,
+  Black = 0,
+  White = 255, /* in the default palette */
+  LongSteps = 200,
+};
+
+static float const Tolerance = 0.001f;
+
+/* ----------------------------------------------------------------------- */
+
+static void pal_init(PaletteEntry (*const pal)[NumColours])
+{
+  /* Same as the palette used by the editor tests */
+  for (int c = 0; c < NumColours; ++c)
+  {
+    (*pal)[c] = make_palette_entry(
+      c, (3 + c) % NumColours, NumColours - 1 - c);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void pal_init_mode13(PaletteEntry (*const pal)[NumColours])
+{
+  /* Default palette for a 256 colour mode */
+  for (int c = 0; c < NumColours; ++c)
+  {
+    int const tint = c & 3;
+    int const red = (((c >> 4) & 1) << 3) | (((c >> 2) & 1) << 2) | tint,
+              green = (((c >> 6) & 1) << 3) | (((c >> 5) & 1) << 2) | tint,
+              blue = (((c >> 7) & 1) << 3) | (((c >> 3) & 1) << 2) | tint;
+
+    (*pal)[c] = make_palette_entry(red * 17, green * 17, blue * 17);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void check_rgb(PaletteEntry const palette[],
+  _Optional PalLookup const *const lookup)
+{
+  /* Compare with the original gradient calculation */
+  for (int start = 0; start < NumColours; start += ColourStep)
+  {
+    for (int end = 0; end < NumColours; end += ColourStep)
+    {
+      for (int steps = 1; steps <= MaxSteps; ++steps)
+      {
+        Gradient gradient;
+        gradient_init(&gradient, GradientStyle_RGB, palette, NumColours,
+                      lookup, (unsigned)start, (unsigned)end, steps);
+
+        PaletteEntry const start_palette = palette[start],
+                           end_palette = palette[end];
+
+        int col = PALETTE_GET_RED(start_palette);
+        int diff = PALETTE_GET_RED(end_palette) - col;
+        float const red_inc = (float)diff / steps;
+        float red_frac = (float)col;
+
+        col = PALETTE_GET_GREEN(start_palette);
+        diff = PALETTE_GET_GREEN(end_palette) - col;
+        float const green_inc = (float)diff / steps;
+        float green_frac = (float)col;
+
+        col = PALETTE_GET_BLUE(start_palette);
+        diff = PALETTE_GET_BLUE(end_palette) - col;
+        float const blue_inc = (float)diff / steps;
+        float blue_frac = (float)col;
+
+        for (int s = 0; s < steps; ++s)
+        {
+          red_frac += red_inc;
+          green_frac += green_inc;
+          blue_frac += blue_inc;
+
+          unsigned int const expected = nearest_palette_entry_rgb(palette,
+            NumColours, (int)(red_frac + 0.5f), (int)(green_frac + 0.5f),
+            (int)(blue_frac + 0.5f));
+
+          assert(gradient_next(&gradient) == expected);
+        }
+      }
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void check_same(PaletteEntry const palette[], GradientStyle const style)
+{
+  /* The inverse colour map doesn't change the result */
+  _Optional PalLookup *const lookup = pal_lookup_create(palette, NumColours);
+  assert(lookup != NULL);
+
+  for (int start = 0; start < NumColours; start += ColourStep)
+  {
+    for (int end = 0; end < NumColours; end += ColourStep)
+    {
+      Gradient with, without;
+      gradient_init(&with, style, palette, NumColours, lookup,
+                    (unsigned)start, (unsigned)end, MaxSteps);
+
+      gradient_init(&without, style, palette, NumColours, NULL,
+                    (unsigned)start, (unsigned)end, MaxSteps);
+
+      for (int s = 0; s < MaxSteps; ++s)
+      {
+        assert(gradient_next(&with) == gradient_next(&without));
+      }
+    }
+  }
+
+  pal_lookup_destroy(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test1(void)
+{
+  /* OKLab conversion */
+  OKLab const black = oklab_from_rgb(0, 0, 0);
+  assert(fabsf(black.l) < Tolerance);
+  assert(fabsf(black.a) < Tolerance);
+  assert(fabsf(black.b) < Tolerance);
+
+  OKLab const white = oklab_from_rgb(MaxComponent, MaxComponent, MaxComponent);
+  assert(fabsf(white.l - 1.0f) < Tolerance);
+  assert(fabsf(white.a) < Tolerance);
+  assert(fabsf(white.b) < Tolerance);
+
+  /* Greys are neutral and get lighter */
+  float last = -1.0f;
+  for (int c = 0; c <= MaxComponent; ++c)
+  {
+    OKLab const grey = oklab_from_rgb(c, c, c);
+    assert(grey.l > last);
+    assert(fabsf(grey.a) < Tolerance);
+    assert(fabsf(grey.b) < Tolerance);
+    last = grey.l;
+  }
+
+  /* Red is reddish and blue is bluish */
+  OKLab const red = oklab_from_rgb(MaxComponent, 0, 0);
+  assert(red.a > 0.0f);
+  OKLab const blue = oklab_from_rgb(0, 0, MaxComponent);
+  assert(blue.b < 0.0f);
+
+  assert(oklab_distance(&red, &red) == 0.0f);
+  assert(oklab_distance(&red, &blue) == oklab_distance(&blue, &red));
+  assert(oklab_distance(&black, &white) > oklab_distance(&black, &red));
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test2(void)
+{
+  /* RGB gradient */
+  PaletteEntry palette[NumColours];
+  pal_init(&palette);
+  check_rgb(palette, NULL);
+
+  pal_init_mode13(&palette);
+  check_rgb(palette, NULL);
+
+  _Optional PalLookup *const lookup = pal_lookup_create(palette, NumColours);
+  assert(lookup != NULL);
+  check_rgb(palette, lookup);
+  pal_lookup_destroy(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test3(void)
+{
+  /* OKLab gradient ends at the end colour */
+  PaletteEntry palette[NumColours];
+  pal_init_mode13(&palette);
+
+  _Optional PalLookup *const lookup = pal_lookup_create(palette, NumColours);
+  assert(lookup != NULL);
+
+  static GradientStyle const styles[] =
+  {
+    GradientStyle_OKLab, GradientStyle_Diffuse
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE(styles); ++i)
+  {
+    for (int start = 0; start < NumColours; start += ColourStep)
+    {
+      for (int end = 0; end < NumColours; end += ColourStep)
+      {
+        for (int steps = 1; steps <= MaxSteps; ++steps)
+        {
+          Gradient gradient;
+          gradient_init(&gradient, styles[i], palette, NumColours, lookup,
+                        (unsigned)start, (unsigned)end, steps);
+
+          unsigned int last = 0;
+          for (int s = 0; s < steps; ++s)
+          {
+            last = gradient_next(&gradient);
+            assert(last < NumColours);
+          }
+
+          /* Error diffusion may not reach the end colour exactly */
+          assert(styles[i] == GradientStyle_Diffuse || last == (unsigned)end);
+        }
+      }
+    }
+  }
+
+  pal_lookup_destroy(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test4(void)
+{
+  /* OKLab grey ramp gets lighter */
+  PaletteEntry palette[NumColours];
+  pal_init_mode13(&palette);
+
+  _Optional PalLookup *const lookup = pal_lookup_create(palette, NumColours);
+  assert(lookup != NULL);
+
+  for (int steps = 1; steps <= MaxSteps; ++steps)
+  {
+    Gradient gradient;
+    gradient_init(&gradient, GradientStyle_OKLab, palette, NumColours,
+                  lookup, Black, White, steps);
+
+    float last = -1.0f;
+    for (int s = 0; s < steps; ++s)
+    {
+      unsigned int const colour = gradient_next(&gradient);
+      float const l = pal_lookup_get_oklab(&*lookup, colour)->l;
+      assert(l >= last);
+      last = l;
+    }
+  }
+
+  pal_lookup_destroy(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test5(void)
+{
+  /* Error diffusion */
+  PaletteEntry palette[NumColours];
+  pal_init_mode13(&palette);
+
+  _Optional PalLookup *const lookup = pal_lookup_create(palette, NumColours);
+  assert(lookup != NULL);
+
+  for (int start = 0; start < NumColours; start += ColourStep)
+  {
+    for (int end = 0; end < NumColours; end += ColourStep)
+    {
+      Gradient plain, diffuse;
+      gradient_init(&plain, GradientStyle_OKLab, palette, NumColours,
+                    lookup, (unsigned)start, (unsigned)end, LongSteps);
+
+      gradient_init(&diffuse, GradientStyle_Diffuse, palette, NumColours,
+                    lookup, (unsigned)start, (unsigned)end, LongSteps);
+
+      /* The total error of a diffused gradient is only what remains to be
+         carried forward, so its average colour is nearer to the ideal */
+      OKLab plain_error = {0}, diffuse_error = {0};
+      for (int s = 0; s < LongSteps; ++s)
+      {
+        OKLab const *const p = pal_lookup_get_oklab(&*lookup,
+                                                    gradient_next(&plain));
+        OKLab const *const d = pal_lookup_get_oklab(&*lookup,
+                                                    gradient_next(&diffuse));
+        OKLab const ideal = {
+          .l = plain.value[0], .a = plain.value[1], .b = plain.value[2]
+        };
+
+        plain_error.l += ideal.l - p->l;
+        plain_error.a += ideal.a - p->a;
+        plain_error.b += ideal.b - p->b;
+
+        diffuse_error.l += ideal.l - d->l;
+        diffuse_error.a += ideal.a - d->a;
+        diffuse_error.b += ideal.b - d->b;
+      }
+
+      assert(fabsf(diffuse_error.l - diffuse.error.l) < Tolerance * 10);
+      assert(fabsf(diffuse_error.a - diffuse.error.a) < Tolerance * 10);
+      assert(fabsf(diffuse_error.b - diffuse.error.b) < Tolerance * 10);
+
+      OKLab const zero = {0};
+      assert(oklab_distance(&diffuse_error, &zero) <=
+             oklab_distance(&plain_error, &zero) + Tolerance);
+    }
+  }
+
+  pal_lookup_destroy(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test6(void)
+{
+  /* No inverse colour map */
+  PaletteEntry palette[NumColours];
+  pal_init_mode13(&palette);
+
+  check_same(palette, GradientStyle_RGB);
+  check_same(palette, GradientStyle_OKLab);
+  check_same(palette, GradientStyle_Diffuse);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test7(void)
+{
+  /* Style names */
+  GradientStyle style = GradientStyle_RGB;
+  assert(gradient_style_from_string("OKLab", &style));
+  assert(style == GradientStyle_OKLab);
+  assert(gradient_style_from_string("diffuse", &style));
+  assert(style == GradientStyle_Diffuse);
+  assert(gradient_style_from_string("RGB", &style));
+  assert(style == GradientStyle_RGB);
+
+  assert(!gradient_style_from_string("", &style));
+  assert(!gradient_style_from_string("lab", &style));
+  assert(style == GradientStyle_RGB);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void Gradient_tests(void)
+{
+  static const struct
+  {
+    char const *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "OKLab conversion", test1 },
+    { "RGB gradient", test2 },
+    { "OKLab gradient", test3 },
+    { "OKLab grey ramp", test4 },
+    { "Error diffusion", test5 },
+    { "No inverse colour map", test6 },
+    { "Style names", test7 },
+  };
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); ++count)
+  {
+    DEBUGF("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    Fortify_EnterScope();
+    unit_tests[count].test_func();
+    Fortify_LeaveScope();
+  }
+}
@@ -77,6 +77,11 @@ int main(int argc, char *argv[])
   {
     { "Sky", Sky_tests },
     { "Editor", Editor_tests },
+    { "Render", Render_tests },
+    { "Scene", Scene_tests },
+    { "PalLookup", PalLookup_tests },
+    { "Gradient", Gradient_tests },
+    { "UndoRing", UndoRing_tests },
 #ifdef ACORN_C
     { "App", App_tests },
 #endif
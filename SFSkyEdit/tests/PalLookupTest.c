@@ -0,0 +1,276 @@
+/*
+ *  SFSkyEdit test: Inverse colour map for nearest palette entry search
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#undef NDEBUG
+
+/* ANSI library files */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+#include "PalEntry.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "../PalLookup.h"
+
+#ifdef FORTIFY
+#include "Fortify.h"
+#endif
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+enum
+{
+  NumColours = 256,
+  MaxComponent = 255,
+  GridStep = 5, /* not a factor of the cell size */
+  FewColours = 16,
+  NRandomPalettes = 4,
+  OutOfRange = 40,
+};
+
+/* ----------------------------------------------------------------------- */
+
+static void pal_init(PaletteEntry (*const pal)[NumColours])
+{
+  /* Same as the palette used by the editor tests */
+  for (int c = 0; c < NumColours; ++c)
+  {
+    (*pal)[c] = make_palette_entry(
+      c, (3 + c) % NumColours, NumColours - 1 - c);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void pal_init_mode13(PaletteEntry (*const pal)[NumColours])
+{
+  /* Default palette for a 256 colour mode */
+  for (int c = 0; c < NumColours; ++c)
+  {
+    int const tint = c & 3;
+    int const red = (((c >> 4) & 1) << 3) | (((c >> 2) & 1) << 2) | tint,
+              green = (((c >> 6) & 1) << 3) | (((c >> 5) & 1) << 2) | tint,
+              blue = (((c >> 7) & 1) << 3) | (((c >> 3) & 1) << 2) | tint;
+
+    (*pal)[c] = make_palette_entry(red * 17, green * 17, blue * 17);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void pal_init_random(PaletteEntry (*const pal)[NumColours],
+  unsigned long seed)
+{
+  /* Coarse components so that some entries are duplicates, to check that
+     the first of any equally near entries is found */
+  for (int c = 0; c < NumColours; ++c)
+  {
+    seed = (seed * 1103515245ul + 12345ul) & 0xffffffffu;
+    (*pal)[c] = make_palette_entry((seed >> 8) & 0xe0, (seed >> 16) & 0xe0,
+      (seed >> 24) & 0xe0);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void check_grid(PaletteEntry const palette[], size_t const ncols)
+{
+  _Optional PalLookup *const lookup = pal_lookup_create(palette, ncols);
+  assert(lookup != NULL);
+  assert(pal_lookup_matches(&*lookup, palette, ncols));
+
+  for (int red = 0; red <= MaxComponent; red += GridStep)
+  {
+    for (int green = 0; green <= MaxComponent; green += GridStep)
+    {
+      for (int blue = 0; blue <= MaxComponent; blue += GridStep)
+      {
+        unsigned int const expected = nearest_palette_entry_rgb(palette,
+          ncols, red, green, blue);
+
+        assert(pal_lookup_nearest(&*lookup, red, green, blue) == expected);
+      }
+    }
+  }
+
+  /* Check the corners of the RGB cube, which aren't all on the grid */
+  for (int corner = 0; corner < 8; ++corner)
+  {
+    int const red = corner & 1 ? MaxComponent : 0,
+              green = corner & 2 ? MaxComponent : 0,
+              blue = corner & 4 ? MaxComponent : 0;
+
+    assert(pal_lookup_nearest(&*lookup, red, green, blue) ==
+           nearest_palette_entry_rgb(palette, ncols, red, green, blue));
+  }
+
+  pal_lookup_destroy(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test1(void)
+{
+  /* Editor test palette */
+  PaletteEntry palette[NumColours];
+  pal_init(&palette);
+  check_grid(palette, NumColours);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test2(void)
+{
+  /* Default mode 13 palette */
+  PaletteEntry palette[NumColours];
+  pal_init_mode13(&palette);
+  check_grid(palette, NumColours);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test3(void)
+{
+  /* Palettes with duplicate entries */
+  for (unsigned long seed = 1; seed <= NRandomPalettes; ++seed)
+  {
+    PaletteEntry palette[NumColours];
+    pal_init_random(&palette, seed);
+    check_grid(palette, NumColours);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test4(void)
+{
+  /* Small palettes */
+  PaletteEntry palette[NumColours];
+  pal_init_mode13(&palette);
+  check_grid(palette, 1);
+  check_grid(palette, FewColours);
+
+  palette[0] = palette[1] = make_palette_entry(0, 0, 0);
+  check_grid(palette, 2);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test5(void)
+{
+  /* Colours outside the RGB cube */
+  PaletteEntry palette[NumColours];
+  pal_init_mode13(&palette);
+
+  _Optional PalLookup *const lookup = pal_lookup_create(palette, NumColours);
+  assert(lookup != NULL);
+
+  for (int n = 1; n <= OutOfRange; ++n)
+  {
+    assert(pal_lookup_nearest(&*lookup, -n, n, MaxComponent + n) ==
+           nearest_palette_entry_rgb(palette, NumColours,
+                                     -n, n, MaxComponent + n));
+
+    assert(pal_lookup_nearest(&*lookup, MaxComponent + n, -n, n) ==
+           nearest_palette_entry_rgb(palette, NumColours,
+                                     MaxComponent + n, -n, n));
+  }
+
+  pal_lookup_destroy(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test6(void)
+{
+  /* Palette changed */
+  PaletteEntry palette[NumColours];
+  pal_init_mode13(&palette);
+
+  _Optional PalLookup *const lookup = pal_lookup_create(palette, NumColours);
+  assert(lookup != NULL);
+
+  assert(pal_lookup_matches(&*lookup, palette, NumColours));
+  assert(!pal_lookup_matches(&*lookup, palette, NumColours - 1));
+
+  palette[NumColours - 1] ^= make_palette_entry(1, 0, 0);
+  assert(!pal_lookup_matches(&*lookup, palette, NumColours));
+
+  pal_lookup_destroy(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test7(void)
+{
+  /* No memory */
+  PaletteEntry palette[NumColours];
+  pal_init_mode13(&palette);
+
+  Fortify_SetNumAllocationsLimit(0);
+  _Optional PalLookup *const lookup = pal_lookup_create(palette, NumColours);
+  Fortify_SetNumAllocationsLimit(ULONG_MAX);
+
+#ifdef FORTIFY
+  assert(lookup == NULL);
+#endif
+  pal_lookup_destroy(lookup);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void PalLookup_tests(void)
+{
+  static const struct
+  {
+    char const *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Editor test palette", test1 },
+    { "Default palette", test2 },
+    { "Duplicate palette entries", test3 },
+    { "Small palettes", test4 },
+    { "Colours out of range", test5 },
+    { "Palette changed", test6 },
+    { "No memory", test7 },
+  };
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); ++count)
+  {
+    DEBUGF("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    Fortify_EnterScope();
+    unit_tests[count].test_func();
+    Fortify_LeaveScope();
+  }
+}
@@ -0,0 +1,631 @@
+/*
+ *  SFSkyEdit test: Sky renderer
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#undef NDEBUG
+
+/* ANSI library files */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+#include "SFFormats.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "../Render.h"
+
+#ifdef FORTIFY
+#include "Fortify.h"
+#endif
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+enum
+{
+  ScreenWidth = 320,
+  ScreenHeight = 256,
+  ScreenSize = ScreenWidth * ScreenHeight,
+  Margin = ScreenWidth * 4, /* room for stray writes by the ARM code */
+  WordSize = 4,
+  BottomRight = ScreenSize - WordSize,
+  Marker = 0xa5,
+  StarColour = 0xff,
+  StarX = 100,
+  StarY = 50,
+  StarCentre = StarX + (StarY * ScreenWidth),
+  StarThreshold = 4096,
+  StarHeight = StarThreshold + (12 << 9), /* index of the brightest colour */
+  StarBright = 0,
+  StarSize = 15,
+  Seed = 1234567,
+  NStars = 200,
+  StarMaxHeight = 16384,
+};
+
+/* Render.s writes outside the frame buffer in some cases */
+static uint8_t screen_memory[Margin + ScreenSize + Margin];
+static uint8_t *const screen = screen_memory + Margin;
+static uint8_t model[Margin + ScreenSize + Margin];
+
+/* ----------------------------------------------------------------------- */
+
+/* The following functions are an instruction-by-instruction model of the
+   ARM code in Render.s, against which the C version is checked.
+   Memory is modelled as a flat array with a margin either side of the frame
+   buffer. */
+
+static uint32_t ror(uint32_t const value, int const shift)
+{
+  return (value >> shift) | (value << (32 - shift));
+}
+
+static int32_t asr(int32_t const value, int const shift)
+{
+  return value >= 0 ? value >> shift : -1 - ((-1 - value) >> shift);
+}
+
+static uint32_t ldr(uint8_t const *const addr)
+{
+  return (uint32_t)addr[0] | ((uint32_t)addr[1] << 8) |
+         ((uint32_t)addr[2] << 16) | ((uint32_t)addr[3] << 24);
+}
+
+static void str(int32_t const addr, uint32_t const value)
+{
+  assert(addr >= 0);
+  assert(addr + WordSize <= (int32_t)sizeof(model));
+  for (int i = 0; i < WordSize; ++i)
+  {
+    model[addr + i] = (uint8_t)(value >> (i * 8));
+  }
+}
+
+static void stmda_line(int32_t *const a4, uint32_t const v2)
+{
+  /* STM ignores the bottom two bits of the address, so only word-aligned
+     addresses are modelled */
+  assert((*a4 - Margin) % WordSize == 0);
+
+  for (int i = 0; i < 20; ++i)
+  {
+    /* STMDA a4!,{v2-v5} */
+    for (int r = 0; r < 4; ++r)
+    {
+      str(*a4 - 12 + (r * WordSize), v2);
+    }
+    *a4 -= 16;
+  }
+}
+
+static void model_drawsky(int32_t a1, SFSky const *const sky, int32_t a4)
+{
+  uint8_t const *a2 = (uint8_t const *)sky;
+  int32_t const a3 = Margin;
+
+  int32_t lr = asr(a1, 7);
+  lr = lr + asr(lr, 1);
+  lr = lr + 48;
+  if (lr > 255) lr = 255;
+
+  int32_t v1 = (int32_t)ldr(a2);
+  a2 += 8;
+  a1 = a1 + v1;
+  v1 = 0;
+
+  if (a4 >= 81920) goto clipsky;
+
+  a4 = a3 + a4;
+  if (a4 <= a3) return;
+
+dolineagain:
+  {
+    int32_t const v3 = asr(v1, 10);
+    uint32_t v2 = ldr(a2 + ((v3 > lr ? lr : v3) * 4));
+    stmda_line(&a4, v2);
+
+    if (a4 <= a3) return;
+
+    v1 = v1 + a1;
+    a1 = a1 - asr(a1, 5);
+
+    int32_t const v3b = asr(v1, 10);
+    v2 = ldr(a2 + ((v3b > lr ? lr : v3b) * 4));
+    v2 = ror(v2, 8);
+    stmda_line(&a4, v2);
+
+    v1 = v1 + (a1 * 2);
+    a1 = a1 - asr(a1, 4);
+
+    if (a4 > a3) goto dolineagain;
+    return;
+  }
+
+clipsky:
+  a4 = a3 + a4;
+  int32_t const v2 = a3 + 81920;
+
+clipskyagain:
+  v1 = v1 + a1;
+  a1 = a1 - asr(a1, 5);
+  a4 = a4 - 320;
+  if (a4 < v2) goto dolineagain;
+
+  v1 = v1 + (a1 * 2);
+  a1 = a1 - asr(a1, 4);
+  a4 = a4 - 320;
+  if (a4 >= v2) goto clipskyagain;
+  goto dolineagain;
+}
+
+static void model_star_plot(int32_t a1, int32_t a3, int32_t a4,
+  int32_t const colour, int32_t const bright, int32_t const size)
+{
+  static uint8_t const star_colours[] =
+  {
+    0x00, 0x01, 0x02, 0x03, 0x2c, 0x2d, 0x2e, 0x2f,
+    0xd0, 0xd1, 0xd2, 0xd3, 0xfc, 0xfd, 0xfe, 0xff
+  };
+
+  if (a3 <= 1 || a4 <= 1) return;
+  if (a3 >= 316 || a4 >= 254) return;
+
+  uint8_t *const a2 = model + Margin + a3 + (a4 << 8) + (a4 << 6);
+
+  a1 = a1 + bright - 4096;
+  if (a1 < 0) return;
+
+  a1 = asr(a1, 9);
+  if (a1 > size) a1 = size;
+
+  a2[0] |= star_colours[a1];
+
+  a1 -= 4;
+  if (a1 < 0) return;
+  uint8_t tint = star_colours[a1] & (uint8_t)colour;
+  a2[-1] |= tint;
+  a2[1] |= tint;
+  a2[-320] |= tint;
+  a2[320] |= tint;
+
+  a1 -= 4;
+  if (a1 < 0) return;
+  tint = star_colours[a1] & (uint8_t)colour;
+  a2[-2] |= tint;
+  a2[2] |= tint;
+  a2[-640] |= tint;
+  a2[640] |= tint;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static uint32_t next_random(uint32_t *const state)
+{
+  *state = (*state * 1103515245u) + 12345u;
+  return *state >> 8;
+}
+
+static void make_sky(SFSky *const sky, int32_t const render_offset,
+  uint32_t *const state)
+{
+  sky->render_offset = render_offset;
+  sky->min_stars_height = 0;
+  for (int row = 0; row < SFSky_Height; ++row)
+  {
+    for (int i = 0; i < SFSky_Width; ++i)
+    {
+      sky->pixel_data[row][i] = (unsigned char)next_random(state);
+    }
+  }
+}
+
+static void clear_screens(void)
+{
+  memset(screen, Marker, ScreenSize);
+  memset(model, Marker, sizeof(model));
+}
+
+static bool screens_match(void)
+{
+  return !memcmp(screen, model + Margin, ScreenSize);
+}
+
+static unsigned long hash_screen(void)
+{
+  /* 32-bit FNV-1a hash */
+  uint32_t hash = UINT32_C(2166136261);
+  for (size_t i = 0; i < ScreenSize; ++i)
+  {
+    hash ^= screen[i];
+    hash = (hash * UINT32_C(16777619)) & UINT32_C(0xffffffff);
+  }
+  return hash;
+}
+
+static void check_sky(int const height, SFSky const *const sky,
+  int const offset)
+{
+  clear_screens();
+  sky_drawsky(height, sky, screen, offset);
+  model_drawsky(height, sky, offset);
+  assert(screens_match());
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test1(void)
+{
+  /* Uniform sky */
+  static SFSky sky;
+  static uint8_t const pattern[] = {1, 2, 3, 4};
+
+  for (int row = 0; row < SFSky_Height; ++row)
+  {
+    memcpy(sky.pixel_data[row], pattern, sizeof(pattern));
+  }
+
+  memset(screen, Marker, ScreenSize);
+  sky_drawsky(0, &sky, screen, BottomRight);
+
+  /* Alternate lines, counting up from the bottom, are rotated by a pixel */
+  for (int y = 0; y < ScreenHeight; ++y)
+  {
+    int const rotate = (ScreenHeight - 1 - y) % 2;
+    for (int x = 0; x < ScreenWidth; ++x)
+    {
+      assert(screen[(y * ScreenWidth) + x] ==
+             pattern[(x + rotate) % WordSize]);
+    }
+  }
+}
+
+static void test2(void)
+{
+  /* Top of screen */
+  static SFSky sky;
+  uint32_t state = Seed;
+  make_sky(&sky, 0, &state);
+
+  static int const offsets[] = {0, -WordSize, -ScreenSize};
+  for (size_t i = 0; i < ARRAY_SIZE(offsets); ++i)
+  {
+    memset(screen, Marker, ScreenSize);
+    sky_drawsky(1000, &sky, screen, offsets[i]);
+    for (size_t j = 0; j < ScreenSize; ++j)
+    {
+      assert(screen[j] == Marker);
+    }
+  }
+}
+
+static void test3(void)
+{
+  /* Draw sky */
+  static int const heights[] = {0, 1, 127, 1000, 4000, 8191, 20000, 70000};
+  static int const render_offsets[] = {0, 300, 4096, 65536};
+  static SFSky sky;
+  uint32_t state = Seed;
+
+  for (size_t h = 0; h < ARRAY_SIZE(heights); ++h)
+  {
+    for (size_t r = 0; r < ARRAY_SIZE(render_offsets); ++r)
+    {
+      make_sky(&sky, render_offsets[r], &state);
+
+      /* Start partway up the screen, at the bottom, or below the bottom */
+      for (int line = -250; line <= 400; line += 13)
+      {
+        check_sky(heights[h], &sky, BottomRight + (line * ScreenWidth));
+      }
+    }
+  }
+}
+
+static void test4(void)
+{
+  /* Draw sky from every word offset near the bottom and top */
+  static SFSky sky;
+  uint32_t state = Seed;
+  make_sky(&sky, 100, &state);
+
+  for (int offset = BottomRight - ScreenWidth; offset < BottomRight + ScreenWidth;
+       offset += WordSize)
+  {
+    check_sky(3000, &sky, offset);
+  }
+
+  for (int offset = WordSize; offset < ScreenWidth + WordSize;
+       offset += WordSize)
+  {
+    check_sky(3000, &sky, offset);
+  }
+}
+
+static void test5(void)
+{
+  /* Star shape */
+  memset(screen, 0, ScreenSize);
+  star_plot(StarHeight, screen, StarX, StarY, StarColour, StarBright,
+            StarSize);
+
+  for (int i = 0; i < ScreenSize; ++i)
+  {
+    uint8_t expected = 0;
+    switch (i - StarCentre)
+    {
+      case 0:
+        expected = 0xfc;
+        break;
+      case -1:
+      case 1:
+      case -ScreenWidth:
+      case ScreenWidth:
+        expected = 0xd0;
+        break;
+      case -2:
+      case 2:
+      case -ScreenWidth * 2:
+      case ScreenWidth * 2:
+        expected = 0x2c;
+        break;
+    }
+    assert(screen[i] == expected);
+  }
+}
+
+static void test6(void)
+{
+  /* Star position */
+  static struct
+  {
+    int x, y;
+  }
+  const positions[] =
+  {
+    {1, 100}, {2, 100}, {315, 100}, {316, 100},
+    {100, 1}, {100, 2}, {100, 253}, {100, 254},
+    {2, 2}, {315, 253}, {-1, -1}, {1000, 1000},
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE(positions); ++i)
+  {
+    clear_screens();
+    star_plot(StarHeight, screen, positions[i].x, positions[i].y,
+              StarColour, StarBright, StarSize);
+    model_star_plot(StarHeight, positions[i].x, positions[i].y,
+                    StarColour, StarBright, StarSize);
+    assert(screens_match());
+  }
+}
+
+static void test7(void)
+{
+  /* Star brightness */
+  static int const colours[] = {0x00, 0x0f, 0xf0, 0xff};
+  uint32_t state = Seed;
+
+  for (int height = 0; height < 16384; height += 97)
+  {
+    for (int size = 0; size < 16; ++size)
+    {
+      int const colour = colours[size % ARRAY_SIZE(colours)];
+      int const bright = (int)(next_random(&state) % 4096);
+      int const x = 2 + (int)(next_random(&state) % 314);
+      int const y = 2 + (int)(next_random(&state) % 252);
+
+      clear_screens();
+      star_plot(height, screen, x, y, colour, bright, size);
+      model_star_plot(height, x, y, colour, bright, size);
+      assert(screens_match());
+    }
+  }
+}
+
+static void test8(void)
+{
+  /* Redraw sky rows */
+  static int const heights[] = {0, 1000, 8191, 70000};
+  static struct
+  {
+    int first, end;
+  }
+  const ranges[] =
+  {
+    {0, 0}, {0, 1}, {0, 3}, {10, 13}, {40, 100}, {254, 256}, {0, 256},
+  };
+  static SFSky sky, changed;
+  static uint8_t expected[ScreenSize], before[ScreenSize];
+  uint32_t state = Seed;
+
+  for (size_t h = 0; h < ARRAY_SIZE(heights); ++h)
+  {
+    for (size_t r = 0; r < ARRAY_SIZE(ranges); ++r)
+    {
+      for (int line = -100; line <= 200; line += 50)
+      {
+        int const offset = BottomRight + (line * ScreenWidth);
+
+        make_sky(&sky, 300, &state);
+        changed = sky;
+        for (int row = ranges[r].first; row < ranges[r].end; ++row)
+        {
+          for (int i = 0; i < SFSky_Width; ++i)
+          {
+            changed.pixel_data[row][i] ^= 0xff;
+          }
+        }
+
+        memset(expected, Marker, sizeof(expected));
+        sky_drawsky(heights[h], &changed, expected, offset);
+
+        memset(screen, Marker, ScreenSize);
+        sky_drawsky(heights[h], &sky, screen, offset);
+        memcpy(before, screen, sizeof(before));
+
+        int first_line = -1, end_line = -1;
+        sky_drawsky_rows(heights[h], &changed, screen, offset,
+                         ranges[r].first, ranges[r].end,
+                         &first_line, &end_line);
+
+        assert(!memcmp(screen, expected, ScreenSize));
+        assert(first_line >= 0);
+        assert(end_line <= ScreenHeight);
+
+        /* Every scan line that differs must be within the reported range */
+        for (int y = 0; y < ScreenHeight; ++y)
+        {
+          if (y < first_line || y >= end_line)
+          {
+            size_t const start = (size_t)y * ScreenWidth;
+            assert(!memcmp(before + start, screen + start, ScreenWidth));
+          }
+        }
+
+        if (ranges[r].first == ranges[r].end)
+        {
+          assert(first_line >= end_line);
+        }
+      }
+    }
+  }
+}
+
+static void test9(void)
+{
+  /* Reference frames drawn by Render.s, which is the renderer under test
+     when built for RISC OS, rather than by the model above */
+  static struct
+  {
+    int height, render_offset, line;
+    unsigned long hash;
+  }
+  const golden[] =
+  {
+    {0, 0, 0, 0x5c3eddc5},
+    {127, 300, 0, 0xb25ff3e5},
+    {1000, 4096, -100, 0x066f8785},
+    {3000, 100, 13, 0x229181e5},
+    {4000, 65536, 50, 0x3d20bdc5},
+    {8191, 0, 200, 0x1e6c5dc5},
+    {20000, 300, -250, 0xc3d45a05},
+    {70000, 4096, 400, 0x3d495dc5},
+  };
+  static SFSky sky;
+
+  for (size_t g = 0; g < ARRAY_SIZE(golden); ++g)
+  {
+    uint32_t state = Seed;
+    make_sky(&sky, golden[g].render_offset, &state);
+
+    memset(screen, Marker, ScreenSize);
+    sky_drawsky(golden[g].height, &sky, screen,
+                BottomRight + (golden[g].line * ScreenWidth));
+
+    unsigned long const hash = hash_screen();
+    DEBUGF("Sky at height %d from offset %d, line %d has hash 0x%lx\n",
+           golden[g].height, golden[g].render_offset, golden[g].line, hash);
+    assert(hash == golden[g].hash);
+  }
+}
+
+static void test10(void)
+{
+  /* Reference stars plotted by Render.s */
+  static struct
+  {
+    int height;
+    uint32_t seed;
+    unsigned long hash;
+  }
+  const golden[] =
+  {
+    {0, Seed, 0x55aea9c7},
+    {3000, Seed + 1, 0x14404412},
+    {8191, Seed + 2, 0x7e27e0c3},
+    {70000, Seed + 3, 0xc8fc3404},
+  };
+  static SFSky sky;
+
+  for (size_t g = 0; g < ARRAY_SIZE(golden); ++g)
+  {
+    uint32_t state = golden[g].seed;
+    make_sky(&sky, 300, &state);
+
+    memset(screen, Marker, ScreenSize);
+    sky_drawsky(golden[g].height, &sky, screen, BottomRight);
+
+    /* Some stars are too close to an edge to be plotted */
+    state = golden[g].seed;
+    for (int i = 0; i < NStars; ++i)
+    {
+      int const height = (int)(next_random(&state) % StarMaxHeight);
+      int const x = (int)(next_random(&state) % ScreenWidth);
+      int const y = (int)(next_random(&state) % ScreenHeight);
+      int const colour = (int)(next_random(&state) & UINT8_MAX);
+      int const bright = (int)(next_random(&state) % StarThreshold);
+      int const size = (int)(next_random(&state) % (StarSize + 1));
+      star_plot(height, screen, x, y, colour, bright, size);
+    }
+
+    unsigned long const hash = hash_screen();
+    DEBUGF("Stars from seed %lu at height %d have hash 0x%lx\n",
+           (unsigned long)golden[g].seed, golden[g].height, hash);
+    assert(hash == golden[g].hash);
+  }
+}
+
+void Render_tests(void)
+{
+  static const struct
+  {
+    char const *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Uniform sky", test1 },
+    { "Top of screen", test2 },
+    { "Draw sky", test3 },
+    { "Draw sky from each word offset", test4 },
+    { "Star shape", test5 },
+    { "Star position", test6 },
+    { "Star brightness", test7 },
+    { "Redraw sky rows", test8 },
+    { "Reference sky frames", test9 },
+    { "Reference star frames", test10 },
+  };
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); ++count)
+  {
+    DEBUGF("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    Fortify_EnterScope();
+    unit_tests[count].test_func();
+    Fortify_LeaveScope();
+  }
+}
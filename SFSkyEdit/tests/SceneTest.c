@@ -0,0 +1,626 @@
+/*
+ *  SFSkyEdit test: 3D scene rendering for the sky preview
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#undef NDEBUG
+
+/* ANSI library files */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <math.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+#include "SFFormats.h"
+#include "TrigTable.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "../Scene.h"
+
+#ifdef FORTIFY
+#include "Fortify.h"
+#endif
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+enum
+{
+  Marker = 0xa5,
+  Seed = 42,
+  ManyStars = 5000,
+  HighStars = 100000, /* minimum stars height above any test height */
+  TimingRepeats = 20,
+  SineMultiplier = 1024, /* as used by the scene renderer */
+  QuarterTurn = 128,
+};
+
+/* Star positions depend on every value in the sine table, so reference
+   frames of stars are stored for each way of rounding those values */
+typedef enum
+{
+  Rounding_Truncate,
+  Rounding_Nearest,
+  Rounding_Count
+}
+Rounding;
+
+typedef enum
+{
+  CannedSky_Gradient,
+  CannedSky_Stripes,
+  CannedSky_Dithered,
+  CannedSky_Count
+}
+CannedSky;
+
+static uint8_t frame[SceneSize], expected[SceneSize];
+
+static struct
+{
+  int height;
+  int direction;
+  int angle;
+}
+const viewpoints[] =
+{
+  {0, 0, 0}, {0, 90, 0}, {512, 0, 0}, {512, 180, 20}, {1000, 45, 60},
+  {2048, 270, 40}, {3648, 359, 0}, {3648, 0, 60},
+};
+
+/* ----------------------------------------------------------------------- */
+
+static void make_canned_sky(SFSky *const sky, CannedSky const type,
+  int const min_stars_height)
+{
+  /* Skies like those made in the editor, but simple enough to describe
+     here instead of storing files */
+  sky->render_offset = 0;
+  sky->min_stars_height = min_stars_height;
+
+  for (int row = 0; row < SFSky_Height; ++row)
+  {
+    for (int i = 0; i < SFSky_Width; ++i)
+    {
+      unsigned char colour = 0;
+      switch (type)
+      {
+        case CannedSky_Gradient:
+          colour = (unsigned char)(row / 2);
+          break;
+        case CannedSky_Stripes:
+          colour = (row / 16) % 2 ? 0x2c : 0xd3;
+          sky->render_offset = 1000;
+          break;
+        case CannedSky_Dithered:
+          colour = (unsigned char)((row / 2) + ((row % 2) ? 0 : (i % 2)));
+          sky->render_offset = -300;
+          break;
+        default:
+          assert("Bad canned sky" == NULL);
+          break;
+      }
+      sky->pixel_data[row][i] = colour;
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static unsigned long hash_frame(uint8_t const *const image)
+{
+  /* 32-bit FNV-1a hash */
+  uint32_t hash = UINT32_C(2166136261);
+  for (size_t i = 0; i < SceneSize; ++i)
+  {
+    hash ^= image[i];
+    hash = (hash * UINT32_C(16777619)) & UINT32_C(0xffffffff);
+  }
+  return hash;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static StarField *make_stars(int const count, unsigned long const seed)
+{
+  _Optional StarField *const stars = scene_create_stars(count);
+  assert(stars != NULL);
+  scene_make_stars(&*stars, seed);
+  return &*stars;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int model_sine(int angle, Rounding const rounding)
+{
+  /* Values for the first quarter turn, reflected to make the others */
+  angle %= QuarterTurn * 4;
+  if (angle < 0)
+  {
+    angle += QuarterTurn * 4;
+  }
+
+  int const quadrant = angle / QuarterTurn;
+  int index = angle % QuarterTurn;
+  if (quadrant % 2)
+  {
+    index = QuarterTurn - index;
+  }
+
+  double const value = SineMultiplier *
+                       sin(index * 2 * atan(1.0) / QuarterTurn);
+
+  int const sine = rounding == Rounding_Nearest ? (int)(value + 0.5) :
+                                                  (int)value;
+  return quadrant >= 2 ? -sine : sine;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static Rounding get_rounding(void)
+{
+  /* Find out how the sine table used by the renderer was rounded */
+  _Optional TrigTable *const tt = TrigTable_make(SineMultiplier, QuarterTurn);
+  assert(tt != NULL);
+
+  Rounding rounding;
+  for (rounding = Rounding_Truncate; rounding < Rounding_Count; ++rounding)
+  {
+    int angle;
+    for (angle = -QuarterTurn * 4; angle < QuarterTurn * 8; ++angle)
+    {
+      if (TrigTable_look_up_sine(&*tt, angle) != model_sine(angle, rounding) ||
+          TrigTable_look_up_cosine(&*tt, angle) !=
+            model_sine(angle + QuarterTurn, rounding))
+      {
+        break;
+      }
+    }
+
+    if (angle == QuarterTurn * 8)
+    {
+      break;
+    }
+  }
+
+  TrigTable_destroy(tt);
+  DEBUGF("Sine table rounding is %d\n", (int)rounding);
+  assert(rounding < Rounding_Count);
+  return rounding;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test1(void)
+{
+  /* Golden frames */
+  static SFSky sky;
+
+  /* Reference hashes of frames of each canned sky, rendered horizontally
+     (so that the position of the horizon doesn't depend on the rounding
+     of any sine table) from below the minimum stars height. */
+  static struct
+  {
+    CannedSky type;
+    int height;
+    unsigned long hash;
+  }
+  const golden[] =
+  {
+    { CannedSky_Gradient, 0, 0x159d9dc5 },
+    { CannedSky_Gradient, 512, 0x9dd33745 },
+    { CannedSky_Gradient, 3648, 0xe2191885 },
+    { CannedSky_Stripes, 0, 0x7c8b2c45 },
+    { CannedSky_Stripes, 512, 0x70a7c205 },
+    { CannedSky_Stripes, 3648, 0x95d4c345 },
+    { CannedSky_Dithered, 0, 0x71733885 },
+    { CannedSky_Dithered, 512, 0xb2643b85 },
+    { CannedSky_Dithered, 3648, 0xf3fa0285 },
+  };
+
+  StarField *const stars = make_stars(NStars, Seed);
+
+  for (size_t g = 0; g < ARRAY_SIZE(golden); ++g)
+  {
+    make_canned_sky(&sky, golden[g].type, HighStars);
+
+    memset(frame, Marker, sizeof(frame));
+    scene_render(&sky, stars, frame, golden[g].height, 0, 0);
+
+    unsigned long const hash = hash_frame(frame);
+    DEBUGF("Canned sky %d at height %d has hash 0x%lx\n",
+           (int)golden[g].type, golden[g].height, hash);
+    assert(hash == golden[g].hash);
+  }
+
+  scene_destroy_stars(stars);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test2(void)
+{
+  /* Render sky and stars separately */
+  static SFSky sky;
+  StarField *const stars = make_stars(NStars, Seed);
+
+  for (int type = 0; type < CannedSky_Count; ++type)
+  {
+    make_canned_sky(&sky, type, 0);
+
+    for (size_t v = 0; v < ARRAY_SIZE(viewpoints); ++v)
+    {
+      memset(expected, Marker, sizeof(expected));
+      scene_render(&sky, stars, expected, viewpoints[v].height,
+                   viewpoints[v].direction, viewpoints[v].angle);
+
+      memset(frame, Marker, sizeof(frame));
+      scene_render_sky(&sky, frame, viewpoints[v].height,
+                       viewpoints[v].angle);
+      scene_render_stars(&sky, stars, frame, viewpoints[v].height,
+                         viewpoints[v].direction, viewpoints[v].angle);
+
+      assert(!memcmp(frame, expected, sizeof(frame)));
+    }
+  }
+
+  scene_destroy_stars(stars);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test3(void)
+{
+  /* No stars */
+  static SFSky sky;
+  StarField *const none = make_stars(0, Seed);
+  StarField *const stars = make_stars(ManyStars, Seed);
+
+  for (int type = 0; type < CannedSky_Count; ++type)
+  {
+    for (size_t v = 0; v < ARRAY_SIZE(viewpoints); ++v)
+    {
+      /* Stars are not plotted below their minimum height */
+      make_canned_sky(&sky, type, viewpoints[v].height + 1);
+
+      memset(expected, Marker, sizeof(expected));
+      scene_render_sky(&sky, expected, viewpoints[v].height,
+                       viewpoints[v].angle);
+
+      memset(frame, Marker, sizeof(frame));
+      scene_render(&sky, stars, frame, viewpoints[v].height,
+                   viewpoints[v].direction, viewpoints[v].angle);
+      assert(!memcmp(frame, expected, sizeof(frame)));
+
+      /* An empty star field plots nothing at any height */
+      make_canned_sky(&sky, type, 0);
+
+      memset(expected, Marker, sizeof(expected));
+      scene_render_sky(&sky, expected, viewpoints[v].height,
+                       viewpoints[v].angle);
+
+      memset(frame, Marker, sizeof(frame));
+      scene_render(&sky, none, frame, viewpoints[v].height,
+                   viewpoints[v].direction, viewpoints[v].angle);
+      assert(!memcmp(frame, expected, sizeof(frame)));
+
+      /* Otherwise, some stars should be visible from every viewpoint */
+      scene_render(&sky, stars, frame, viewpoints[v].height,
+                   viewpoints[v].direction, viewpoints[v].angle);
+      assert(memcmp(frame, expected, sizeof(frame)));
+    }
+  }
+
+  scene_destroy_stars(stars);
+  scene_destroy_stars(none);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test4(void)
+{
+  /* Reproducible stars */
+  static int const counts[] = {1, NStars, ManyStars};
+
+  for (size_t c = 0; c < ARRAY_SIZE(counts); ++c)
+  {
+    StarField *const stars = make_stars(counts[c], Seed);
+    StarField *const same = make_stars(counts[c], Seed);
+    StarField *const other = make_stars(counts[c], Seed + 1);
+
+    size_t const n = (size_t)counts[c];
+    assert(!memcmp(stars->x, same->x, sizeof(*stars->x) * n));
+    assert(!memcmp(stars->y, same->y, sizeof(*stars->y) * n));
+    assert(!memcmp(stars->z, same->z, sizeof(*stars->z) * n));
+    assert(!memcmp(stars->bright, same->bright, sizeof(*stars->bright) * n));
+    assert(!memcmp(stars->colour, same->colour, sizeof(*stars->colour) * n));
+    assert(!memcmp(stars->size, same->size, sizeof(*stars->size) * n));
+
+    bool differ = false;
+    for (size_t s = 0; s < n && !differ; ++s)
+    {
+      differ = stars->x[s] != other->x[s] || stars->y[s] != other->y[s] ||
+               stars->z[s] != other->z[s] ||
+               stars->bright[s] != other->bright[s];
+    }
+    assert(differ);
+
+    scene_destroy_stars(other);
+    scene_destroy_stars(same);
+    scene_destroy_stars(stars);
+  }
+
+  /* Zero is a valid seed */
+  StarField *const stars = make_stars(NStars, 0);
+  assert(stars->count == NStars);
+  scene_destroy_stars(stars);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test5(void)
+{
+  /* Cached star positions */
+  static SFSky sky;
+  StarField *const stars = make_stars(ManyStars, Seed);
+  _Optional StarCache *const cache = scene_create_cache(stars);
+  assert(cache != NULL);
+
+  make_canned_sky(&sky, CannedSky_Gradient, 0);
+
+  /* Scrub the height at each viewpoint, then revisit the viewpoints */
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    for (size_t v = 0; v < ARRAY_SIZE(viewpoints); ++v)
+    {
+      for (int height = 0; height <= 3648; height += 608)
+      {
+        memset(expected, Marker, sizeof(expected));
+        scene_render(&sky, stars, expected, height,
+                     viewpoints[v].direction, viewpoints[v].angle);
+
+        memset(frame, Marker, sizeof(frame));
+        scene_render_cached(&sky, stars, &*cache, frame, height,
+                            viewpoints[v].direction, viewpoints[v].angle);
+
+        assert(!memcmp(frame, expected, sizeof(frame)));
+      }
+    }
+  }
+
+  /* Regenerated stars are only plotted if the cache is invalidated */
+  scene_make_stars(stars, Seed + 1);
+  scene_invalidate_stars(&*cache);
+
+  memset(expected, Marker, sizeof(expected));
+  scene_render(&sky, stars, expected, 1000, 45, 60);
+
+  memset(frame, Marker, sizeof(frame));
+  scene_render_cached(&sky, stars, &*cache, frame, 1000, 45, 60);
+  assert(!memcmp(frame, expected, sizeof(frame)));
+
+  scene_destroy_cache(cache);
+  scene_destroy_stars(stars);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test6(void)
+{
+  /* Redraw changed bands */
+  static SFSky sky, changed;
+  static struct
+  {
+    int start, end;
+  }
+  const ranges[] =
+  {
+    {0, 0}, {0, 1}, {5, 6}, {20, 40}, {100, 128}, {0, 128},
+  };
+
+  StarField *const stars = make_stars(NStars, Seed);
+  _Optional StarCache *const cache = scene_create_cache(stars);
+  assert(cache != NULL);
+
+  for (size_t r = 0; r < ARRAY_SIZE(ranges); ++r)
+  {
+    for (size_t v = 0; v < ARRAY_SIZE(viewpoints); ++v)
+    {
+      make_canned_sky(&sky, CannedSky_Dithered, 0);
+      changed = sky;
+
+      /* Each band is stored as two rows of the sky */
+      for (int row = ranges[r].start * 2; row < ranges[r].end * 2; ++row)
+      {
+        for (int i = 0; i < SFSky_Width; ++i)
+        {
+          changed.pixel_data[row][i] ^= 0xff;
+        }
+      }
+
+      memset(expected, Marker, sizeof(expected));
+      scene_render(&changed, stars, expected, viewpoints[v].height,
+                   viewpoints[v].direction, viewpoints[v].angle);
+
+      memset(frame, Marker, sizeof(frame));
+      scene_render_cached(&sky, stars, &*cache, frame, viewpoints[v].height,
+                          viewpoints[v].direction, viewpoints[v].angle);
+
+      int first_line = -1, end_line = -1;
+      scene_render_bands(&changed, stars, &*cache, frame,
+                         viewpoints[v].height, viewpoints[v].direction,
+                         viewpoints[v].angle, ranges[r].start, ranges[r].end,
+                         &first_line, &end_line);
+
+      assert(!memcmp(frame, expected, sizeof(frame)));
+      if (ranges[r].start == ranges[r].end)
+      {
+        assert(first_line >= end_line);
+      }
+    }
+  }
+
+  scene_destroy_cache(cache);
+  scene_destroy_stars(stars);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test7(void)
+{
+  /* Render timing */
+  static SFSky sky;
+  static int const counts[] = {NStars, ManyStars};
+
+  for (size_t c = 0; c < ARRAY_SIZE(counts); ++c)
+  {
+    StarField *const stars = make_stars(counts[c], Seed);
+
+    for (int type = 0; type < CannedSky_Count; ++type)
+    {
+      make_canned_sky(&sky, type, 0);
+
+      for (size_t v = 0; v < ARRAY_SIZE(viewpoints); ++v)
+      {
+        clock_t sky_time = 0, star_time = 0;
+
+        for (int r = 0; r < TimingRepeats; ++r)
+        {
+          clock_t const start = clock();
+          scene_render_sky(&sky, frame, viewpoints[v].height,
+                           viewpoints[v].angle);
+          clock_t const mid = clock();
+          scene_render_stars(&sky, stars, frame, viewpoints[v].height,
+                             viewpoints[v].direction, viewpoints[v].angle);
+          clock_t const end = clock();
+
+          sky_time += mid - start;
+          star_time += end - mid;
+        }
+
+        /* Only reported, since it depends on the machine */
+        DEBUGF("%d stars, canned sky %d, viewpoint %d,%d,%d: "
+               "sky %g us, stars %g us per frame\n",
+               counts[c], type, viewpoints[v].height,
+               viewpoints[v].direction, viewpoints[v].angle,
+               (double)sky_time * 1e6 / CLOCKS_PER_SEC / TimingRepeats,
+               (double)star_time * 1e6 / CLOCKS_PER_SEC / TimingRepeats);
+      }
+    }
+
+    scene_destroy_stars(stars);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test8(void)
+{
+  /* Golden star fields */
+  static SFSky sky;
+
+  /* Reference hashes of frames of seeded star fields, viewed from above
+     the minimum stars height in various directions and at various
+     angles. */
+  static struct
+  {
+    int count;
+    unsigned long seed;
+    int height;
+    int direction;
+    int angle;
+    unsigned long hash[Rounding_Count];
+  }
+  const golden[] =
+  {
+    { NStars, Seed, 0, 90, 20, { 0x98b13ab1, 0x59c0b01d } },
+    { NStars, Seed, 512, 45, 60, { 0x1976f45f, 0x4298485b } },
+    { NStars, Seed, 1000, 180, 10, { 0xd5c15c92, 0x18e88a85 } },
+    { NStars, Seed, 2048, 270, 40, { 0x34d53965, 0x6cc6995f } },
+    { NStars, Seed + 1, 3648, 315, 30, { 0x6b7b7dc9, 0xb53a0639 } },
+    { ManyStars, Seed, 512, 135, 50, { 0xb014a009, 0x5b99263e } },
+    { ManyStars, Seed + 1, 2048, 359, 5, { 0xa8a210ef, 0x5eaf100a } },
+  };
+
+  Rounding const rounding = get_rounding();
+  make_canned_sky(&sky, CannedSky_Gradient, 0);
+
+  for (size_t g = 0; g < ARRAY_SIZE(golden); ++g)
+  {
+    StarField *const stars = make_stars(golden[g].count, golden[g].seed);
+
+    memset(frame, Marker, sizeof(frame));
+    scene_render(&sky, stars, frame, golden[g].height, golden[g].direction,
+                 golden[g].angle);
+
+    unsigned long const hash = hash_frame(frame);
+    DEBUGF("%d stars from seed %lu at %d,%d,%d have hash 0x%lx\n",
+           golden[g].count, golden[g].seed, golden[g].height,
+           golden[g].direction, golden[g].angle, hash);
+    assert(hash == golden[g].hash[rounding]);
+
+    scene_destroy_stars(stars);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+void Scene_tests(void)
+{
+  static const struct
+  {
+    char const *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Golden frames", test1 },
+    { "Render sky and stars separately", test2 },
+    { "No stars", test3 },
+    { "Reproducible stars", test4 },
+    { "Cached star positions", test5 },
+    { "Redraw changed bands", test6 },
+    { "Render timing", test7 },
+    { "Golden star fields", test8 },
+  };
+
+  bool const ok = scene_initialise();
+  assert(ok);
+  NOT_USED(ok);
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); ++count)
+  {
+    DEBUGF("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    Fortify_EnterScope();
+    unit_tests[count].test_func();
+    Fortify_LeaveScope();
+  }
+
+  scene_finalise();
+}
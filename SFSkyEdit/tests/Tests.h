@@ -8,6 +8,11 @@
 
 void Sky_tests(void);
 void Editor_tests(void);
+void Render_tests(void);
+void Scene_tests(void);
+void PalLookup_tests(void);
+void Gradient_tests(void);
+void UndoRing_tests(void);
 void App_tests(void);
 
 #ifdef FORTIFY
@@ -0,0 +1,450 @@
+/*
+ *  SFSkyEdit test: Ring buffer of variable-sized undo records
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#undef NDEBUG
+
+/* ANSI library files */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "../UndoRing.h"
+
+#ifdef FORTIFY
+#include "Fortify.h"
+#endif
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+enum
+{
+  RingSize = 1024,
+  BlockSize = 100,
+  MaxBlocks = RingSize / BlockSize,
+  SmallSize = 10,
+  NRandomOps = 5000,
+  MaxRandomSize = 200,
+  Seed = 2026,
+};
+
+typedef struct
+{
+  unsigned char *ptr;
+  size_t size;
+  unsigned char fill;
+}
+Block;
+
+/* ----------------------------------------------------------------------- */
+
+static void fill_block(Block const *const block)
+{
+  memset(block->ptr, block->fill, block->size);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void check_block(Block const *const block)
+{
+  for (size_t i = 0; i < block->size; ++i)
+  {
+    assert(block->ptr[i] == block->fill);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void check_aligned(void const *const ptr)
+{
+  assert((uintptr_t)ptr % sizeof(double) == 0);
+  assert((uintptr_t)ptr % sizeof(void *) == 0);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static unsigned char *alloc_block(UndoRing *const ring, size_t const size)
+{
+  _Optional unsigned char *const ptr = undo_ring_alloc(ring, size);
+  if (!ptr)
+  {
+    return NULL;
+  }
+  check_aligned(&*ptr);
+  return &*ptr;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test1(void)
+{
+  /* Empty */
+  UndoRing ring;
+  undo_ring_init(&ring, RingSize);
+  assert(undo_ring_is_empty(&ring));
+  assert(undo_ring_get_used(&ring) == 0);
+  undo_ring_destroy(&ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test2(void)
+{
+  /* Free newest */
+  UndoRing ring;
+  undo_ring_init(&ring, RingSize);
+
+  Block blocks[MaxBlocks];
+  size_t used[MaxBlocks];
+  size_t nblocks = 0;
+
+  for (; nblocks < MaxBlocks; ++nblocks)
+  {
+    used[nblocks] = undo_ring_get_used(&ring);
+    blocks[nblocks].size = BlockSize;
+    blocks[nblocks].fill = (unsigned char)nblocks;
+    blocks[nblocks].ptr = alloc_block(&ring, BlockSize);
+    if (!blocks[nblocks].ptr)
+    {
+      break;
+    }
+    fill_block(&blocks[nblocks]);
+    assert(undo_ring_get_used(&ring) ==
+           used[nblocks] + undo_ring_block_size(BlockSize));
+  }
+  assert(nblocks > 1);
+
+  while (nblocks-- > 0)
+  {
+    for (size_t i = 0; i <= nblocks; ++i)
+    {
+      check_block(&blocks[i]);
+    }
+    undo_ring_free_newest(&ring);
+    assert(undo_ring_get_used(&ring) == used[nblocks]);
+  }
+  assert(undo_ring_is_empty(&ring));
+
+  undo_ring_destroy(&ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test3(void)
+{
+  /* Free oldest to make room */
+  UndoRing ring;
+  undo_ring_init(&ring, RingSize);
+
+  Block blocks[MaxBlocks * 3];
+  size_t oldest = 0, nblocks = 0;
+
+  while (nblocks < ARRAY_SIZE(blocks))
+  {
+    Block *const block = &blocks[nblocks];
+    block->size = BlockSize;
+    block->fill = (unsigned char)nblocks;
+    block->ptr = alloc_block(&ring, BlockSize);
+    if (!block->ptr)
+    {
+      /* The ring must have wrapped (or be about to) */
+      assert(oldest < nblocks);
+      undo_ring_free_oldest(&ring);
+      ++oldest;
+      continue;
+    }
+    fill_block(block);
+    ++nblocks;
+
+    for (size_t i = oldest; i < nblocks; ++i)
+    {
+      check_block(&blocks[i]);
+    }
+  }
+  assert(oldest > MaxBlocks);
+
+  while (oldest < nblocks)
+  {
+    undo_ring_free_oldest(&ring);
+    ++oldest;
+    for (size_t i = oldest; i < nblocks; ++i)
+    {
+      check_block(&blocks[i]);
+    }
+  }
+  assert(undo_ring_is_empty(&ring));
+  assert(undo_ring_get_used(&ring) == 0);
+
+  undo_ring_destroy(&ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test4(void)
+{
+  /* Too big */
+  UndoRing ring;
+  undo_ring_init(&ring, RingSize);
+
+  assert(alloc_block(&ring, RingSize) == NULL);
+  assert(undo_ring_is_empty(&ring));
+
+  size_t const max_size = RingSize - undo_ring_block_size(0);
+  assert(undo_ring_block_size(max_size) == RingSize);
+  assert(alloc_block(&ring, max_size) != NULL);
+  assert(undo_ring_get_used(&ring) == RingSize);
+  assert(alloc_block(&ring, 0) == NULL);
+
+  undo_ring_destroy(&ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test5(void)
+{
+  /* Shrink newest */
+  UndoRing ring;
+  undo_ring_init(&ring, RingSize);
+
+  Block first = {.size = SmallSize, .fill = 1};
+  first.ptr = alloc_block(&ring, first.size);
+  assert(first.ptr != NULL);
+  fill_block(&first);
+
+  Block second = {.size = BlockSize, .fill = 2};
+  second.ptr = alloc_block(&ring, second.size);
+  assert(second.ptr != NULL);
+  fill_block(&second);
+
+  second.size = SmallSize;
+  undo_ring_shrink_newest(&ring, second.size);
+  assert(undo_ring_get_used(&ring) == undo_ring_block_size(SmallSize) * 2);
+
+  /* The space released by shrinking is reused */
+  Block third = {.size = SmallSize, .fill = 3};
+  third.ptr = alloc_block(&ring, third.size);
+  assert(third.ptr == second.ptr + undo_ring_block_size(SmallSize));
+  fill_block(&third);
+
+  check_block(&first);
+  check_block(&second);
+  check_block(&third);
+
+  undo_ring_free_newest(&ring);
+  undo_ring_free_newest(&ring);
+  check_block(&first);
+  undo_ring_free_newest(&ring);
+  assert(undo_ring_is_empty(&ring));
+
+  undo_ring_destroy(&ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test6(void)
+{
+  /* Random allocation and freeing */
+  enum { NRandomKinds = 4 };
+  UndoRing ring;
+  undo_ring_init(&ring, RingSize);
+
+  Block blocks[RingSize / sizeof(double)];
+  size_t oldest = 0, nblocks = 0;
+
+  srand(Seed);
+  for (int op = 0; op < NRandomOps; ++op)
+  {
+    switch (rand() % NRandomKinds)
+    {
+    case 0:
+      if (nblocks > 0)
+      {
+        undo_ring_free_oldest(&ring);
+        oldest = (oldest + 1) % ARRAY_SIZE(blocks);
+        --nblocks;
+      }
+      break;
+
+    case 1:
+      if (nblocks > 0)
+      {
+        undo_ring_free_newest(&ring);
+        --nblocks;
+      }
+      break;
+
+    case 2:
+      if (nblocks > 0)
+      {
+        size_t const keep = 1 + (size_t)rand() % nblocks;
+        Block const *const last = &blocks[(oldest + keep - 1) %
+                                          ARRAY_SIZE(blocks)];
+        undo_ring_free_after(&ring, last->ptr);
+        nblocks = keep;
+      }
+      break;
+
+    default:
+      {
+        assert(nblocks < ARRAY_SIZE(blocks));
+        Block *const block = &blocks[(oldest + nblocks) % ARRAY_SIZE(blocks)];
+        block->size = (size_t)rand() % MaxRandomSize;
+        block->fill = (unsigned char)op;
+        block->ptr = alloc_block(&ring, block->size);
+        if (block->ptr)
+        {
+          fill_block(block);
+          ++nblocks;
+        }
+        else
+        {
+          /* Fails only if short of space */
+          assert(!undo_ring_is_empty(&ring));
+        }
+      }
+      break;
+    }
+
+    size_t used = 0;
+    for (size_t i = 0; i < nblocks; ++i)
+    {
+      Block const *const block = &blocks[(oldest + i) % ARRAY_SIZE(blocks)];
+      check_block(block);
+      used += undo_ring_block_size(block->size);
+    }
+    assert(undo_ring_get_used(&ring) == used);
+    assert(undo_ring_is_empty(&ring) == (nblocks == 0));
+
+    /* Iterate in both directions */
+    _Optional unsigned char *ptr = undo_ring_get_oldest(&ring);
+    for (size_t i = 0; i < nblocks; ++i)
+    {
+      assert(ptr == blocks[(oldest + i) % ARRAY_SIZE(blocks)].ptr);
+      ptr = undo_ring_get_next(&ring, &*ptr);
+    }
+    assert(ptr == NULL);
+
+    ptr = undo_ring_get_newest(&ring);
+    for (size_t i = nblocks; i-- > 0; )
+    {
+      assert(ptr == blocks[(oldest + i) % ARRAY_SIZE(blocks)].ptr);
+      ptr = undo_ring_get_prev(&ring, &*ptr);
+    }
+    assert(ptr == NULL);
+  }
+
+  undo_ring_destroy(&ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test7(void)
+{
+  /* No memory */
+  UndoRing ring;
+  undo_ring_init(&ring, RingSize);
+
+  Fortify_SetNumAllocationsLimit(0);
+  unsigned char *const ptr = alloc_block(&ring, SmallSize);
+  Fortify_SetNumAllocationsLimit(ULONG_MAX);
+
+#ifdef FORTIFY
+  assert(ptr == NULL);
+  assert(undo_ring_is_empty(&ring));
+#else
+  NOT_USED(ptr);
+#endif
+
+  /* The buffer is allocated when next needed */
+  assert(alloc_block(&ring, SmallSize) != NULL);
+
+  undo_ring_destroy(&ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void test8(void)
+{
+  /* Free all */
+  UndoRing ring;
+  undo_ring_init(&ring, RingSize);
+
+  while (alloc_block(&ring, BlockSize) != NULL)
+  {
+  }
+  assert(undo_ring_get_used(&ring) > RingSize - undo_ring_block_size(BlockSize));
+
+  undo_ring_free_all(&ring);
+  assert(undo_ring_is_empty(&ring));
+  assert(undo_ring_get_used(&ring) == 0);
+  assert(undo_ring_get_oldest(&ring) == NULL);
+  assert(undo_ring_get_newest(&ring) == NULL);
+
+  /* The buffer is reused */
+  unsigned char *const ptr = alloc_block(&ring, RingSize / 2);
+  assert(ptr != NULL);
+  assert(undo_ring_get_oldest(&ring) == ptr);
+  assert(undo_ring_get_newest(&ring) == ptr);
+
+  undo_ring_destroy(&ring);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void UndoRing_tests(void)
+{
+  static const struct
+  {
+    char const *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Empty", test1 },
+    { "Free newest", test2 },
+    { "Free oldest to make room", test3 },
+    { "Too big", test4 },
+    { "Shrink newest", test5 },
+    { "Random allocation and freeing", test6 },
+    { "No memory", test7 },
+    { "Free all", test8 },
+  };
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); ++count)
+  {
+    DEBUGF("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    Fortify_EnterScope();
+    unit_tests[count].test_func();
+    Fortify_LeaveScope();
+  }
+}
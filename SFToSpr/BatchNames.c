@@ -0,0 +1,329 @@
+/*
+ *  SFToSpr - Star Fighter 3000 graphics converter
+ *  Output file names for batch conversion
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "SFFormats.h"
+#include "Debug.h"
+
+/* Local headers */
+#include "BatchNames.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  MinNamesSize = 64, /* Initial capacity of a set of names */
+};
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static bool is_separator(char const c)
+{
+  return c == '/' || c == '\\';
+}
+
+/* ----------------------------------------------------------------------- */
+
+static size_t hash_name(char const *const name)
+{
+  assert(name != NULL);
+  size_t hash = 5381;
+  for (char const *p = name; *p != '\0'; ++p)
+  {
+    hash = (hash * 33) ^ (size_t)tolower((unsigned char)*p);
+  }
+  return hash;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool names_equal(char const *a, char const *b)
+{
+  assert(a != NULL);
+  assert(b != NULL);
+  while (tolower((unsigned char)*a) == tolower((unsigned char)*b))
+  {
+    if (*a == '\0')
+    {
+      return true;
+    }
+    ++a;
+    ++b;
+  }
+  return false;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static size_t find_slot(_Optional char *const entries[],
+  size_t const size, char const *const name)
+{
+  /* Returns the index of the entry for 'name', or of the empty slot where
+     it would be inserted */
+  assert(entries != NULL);
+  assert(size > 0);
+  assert((size & (size - 1)) == 0);
+
+  size_t i = hash_name(name) & (size - 1);
+  while (entries[i] != NULL && !names_equal(&*entries[i], name))
+  {
+    i = (i + 1) & (size - 1);
+  }
+  return i;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool grow(BatchNames *const names)
+{
+  assert(names != NULL);
+
+  size_t const new_size = names->size ? names->size * 2 : MinNamesSize;
+  _Optional char *_Optional *const new_entries = calloc(new_size,
+                                                        sizeof(*new_entries));
+  if (!new_entries)
+  {
+    return false;
+  }
+
+  for (size_t i = 0; i < names->size; ++i)
+  {
+    _Optional char *const entry = (&*names->entries)[i];
+    if (entry)
+    {
+      (&*new_entries)[find_slot(&*new_entries, new_size, &*entry)] = entry;
+    }
+  }
+
+  free(names->entries);
+  names->entries = new_entries;
+  names->size = new_size;
+  DEBUGF("Grew set of names to %zu entries\n", new_size);
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+char const *batchnames_leaf(char const *const path)
+{
+  assert(path != NULL);
+  char const *leaf = path;
+  for (char const *p = path; *p != '\0'; ++p)
+  {
+    if (is_separator(*p))
+    {
+      leaf = p + 1;
+    }
+  }
+  return leaf;
+}
+
+/* ----------------------------------------------------------------------- */
+
+size_t batchnames_strip_type(char const *const name,
+  _Optional int *const file_type)
+{
+  assert(name != NULL);
+  size_t const len = strlen(name);
+
+  if (file_type)
+  {
+    *file_type = FileType_Null;
+  }
+
+  if (len <= FileTypeSuffixLen || name[len - FileTypeSuffixLen] != ',')
+  {
+    return len;
+  }
+
+  int type = 0;
+  for (size_t i = len - FileTypeSuffixLen + 1; i < len; ++i)
+  {
+    if (!isxdigit((unsigned char)name[i]))
+    {
+      return len;
+    }
+    type = (type << 4) | (isdigit((unsigned char)name[i]) ?
+                          name[i] - '0' :
+                          tolower((unsigned char)name[i]) - 'a' + 10);
+  }
+
+  if (file_type)
+  {
+    *file_type = type;
+  }
+  return len - FileTypeSuffixLen;
+}
+
+/* ----------------------------------------------------------------------- */
+
+_Optional char const *batchnames_mirror(char const *const path)
+{
+  assert(path != NULL);
+  char const *start = path;
+
+  if (isalpha((unsigned char)start[0]) && start[1] == ':')
+  {
+    start += 2; /* skip a drive */
+  }
+
+  for (;;)
+  {
+    if (is_separator(start[0]))
+    {
+      start++;
+    }
+    else if (start[0] == '.' && is_separator(start[1]))
+    {
+      start += 2;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  for (char const *dir = start; *dir != '\0';)
+  {
+    size_t const len = strcspn(dir, "/\\");
+    if (len == 2 && dir[0] == '.' && dir[1] == '.')
+    {
+      return NULL;
+    }
+    dir += len;
+    if (*dir != '\0')
+    {
+      dir++;
+    }
+  }
+
+  return start;
+}
+
+/* ----------------------------------------------------------------------- */
+
+bool batchnames_make_stem(char *const stem, size_t const size,
+  char const *const load_path, _Optional char const *const save_dir)
+{
+  assert(stem != NULL);
+  assert(load_path != NULL);
+
+  int nchars;
+  if (save_dir)
+  {
+    _Optional char const *const sub_path = batchnames_mirror(load_path);
+    if (!sub_path)
+    {
+      return false;
+    }
+    char const *const leaf = batchnames_leaf(&*sub_path);
+    size_t const leaf_len = batchnames_strip_type(leaf, NULL);
+    nchars = snprintf(stem, size, "%s/%.*s", &*save_dir,
+                      (int)(leaf - &*sub_path + leaf_len), &*sub_path);
+  }
+  else
+  {
+    char const *const leaf = batchnames_leaf(load_path);
+    size_t const leaf_len = batchnames_strip_type(leaf, NULL);
+    nchars = snprintf(stem, size, "%.*s", (int)(leaf - load_path + leaf_len),
+                      load_path);
+  }
+  return nchars >= 0 && (size_t)nchars < size;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void batchnames_init(BatchNames *const names)
+{
+  assert(names != NULL);
+  *names = (BatchNames){.entries = NULL};
+}
+
+/* ----------------------------------------------------------------------- */
+
+void batchnames_destroy(BatchNames *const names)
+{
+  assert(names != NULL);
+  for (size_t i = 0; i < names->size; ++i)
+  {
+    free((&*names->entries)[i]);
+  }
+  FREE_SAFE(names->entries);
+  names->count = names->size = 0;
+}
+
+/* ----------------------------------------------------------------------- */
+
+bool batchnames_claim(BatchNames *const names, char const *const name,
+  char const *const owner, _Optional char const **const prev_owner)
+{
+  assert(names != NULL);
+  assert(name != NULL);
+  assert(owner != NULL);
+  assert(prev_owner != NULL);
+
+  *prev_owner = NULL;
+
+  /* Keep the load factor no greater than 3/4 */
+  if ((names->count + 1) * 4 > names->size * 3 && !grow(names))
+  {
+    return false;
+  }
+
+  _Optional char **const entries = &*names->entries;
+  size_t const i = find_slot(entries, names->size, name);
+  _Optional char *const entry = entries[i];
+  if (entry)
+  {
+    /* The owner is stored after the name */
+    *prev_owner = &*entry + strlen(&*entry) + 1;
+    DEBUGF("%s was already claimed by %s\n", name, &**prev_owner);
+    return true;
+  }
+
+  size_t const name_size = strlen(name) + 1;
+  size_t const owner_size = strlen(owner) + 1;
+  _Optional char *const new_entry = malloc(name_size + owner_size);
+  if (!new_entry)
+  {
+    return false;
+  }
+
+  memcpy(&*new_entry, name, name_size);
+  memcpy(&*new_entry + name_size, owner, owner_size);
+  entries[i] = new_entry;
+  names->count++;
+  return true;
+}
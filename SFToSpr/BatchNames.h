@@ -0,0 +1,63 @@
+/*
+ *  SFToSpr - Star Fighter 3000 graphics converter
+ *  Output file names for batch conversion
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFTBatchNames_h
+#define SFTBatchNames_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#if !defined(USE_OPTIONAL) && !defined(_Optional)
+#define _Optional
+#endif
+
+enum
+{
+  FileTypeSuffixLen = 4, /* Length of a ",xxx" file name suffix */
+};
+
+/* A set of output file names, each claimed by one input file. */
+typedef struct
+{
+  _Optional char *_Optional *entries; /* name followed by owner, or null */
+  size_t count;
+  size_t size; /* capacity (zero or a power of two) */
+}
+BatchNames;
+
+/* Get the leaf of a path in which '/' or '\' separates directories. */
+char const *batchnames_leaf(char const *path);
+
+/* Get the length of 'name' without any ",xxx" file type suffix. The file
+   type is output via 'file_type' (unless null), or FileType_Null if there
+   is no suffix. */
+size_t batchnames_strip_type(char const *name, _Optional int *file_type);
+
+/* Get the part of 'path' to be mirrored below an output directory, which
+   excludes any drive, root directory or leading "." directories. Returns a
+   null pointer if 'path' has a ".." directory, because the output would
+   then be outside the output directory. */
+_Optional char const *batchnames_mirror(char const *path);
+
+/* Make the name of the output file for 'load_path' without its file type
+   suffix. Output files are written alongside their input unless 'save_dir'
+   is not null, in which case the input path is mirrored below 'save_dir'.
+   Returns false if the name would be truncated or the input path can't be
+   mirrored. */
+bool batchnames_make_stem(char *stem, size_t size, char const *load_path,
+  _Optional char const *save_dir);
+
+void batchnames_init(BatchNames *names);
+void batchnames_destroy(BatchNames *names);
+
+/* Claim 'name' for the input file at 'owner'. Names are compared without
+   regard to case, as on RISC OS. If the name was already claimed then the
+   path of its owner is output via 'prev_owner', otherwise a null pointer.
+   Returns false if there is not enough memory. */
+bool batchnames_claim(BatchNames *names, char const *name, char const *owner,
+  _Optional char const **prev_owner);
+
+#endif
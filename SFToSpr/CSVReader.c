@@ -0,0 +1,216 @@
+/*
+ *  SFToSpr - Star Fighter 3000 graphics converter
+ *  Streaming parser for comma-separated values
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ISO library headers */
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <assert.h>
+
+/* My library files */
+#include "Debug.h"
+#include "Reader.h"
+
+/* Local headers */
+#include "CSVReader.h"
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static int peek_char(CSVReader *const csv)
+{
+  assert(csv != NULL);
+  if (csv->pos == csv->len)
+  {
+    csv->pos = 0;
+    csv->len = reader_fread(csv->chunk, 1, sizeof(csv->chunk), csv->reader);
+    assert(csv->len <= sizeof(csv->chunk));
+    if (csv->len == 0)
+    {
+      return EOF;
+    }
+  }
+  return csv->chunk[csv->pos];
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void skip_char(CSVReader *const csv)
+{
+  assert(csv != NULL);
+  assert(csv->pos < csv->len);
+  ++csv->pos;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool is_eol(int const c)
+{
+  return c == '\n' || c == '\r';
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int skip_blanks(CSVReader *const csv)
+{
+  int c = peek_char(csv);
+  while (c == ' ' || c == '\t')
+  {
+    skip_char(csv);
+    c = peek_char(csv);
+  }
+  return c;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void skip_eol(CSVReader *const csv)
+{
+  /* Accept LF, CR or CR LF */
+  int const c = peek_char(csv);
+  if (c == '\r')
+  {
+    skip_char(csv);
+    if (peek_char(csv) == '\n')
+    {
+      skip_char(csv);
+    }
+  }
+  else if (c == '\n')
+  {
+    skip_char(csv);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void skip_line(CSVReader *const csv)
+{
+  int c = peek_char(csv);
+  while (c != EOF && !is_eol(c))
+  {
+    skip_char(csv);
+    c = peek_char(csv);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int skip_to_end_of_field(CSVReader *const csv)
+{
+  int c = peek_char(csv);
+  while (c != ',' && c != EOF && !is_eol(c))
+  {
+    skip_char(csv);
+    c = peek_char(csv);
+  }
+  return c;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int parse_int(CSVReader *const csv)
+{
+  int c = skip_blanks(csv);
+  bool const negative = (c == '-');
+  if (c == '-' || c == '+')
+  {
+    skip_char(csv);
+    c = peek_char(csv);
+  }
+
+  /* Saturate at one beyond INT_MAX, which is enough to represent INT_MIN */
+  unsigned long int const limit = (unsigned long)INT_MAX + 1;
+  unsigned long int value = 0;
+  while (c >= '0' && c <= '9')
+  {
+    unsigned long int const digit = (unsigned long)(c - '0');
+    value = value > (limit - digit) / 10 ? limit : (value * 10) + digit;
+    skip_char(csv);
+    c = peek_char(csv);
+  }
+
+  if (negative)
+  {
+    return value >= limit ? INT_MIN : -(int)value;
+  }
+  return value > INT_MAX ? INT_MAX : (int)value;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+void csvreader_init(CSVReader *const csv, Reader *const reader)
+{
+  assert(csv != NULL);
+  assert(reader != NULL);
+  *csv = (CSVReader){.reader = reader};
+}
+
+/* ----------------------------------------------------------------------- */
+
+size_t csvreader_read_ints(CSVReader *const csv, int values[],
+  size_t const max)
+{
+  assert(csv != NULL);
+  assert(values != NULL || max == 0);
+
+  /* Find the start of the next record */
+  for (;;)
+  {
+    int const c = skip_blanks(csv);
+    if (c == EOF)
+    {
+      return 0;
+    }
+
+    if (c == '#')
+    {
+      skip_line(csv);
+    }
+    else if (!is_eol(c))
+    {
+      break;
+    }
+    skip_eol(csv);
+  }
+
+  size_t nfields = 0;
+  for (;;)
+  {
+    int const value = parse_int(csv);
+    if (nfields < max)
+    {
+      values[nfields] = value;
+    }
+    ++nfields;
+
+    if (skip_to_end_of_field(csv) != ',')
+    {
+      break;
+    }
+    skip_char(csv);
+  }
+  skip_eol(csv);
+
+  DEBUGF("Parsed %zu fields from CSV record\n", nfields);
+  return nfields;
+}
@@ -0,0 +1,41 @@
+/*
+ *  SFToSpr - Star Fighter 3000 graphics converter
+ *  Streaming parser for comma-separated values
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFTCSVReader_h
+#define SFTCSVReader_h
+
+#include <stddef.h>
+
+#include "Reader.h"
+
+enum
+{
+  CSVReaderChunkSize = 64, /* Bytes read from the input at a time */
+};
+
+/* Input is parsed one fixed-size chunk at a time, so there is no limit on
+   the length of a file or record and nothing is allocated per field. */
+typedef struct
+{
+  Reader *reader;
+  size_t pos; /* Offset of the next character in the chunk */
+  size_t len; /* Number of characters in the chunk */
+  unsigned char chunk[CSVReaderChunkSize];
+}
+CSVReader;
+
+/* Initialize a parser to read from the current position of 'reader'. */
+void csvreader_init(CSVReader *csv, Reader *reader);
+
+/* Parse the next record as integers, skipping blank lines and comment lines
+   (those beginning with '#'). Each field is converted like strtol (saturating
+   instead of overflowing) and any characters after the number are ignored.
+   Up to 'max' values are stored. Returns the number of fields in the record,
+   which may be more than 'max', or 0 at the end of the input or upon a read
+   error (check reader_ferror). */
+size_t csvreader_read_ints(CSVReader *csv, int values[], size_t max);
+
+#endif
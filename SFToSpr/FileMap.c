@@ -0,0 +1,215 @@
+/*
+ *  SFToSpr - Star Fighter 3000 graphics converter
+ *  Read-only mapping of whole files into memory
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <assert.h>
+
+/* My library files */
+#include "Debug.h"
+
+/* Local headers */
+#include "FileMap.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(FILEMAP_MMAP)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Mappings of length zero aren't allowed, so empty files use this instead */
+static char const empty[1];
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+#if defined(_WIN32)
+
+static bool map_file(FileMap *const map, char const *const path)
+{
+  HANDLE const file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                  OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  bool success = false;
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && (unsigned long long)size.QuadPart <= LONG_MAX)
+  {
+    if (size.QuadPart == 0)
+    {
+      *map = (FileMap){.data = empty};
+      success = true;
+    }
+    else
+    {
+      HANDLE const mapping = CreateFileMappingA(file, NULL, PAGE_READONLY,
+                                                0, 0, NULL);
+      if (mapping != NULL)
+      {
+        void *const view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view != NULL)
+        {
+          *map = (FileMap){.data = view, .size = (size_t)size.QuadPart,
+                           .handle = view};
+          success = true;
+        }
+        /* The view keeps the file mapping object alive */
+        CloseHandle(mapping);
+      }
+    }
+  }
+  CloseHandle(file);
+  return success;
+}
+
+static void unmap_file(FileMap *const map)
+{
+  UnmapViewOfFile(map->handle);
+}
+
+#elif defined(FILEMAP_MMAP)
+
+static bool map_file(FileMap *const map, char const *const path)
+{
+  int const fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  bool success = false;
+  struct stat info;
+  if (!fstat(fd, &info) && info.st_size >= 0 && info.st_size <= LONG_MAX)
+  {
+    if (info.st_size == 0)
+    {
+      *map = (FileMap){.data = empty};
+      success = true;
+    }
+    else
+    {
+      void *const base = mmap(NULL, (size_t)info.st_size, PROT_READ,
+                              MAP_PRIVATE, fd, 0);
+      if (base != MAP_FAILED)
+      {
+        *map = (FileMap){.data = base, .size = (size_t)info.st_size,
+                         .handle = base};
+        success = true;
+      }
+    }
+  }
+  /* The mapping remains valid after the file is closed */
+  close(fd);
+  return success;
+}
+
+static void unmap_file(FileMap *const map)
+{
+  munmap(map->handle, map->size);
+}
+
+#else
+
+static bool map_file(FileMap *const map, char const *const path)
+{
+  /* No way to map files on this platform, so read the whole file instead */
+  FILE *const f = fopen(path, "rb");
+  if (!f)
+  {
+    return false;
+  }
+
+  bool success = false;
+  if (!fseek(f, 0, SEEK_END))
+  {
+    long int const size = ftell(f);
+    if (size == 0)
+    {
+      *map = (FileMap){.data = empty};
+      success = true;
+    }
+    else if (size > 0 && !fseek(f, 0, SEEK_SET))
+    {
+      _Optional char *const buf = malloc((size_t)size);
+      if (buf && fread(&*buf, (size_t)size, 1, f) == 1)
+      {
+        *map = (FileMap){.data = &*buf, .size = (size_t)size, .handle = &*buf};
+        success = true;
+      }
+      else
+      {
+        free(buf);
+      }
+    }
+  }
+  fclose(f);
+  return success;
+}
+
+static void unmap_file(FileMap *const map)
+{
+  free(map->handle);
+}
+
+#endif
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+bool filemap_open(FileMap *const map, char const *const path)
+{
+  assert(map != NULL);
+  assert(path != NULL);
+
+  *map = (FileMap){.data = NULL};
+  bool const success = map_file(map, path);
+  DEBUGF("%s %lu bytes of %s at %p\n", success ? "Mapped" : "Failed to map",
+         (unsigned long)map->size, path, (void *)map->data);
+  return success;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void filemap_close(FileMap *const map)
+{
+  assert(map != NULL);
+
+  if (map->handle != NULL)
+  {
+    unmap_file(map);
+  }
+  *map = (FileMap){.data = NULL};
+}
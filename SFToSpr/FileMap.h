@@ -0,0 +1,32 @@
+/*
+ *  SFToSpr - Star Fighter 3000 graphics converter
+ *  Read-only mapping of whole files into memory
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFTFileMap_h
+#define SFTFileMap_h
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#if !defined(USE_OPTIONAL) && !defined(_Optional)
+#define _Optional
+#endif
+
+typedef struct
+{
+  void const *data;
+  size_t size;
+  void *handle; /* private */
+}
+FileMap;
+
+/* Where the platform allows, the file's contents are mapped directly
+   rather than copied. Returns false if the file could not be opened or
+   there is not enough memory. */
+bool filemap_open(FileMap *map, char const *path);
+
+void filemap_close(FileMap *map);
+
+#endif
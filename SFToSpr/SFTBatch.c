@@ -0,0 +1,1329 @@
+/*
+ *  SFToSpr - Star Fighter 3000 graphics converter
+ *  Command-line batch converter
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* Unlike the rest of SFToSpr, this program has no dependency on the RISC OS
+   toolbox or Wimp. It converts files named on the command line (or listed
+   one per line on the standard input stream), and every file below any
+   named directory, using the same conversion routines as the directory
+   scan. RISC OS file types are taken from a ",xxx" suffix on each file
+   name, as used by HostFS and NFS.
+   Files can be converted concurrently on a pool of worker threads, but
+   results are always reported in the order that files were listed. */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <dirent.h>
+#endif
+
+/* My library files */
+#include "Macros.h"
+#include "SFFormats.h"
+#include "SprFormats.h"
+#include "Debug.h"
+#include "ReaderMem.h"
+#include "ReaderGKey.h"
+#include "WriterRaw.h"
+#include "WriterGKey.h"
+
+/* Local headers */
+#include "SFgfxconv.h"
+#include "SFError.h"
+#include "BatchPool.h"
+#include "BatchNames.h"
+#include "FileMap.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  FednetHistoryLog2 = 9, /* Base 2 logarithm of the history size used by
+                            the compression algorithm */
+  MaxPathLen = 1024,
+  QueueSlotsPerThread = 4, /* Files queued ahead of the workers */
+  ExpandMinSize = 16 * 1024, /* Initial size of a decompression buffer */
+  MinListingSize = 16, /* Initial capacity of a directory listing */
+};
+
+typedef struct
+{
+  char const *save_dir;
+  size_t make_path_offset; /* avoids creating directories that should already exist */
+  int force_type;
+  bool extract_images;
+  bool extract_data;
+  bool verbose;
+}
+BatchOptions;
+
+typedef struct
+{
+  unsigned long int num_checked;
+  unsigned long int num_output;
+  unsigned long int num_failed;
+}
+BatchStats;
+
+typedef enum
+{
+  BatchResult_Ignored,
+  BatchResult_NoGraphics,
+  BatchResult_MultiType,
+  BatchResult_Converted,
+  BatchResult_Failed,
+  BatchResult_Clash,
+  BatchResult_NotInDir,
+  BatchResult_DirFail,
+}
+BatchResult;
+
+typedef struct
+{
+  BatchOptions opts;
+  BatchStats stats; /* only updated on the main thread */
+  BatchNames save_names; /* only used on the main thread */
+}
+BatchContext;
+
+typedef struct
+{
+  char **names;
+  size_t count;
+  size_t size;
+}
+DirListing;
+
+typedef struct
+{
+  BatchResult result;
+  SFError err;
+  _Optional char const *clash_path; /* input whose output would clash */
+  char load_path[MaxPathLen];
+  char save_path[MaxPathLen];
+}
+BatchJob;
+
+static char const *prog_name = "SFToSprBatch";
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static char const *error_text(SFError const err)
+{
+  static char const *const ms_to_text[] = {
+    [SFError_OK] = "No error",
+    [SFError_OSError] = "Operating system error",
+    [SFError_OpenInFail] = "Failed to open input file",
+    [SFError_OpenOutFail] = "Failed to open output file",
+    [SFError_ReadFail] = "Failed to read from file",
+    [SFError_WriteFail] = "Failed to write to file",
+    [SFError_BadTell] = "Failed to get file position",
+    [SFError_BadSeek] = "Failed to set file position",
+    [SFError_Trunc] = "File is truncated",
+    [SFError_TooLong] = "File is too long",
+    [SFError_Escape] = "Escape",
+    [SFError_NoMem] = "Not enough free memory",
+    [SFError_BadDataOff] = "Bad image data offset",
+    [SFError_BadNumGFX] = "Bad number of images",
+    [SFError_BadImages] = "Bad image data",
+    [SFError_BadPaintOff] = "Bad planet paint offsets",
+    [SFError_BadAnims] = "Bad tile animation data",
+    [SFError_ForceAnim] = "Tile animation values were out of range",
+    [SFError_ForceOff] = "Planet paint offsets were out of range",
+    [SFError_ForceSky] = "Sky values were out of range",
+    [SFError_BadRend] = "Bad sky render offset",
+    [SFError_BadStar] = "Bad minimum stars height",
+    [SFError_TooShort] = "File is too short",
+    [SFError_BadSprite] = "Bad sprite",
+    [SFError_NoAnim] = "No tile animation data",
+    [SFError_NoHeight] = "No minimum stars height",
+    [SFError_NoOffset] = "No planet paint offsets",
+    [SFError_StrOFlo] = "String too long",
+    [SFError_Done] = "Done",
+  };
+
+  char const *text = NULL;
+  if ((size_t)err < ARRAY_SIZE(ms_to_text))
+  {
+    text = ms_to_text[err];
+  }
+  return text ? text : "Unknown error";
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void report_error(SFError const err, char const *const load_path,
+  char const *const save_path)
+{
+  assert(err != SFError_OK);
+
+  /* Most write errors are treated as WriteFail, including fseek failures */
+  char const *const path = (err == SFError_OpenOutFail ||
+                            err == SFError_WriteFail) ? save_path : load_path;
+
+  fprintf(stderr, "%s: %s: %s\n", prog_name, path ? path : "", error_text(err));
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool is_separator(char const c)
+{
+  return c == '/' || c == '\\';
+}
+
+/* ----------------------------------------------------------------------- */
+
+static char *trim_separators(char *const path)
+{
+  /* Removes any trailing separators, except from a root directory */
+  assert(path != NULL);
+  size_t len = strlen(path);
+  while (len > 1 && is_separator(path[len - 1]))
+  {
+    path[--len] = '\0';
+  }
+  return path;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool make_save_path(char *const save_path, size_t const size,
+  char const *const load_path, BatchOptions const *const opts,
+  int const output_type)
+{
+  assert(save_path != NULL);
+  assert(load_path != NULL);
+  assert(opts != NULL);
+
+  if (!batchnames_make_stem(save_path, size, load_path, opts->save_dir))
+  {
+    return false;
+  }
+
+  size_t const len = strlen(save_path);
+  int const nchars = snprintf(save_path + len, size - len, ",%03x",
+                              output_type);
+  return nchars >= 0 && (size_t)nchars < size - len;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool make_dir(char const *const path)
+{
+#if defined(_WIN32)
+  return !_mkdir(path) || errno == EEXIST;
+#else
+  return !mkdir(path, 0777) || errno == EEXIST;
+#endif
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool make_path(char *const save_path, size_t const offset)
+{
+  /* Creates any directories in the given path that are named after
+     'offset', but not the leaf (which is a file). */
+  assert(save_path != NULL);
+
+  for (size_t i = offset; save_path[i] != '\0'; ++i)
+  {
+    char const sep = save_path[i];
+    if (is_separator(sep))
+    {
+      save_path[i] = '\0';
+      bool const made = make_dir(save_path);
+      save_path[i] = sep;
+      if (!made)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError open_output(FILE **const out, Writer *const writer,
+  char const *const save_path, long int const min_size)
+{
+  assert(out != NULL);
+  assert(writer != NULL);
+  assert(save_path != NULL);
+
+  *out = fopen(save_path, "wb");
+  if (!*out)
+  {
+    return SFError_OpenOutFail;
+  }
+
+  if (min_size >= 0)
+  {
+    if (!writer_gkey_init(writer, FednetHistoryLog2, min_size, *out))
+    {
+      fclose(*out);
+      *out = NULL;
+      return SFError_NoMem;
+    }
+  }
+  else
+  {
+    writer_raw_init(writer, *out);
+  }
+  return SFError_OK;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError close_output(FILE *const out, Writer *const writer,
+  char const *const save_path, SFError err)
+{
+  assert(out != NULL);
+  assert(writer != NULL);
+  assert(save_path != NULL);
+
+  long int const out_bytes = writer_destroy(writer);
+  if (fclose(out) && err == SFError_OK)
+  {
+    err = SFError_WriteFail;
+  }
+  else if (out_bytes < 0 && err == SFError_OK)
+  {
+    err = SFError_WriteFail;
+  }
+
+  if (err != SFError_OK)
+  {
+    /* Don't leave a partial output file to be mistaken for a good one */
+    (void)remove(save_path);
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError game_to_output(Reader *const reader, char const *const save_path,
+  int const input_type, int const output_type, bool const extract_data)
+{
+  assert(reader != NULL);
+  assert(save_path != NULL);
+
+  FILE *out = NULL;
+  Writer writer;
+  SFError err = open_output(&out, &writer, save_path, -1);
+  if (err != SFError_OK)
+  {
+    return err;
+  }
+
+  if (output_type == FileType_CSV)
+  {
+    switch (input_type)
+    {
+    case FileType_SFMapGfx:
+      err = tiles_to_csv(reader, &writer);
+      break;
+
+    case FileType_SFSkyPic:
+      err = planets_to_csv(reader, &writer);
+      break;
+
+    case FileType_SFSkyCol:
+      err = sky_to_csv(reader, &writer);
+      break;
+
+    default:
+      assert(!"Unexpected input filetype");
+      break;
+    }
+  }
+  else
+  {
+    assert(output_type == FileType_Sprite);
+    switch (input_type)
+    {
+    case FileType_SFMapGfx:
+      err = extract_data ? tiles_to_sprites_ext(reader, &writer) :
+                           tiles_to_sprites(reader, &writer);
+      break;
+
+    case FileType_SFSkyPic:
+      err = extract_data ? planets_to_sprites_ext(reader, &writer) :
+                           planets_to_sprites(reader, &writer);
+      break;
+
+    case FileType_SFSkyCol:
+      err = extract_data ? sky_to_sprites_ext(reader, &writer) :
+                           sky_to_sprites(reader, &writer);
+      break;
+
+    default:
+      assert(!"Unexpected input filetype");
+      break;
+    }
+
+    if (err == SFError_OK &&
+        (input_type == FileType_SFMapGfx || input_type == FileType_SFSkyPic) &&
+        reader_fgetc(reader) != EOF)
+    {
+      err = SFError_TooLong;
+    }
+  }
+
+  return close_output(out, &writer, save_path, err);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError pick_conversion(ScanSpritesContext const *const context,
+  int *const output_type, long int *const min_size)
+{
+  assert(context != NULL);
+  assert(output_type != NULL);
+  assert(min_size != NULL);
+
+  SFError err = SFError_OK;
+  if (context->tiles.count > 0)
+  {
+    *output_type = FileType_SFMapGfx;
+    if (!context->tiles.got_hdr)
+    {
+      err = SFError_NoAnim;
+    }
+    else if (context->tiles.fixed_hdr)
+    {
+      err = SFError_BadAnims;
+    }
+    else
+    {
+      *min_size = tiles_size(&context->tiles.hdr);
+    }
+  }
+  else if (context->planets.count > 0)
+  {
+    *output_type = FileType_SFSkyPic;
+    if (!context->planets.got_hdr)
+    {
+      err = SFError_NoOffset;
+    }
+    else if (context->planets.fixed_hdr)
+    {
+      err = SFError_BadPaintOff;
+    }
+    else
+    {
+      *min_size = planets_size(&context->planets.hdr);
+    }
+  }
+  else if (context->sky.count > 0)
+  {
+    *output_type = FileType_SFSkyCol;
+    if (!context->sky.got_hdr)
+    {
+      err = SFError_NoHeight;
+    }
+    else if (context->sky.fixed_render)
+    {
+      err = SFError_BadRend;
+    }
+    else if (context->sky.fixed_stars)
+    {
+      err = SFError_BadStar;
+    }
+    else
+    {
+      *min_size = sky_size();
+    }
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError sprites_to_output(Reader *const reader,
+  ScanSpritesContext const *const context, char const *const save_path,
+  int const output_type, long int const min_size)
+{
+  assert(reader != NULL);
+  assert(context != NULL);
+  assert(save_path != NULL);
+
+  if (reader_fseek(reader, 0, SEEK_SET))
+  {
+    return SFError_BadSeek;
+  }
+
+  FILE *out = NULL;
+  Writer writer;
+  SFError err = open_output(&out, &writer, save_path, min_size);
+  if (err != SFError_OK)
+  {
+    return err;
+  }
+
+  switch (output_type)
+  {
+  case FileType_SFMapGfx:
+    err = sprites_to_tiles(reader, &writer, &context->tiles);
+    break;
+
+  case FileType_SFSkyPic:
+    err = sprites_to_planets(reader, &writer, &context->planets);
+    break;
+
+  case FileType_SFSkyCol:
+    err = sprites_to_sky(reader, &writer, &context->sky);
+    break;
+
+  default:
+    assert(!"Unexpected output filetype");
+    break;
+  }
+
+  return close_output(out, &writer, save_path, err);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError convert_sprites(BatchJob *const bj,
+  BatchOptions const *const opts)
+{
+  assert(bj != NULL);
+  assert(opts != NULL);
+
+  /* Map the whole file so that the scan and conversion passes share one
+     copy of its contents and never touch the file system again. */
+  FileMap map;
+  if (!filemap_open(&map, bj->load_path))
+  {
+    return SFError_OpenInFail;
+  }
+
+  Reader reader;
+  if (!reader_mem_init(&reader, map.data, map.size))
+  {
+    filemap_close(&map);
+    return SFError_NoMem;
+  }
+
+  ScanSpritesContext scan_context;
+  SFError err = scan_sprite_file(&reader, &scan_context);
+  if (err == SFError_OK)
+  {
+    /* Does the sprite file contain valid planet or tile graphics? */
+    int const ntypes = count_spr_types(&scan_context);
+    if (ntypes > 1)
+    {
+      bj->result = BatchResult_MultiType;
+    }
+    else if (ntypes == 0)
+    {
+      bj->result = BatchResult_NoGraphics;
+    }
+    else
+    {
+      int output_type = FileType_Null;
+      long int min_size = -1;
+      err = pick_conversion(&scan_context, &output_type, &min_size);
+      if (err == SFError_OK)
+      {
+        if (!make_save_path(bj->save_path, sizeof(bj->save_path),
+                            bj->load_path, opts, output_type))
+        {
+          err = SFError_StrOFlo;
+        }
+        else
+        {
+          err = sprites_to_output(&reader, &scan_context, bj->save_path,
+                                  output_type, min_size);
+          bj->result = BatchResult_Converted;
+        }
+      }
+    }
+  }
+
+  reader_destroy(&reader);
+  filemap_close(&map);
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError expand_game(Reader *const src, unsigned char **const data,
+  size_t *const size)
+{
+  assert(src != NULL);
+  assert(data != NULL);
+  assert(size != NULL);
+
+  _Optional unsigned char *buf = NULL;
+  size_t capacity = 0, n = 0;
+
+  do
+  {
+    if (n == capacity)
+    {
+      size_t const new_capacity = capacity ? capacity * 2 : ExpandMinSize;
+      _Optional unsigned char *const new_buf = realloc(buf, new_capacity);
+      if (!new_buf)
+      {
+        free(buf);
+        return SFError_NoMem;
+      }
+      buf = new_buf;
+      capacity = new_capacity;
+    }
+    n += reader_fread(&*buf + n, 1, capacity - n, src);
+  }
+  while (!reader_feof(src) && !reader_ferror(src));
+
+  if (reader_ferror(src))
+  {
+    free(buf);
+    return SFError_ReadFail;
+  }
+
+  DEBUGF("Decompressed %zu bytes into a buffer of %zu\n", n, capacity);
+  *data = &*buf;
+  *size = n;
+  return SFError_OK;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError convert_game(BatchJob *const bj, BatchOptions const *const opts,
+  int const input_type, int const output_type)
+{
+  assert(bj != NULL);
+  assert(opts != NULL);
+
+  FILE *const in = fopen(bj->load_path, "rb");
+  if (!in)
+  {
+    return SFError_OpenInFail;
+  }
+
+  Reader reader;
+  if (!reader_gkey_init(&reader, FednetHistoryLog2, in))
+  {
+    fclose(in);
+    return SFError_NoMem;
+  }
+
+  /* Decompress the whole file before converting it, otherwise every
+     backward seek (e.g. between planet images) would restart the
+     decompressor from the beginning of the file. */
+  unsigned char *data = NULL;
+  size_t size = 0;
+  SFError err = expand_game(&reader, &data, &size);
+  reader_destroy(&reader);
+  fclose(in);
+  if (err != SFError_OK)
+  {
+    return err;
+  }
+
+  if (!reader_mem_init(&reader, data, size))
+  {
+    free(data);
+    return SFError_NoMem;
+  }
+
+  if (!make_save_path(bj->save_path, sizeof(bj->save_path),
+                      bj->load_path, opts, output_type))
+  {
+    err = SFError_StrOFlo;
+  }
+  else
+  {
+    err = game_to_output(&reader, bj->save_path, input_type, output_type,
+                         opts->extract_data);
+    bj->result = BatchResult_Converted;
+  }
+
+  reader_destroy(&reader);
+  free(data);
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool should_convert(char const *const load_path,
+  BatchOptions const *const opts, int *const input_type,
+  int *const output_type)
+{
+  /* Returns false if the file should be ignored. The output type of a
+     sprite file isn't known until it has been scanned. */
+  assert(load_path != NULL);
+  assert(opts != NULL);
+  assert(input_type != NULL);
+  assert(output_type != NULL);
+
+  (void)batchnames_strip_type(batchnames_leaf(load_path), input_type);
+  if (opts->force_type != FileType_Null)
+  {
+    *input_type = opts->force_type;
+  }
+
+  bool skip = true;
+  *output_type = FileType_Null;
+  switch (*input_type)
+  {
+    case FileType_SFMapGfx:
+    case FileType_SFSkyPic:
+    case FileType_SFSkyCol:
+      if (opts->extract_images || opts->extract_data)
+      {
+        *output_type = opts->extract_images ? FileType_Sprite : FileType_CSV;
+        skip = false;
+      }
+      break;
+
+    case FileType_Sprite:
+      skip = opts->extract_images || opts->extract_data;
+      break;
+
+    default:
+      /* Ignore unsupported file types */
+      break;
+  }
+
+  return !skip;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void convert_file(void *const job, void *const arg)
+{
+  /* May be called on a worker thread, so must only touch the job */
+  BatchJob *const bj = job;
+  BatchContext const *const context = arg;
+  assert(bj != NULL);
+  assert(context != NULL);
+  BatchOptions const *const opts = &context->opts;
+
+  if (bj->result != BatchResult_Ignored)
+  {
+    return;
+  }
+
+  /* Check whether we should load the file */
+  int input_type, output_type;
+  if (!should_convert(bj->load_path, opts, &input_type, &output_type))
+  {
+    bj->result = BatchResult_Ignored;
+    return;
+  }
+
+  SFError const err = (input_type == FileType_Sprite) ?
+    convert_sprites(bj, opts) :
+    convert_game(bj, opts, input_type, output_type);
+
+  if (err != SFError_OK)
+  {
+    bj->err = err;
+    bj->result = BatchResult_Failed;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void report_file(void *const job, void *const arg)
+{
+  /* Called in the same order as files were submitted */
+  BatchJob *const bj = job;
+  BatchContext *const context = arg;
+  assert(bj != NULL);
+  assert(context != NULL);
+  bool const verbose = context->opts.verbose;
+
+  if (bj->result != BatchResult_Ignored)
+  {
+    context->stats.num_checked++;
+  }
+
+  switch (bj->result)
+  {
+    case BatchResult_Ignored:
+      if (verbose)
+      {
+        printf("Ignoring %s\n", bj->load_path);
+      }
+      break;
+
+    case BatchResult_NoGraphics:
+      if (verbose)
+      {
+        printf("No graphics found in %s\n", bj->load_path);
+      }
+      break;
+
+    case BatchResult_MultiType:
+      fprintf(stderr, "%s: %s: Sprite file contains more than one type "
+              "of graphics\n", prog_name, bj->load_path);
+      context->stats.num_failed++;
+      break;
+
+    case BatchResult_Converted:
+      if (verbose)
+      {
+        printf("Converted %s to %s\n", bj->load_path, bj->save_path);
+      }
+      context->stats.num_output++;
+      break;
+
+    case BatchResult_Failed:
+      report_error(bj->err, bj->load_path, bj->save_path);
+      context->stats.num_failed++;
+      break;
+
+    case BatchResult_Clash:
+      assert(bj->clash_path != NULL);
+      fprintf(stderr, "%s: %s: Output file name clashes with that for %s\n",
+              prog_name, bj->load_path, &*bj->clash_path);
+      context->stats.num_failed++;
+      break;
+
+    case BatchResult_NotInDir:
+      fprintf(stderr, "%s: %s: Path has a parent directory, so can't be "
+              "mirrored in the output directory\n", prog_name, bj->load_path);
+      context->stats.num_failed++;
+      break;
+
+    case BatchResult_DirFail:
+      fprintf(stderr, "%s: %s: Failed to create directory\n", prog_name,
+              bj->save_path);
+      context->stats.num_failed++;
+      break;
+  }
+
+  free(bj);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool claim_save_name(BatchJob *const bj, BatchContext *const context)
+{
+  /* Workers can't be allowed to write the same output file at once, nor
+     can one delete another's output upon failure, so each output file
+     name is claimed before queueing the job that will write it. The file
+     type is ignored because it isn't known until a sprite file has been
+     scanned. */
+  assert(bj != NULL);
+  assert(context != NULL);
+
+  int input_type, output_type;
+  if (!should_convert(bj->load_path, &context->opts, &input_type,
+                      &output_type))
+  {
+    return true;
+  }
+
+  _Optional char const *const save_dir = context->opts.save_dir;
+  if (save_dir && !batchnames_mirror(bj->load_path))
+  {
+    bj->result = BatchResult_NotInDir;
+    return true;
+  }
+
+  if (!batchnames_make_stem(bj->save_path, sizeof(bj->save_path),
+                            bj->load_path, save_dir))
+  {
+    bj->result = BatchResult_Failed;
+    bj->err = SFError_StrOFlo;
+    return true;
+  }
+
+  if (!batchnames_claim(&context->save_names, bj->save_path, bj->load_path,
+                        &bj->clash_path))
+  {
+    return false;
+  }
+
+  if (bj->clash_path != NULL)
+  {
+    bj->result = BatchResult_Clash;
+  }
+  else if (save_dir &&
+           !make_path(bj->save_path, context->opts.make_path_offset))
+  {
+    /* Directories are created on this thread, in the same order as a
+       serial scan, so that workers never race to create them. */
+    bj->result = BatchResult_DirFail;
+  }
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool submit_file(BatchPool *const pool, BatchContext *const context,
+  char const *const load_path)
+{
+  assert(pool != NULL);
+  assert(context != NULL);
+  assert(load_path != NULL);
+
+  _Optional BatchJob *const bj = malloc(sizeof(*bj));
+  if (!bj)
+  {
+    fprintf(stderr, "%s: %s\n", prog_name, error_text(SFError_NoMem));
+    return false;
+  }
+
+  *bj = (BatchJob){.result = BatchResult_Ignored};
+
+  size_t const len = strlen(load_path);
+  if (len >= sizeof(bj->load_path))
+  {
+    /* Still submitted so that the error is reported in order */
+    bj->result = BatchResult_Failed;
+    bj->err = SFError_StrOFlo;
+    memcpy(bj->load_path, load_path, sizeof(bj->load_path) - 1);
+  }
+  else
+  {
+    memcpy(bj->load_path, load_path, len + 1);
+    if (!claim_save_name(&*bj, context))
+    {
+      fprintf(stderr, "%s: %s\n", prog_name, error_text(SFError_NoMem));
+      free(bj);
+      return false;
+    }
+  }
+
+  batchpool_submit(pool, &*bj);
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool submit_list(BatchPool *const pool, BatchContext *const context,
+  FILE *const list)
+{
+  assert(pool != NULL);
+  assert(context != NULL);
+  assert(list != NULL);
+
+  /* One character more than fits in a job, to detect long lines */
+  char line[MaxPathLen + 1];
+  while (fgets(line, sizeof(line), list))
+  {
+    size_t len = strlen(line);
+    if (len == sizeof(line) - 1 && line[len - 1] != '\n')
+    {
+      /* Skip the rest of the line, instead of treating it as another file
+         name. The start of the line is submitted for the error to be
+         reported in order. */
+      int c;
+      do
+      {
+        c = fgetc(list);
+      }
+      while (c != EOF && c != '\n');
+    }
+    else
+    {
+      while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      {
+        line[--len] = '\0';
+      }
+    }
+
+    if (len > 0 && !submit_file(pool, context, line))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool is_dir(char const *const path, bool const follow_link)
+{
+  assert(path != NULL);
+#if defined(_WIN32)
+  DWORD const attr = GetFileAttributesA(path);
+  return attr != INVALID_FILE_ATTRIBUTES &&
+         (attr & FILE_ATTRIBUTE_DIRECTORY) &&
+         (follow_link || !(attr & FILE_ATTRIBUTE_REPARSE_POINT));
+#else
+  struct stat info;
+  return !(follow_link ? stat(path, &info) : lstat(path, &info)) &&
+         S_ISDIR(info.st_mode);
+#endif
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool add_name(DirListing *const listing, char const *const name)
+{
+  assert(listing != NULL);
+  assert(name != NULL);
+
+  if (!strcmp(name, ".") || !strcmp(name, ".."))
+  {
+    return true;
+  }
+
+  if (listing->count == listing->size)
+  {
+    size_t const new_size = listing->size ? listing->size * 2 : MinListingSize;
+    _Optional char **const names = realloc(listing->names,
+                                           new_size * sizeof(*names));
+    if (!names)
+    {
+      return false;
+    }
+    listing->names = &*names;
+    listing->size = new_size;
+  }
+
+  size_t const len = strlen(name);
+  _Optional char *const copy = malloc(len + 1);
+  if (!copy)
+  {
+    return false;
+  }
+  memcpy(&*copy, name, len + 1);
+  listing->names[listing->count++] = &*copy;
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool read_dir(char const *const path, DirListing *const listing)
+{
+  assert(path != NULL);
+  assert(listing != NULL);
+
+  bool ok = true;
+#if defined(_WIN32)
+  size_t const len = strlen(path);
+  _Optional char *const pattern = malloc(len + sizeof("\\*"));
+  if (!pattern)
+  {
+    return false;
+  }
+  sprintf(&*pattern, "%s\\*", path);
+
+  WIN32_FIND_DATAA data;
+  HANDLE const find = FindFirstFileA(&*pattern, &data);
+  free(pattern);
+  if (find == INVALID_HANDLE_VALUE)
+  {
+    return false;
+  }
+
+  do
+  {
+    ok = add_name(listing, data.cFileName);
+  }
+  while (ok && FindNextFileA(find, &data));
+
+  FindClose(find);
+#else
+  _Optional DIR *const dir = opendir(path);
+  if (!dir)
+  {
+    return false;
+  }
+
+  for (_Optional struct dirent *entry = readdir(&*dir);
+       ok && entry != NULL;
+       entry = readdir(&*dir))
+  {
+    ok = add_name(listing, entry->d_name);
+  }
+
+  closedir(&*dir);
+#endif
+  return ok;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int compare_names(void const *const a, void const *const b)
+{
+  /* Same order as a RISC OS directory, which ignores case */
+  char const *const name_a = *(char *const *)a;
+  char const *const name_b = *(char *const *)b;
+
+  for (size_t i = 0; name_a[i] != '\0' || name_b[i] != '\0'; ++i)
+  {
+    int const diff = tolower((unsigned char)name_a[i]) -
+                     tolower((unsigned char)name_b[i]);
+    if (diff)
+    {
+      return diff;
+    }
+  }
+  return strcmp(name_a, name_b);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool submit_tree(BatchPool *const pool, BatchContext *const context,
+  char const *const path, bool const follow_link)
+{
+  /* Submits every file below 'path' in the order of a directory scan,
+     or 'path' itself if it isn't a directory. Links found in a directory
+     are not followed, in case they lead back to the same directory. */
+  assert(pool != NULL);
+  assert(context != NULL);
+  assert(path != NULL);
+
+  if (!is_dir(path, follow_link))
+  {
+    if (!follow_link && is_dir(path, true))
+    {
+      /* Ignore a link to a directory */
+      return true;
+    }
+    return submit_file(pool, context, path);
+  }
+
+  DirListing listing = {.names = NULL};
+  bool ok = read_dir(path, &listing);
+  if (!ok)
+  {
+    fprintf(stderr, "%s: %s: Failed to read directory\n", prog_name, path);
+  }
+  else
+  {
+    qsort(listing.names, listing.count, sizeof(*listing.names),
+          compare_names);
+  }
+
+  size_t const len = strlen(path);
+  bool const add_sep = !is_separator(path[len - 1]);
+
+  for (size_t i = 0; ok && i < listing.count; ++i)
+  {
+    _Optional char *const child = malloc(len + 1 +
+                                         strlen(listing.names[i]) + 1);
+    if (!child)
+    {
+      fprintf(stderr, "%s: %s\n", prog_name, error_text(SFError_NoMem));
+      ok = false;
+    }
+    else
+    {
+      sprintf(&*child, "%s%s%s", path, add_sep ? "/" : "", listing.names[i]);
+      ok = submit_tree(pool, context, &*child, false);
+      free(child);
+    }
+  }
+
+  for (size_t i = 0; i < listing.count; ++i)
+  {
+    free(listing.names[i]);
+  }
+  free(listing.names);
+  return ok;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int parse_type(char const *const name)
+{
+  static const struct
+  {
+    char const *name;
+    int file_type;
+  }
+  types[] =
+  {
+    { "tiles", FileType_SFMapGfx },
+    { "planets", FileType_SFSkyPic },
+    { "sky", FileType_SFSkyCol },
+    { "sprite", FileType_Sprite },
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE(types); ++i)
+  {
+    if (!strcmp(name, types[i].name))
+    {
+      return types[i].file_type;
+    }
+  }
+  return FileType_Null;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void usage(void)
+{
+  fprintf(stderr,
+    "Usage: %s [options] file...\n"
+    "Convert Star Fighter 3000 graphics files to or from sprite files.\n"
+    "Every file below a named directory is converted.\n"
+    "A file name of - reads a list of file names from the standard input.\n"
+    "Options:\n"
+    "  -i        Extract images from game files to sprite files\n"
+    "  -j n      Convert up to n files at once\n"
+    "  -d        Extract data from game files (to CSV files unless -i)\n"
+    "  -o dir    Write output files in the equivalent place in the given\n"
+    "            directory (instead of alongside the input files)\n"
+    "  -t type   Treat input files as tiles, planets, sky or sprite\n"
+    "  -v        Report the progress of each file\n"
+    "Without -i or -d, sprite files are converted to game files.\n"
+    "Otherwise, file types are taken from ',xxx' file name suffixes.\n",
+    prog_name);
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+int main(int argc, char *argv[])
+{
+  BatchContext context = {.opts = {.force_type = FileType_Null}};
+  BatchOptions *const opts = &context.opts;
+  int nthreads = 0;
+
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'; ++arg)
+  {
+    char const *const opt = argv[arg];
+    if (!strcmp(opt, "-i"))
+    {
+      opts->extract_images = true;
+    }
+    else if (!strcmp(opt, "-d"))
+    {
+      opts->extract_data = true;
+    }
+    else if (!strcmp(opt, "-v"))
+    {
+      opts->verbose = true;
+    }
+    else if (!strcmp(opt, "-o") && arg + 1 < argc)
+    {
+      opts->save_dir = trim_separators(argv[++arg]);
+    }
+    else if (!strcmp(opt, "-t") && arg + 1 < argc)
+    {
+      opts->force_type = parse_type(argv[++arg]);
+      if (opts->force_type == FileType_Null)
+      {
+        usage();
+        return EXIT_FAILURE;
+      }
+    }
+    else if (!strcmp(opt, "-j") && arg + 1 < argc)
+    {
+      char *endp;
+      long int const n = strtol(argv[++arg], &endp, 10);
+      if (*endp != '\0' || n < 1 || n > INT_MAX)
+      {
+        usage();
+        return EXIT_FAILURE;
+      }
+      /* The main thread only feeds the queue and reports results */
+      nthreads = n > 1 ? (int)n : 0;
+    }
+    else if (!strcmp(opt, "--"))
+    {
+      ++arg;
+      break;
+    }
+    else
+    {
+      usage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (arg >= argc)
+  {
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  if (opts->save_dir)
+  {
+    /* We want to create the output directory and all of its descendants
+       but not any of its ancestors.
+     e.g. save_dir = "/tmp/Sprites", last_sep = "/Sprites", make_path_offset = 5
+          makes "/tmp/Sprites" and any descendants */
+    char const *last_sep = NULL;
+    for (char const *p = opts->save_dir; *p != '\0'; ++p)
+    {
+      if (is_separator(*p))
+      {
+        last_sep = p;
+      }
+    }
+    opts->make_path_offset = (last_sep == NULL) ? 0 : last_sep - opts->save_dir + 1;
+  }
+
+  batchnames_init(&context.save_names);
+
+  _Optional BatchPool *const pool = batchpool_create(nthreads,
+    (size_t)(nthreads > 0 ? nthreads * QueueSlotsPerThread : 1),
+    convert_file, report_file, &context);
+  if (!pool)
+  {
+    fprintf(stderr, "%s: %s\n", prog_name, error_text(SFError_NoMem));
+    batchnames_destroy(&context.save_names);
+    return EXIT_FAILURE;
+  }
+
+  bool ok = true;
+  for (; ok && arg < argc; ++arg)
+  {
+    if (!strcmp(argv[arg], "-"))
+    {
+      ok = submit_list(&*pool, &context, stdin);
+    }
+    else
+    {
+      ok = submit_tree(&*pool, &context, argv[arg], true);
+    }
+  }
+
+  /* Waits for outstanding conversions to finish */
+  batchpool_destroy(pool);
+  batchnames_destroy(&context.save_names);
+
+  if (opts->verbose)
+  {
+    printf("%lu files checked, %lu output, %lu failed\n",
+           context.stats.num_checked, context.stats.num_output,
+           context.stats.num_failed);
+  }
+
+  return !ok || context.stats.num_failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
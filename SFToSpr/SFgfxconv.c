@@ -32,14 +32,17 @@
 
 /* My library files */
 #include "Macros.h"
-#include "CSV.h"
 #include "Debug.h"
 #include "Reader.h"
 #include "Writer.h"
+#include "ReaderMem.h"
+#include "WriterMem.h"
+#include "WriterNull.h"
 #include "SprFormats.h"
 
 /* Local headers */
 #include "Utils.h"
+#include "CSVReader.h"
 #include "SFgfxconv.h"
 #include "SFError.h"
 
@@ -65,7 +68,6 @@
 /* Constant numeric values */
 enum
 {
-  CSVBufferSize = 256,
   SprAreaHdrSize = sizeof(int32_t) * 4,
   SprHdrSize = sizeof(int32_t) * 11,
   SpriteType = 13, /* Mode number */
@@ -87,6 +89,8 @@ enum
   SkyRenderMax = 2048,
   SkyStarsMin = -32768,
   SkyStarsMax = 2048,
+  BitmapBufferMin = 1024,
+  BitmapBufferStart = sizeof(int32_t), /* because offset 0 means no sprite */
 };
 
 typedef struct
@@ -106,6 +110,19 @@ SFSpriteHeader;
 /* ----------------------------------------------------------------------- */
 /*                         Private functions                               */
 
+static inline int32_t read_int32le(uint8_t const *const bytes)
+{
+  assert(bytes);
+  uint32_t const value = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+                         ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+
+  /* Avoid implementation-defined conversion of out-of-range values */
+  return value > INT32_MAX ? -(int32_t)(UINT32_MAX - value) - 1 :
+                             (int32_t)value;
+}
+
+/* ----------------------------------------------------------------------- */
+
 static inline bool sprite_type_has_8_bpp(int32_t const sprite_type)
 {
   bool has_8_bpp = false;
@@ -170,6 +187,44 @@ static void write_sprite_area_hdr(int32_t const sprite_count,
 
 /* ----------------------------------------------------------------------- */
 
+static long int sprite_area_size(int32_t const sprite_count,
+  int32_t const ext_data_size, int32_t const sprite_size)
+{
+  assert(sprite_count >= 0);
+  assert(ext_data_size >= 0);
+  assert(sprite_size >= SprHdrSize);
+
+  /* Must match what write_sprite_area_hdr writes. The first word of a
+     sprite area isn't stored in files. */
+  long int const size = SprAreaHdrSize - (long)sizeof(int32_t) + ext_data_size +
+                        ((long)sprite_count * sprite_size);
+  DEBUGF("Expected sprite file size is %ld (%" PRId32 " sprites)\n",
+         size, sprite_count);
+  return size;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError csv_size(SFError (*const to_csv)(Reader *, Writer *),
+  Reader *const reader, long int *const size)
+{
+  assert(to_csv);
+  assert(size);
+
+  /* CSV output depends only on the header, so this is cheap */
+  Writer writer;
+  writer_null_init(&writer);
+  SFError const err = to_csv(reader, &writer);
+  *size = writer_destroy(&writer);
+  if (err == SFError_OK && *size < 0)
+  {
+    return SFError_WriteFail;
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
 static void write_spr_header(int32_t const sprite_size, char const *const name,
   int32_t const w, int32_t const h, Writer *const writer)
 {
@@ -203,6 +258,29 @@ static SFError read_fail(Reader *const reader)
 
 /* ----------------------------------------------------------------------- */
 
+static void flip_bitmap(uint8_t *const bitmap, int const awidth,
+  int const height)
+{
+  assert(bitmap);
+  assert(awidth > 0);
+  assert(height > 0);
+
+  /* Swap rows from the top and bottom inwards. The inner loop has no
+     dependencies between iterations so compilers can vectorise it. */
+  uint8_t *top = bitmap, *bottom = bitmap + ((height - 1) * awidth);
+  for (; top < bottom; top += awidth, bottom -= awidth)
+  {
+    for (int x = 0; x < awidth; ++x)
+    {
+      uint8_t const pixel = top[x];
+      top[x] = bottom[x];
+      bottom[x] = pixel;
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
 static inline SFError copy_n_flip(Reader *const reader, Writer *const writer,
   uint8_t *const tmp, int const width, int const height)
 {
@@ -216,15 +294,10 @@ static inline SFError copy_n_flip(Reader *const reader, Writer *const writer,
     return read_fail(reader);
   }
 
-  /* Append the raw bitmap to the output sprite, one row at a time
-     (same pixel format etc).
-     Note that the bitmap is flipped vertically during copying. */
-  uint8_t *src = tmp + size;
-  for (int row = 0; row < height && !writer_ferror(writer); ++row)
-  {
-    src -= awidth;
-    writer_fwrite(src, awidth, 1, writer);
-  }
+  /* Append the raw bitmap to the output sprite (same pixel format etc).
+     Note that the bitmap is flipped vertically before copying. */
+  flip_bitmap(tmp, awidth, height);
+  writer_fwrite(tmp, size, 1, writer);
 
   return SFError_OK;
 }
@@ -613,6 +686,35 @@ static void write_planets_coords(PlanetsHeader const *const hdr,
 
 /* ----------------------------------------------------------------------- */
 
+static inline bool image_offset_valid(int32_t const offset)
+{
+  return offset >= PlanetHeaderSize &&
+         offset <= PlanetFileSizeMax - PlanetBitmapSize;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static inline bool images_overlap(int32_t const offset_1, int32_t const offset_2)
+{
+  return offset_1 < offset_2 + PlanetBitmapSize &&
+         offset_2 < offset_1 + PlanetBitmapSize;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool planets_overlap(PlanetsBitmapOffset const *const planet_1,
+                            PlanetsBitmapOffset const *const planet_2)
+{
+  assert(planet_1);
+  assert(planet_2);
+  return images_overlap(planet_1->image_A, planet_2->image_A) ||
+         images_overlap(planet_1->image_A, planet_2->image_B) ||
+         images_overlap(planet_1->image_B, planet_2->image_A) ||
+         images_overlap(planet_1->image_B, planet_2->image_B);
+}
+
+/* ----------------------------------------------------------------------- */
+
 static SFError read_planets_hdr(PlanetsHeader *const hdr, Reader *const reader)
 {
   assert(hdr);
@@ -655,8 +757,6 @@ static SFError read_planets_hdr(PlanetsHeader *const hdr, Reader *const reader)
     return SFError_BadSeek;
   }
 
-  int32_t min_offset = PlanetHeaderSize;
-
   for (int32_t i = 0; i <= hdr->last_image_num; i++)
   {
     if (!reader_fread_int32(&hdr->data_offsets[i].image_A, reader) ||
@@ -669,27 +769,25 @@ static SFError read_planets_hdr(PlanetsHeader *const hdr, Reader *const reader)
     DEBUGF("Data offsets for image %" PRId32 " are %" PRId32 ",%" PRId32 "\n", i,
            hdr->data_offsets[i].image_A, hdr->data_offsets[i].image_B);
 
-    if (hdr->data_offsets[i].image_A < min_offset)
-    {
-      return SFError_BadDataOff;
-    }
-
-    if (hdr->data_offsets[i].image_B < PlanetBitmapSize)
+    if (!image_offset_valid(hdr->data_offsets[i].image_A) ||
+        !image_offset_valid(hdr->data_offsets[i].image_B))
     {
       return SFError_BadDataOff;
     }
 
-    if (hdr->data_offsets[i].image_B - PlanetBitmapSize < hdr->data_offsets[i].image_A)
+    /* Images may be stored in any order but must not overlap */
+    if (images_overlap(hdr->data_offsets[i].image_A, hdr->data_offsets[i].image_B))
     {
       return SFError_BadDataOff;
     }
 
-    if (hdr->data_offsets[i].image_B > PlanetFileSizeMax - PlanetBitmapSize)
+    for (int32_t j = 0; j < i; j++)
     {
-      return SFError_BadDataOff;
+      if (planets_overlap(&hdr->data_offsets[i], &hdr->data_offsets[j]))
+      {
+        return SFError_BadDataOff;
+      }
     }
-
-    min_offset = hdr->data_offsets[i].image_B + PlanetBitmapSize;
   }
 
   return SFError_OK;
@@ -713,10 +811,9 @@ static inline void write_planets_hdr(PlanetsHeader const *const hdr, Writer *con
           hdr->data_offsets[i].image_A,
           hdr->data_offsets[i].image_B);
 
-    assert(hdr->data_offsets[i].image_A >= PlanetHeaderSize);
-    assert(hdr->data_offsets[i].image_B >= PlanetHeaderSize + PlanetBitmapSize);
-    assert(hdr->data_offsets[i].image_A <= hdr->data_offsets[i].image_B - PlanetBitmapSize);
-    assert(hdr->data_offsets[i].image_B <= PlanetFileSizeMax - PlanetBitmapSize);
+    assert(image_offset_valid(hdr->data_offsets[i].image_A));
+    assert(image_offset_valid(hdr->data_offsets[i].image_B));
+    assert(!images_overlap(hdr->data_offsets[i].image_A, hdr->data_offsets[i].image_B));
 
     writer_fwrite_int32(hdr->data_offsets[i].image_A, writer);
     writer_fwrite_int32(hdr->data_offsets[i].image_B, writer);
@@ -781,51 +878,15 @@ static inline void write_planets_ext(PlanetsHeader const *const hdr, Writer *con
 
 /* ----------------------------------------------------------------------- */
 
-static inline SFError planet_to_sprite(Reader *const reader, Writer *const writer,
-                                       PlanetsHeader const *const hdr,
-                                       uint8_t *const tmp, int32_t const i)
+static bool check_planet_images(uint8_t const *image_A,
+                                uint8_t const *image_B)
 {
-  assert(hdr);
-  assert(tmp);
-  assert(i >= 0);
-  assert(i <= PlanetMax);
-
-  char numstr[16];
-  char name[sizeof PLANET_SPR_NAME - 1 + sizeof numstr] = PLANET_SPR_NAME;
-  int nout = sprintf(numstr, "%" PRId32, i);
-  assert(nout >= 0); /* no formatting error */
-  NOT_USED(nout);
-  strncat(name, numstr, sizeof(name) - strlen(name) - 1);
-  DEBUGF("Sprite name is %s\n", name);
-
-  write_spr_header(PlanetSprSize, name, PlanetSprWidth, PlanetHeight, writer);
-
-  assert(hdr->data_offsets[i].image_A >= PlanetHeaderSize);
-  assert(hdr->data_offsets[i].image_A <= hdr->data_offsets[i].image_B);
-  if (reader_fseek(reader, hdr->data_offsets[i].image_A, SEEK_SET))
-  {
-    return SFError_BadSeek;
-  }
+  assert(image_A);
+  assert(image_B);
 
-  if (!reader_fread(tmp, PlanetBitmapSize, 1, reader))
-  {
-    return read_fail(reader);
-  }
-
-  assert(hdr->data_offsets[i].image_B >= PlanetHeaderSize + PlanetBitmapSize);
-  assert(hdr->data_offsets[i].image_B - PlanetBitmapSize >= hdr->data_offsets[i].image_A);
-  assert(hdr->data_offsets[i].image_B <= PlanetFileSizeMax - PlanetBitmapSize);
-  if (reader_fseek(reader, hdr->data_offsets[i].image_B, SEEK_SET))
-  {
-    return SFError_BadSeek;
-  }
-
-  /* Copy raw bitmap image to sprite area, one row at a time
-     (same pixel format etc) */
-  const uint8_t *image_A = tmp;
-  for (int row = 0;
-       row < PlanetHeight && !writer_ferror(writer);
-       row++, image_A += WORD_ALIGN(PlanetWidth))
+  for (int row = 0; row < PlanetHeight;
+       row++, image_A += WORD_ALIGN(PlanetWidth),
+       image_B += WORD_ALIGN(PlanetWidth))
   {
     /* Check that the two copies of the image bitmap are identical except
        for their alignment, and that two pixel columns on the righthand
@@ -854,72 +915,138 @@ static inline SFError planet_to_sprite(Reader *const reader, Writer *const write
     if (pce)
     {
       DEBUGF("Penultimate Column Error on row %d\n", row);
-      return SFError_BadImages;
+      return false;
     }
 
-    uint8_t image_B[WORD_ALIGN(PlanetWidth)];
-    if (!reader_fread(image_B, sizeof(image_B), 1, reader))
-    {
-      return read_fail(reader);
-    }
     DEBUG("First two pixels of image B on row %d are %d,%d", row, image_B[0], image_B[1]);
 
     if (image_B[0] != 0 || image_B[1] != 0 || image_A[PlanetWidth - 1] != 0 ||
         memcmp(image_A, image_B + PlanetMargin, PlanetSprWidth))
     {
-      return SFError_BadImages;
+      return false;
     }
+  }
+
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static inline SFError planet_to_sprite(Reader *const reader, Writer *const writer,
+                                       PlanetsHeader const *const hdr,
+                                       uint8_t *const image_A,
+                                       uint8_t *const image_B, int32_t const i)
+{
+  assert(hdr);
+  assert(image_A);
+  assert(image_B);
+  assert(i >= 0);
+  assert(i <= PlanetMax);
+
+  char numstr[16];
+  char name[sizeof PLANET_SPR_NAME - 1 + sizeof numstr] = PLANET_SPR_NAME;
+  int nout = sprintf(numstr, "%" PRId32, i);
+  assert(nout >= 0); /* no formatting error */
+  NOT_USED(nout);
+  strncat(name, numstr, sizeof(name) - strlen(name) - 1);
+  DEBUGF("Sprite name is %s\n", name);
+
+  write_spr_header(PlanetSprSize, name, PlanetSprWidth, PlanetHeight, writer);
+
+  assert(image_offset_valid(hdr->data_offsets[i].image_A));
+  assert(image_offset_valid(hdr->data_offsets[i].image_B));
+  assert(!images_overlap(hdr->data_offsets[i].image_A, hdr->data_offsets[i].image_B));
+  if (reader_fseek(reader, hdr->data_offsets[i].image_A, SEEK_SET))
+  {
+    return SFError_BadSeek;
+  }
+
+  if (!reader_fread(image_A, PlanetBitmapSize, 1, reader))
+  {
+    return read_fail(reader);
+  }
+
+  if (reader_fseek(reader, hdr->data_offsets[i].image_B, SEEK_SET))
+  {
+    return SFError_BadSeek;
+  }
+
+  if (!reader_fread(image_B, PlanetBitmapSize, 1, reader))
+  {
+    return read_fail(reader);
+  }
 
-    /* The first copy of the image is left-aligned, so we just
-       chop the last two pixels off each row */
-    writer_fwrite(tmp + (row * WORD_ALIGN(PlanetSprWidth)),
-                  WORD_ALIGN(PlanetSprWidth), 1, writer);
+  if (!check_planet_images(image_A, image_B))
+  {
+    return SFError_BadImages;
   }
 
+  /* Copy raw bitmap image to sprite area (same pixel format etc).
+     The first copy of the image is left-aligned and its rows are padded to
+     the same length as those of the sprite, so it can be copied as is. */
+  assert(WORD_ALIGN(PlanetSprWidth) == WORD_ALIGN(PlanetWidth));
+  writer_fwrite(image_A, PlanetSprBitmapSize, 1, writer);
+
   return SFError_OK;
 }
 
 /* ----------------------------------------------------------------------- */
 
+static void make_planet_image(uint8_t *const dst, uint8_t const *const src,
+                              int const margin)
+{
+  assert(dst);
+  assert(src);
+  assert(margin == 0 || margin == PlanetMargin);
+
+  /* Black out the unused columns on whichever side of the image isn't
+     occupied by the sprite. */
+  memset(dst, 0, PlanetBitmapSize);
+  for (int row = 0; row < PlanetHeight; row++)
+  {
+    memcpy(dst + (row * WORD_ALIGN(PlanetWidth)) + margin,
+           src + (row * WORD_ALIGN(PlanetSprWidth)), PlanetSprWidth);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
 static inline SFError sprite_to_planet(Writer *const writer,
-                                PlanetsHeader const *const hdr, uint8_t *const tmp,
-                                int const i)
+                                PlanetsHeader const *const hdr,
+                                uint8_t const *const tmp, uint8_t *const image,
+                                int const i, long int *const end)
 {
   assert(hdr);
   assert(tmp);
+  assert(image);
+  assert(end);
   assert(i >= 0);
   assert(i <= PlanetMax);
   assert((unsigned)i < ARRAY_SIZE(hdr->data_offsets));
 
-  /* Beware of seeking too far ahead because the compressor will zero-fill instead of failing */
-  assert(hdr->data_offsets[i].image_A >= PlanetHeaderSize);
-  assert(hdr->data_offsets[i].image_A <= hdr->data_offsets[i].image_B);
+  /* We make two copies of the input sprite; one word-aligned and the
+     other half-word aligned. Each is built in full before being written. */
+
+  /* The images may be at any offsets that don't overlap. A compressed
+     stream can't be rewound, so unless the images are contiguous and in
+     order the file must be assembled in memory first (as
+     sprites_to_planets does). Offsets made by scanning a sprite file are
+     always in order. */
+  assert(image_offset_valid(hdr->data_offsets[i].image_A));
+  assert(image_offset_valid(hdr->data_offsets[i].image_B));
+  assert(!images_overlap(hdr->data_offsets[i].image_A, hdr->data_offsets[i].image_B));
   writer_fseek(writer, hdr->data_offsets[i].image_A, SEEK_SET);
   /* Do not use BadSeek, which is reserved for read errors! */
 
-  /* We make two copies of the input sprite; one word-aligned and the
-     other half-word aligned. This requires copying one row at a time.
-   */
-  static uint8_t margin[PlanetMargin] = {0};
-  for (int row = 0; row < PlanetHeight && !writer_ferror(writer); row++)
-  {
-    /* The first copy of the image is word-aligned */
-    writer_fwrite(tmp + (row * WORD_ALIGN(PlanetSprWidth)), PlanetSprWidth, 1, writer);
-    writer_fwrite(margin, sizeof(margin), 1, writer);
-  }
+  make_planet_image(image, tmp, 0);
+  writer_fwrite(image, PlanetBitmapSize, 1, writer);
+  *end = HIGHEST(*end, writer_ftell(writer));
 
-  /* Beware of seeking too far ahead because the compressor will zero-fill instead of failing */
-  assert(hdr->data_offsets[i].image_B >= PlanetHeaderSize + PlanetBitmapSize);
-  assert(hdr->data_offsets[i].image_B - PlanetBitmapSize >= hdr->data_offsets[i].image_A);
-  assert(hdr->data_offsets[i].image_B <= PlanetFileSizeMax - PlanetBitmapSize);
   writer_fseek(writer, hdr->data_offsets[i].image_B, SEEK_SET);
 
-  for (int row = 0; row < PlanetHeight && !writer_ferror(writer); row++)
-  {
-    /* The second copy of the image is half-word aligned */
-    writer_fwrite(margin, sizeof(margin), 1, writer);
-    writer_fwrite(tmp + (row * WORD_ALIGN(PlanetSprWidth)), PlanetSprWidth, 1, writer);
-  }
+  make_planet_image(image, tmp, PlanetMargin);
+  writer_fwrite(image, PlanetBitmapSize, 1, writer);
+  *end = HIGHEST(*end, writer_ftell(writer));
 
   return SFError_OK;
 }
@@ -983,7 +1110,7 @@ static SFError planets_to_sprites_conv(ConvertIter *const iter)
 
   PlanetsToSpritesIter *const sub = CONTAINER_OF(iter, PlanetsToSpritesIter, super);
   return planet_to_sprite(iter->reader, iter->writer, &sub->hdr,
-                          sub->tmp, iter->pos);
+                          sub->tmp, sub->tmp_B, iter->pos);
 }
 
 /* ----------------------------------------------------------------------- */
@@ -1021,13 +1148,15 @@ static SFError sprites_to_planets_conv(ConvertIter *const iter)
   }
 
   err = sprite_to_planet(iter->writer, &sub->hdr,
-                         sub->tmp, iter->pos);
+                         sub->tmp, sub->image, iter->pos, &sub->end);
 
   if (err == SFError_OK && iter->pos == iter->count - 1)
   {
-    DEBUGF("Final file position is %ld\n", writer_ftell(iter->writer));
+    /* The images needn't be in order, so the final file position isn't
+       necessarily the end of the file */
+    DEBUGF("End of file is %ld\n", sub->end);
     assert(writer_ferror(iter->writer) ||
-           writer_ftell(iter->writer) == planets_size(&sub->hdr));
+           sub->end == planets_size(&sub->hdr));
   }
 
   return err;
@@ -1287,23 +1416,25 @@ static inline SFError all_ext_parser(ScanSpritesContext *const context, int32_t
 
 static inline SFError all_sprite_identifier(
   SFSpriteHeader const *const sph, long int const fpos,
-  ScanSpritesContext *const context)
+  ScanSpritesContext *const context, long int *const bitmap_size)
 {
   assert(context);
   assert(sph);
+  assert(bitmap_size);
   DEBUGF("Identifying sprite %s\n", sph->name);
 
   static struct
   {
     int width;
     int height;
+    long int bitmap_size;
     bool (*sprite_identifier)(long int, char const *name, ScanSpritesContext *);
   }
   const data_types[] =
   {
-    {MapTileWidth, MapTileHeight, tiles_sprite_identifier},
-    {PlanetSprWidth, PlanetHeight, planets_sprite_identifier},
-    {SkyWidth, SkyHeight, sky_sprite_identifier},
+    {MapTileWidth, MapTileHeight, MapTileBitmapSize, tiles_sprite_identifier},
+    {PlanetSprWidth, PlanetHeight, PlanetSprBitmapSize, planets_sprite_identifier},
+    {SkyWidth, SkyHeight, SkyBitmapSize, sky_sprite_identifier},
   };
 
   for (size_t i = 0; i < ARRAY_SIZE(data_types); ++i)
@@ -1311,10 +1442,12 @@ static inline SFError all_sprite_identifier(
     if (sprite_has_dims(sph, data_types[i].width, data_types[i].height) &&
         data_types[i].sprite_identifier(fpos, sph->name, context))
     {
+      *bitmap_size = data_types[i].bitmap_size;
       return SFError_OK;
     }
   }
 
+  *bitmap_size = 0;
   if (!context->bad_sprite)
   {
     context->bad_sprite = true;
@@ -1326,49 +1459,118 @@ static inline SFError all_sprite_identifier(
 
 /* ----------------------------------------------------------------------- */
 
-static inline SFError scan_sprite(Reader *const reader, ScanSpritesContext *const context)
+static bool reserve_bitmaps(SpriteBitmapBuffer *const bitmaps,
+  long int const extra)
 {
-  long int const sp_start = reader_ftell(reader);
-  if (sp_start < 0)
+  assert(bitmaps);
+  assert(bitmaps->size >= 0);
+  assert(bitmaps->capacity >= bitmaps->size);
+  assert(extra >= 0);
+
+  if (extra <= bitmaps->capacity - bitmaps->size)
   {
-    return SFError_BadTell;
+    return true;
   }
 
-  SFSpriteHeader sph = {0};
-  if (!reader_fread_int32(&sph.size, reader))
+  long int capacity = HIGHEST(bitmaps->capacity * 2, BitmapBufferMin);
+  while (extra > capacity - bitmaps->size)
   {
-    return read_fail(reader);
+    capacity *= 2;
+  }
+
+  _Optional uint8_t *const data = realloc(bitmaps->data, (size_t)capacity);
+  if (!data)
+  {
+    return false;
+  }
+
+  DEBUGF("Sprite bitmap buffer grown from %ld to %ld bytes\n",
+         bitmaps->capacity, capacity);
+  bitmaps->data = data;
+  bitmaps->capacity = capacity;
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SFError buffer_bitmap(Reader *const reader, long int const fpos,
+  long int const bitmap_size, SpriteBitmapBuffer *const bitmaps)
+{
+  assert(bitmaps);
+  assert(bitmap_size > 0);
+
+  if (!reserve_bitmaps(bitmaps, bitmap_size))
+  {
+    return SFError_NoMem;
+  }
+
+  DEBUGF("Buffering %ld bytes at offset %ld\n", bitmap_size, fpos);
+  if (reader_fseek(reader, fpos, SEEK_SET))
+  {
+    return SFError_BadSeek;
   }
 
-  if (!reader_fread(&sph.name, sizeof(sph.name) - 1, 1, reader))
+  assert(bitmaps->data);
+  if (!reader_fread(&bitmaps->data[bitmaps->size], (size_t)bitmap_size, 1,
+                    reader))
   {
     return read_fail(reader);
   }
-  DEBUGF("Sprite '%s' has length of %" PRId32 " bytes\n", sph.name, sph.size);
 
-  if (!reader_fread_int32(&sph.width, reader) ||
-      !reader_fread_int32(&sph.height, reader) ||
-      !reader_fread_int32(&sph.left_bit, reader) ||
-      !reader_fread_int32(&sph.right_bit, reader) ||
-      !reader_fread_int32(&sph.image, reader) ||
-      !reader_fread_int32(&sph.mask, reader) ||
-      !reader_fread_int32(&sph.type, reader))
+  bitmaps->size += bitmap_size;
+  return SFError_OK;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static inline SFError scan_sprite(Reader *const reader,
+  ScanSpritesContext *const context, _Optional SpriteBitmapBuffer *const bitmaps)
+{
+  long int const sp_start = reader_ftell(reader);
+  if (sp_start < 0)
+  {
+    return SFError_BadTell;
+  }
+
+  /* Read the whole header at once rather than field by field, since this
+     is called for every sprite in a file. */
+  uint8_t hdr[SprHdrSize];
+  if (!reader_fread(hdr, sizeof(hdr), 1, reader))
   {
     return read_fail(reader);
   }
 
+  SFSpriteHeader sph = {.size = read_int32le(hdr)};
+  memcpy(sph.name, hdr + sizeof(int32_t), sizeof(sph.name) - 1);
+  DEBUGF("Sprite '%s' has length of %" PRId32 " bytes\n", sph.name, sph.size);
+
+  uint8_t const *const fields = hdr + sizeof(int32_t) + sizeof(sph.name) - 1;
+  sph.width = read_int32le(fields);
+  sph.height = read_int32le(fields + sizeof(int32_t));
+  sph.left_bit = read_int32le(fields + sizeof(int32_t) * 2);
+  sph.right_bit = read_int32le(fields + sizeof(int32_t) * 3);
+  sph.image = read_int32le(fields + sizeof(int32_t) * 4);
+  sph.mask = read_int32le(fields + sizeof(int32_t) * 5);
+  sph.type = read_int32le(fields + sizeof(int32_t) * 6);
+
   if ((sph.image < SprHdrSize) || (sph.image > sph.size) ||
       (sph.mask < sph.image) || (sph.mask > sph.size))
   {
     return SFError_BadDataOff;
   }
 
-  if (reader_fseek(reader, sp_start + sph.image, SEEK_SET))
+  /* If buffering, record where the bitmap will be in the buffer instead of
+     where it is in the file. */
+  long int const image_pos = sp_start + sph.image;
+  long int bitmap_size = 0;
+  SFError err = all_sprite_identifier(&sph,
+    bitmaps ? bitmaps->size : image_pos, context, &bitmap_size);
+
+  if (err == SFError_OK && bitmaps && bitmap_size > 0)
   {
-    return SFError_BadSeek;
+    err = buffer_bitmap(reader, image_pos, bitmap_size, &*bitmaps);
   }
 
-  SFError const err = all_sprite_identifier(&sph, sp_start + sph.image, context);
   if (err != SFError_OK)
   {
     return err;
@@ -1396,7 +1598,7 @@ static SFError scan_sprites_conv(ConvertIter *const iter)
   Reader *const reader = iter->reader;
   ScanSpritesContext *const context = sub->context;
 
-  SFError err = scan_sprite(reader, context);
+  SFError err = scan_sprite(reader, context, sub->bitmaps);
   if (err == SFError_OK && iter->pos == (iter->count - 1))
   {
     if (context->tiles.hdr.last_tile_num >= 0 &&
@@ -1429,6 +1631,40 @@ SFError convert_advance(ConvertIter *const iter)
 
 /* ----------------------------------------------------------------------- */
 
+SFError convert_advance_budget(ConvertIter *const iter, int32_t const max_items,
+  _Optional volatile bool const *const time_up)
+{
+  assert(iter);
+  assert(max_items > 0);
+
+  SFError err = SFError_OK;
+  int32_t const end = iter->count - iter->pos > max_items ?
+                      iter->pos + max_items : iter->count;
+  while (iter->pos < end)
+  {
+    err = iter->convert(iter);
+    ++iter->pos;
+
+    if (err != SFError_OK ||
+        (iter->writer && writer_ferror(iter->writer)) ||
+        (time_up && *time_up))
+    {
+      break;
+    }
+  }
+
+  DEBUG_VERBOSEF("Read position: %ld\nWrite position: %ld\n",
+     reader_ftell(iter->reader), iter->writer ? writer_ftell(iter->writer) : 0);
+
+  if (err == SFError_OK && iter->pos >= iter->count)
+  {
+    err = SFError_Done;
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
 SFError convert_finish(ConvertIter *const iter)
 {
   assert(iter);
@@ -1457,6 +1693,7 @@ SFError scan_sprite_file_init(ScanSpritesIter *const iter, Reader *const reader,
     .convert = scan_sprites_conv,
   };
   iter->context = context;
+  iter->bitmaps = NULL;
 
   *context = (ScanSpritesContext){ .tiles = { .count = 0 } };
 
@@ -1504,6 +1741,30 @@ SFError scan_sprite_file_init(ScanSpritesIter *const iter, Reader *const reader,
 
 /* ----------------------------------------------------------------------- */
 
+SFError scan_sprite_file_buffered_init(ScanSpritesIter *const iter,
+  Reader *const reader, ScanSpritesContext *const context,
+  SpriteBitmapBuffer *const bitmaps)
+{
+  assert(bitmaps);
+
+  /* Keep any memory allocated for the previous file */
+  bitmaps->size = 0;
+  if (!reserve_bitmaps(bitmaps, BitmapBufferStart))
+  {
+    return SFError_NoMem;
+  }
+
+  assert(bitmaps->data);
+  memset(&*bitmaps->data, 0, BitmapBufferStart);
+  bitmaps->size = BitmapBufferStart;
+
+  SFError const err = scan_sprite_file_init(iter, reader, context);
+  iter->bitmaps = bitmaps;
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
 SFError scan_sprite_file(Reader *const reader, ScanSpritesContext *const context)
 {
   _Optional ScanSpritesIter *const iter = malloc(sizeof(*iter));
@@ -1523,6 +1784,54 @@ SFError scan_sprite_file(Reader *const reader, ScanSpritesContext *const context
 
 /* ----------------------------------------------------------------------- */
 
+SFError scan_sprite_file_buffered(Reader *const reader,
+  ScanSpritesContext *const context, SpriteBitmapBuffer *const bitmaps)
+{
+  _Optional ScanSpritesIter *const iter = malloc(sizeof(*iter));
+  if (!iter)
+  {
+    return SFError_NoMem;
+  }
+
+  SFError err = scan_sprite_file_buffered_init(&*iter, reader, context, bitmaps);
+  if (err == SFError_OK)
+  {
+    err = convert_finish(&iter->super);
+  }
+  free(iter);
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void sprite_bitmap_buffer_init(SpriteBitmapBuffer *const bitmaps)
+{
+  assert(bitmaps);
+  *bitmaps = (SpriteBitmapBuffer){.data = NULL};
+}
+
+/* ----------------------------------------------------------------------- */
+
+void sprite_bitmap_buffer_destroy(SpriteBitmapBuffer *const bitmaps)
+{
+  assert(bitmaps);
+  free(bitmaps->data);
+  *bitmaps = (SpriteBitmapBuffer){.data = NULL};
+}
+
+/* ----------------------------------------------------------------------- */
+
+bool sprite_bitmap_buffer_reader_init(Reader *const reader,
+  SpriteBitmapBuffer const *const bitmaps)
+{
+  assert(bitmaps);
+  assert(bitmaps->size >= BitmapBufferStart);
+  assert(bitmaps->data);
+  return reader_mem_init(reader, &*bitmaps->data, (size_t)bitmaps->size);
+}
+
+/* ----------------------------------------------------------------------- */
+
 int count_spr_types(ScanSpritesContext const *const context)
 {
   assert(context);
@@ -1592,20 +1901,13 @@ SFError csv_to_tiles(Reader *const reader, MapTilesHeader * const hdr)
   DEBUG("Will copy animations from a CSV file anchored to a map"
         " graphics header %p", (void *)hdr);
 
-  char csv_buffer[CSVBufferSize];
-  size_t const n = reader_fread(csv_buffer, 1, sizeof(csv_buffer), reader);
-  if (n >= sizeof(csv_buffer))
-  {
-    return SFError_StrOFlo;
-  }
-  csv_buffer[n] = '\0';
-  _Optional char *text_ptr = csv_buffer;
+  CSVReader csv;
+  csvreader_init(&csv, reader);
 
   int array[ARRAY_SIZE(hdr->splash_anim_1)];
 
   DEBUG("Reading 1st splash animation");
-  size_t num_fields = csv_parse_string(&*text_ptr, &text_ptr, array,
-                                       CSVOutputType_Int, ARRAY_SIZE(array));
+  size_t num_fields = csvreader_read_ints(&csv, array, ARRAY_SIZE(array));
   if (num_fields > ARRAY_SIZE(array))
   {
     num_fields = ARRAY_SIZE(array);
@@ -1630,11 +1932,10 @@ SFError csv_to_tiles(Reader *const reader, MapTilesHeader * const hdr)
     }
   } /* next frame */
 
-  if (text_ptr != NULL)
+  if (num_fields > 0)
   {
     DEBUG("Reading 2nd splash animation");
-    num_fields = csv_parse_string(&*text_ptr, &text_ptr, array,
-                                  CSVOutputType_Int, ARRAY_SIZE(array));
+    num_fields = csvreader_read_ints(&csv, array, ARRAY_SIZE(array));
     if (num_fields > ARRAY_SIZE(array))
     {
       num_fields = ARRAY_SIZE(array);
@@ -1657,13 +1958,12 @@ SFError csv_to_tiles(Reader *const reader, MapTilesHeader * const hdr)
         hdr->splash_anim_2[frame] = (uint8_t)array[frame];
       }
     } /* next frame */
-  } /* endif (text_ptr != NULL) */
+  } /* endif (num_fields > 0) */
 
-  if (text_ptr != NULL)
+  if (num_fields > 0)
   {
     DEBUG("Reading 2nd splash triggers");
-    num_fields = csv_parse_string(&*text_ptr, &text_ptr, array,
-                                  CSVOutputType_Int, ARRAY_SIZE(array));
+    num_fields = csvreader_read_ints(&csv, array, ARRAY_SIZE(array));
     if (num_fields > ARRAY_SIZE(array))
       num_fields = ARRAY_SIZE(array);
 
@@ -1679,7 +1979,12 @@ SFError csv_to_tiles(Reader *const reader, MapTilesHeader * const hdr)
         hdr->splash_2_triggers[frame] = (uint8_t)array[frame];
       }
     } /* next frame */
-  } /* endif (text_ptr != NULL) */
+  } /* endif (num_fields > 0) */
+
+  if (reader_ferror(reader))
+  {
+    return SFError_ReadFail;
+  }
 
   if (out_of_range)
   {
@@ -1830,6 +2135,42 @@ SFError tiles_to_sprites_ext(Reader *const reader, Writer *const writer)
 
 /* ----------------------------------------------------------------------- */
 
+SFError tiles_to_sprites_size(Reader *const reader, long int *const size)
+{
+  assert(size);
+  MapTilesHeader hdr = {0};
+  SFError const err = read_tiles_hdr(&hdr, reader);
+  if (err == SFError_OK)
+  {
+    *size = sprite_area_size(hdr.last_tile_num + 1, 0, MapTileSprSize);
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+SFError tiles_to_sprites_ext_size(Reader *const reader, long int *const size)
+{
+  assert(size);
+  MapTilesHeader hdr = {0};
+  SFError const err = read_tiles_hdr(&hdr, reader);
+  if (err == SFError_OK)
+  {
+    *size = sprite_area_size(hdr.last_tile_num + 1, MapTileSprExtDataSize,
+                             MapTileSprSize);
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+SFError tiles_to_csv_size(Reader *const reader, long int *const size)
+{
+  return csv_size(tiles_to_csv, reader, size);
+}
+
+/* ----------------------------------------------------------------------- */
+
 SFError sprites_to_planets_init(SpritesToPlanetsIter *const iter,
   Reader *const reader, Writer *const writer, PlanetSpritesContext const *const context)
 {
@@ -1844,6 +2185,7 @@ SFError sprites_to_planets_init(SpritesToPlanetsIter *const iter,
   iter->hdr = context->hdr,
   iter->offsets = context->offsets,
   write_planets_hdr(&context->hdr, writer);
+  iter->end = writer_ftell(writer);
   return SFError_OK;
 }
 
@@ -1852,17 +2194,46 @@ SFError sprites_to_planets_init(SpritesToPlanetsIter *const iter,
 SFError sprites_to_planets(Reader *reader, Writer *writer,
   PlanetSpritesContext const *const context)
 {
+  assert(context);
+
+  /* The images are written at whatever offsets the header specifies,
+     so the whole file is assembled in memory (with any gaps already
+     zeroed) and then written in one go. That allows the images to be
+     out of order and saves the compressor from zero-filling gaps. */
+  int const size = planets_size(&context->hdr);
+  assert(size > 0);
   _Optional SpritesToPlanetsIter *const iter = malloc(sizeof(*iter));
-  if (!iter)
+  _Optional uint8_t *const buf = calloc((size_t)size, 1);
+  if (!iter || !buf)
   {
+    free(iter);
+    free(buf);
     return SFError_NoMem;
   }
 
-  SFError err = sprites_to_planets_init(&*iter, reader, writer, context);
-  if (err == SFError_OK)
+  Writer mem_writer;
+  SFError err = SFError_NoMem;
+  if (writer_mem_init(&mem_writer, &*buf, (size_t)size))
   {
-    err = convert_finish(&iter->super);
+    err = sprites_to_planets_init(&*iter, reader, &mem_writer, context);
+    if (err == SFError_OK)
+    {
+      err = convert_finish(&iter->super);
+    }
+
+    if (writer_destroy(&mem_writer) < 0 && err == SFError_OK)
+    {
+      err = SFError_WriteFail;
+    }
+  }
+
+  if (err == SFError_OK &&
+      writer_fwrite(&*buf, (size_t)size, 1, writer) != 1)
+  {
+    err = SFError_WriteFail;
   }
+
+  free(buf);
   free(iter);
   return err;
 }
@@ -1875,14 +2246,8 @@ SFError csv_to_planets(Reader *const reader, PlanetsHeader * const hdr)
   DEBUG("Will copy image offsets from a CSV file to a "
         "planet images header %p", (void *)hdr);
 
-  char csv_buffer[CSVBufferSize];
-  size_t const n = reader_fread(csv_buffer, 1, sizeof(csv_buffer), reader);
-  if (n >= sizeof(csv_buffer))
-  {
-    return SFError_StrOFlo;
-  }
-  csv_buffer[n] = '\0';
-  _Optional char *text_ptr = csv_buffer;
+  CSVReader csv;
+  csvreader_init(&csv, reader);
 
   bool fixed = false;
   for (int32_t planet = 0; planet <= hdr->last_image_num; planet++)
@@ -1890,15 +2255,16 @@ SFError csv_to_planets(Reader *const reader, PlanetsHeader * const hdr)
     DEBUG("Reading paint offsets for sky picture %" PRId32, planet);
 
     int array[2] = {0, 0}; /* for X and Y coordinates */
-    size_t num_fields = csv_parse_string(&*text_ptr, &text_ptr, array,
-                                         CSVOutputType_Int, ARRAY_SIZE(array));
+    size_t num_fields = csvreader_read_ints(&csv, array, ARRAY_SIZE(array));
+    if (num_fields == 0)
+    {
+      break; /* end of input - success */
+    }
+
     if (num_fields > ARRAY_SIZE(array))
       num_fields = ARRAY_SIZE(array);
 
-    if (num_fields > 0)
-    {
-      hdr->paint_coords[planet].x_offset = array[0];
-    }
+    hdr->paint_coords[planet].x_offset = array[0];
 
     if (num_fields > 1)
     {
@@ -1909,14 +2275,13 @@ SFError csv_to_planets(Reader *const reader, PlanetsHeader * const hdr)
     {
       fixed = true;
     }
-
-    if (text_ptr == NULL)
-    {
-      break; /* end of input string - success */
-    }
-
   } /* next planet */
 
+  if (reader_ferror(reader))
+  {
+    return SFError_ReadFail;
+  }
+
   if (fixed)
   {
     return SFError_ForceOff;
@@ -1931,7 +2296,19 @@ int planets_size(PlanetsHeader const * const hdr)
 {
   assert(hdr);
   int32_t const nimages = hdr->last_image_num + 1;
-  int32_t const size = PlanetHeaderSize + (nimages * PlanetBitmapSize * 2);
+  int32_t size = PlanetHeaderSize + (nimages * PlanetBitmapSize * 2);
+
+  /* Any gaps between images make the file bigger */
+  for (int32_t i = 0; i < nimages; ++i)
+  {
+    assert((size_t)i < ARRAY_SIZE(hdr->data_offsets));
+    int32_t const end = HIGHEST(hdr->data_offsets[i].image_A,
+                                hdr->data_offsets[i].image_B) + PlanetBitmapSize;
+    if (end > size)
+    {
+      size = end;
+    }
+  }
   DEBUGF("Expected planets file size is %" PRId32 " (%" PRId32 " images)\n", size, nimages);
   return size;
 }
@@ -2045,6 +2422,45 @@ SFError planets_to_sprites_ext(Reader *const reader, Writer *const writer)
 }
 
 
+/* ----------------------------------------------------------------------- */
+
+SFError planets_to_sprites_size(Reader *const reader, long int *const size)
+{
+  assert(size);
+  PlanetsHeader hdr = {0};
+  SFError const err = read_planets_hdr(&hdr, reader);
+  if (err == SFError_OK)
+  {
+    *size = sprite_area_size(hdr.last_image_num + 1, 0, PlanetSprSize);
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+SFError planets_to_sprites_ext_size(Reader *const reader, long int *const size)
+{
+  assert(size);
+  PlanetsHeader hdr = {0};
+  SFError const err = read_planets_hdr(&hdr, reader);
+  if (err == SFError_OK)
+  {
+    int32_t const count = hdr.last_image_num + 1;
+    int32_t const ext_data_size =
+       PlanetSprExtDataHdrSize + (PlanetSprExtDataOffsetSize * count);
+
+    *size = sprite_area_size(count, ext_data_size, PlanetSprSize);
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+SFError planets_to_csv_size(Reader *const reader, long int *const size)
+{
+  return csv_size(planets_to_csv, reader, size);
+}
+
 /* ----------------------------------------------------------------------- */
 
 SFError sprites_to_sky_init(SpritesToSkyIter *const iter,
@@ -2093,19 +2509,17 @@ SFError csv_to_sky(Reader *const reader, SkyHeader *const hdr)
   DEBUG("Will copy height values from a CSV file to a sky"
         " colours header %p", (void *)hdr);
 
-  char csv_buffer[CSVBufferSize];
-  size_t const n = reader_fread(csv_buffer, 1, sizeof(csv_buffer), reader);
-  if (n >= sizeof(csv_buffer))
-  {
-    return SFError_StrOFlo;
-  }
-  csv_buffer[n] = '\0';
-  _Optional char *text_ptr = csv_buffer;
+  CSVReader csv;
+  csvreader_init(&csv, reader);
 
   int array[2];
 
-  const size_t num_fields = csv_parse_string(&*text_ptr, &text_ptr, array,
-                                             CSVOutputType_Int, ARRAY_SIZE(array));
+  const size_t num_fields = csvreader_read_ints(&csv, array, ARRAY_SIZE(array));
+  if (reader_ferror(reader))
+  {
+    return SFError_ReadFail;
+  }
+
   bool fixed = false;
   if (num_fields > 0)
   {
@@ -2245,3 +2659,38 @@ SFError sky_to_sprites_ext(Reader *const reader, Writer *const writer)
   free(iter);
   return err;
 }
+
+/* ----------------------------------------------------------------------- */
+
+SFError sky_to_sprites_size(Reader *const reader, long int *const size)
+{
+  assert(size);
+  SkyHeader hdr = {0};
+  SFError const err = read_sky_hdr(&hdr, reader);
+  if (err == SFError_OK)
+  {
+    *size = sprite_area_size(SkySprCount, 0, SkySprSize);
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+SFError sky_to_sprites_ext_size(Reader *const reader, long int *const size)
+{
+  assert(size);
+  SkyHeader hdr = {0};
+  SFError const err = read_sky_hdr(&hdr, reader);
+  if (err == SFError_OK)
+  {
+    *size = sprite_area_size(SkySprCount, SkySprExtDataSize, SkySprSize);
+  }
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+SFError sky_to_csv_size(Reader *const reader, long int *const size)
+{
+  return csv_size(sky_to_csv, reader, size);
+}
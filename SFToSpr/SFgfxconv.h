@@ -13,6 +13,10 @@
 #include "Writer.h"
 #include "SFError.h"
 
+#if !defined(USE_OPTIONAL) && !defined(_Optional)
+#define _Optional
+#endif
+
 typedef struct ConvertIter
 {
   int32_t pos;
@@ -23,6 +27,13 @@ typedef struct ConvertIter
 } ConvertIter;
 
 SFError convert_advance(ConvertIter *iter);
+
+/* Convert up to 'max_items' items (at least one), stopping early if
+   '*time_up' becomes true. Unlike convert_advance, returns SFError_Done
+   as soon as the last item has been converted. */
+SFError convert_advance_budget(ConvertIter *iter, int32_t max_items,
+  _Optional volatile bool const *time_up);
+
 SFError convert_finish(ConvertIter *iter);
 
 
@@ -72,7 +83,9 @@ typedef struct {
   long int const *offsets;
   PlanetsHeader hdr;
   ConvertIter super;
+  long int end; /* highest file position written */
   uint8_t tmp[PlanetSprBitmapSize];
+  uint8_t image[PlanetBitmapSize];
 } SpritesToPlanetsIter;
 
 SFError sprites_to_planets_init(SpritesToPlanetsIter *iter,
@@ -84,6 +97,7 @@ typedef struct {
   PlanetsHeader hdr;
   ConvertIter super;
   uint8_t tmp[PlanetBitmapSize];
+  uint8_t tmp_B[PlanetBitmapSize];
 } PlanetsToSpritesIter;
 
 SFError planets_to_sprites_init(PlanetsToSpritesIter *iter,
@@ -96,6 +110,9 @@ int planets_size(PlanetsHeader const *hdr);
 SFError planets_to_sprites_ext(Reader *reader, Writer *writer);
 SFError planets_to_sprites(Reader *reader, Writer *writer);
 SFError planets_to_csv(Reader *reader, Writer *writer);
+SFError planets_to_sprites_size(Reader *reader, long int *size);
+SFError planets_to_sprites_ext_size(Reader *reader, long int *size);
+SFError planets_to_csv_size(Reader *reader, long int *size);
 SFError csv_to_planets(Reader *reader, PlanetsHeader *hdr);
 
 
@@ -153,6 +170,12 @@ int tiles_size(MapTilesHeader const *hdr);
 SFError tiles_to_sprites_ext(Reader *reader, Writer *writer);
 SFError tiles_to_sprites(Reader *reader, Writer *writer);
 SFError tiles_to_csv(Reader *reader, Writer *writer);
+
+/* Get the exact size of the output of the corresponding conversion
+   from the header alone. */
+SFError tiles_to_sprites_size(Reader *reader, long int *size);
+SFError tiles_to_sprites_ext_size(Reader *reader, long int *size);
+SFError tiles_to_csv_size(Reader *reader, long int *size);
 SFError csv_to_tiles(Reader *reader, MapTilesHeader *hdr);
 
 
@@ -207,6 +230,9 @@ int sky_size(void);
 SFError sky_to_sprites_ext(Reader *reader, Writer *writer);
 SFError sky_to_sprites(Reader *reader, Writer *writer);
 SFError sky_to_csv(Reader *reader, Writer *writer);
+SFError sky_to_sprites_size(Reader *reader, long int *size);
+SFError sky_to_sprites_ext_size(Reader *reader, long int *size);
+SFError sky_to_csv_size(Reader *reader, long int *size);
 SFError csv_to_sky(Reader *reader, SkyHeader *hdr);
 
 
@@ -224,16 +250,41 @@ typedef struct
 }
 ScanSpritesContext;
 
+/* Copies of the bitmaps of identified sprites, gathered whilst scanning
+   so that the sprite file need not be read again to convert it. */
+typedef struct
+{
+  _Optional uint8_t *data;
+  long int size;
+  long int capacity;
+}
+SpriteBitmapBuffer;
+
+void sprite_bitmap_buffer_init(SpriteBitmapBuffer *bitmaps);
+void sprite_bitmap_buffer_destroy(SpriteBitmapBuffer *bitmaps);
+
+/* The offsets recorded by a buffered scan are relative to the start of the
+   buffer, so conversion must read from this instead of the sprite file. */
+bool sprite_bitmap_buffer_reader_init(Reader *reader,
+  SpriteBitmapBuffer const *bitmaps);
+
 typedef struct
 {
   ConvertIter super;
   ScanSpritesContext *context;
+  _Optional SpriteBitmapBuffer *bitmaps;
 } ScanSpritesIter;
 
 SFError scan_sprite_file_init(ScanSpritesIter *iter, Reader *reader,
   ScanSpritesContext *context);
 
+SFError scan_sprite_file_buffered_init(ScanSpritesIter *iter, Reader *reader,
+  ScanSpritesContext *context, SpriteBitmapBuffer *bitmaps);
+
 SFError scan_sprite_file(Reader *reader, ScanSpritesContext *context);
+
+SFError scan_sprite_file_buffered(Reader *reader, ScanSpritesContext *context,
+  SpriteBitmapBuffer *bitmaps);
 int count_spr_types(ScanSpritesContext const *context);
 
 #endif
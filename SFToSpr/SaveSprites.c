@@ -42,7 +42,6 @@
 #include "EventExtra.h"
 #include "Debug.h"
 #include "ReaderFlex.h"
-#include "WriterNull.h"
 #include "Hourglass.h"
 #include "ReaderGKey.h"
 
@@ -83,6 +82,14 @@ typedef struct
 SaveSprites;
 
 typedef SFError ConverterFn(Reader *, Writer *);
+typedef SFError SizeFn(Reader *, long int *);
+
+typedef struct
+{
+  ConverterFn *convert;
+  SizeFn *get_size;
+}
+Conversion;
 
 /* -----------------------------------------------------------------------
  *                          Private functions
@@ -110,7 +117,7 @@ static void destroy_savebox(SFTSaveBox *savebox)
 
 /* ----------------------------------------------------------------------- */
 
-static int get_size(SaveSprites *const savefile_data, ConverterFn *const fn)
+static int get_size(SaveSprites *const savefile_data, SizeFn *const fn)
 {
   long int out_size = 0;
 
@@ -128,17 +135,11 @@ static int get_size(SaveSprites *const savefile_data, ConverterFn *const fn)
   }
   else
   {
-    Writer writer;
-    writer_null_init(&writer);
-
-    hourglass_on();
-    SFError err = fn(&gkreader, &writer);
-    hourglass_off();
-
-    out_size = writer_destroy(&writer);
-    if (out_size < 0 || err != SFError_OK)
+    /* Only the header needs to be decompressed */
+    SFError const err = fn(&gkreader, &out_size);
+    if (out_size < 0 || out_size > INT_MAX || err != SFError_OK)
     {
-      DEBUGF("Unable to get file size: conversion failed\n");
+      DEBUGF("Unable to get file size: bad header\n");
       out_size = 0;
     }
 
@@ -155,35 +156,35 @@ static int get_size(SaveSprites *const savefile_data, ConverterFn *const fn)
 
 /* ----------------------------------------------------------------------- */
 
-static _Optional ConverterFn *pick_converter(SaveSprites *const savefile_data, int const radio_button)
+static _Optional Conversion const *pick_converter(SaveSprites *const savefile_data, int const radio_button)
 {
-  _Optional ConverterFn *fn = (ConverterFn *)NULL;
+  _Optional Conversion const *conv = NULL;
 
   assert(savefile_data);
   DEBUGF("Input filetype is 0x%x, output component ID is 0x%x\n",
          savefile_data->input_file_type, radio_button);
 
-  static ConverterFn *const tile_conv[] =
+  static Conversion const tile_conv[] =
   {
-    [ComponentId_Data_Radio] = tiles_to_csv,
-    [ComponentId_ImagesData_Radio] = tiles_to_sprites_ext,
-    [ComponentId_Images_Radio] = tiles_to_sprites,
+    [ComponentId_Data_Radio] = {tiles_to_csv, tiles_to_csv_size},
+    [ComponentId_ImagesData_Radio] = {tiles_to_sprites_ext, tiles_to_sprites_ext_size},
+    [ComponentId_Images_Radio] = {tiles_to_sprites, tiles_to_sprites_size},
   };
 
-  static ConverterFn *const planet_conv[] =
+  static Conversion const planet_conv[] =
   {
-    [ComponentId_Data_Radio] = planets_to_csv,
-    [ComponentId_ImagesData_Radio] = planets_to_sprites_ext,
-    [ComponentId_Images_Radio] = planets_to_sprites,
+    [ComponentId_Data_Radio] = {planets_to_csv, planets_to_csv_size},
+    [ComponentId_ImagesData_Radio] = {planets_to_sprites_ext, planets_to_sprites_ext_size},
+    [ComponentId_Images_Radio] = {planets_to_sprites, planets_to_sprites_size},
   };
 
-  static ConverterFn *const sky_conv[] =
+  static Conversion const sky_conv[] =
   {
-    [ComponentId_Data_Radio] = sky_to_csv,
-    [ComponentId_ImagesData_Radio] = sky_to_sprites_ext,
-    [ComponentId_Images_Radio] = sky_to_sprites,
+    [ComponentId_Data_Radio] = {sky_to_csv, sky_to_csv_size},
+    [ComponentId_ImagesData_Radio] = {sky_to_sprites_ext, sky_to_sprites_ext_size},
+    [ComponentId_Images_Radio] = {sky_to_sprites, sky_to_sprites_size},
   };
-  ConverterFn *_Optional const (*table)[ComponentId_Data_Radio + 1] = NULL;
+  _Optional Conversion const (*table)[ComponentId_Data_Radio + 1] = NULL;
 
   switch (savefile_data->input_file_type)
   {
@@ -208,10 +209,10 @@ static _Optional ConverterFn *pick_converter(SaveSprites *const savefile_data, i
   {
     if (radio_button >= 0 && (unsigned)radio_button < ARRAY_SIZE(*table))
     {
-      fn = (*table)[radio_button];
+      conv = &(*table)[radio_button];
     }
   }
-  return fn;
+  return conv;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -240,14 +241,14 @@ static bool change_output(SaveSprites *const savefile_data, int const radio_butt
     return false;
   }
 
-  _Optional ConverterFn *const converter = pick_converter(savefile_data, radio_button);
+  _Optional Conversion const *const converter = pick_converter(savefile_data, radio_button);
   if (!converter)
   {
     DEBUGF("No format converter\n");
     return false;
   }
 
-  int const file_size = get_size(savefile_data, &*converter);
+  int const file_size = get_size(savefile_data, converter->get_size);
   if (E(saveas_set_file_size(0, savefile_data->super.saveas_id, file_size)))
   {
     return false;
@@ -272,7 +273,7 @@ static bool write_sprite_or_csv(Writer *const writer, void *const handle,
     return false;
   }
 
-  _Optional ConverterFn *const converter = pick_converter(savefile_data, savefile_data->reset_radio);
+  _Optional Conversion const *const converter = pick_converter(savefile_data, savefile_data->reset_radio);
   if (!converter)
   {
     DEBUGF("No format converter\n");
@@ -288,7 +289,7 @@ static bool write_sprite_or_csv(Writer *const writer, void *const handle,
   if (success)
   {
     hourglass_on();
-    err = converter(&gkreader, writer);
+    err = converter->convert(&gkreader, writer);
     hourglass_off();
     reader_destroy(&gkreader);
   }
@@ -65,6 +65,8 @@
 /* Local headers */
 #include "SFgfxconv.h"
 #include "Utils.h"
+#include "SFTInit.h"
+#include "ScanStats.h"
 #include "Scan.h"
 
 #ifdef USE_OPTIONAL
@@ -91,10 +93,11 @@ typedef enum
   ScanStatus_Paused,
   ScanStatus_ExamineObject,
   ScanStatus_OpenInput, /* from ExamineObject */
+  ScanStatus_ExpandInput, /* from OpenInput */
   ScanStatus_StartScanSprites, /* from OpenInput */
   ScanStatus_ScanSprites, /* from StartScanSprites */
   ScanStatus_PickConversion, /* from ScanSprites */
-  ScanStatus_DecideOutput, /* from PickConversion or OpenInput */
+  ScanStatus_DecideOutput, /* from PickConversion or ExpandInput */
   ScanStatus_MakePath, /* from DecideOutput */
   ScanStatus_OpenOutput, /* from MakePath or CloseTmpOutput */
   ScanStatus_StartConvert, /* from OpenOutput or DecideOutput */
@@ -109,6 +112,35 @@ typedef enum
 }
 ScanStatus;
 
+/* Names of phases in the statistics */
+static char const *const phase_names[] =
+{
+  [ScanStatus_Error] = "Error",
+  [ScanStatus_Paused] = "Paused",
+  [ScanStatus_ExamineObject] = "ExamineObject",
+  [ScanStatus_OpenInput] = "OpenInput",
+  [ScanStatus_ExpandInput] = "ExpandInput",
+  [ScanStatus_StartScanSprites] = "StartScanSprites",
+  [ScanStatus_ScanSprites] = "ScanSprites",
+  [ScanStatus_PickConversion] = "PickConversion",
+  [ScanStatus_DecideOutput] = "DecideOutput",
+  [ScanStatus_MakePath] = "MakePath",
+  [ScanStatus_OpenOutput] = "OpenOutput",
+  [ScanStatus_StartConvert] = "StartConvert",
+  [ScanStatus_Convert] = "Convert",
+  [ScanStatus_CloseInput] = "CloseInput",
+  [ScanStatus_CloseTmpOutput] = "CloseTmpOutput",
+  [ScanStatus_CopyTmp] = "CopyTmp",
+  [ScanStatus_CloseOutput] = "CloseOutput",
+  [ScanStatus_SetFileType] = "SetFileType",
+  [ScanStatus_NextObject] = "NextObject",
+  [ScanStatus_Finished] = "Finished",
+};
+
+/* Compile-time check that the statistics have room for every phase */
+typedef char phase_names_fit[ARRAY_SIZE(phase_names) <= ScanStatsMaxPhases ?
+                             1 : -1];
+
 /* Constant numeric values */
 enum
 {
@@ -123,6 +155,8 @@ enum
   MaxActionLen      = 15,
   FednetHistoryLog2 = 9, /* Base 2 logarithm of the history size used by
                             the compression algorithm */
+  ConvertBudgetMin  = 1, /* Items converted per call of the idle function */
+  ConvertBudgetMax  = 256,
 };
 
 typedef struct
@@ -135,6 +169,7 @@ typedef struct
   int input_type;
   int output_type;
 
+  void *in_buf; /* decompressed copy of the input, for random access */
   void *out_buf;
   ScanStatus return_phase; /* for pause, error */
   /* preserved data for retry */
@@ -150,6 +185,7 @@ typedef struct
   Reader reader;
   Writer writer;
   _Optional ConvertIter *conv_iter;
+  int32_t convert_budget; /* adapted to how many items fit in a time slice */
 
   bool extract_images:1;
   bool extract_data:1;
@@ -162,7 +198,9 @@ typedef struct
 {
   UserData list_node;
   ScanDataState state;
+  ScanStats stats; /* not reset by a retry */
   ScanSpritesContext context;
+  SpriteBitmapBuffer bitmaps; /* avoids re-reading the input to convert it */
   union {
     ScanSpritesIter scan_sprites;
     SpritesToPlanetsIter sprites_to_planets;
@@ -204,14 +242,23 @@ static long int scan_writer_destroy(ScanData *const scan_data)
   return n;
 }
 
+static void scan_count_io(ScanData *const scan_data)
+{
+  assert(scan_data != NULL);
+  scan_stats_count_io(&scan_data->stats, scan_data->state.in,
+                      scan_data->state.out);
+}
+
 static void scan_close_in(ScanData *const scan_data)
 {
   assert(scan_data != NULL);
   if (scan_data->state.in)
   {
+    scan_count_io(scan_data);
     FILE *const f = &*scan_data->state.in;
     scan_data->state.in = NULL;
     fclose_dec(f);
+    scan_count_io(scan_data);
   }
 }
 
@@ -221,9 +268,11 @@ static int scan_close_out(ScanData *const scan_data)
   int err = 0;
   if (scan_data->state.out)
   {
+    scan_count_io(scan_data);
     FILE *const f = &*scan_data->state.out;
     scan_data->state.out = NULL;
     err = fclose_dec(f);
+    scan_count_io(scan_data);
   }
   return err;
 }
@@ -256,6 +305,16 @@ static void scan_finished(ScanData *const scan_data)
     scan_close_in(scan_data);
     (void)scan_close_out(scan_data);
 
+    scan_stats_next_file(&scan_data->stats,
+                         stringbuffer_get_pointer(&scan_data->state.load_path));
+    (void)scan_stats_dump(&scan_data->stats);
+    scan_stats_destroy(&scan_data->stats);
+
+    if (scan_data->state.in_buf)
+    {
+      flex_free(&scan_data->state.in_buf);
+    }
+
     if (scan_data->state.out_buf)
     {
       flex_free(&scan_data->state.out_buf);
@@ -263,6 +322,7 @@ static void scan_finished(ScanData *const scan_data)
 
     stringbuffer_destroy(&scan_data->state.load_path);
     stringbuffer_destroy(&scan_data->state.save_path);
+    sprite_bitmap_buffer_destroy(&scan_data->bitmaps);
 
     free(scan_data);
   }
@@ -701,7 +761,10 @@ static _Optional const _kernel_oserror *open_input(ScanData *const scan_data)
       else
       {
         scan_data->state.has_reader = true;
-        scan_data->state.phase = ScanStatus_DecideOutput;
+        assert(!scan_data->state.has_writer);
+        writer_flex_init(&scan_data->state.writer, &scan_data->state.in_buf);
+        scan_data->state.has_writer = true;
+        scan_data->state.phase = ScanStatus_ExpandInput;
       }
       break;
 
@@ -721,12 +784,54 @@ static _Optional const _kernel_oserror *open_input(ScanData *const scan_data)
 
 /* ----------------------------------------------------------------------- */
 
+static _Optional const _kernel_oserror *expand_input(ScanData *const scan_data)
+{
+  assert(scan_data != NULL);
+
+  /* Decompress the whole input before converting it, otherwise every
+     backward seek (e.g. between planet images) would restart the
+     decompressor from the beginning of the file. */
+  SFError err = SFError_OK;
+  size_t const n = reader_fread(scan_data->copy_buf, 1, sizeof(scan_data->copy_buf),
+                                &scan_data->state.reader);
+  assert(n <= sizeof(scan_data->copy_buf));
+  if (reader_ferror(&scan_data->state.reader))
+  {
+    err = SFError_ReadFail;
+  }
+  else if (writer_fwrite(scan_data->copy_buf, 1, n, &scan_data->state.writer) != n)
+  {
+    err = SFError_NoMem;
+  }
+
+  if (err == SFError_OK && reader_feof(&scan_data->state.reader))
+  {
+    scan_reader_destroy(scan_data);
+    scan_close_in(scan_data);
+
+    if (scan_writer_destroy(scan_data) < 0)
+    {
+      err = SFError_NoMem;
+    }
+    else
+    {
+      reader_flex_init(&scan_data->state.reader, &scan_data->state.in_buf);
+      scan_data->state.has_reader = true;
+      scan_data->state.phase = ScanStatus_DecideOutput;
+    }
+  }
+
+  return scan_error(err, scan_data);
+}
+
+/* ----------------------------------------------------------------------- */
+
 static _Optional const _kernel_oserror *start_scan_sprites(ScanData *const scan_data)
 {
   assert(scan_data->state.in);
-  SFError const err = scan_sprite_file_init(&scan_data->iter.scan_sprites,
-                                            &scan_data->state.reader,
-                                            &scan_data->context);
+  SFError const err = scan_sprite_file_buffered_init(
+                          &scan_data->iter.scan_sprites, &scan_data->state.reader,
+                          &scan_data->context, &scan_data->bitmaps);
   if (err == SFError_OK)
   {
     scan_data->state.phase = ScanStatus_ScanSprites;
@@ -736,11 +841,42 @@ static _Optional const _kernel_oserror *start_scan_sprites(ScanData *const scan_
 
 /* ----------------------------------------------------------------------- */
 
-static _Optional const _kernel_oserror *scan_sprites(ScanData *const scan_data)
+static SFError advance_budget(ScanData *const scan_data,
+  ConvertIter *const iter, const volatile bool *const time_up)
+{
+  assert(scan_data != NULL);
+  assert(time_up != NULL);
+
+  int32_t const budget = scan_data->state.convert_budget;
+  int32_t const start = iter->pos;
+  SFError const err = convert_advance_budget(iter, budget, time_up);
+
+  /* Convert more items per call until the time slice runs out first,
+     then fewer, so that the overhead of each call is amortised without
+     making the desktop unresponsive. */
+  if (*time_up && iter->pos - start < budget)
+  {
+    scan_data->state.convert_budget = HIGHEST(budget / 2, ConvertBudgetMin);
+  }
+  else if (!*time_up && err == SFError_OK)
+  {
+    scan_data->state.convert_budget = LOWEST(budget * 2, ConvertBudgetMax);
+  }
+  DEBUG_VERBOSEF("Converted %ld items (budget %ld)\n",
+                 (long)(iter->pos - start), (long)scan_data->state.convert_budget);
+
+  return err;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static _Optional const _kernel_oserror *scan_sprites(ScanData *const scan_data,
+  const volatile bool *const time_up)
 {
   assert(scan_data != NULL);
 
-  SFError err = convert_advance(&scan_data->iter.scan_sprites.super);
+  SFError err = advance_budget(scan_data, &scan_data->iter.scan_sprites.super,
+                               time_up);
   if (err == SFError_Done)
   {
     err = SFError_OK;
@@ -771,12 +907,20 @@ static _Optional const _kernel_oserror *pick_conversion(ScanData *const scan_dat
     return NULL;
   }
 
-  SFError err = SFError_OK;
-  if (reader_fseek(&scan_data->state.reader, 0, SEEK_SET))
+  /* The bitmaps to be converted were copied whilst scanning, so the
+     input file is no longer needed. */
+  scan_reader_destroy(scan_data);
+  scan_close_in(scan_data);
+
+  if (!sprite_bitmap_buffer_reader_init(&scan_data->state.reader,
+                                        &scan_data->bitmaps))
   {
-    err = SFError_BadSeek;
+    return scan_error(SFError_NoMem, scan_data);
   }
-  else if (scan_data->context.tiles.count > 0)
+  scan_data->state.has_reader = true;
+
+  SFError err = SFError_OK;
+  if (scan_data->context.tiles.count > 0)
   {
     scan_data->state.output_type = FileType_SFMapGfx;
     if (!scan_data->context.tiles.got_hdr)
@@ -1042,12 +1186,14 @@ static _Optional const _kernel_oserror *start_convert(ScanData *const scan_data)
 
 /* ----------------------------------------------------------------------- */
 
-static _Optional const _kernel_oserror *convert_data(ScanData *const scan_data)
+static _Optional const _kernel_oserror *convert_data(ScanData *const scan_data,
+  const volatile bool *const time_up)
 {
   assert(scan_data != NULL);
 
   SFError err = scan_data->state.conv_iter ?
-    convert_advance(&*scan_data->state.conv_iter) : SFError_Done;
+    advance_budget(scan_data, &*scan_data->state.conv_iter, time_up) :
+    SFError_Done;
 
   if (err == SFError_Done)
   {
@@ -1195,6 +1341,8 @@ static SchedulerTime do_scan_idle(void *handle, SchedulerTime new_time,
 #ifdef FORTIFY
     Fortify_CheckAllMemory();
 #endif
+    scan_stats_begin(&scan_data->stats, scan_data->state.phase);
+
     switch (scan_data->state.phase)
     {
       case ScanStatus_ExamineObject:
@@ -1205,12 +1353,16 @@ static SchedulerTime do_scan_idle(void *handle, SchedulerTime new_time,
         e = open_input(scan_data);
         break;
 
+      case ScanStatus_ExpandInput:
+        e = expand_input(scan_data);
+        break;
+
       case ScanStatus_StartScanSprites:
         e = start_scan_sprites(scan_data);
         break;
 
       case ScanStatus_ScanSprites:
-        e = scan_sprites(scan_data);
+        e = scan_sprites(scan_data, time_up);
         break;
 
       case ScanStatus_PickConversion:
@@ -1243,7 +1395,7 @@ static SchedulerTime do_scan_idle(void *handle, SchedulerTime new_time,
         break;
 
       case ScanStatus_Convert:
-        e = convert_data(scan_data);
+        e = convert_data(scan_data, time_up);
         break;
 
       case ScanStatus_CloseInput:
@@ -1272,6 +1424,9 @@ static SchedulerTime do_scan_idle(void *handle, SchedulerTime new_time,
         break;
 
       case ScanStatus_NextObject:
+        scan_stats_next_file(&scan_data->stats,
+                             stringbuffer_get_pointer(&scan_data->state.load_path));
+
         if (scan_data->state.iterator == NULL)
         {
           scan_data->state.phase = ScanStatus_Finished;
@@ -1292,6 +1447,9 @@ static SchedulerTime do_scan_idle(void *handle, SchedulerTime new_time,
         assert("Unexpected state" == NULL);
         break;
     }
+
+    scan_stats_end(&scan_data->stats, scan_data->state.in,
+                   scan_data->state.out);
   }
 
   if (e != NULL)
@@ -1527,6 +1685,7 @@ void Scan_create(char *const load_root, const char *const save_root,
     .output_type = 0,
     .return_action[0] = '\0',
     .real_save_path = "",
+    .convert_budget = ConvertBudgetMin,
     .replace_input = !stricmp(load_root, save_root),
   };
 
@@ -1539,6 +1698,11 @@ void Scan_create(char *const load_root, const char *const save_root,
 
   stringbuffer_init(&scan_data->state.load_path);
   stringbuffer_init(&scan_data->state.save_path);
+  sprite_bitmap_buffer_init(&scan_data->bitmaps);
+
+  /* Statistics are gathered only if a file name was given for them */
+  scan_stats_init(&scan_data->stats, getenv(APP_NAME "$ScanStats"),
+                  phase_names, ARRAY_SIZE(phase_names));
 
   if (!E(toolbox_create_object(0, "Scan", &scan_data->state.window_id)))
   {
@@ -1600,5 +1764,7 @@ void Scan_create(char *const load_root, const char *const save_root,
   diriterator_destroy(scan_data->state.iterator);
   stringbuffer_destroy(&scan_data->state.load_path);
   stringbuffer_destroy(&scan_data->state.save_path);
+  sprite_bitmap_buffer_destroy(&scan_data->bitmaps);
+  scan_stats_destroy(&scan_data->stats);
   free(scan_data);
 }
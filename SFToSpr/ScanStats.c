@@ -0,0 +1,296 @@
+/*
+ *  SFToSpr - Star Fighter 3000 graphics converter
+ *  Per-phase statistics for a directory scan
+ *  Copyright (C) 2026 Christopher Bazley
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public Licence as published by
+ *  the Free Software Foundation; either version 2 of the Licence, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public Licence for more details.
+ *
+ *  You should have received a copy of the GNU General Public Licence
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <assert.h>
+
+/* My library files */
+#include "Macros.h"
+#include "Debug.h"
+#include "StringBuff.h"
+
+/* Local headers */
+#include "ScanStats.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  MaxFieldsLen = 127, /* Length of a formatted record, excluding the file */
+};
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static void count_bytes(_Optional FILE *const f, long int *const pos,
+  unsigned long int *const count)
+{
+  assert(pos != NULL);
+  assert(count != NULL);
+
+  if (f == NULL)
+  {
+    *pos = 0;
+    return;
+  }
+
+  long int const new_pos = ftell(&*f);
+  if (new_pos < 0)
+  {
+    return;
+  }
+
+  if (new_pos > *pos)
+  {
+    *count += (unsigned long)(new_pos - *pos);
+  }
+  *pos = new_pos;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool format_record(StringBuffer *const buffer, char const *const path,
+  char const *const phase_name, ScanStatsEntry const *const entry)
+{
+  assert(buffer != NULL);
+  assert(path != NULL);
+  assert(phase_name != NULL);
+  assert(entry != NULL);
+
+  char fields[MaxFieldsLen + 1];
+  int const n = snprintf(fields, sizeof(fields), "\",%s,%lu,%.3f,%lu,%lu\n",
+                         phase_name, entry->calls,
+                         (double)entry->time / CLOCKS_PER_SEC,
+                         entry->bytes_read, entry->bytes_written);
+  assert(n >= 0);
+  assert((size_t)n < sizeof(fields));
+  NOT_USED(n);
+
+  return stringbuffer_append(buffer, "\"", SIZE_MAX) &&
+         stringbuffer_append(buffer, path, SIZE_MAX) &&
+         stringbuffer_append(buffer, fields, SIZE_MAX);
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+void scan_stats_init(ScanStats *const stats,
+  _Optional char const *const csv_path, char const *const phase_names[],
+  size_t const nphases)
+{
+  assert(stats != NULL);
+  assert(phase_names != NULL);
+  assert(nphases > 0);
+  assert(nphases <= ScanStatsMaxPhases);
+
+  *stats = (ScanStats){
+    .csv_path = NULL,
+    .phase_names = phase_names,
+    .nphases = nphases,
+  };
+  stringbuffer_init(&stats->rows);
+
+  if (csv_path == NULL)
+  {
+    return;
+  }
+
+  size_t const len = strlen(&*csv_path);
+  if (len == 0)
+  {
+    return;
+  }
+
+  stats->csv_path = malloc(len + 1);
+  if (stats->csv_path == NULL)
+  {
+    DEBUGF("Not enough memory for scan statistics\n");
+    return;
+  }
+
+  memcpy(&*stats->csv_path, &*csv_path, len + 1);
+  DEBUGF("Scan statistics will be written to %s\n", &*stats->csv_path);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scan_stats_destroy(ScanStats *const stats)
+{
+  assert(stats != NULL);
+  FREE_SAFE(stats->csv_path);
+  stringbuffer_destroy(&stats->rows);
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scan_stats_begin(ScanStats *const stats, size_t const phase)
+{
+  assert(stats != NULL);
+  assert(phase < stats->nphases);
+
+  if (scan_stats_is_enabled(stats))
+  {
+    stats->phase = phase;
+    stats->start = clock();
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scan_stats_end(ScanStats *const stats, _Optional FILE *const in,
+  _Optional FILE *const out)
+{
+  assert(stats != NULL);
+
+  if (scan_stats_is_enabled(stats))
+  {
+    ScanStatsEntry *const entry = &stats->file[stats->phase];
+    entry->time += clock() - stats->start;
+    ++entry->calls;
+    scan_stats_count_io(stats, in, out);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scan_stats_count_io(ScanStats *const stats, _Optional FILE *const in,
+  _Optional FILE *const out)
+{
+  assert(stats != NULL);
+
+  if (scan_stats_is_enabled(stats))
+  {
+    ScanStatsEntry *const entry = &stats->file[stats->phase];
+    count_bytes(in, &stats->in_pos, &entry->bytes_read);
+    count_bytes(out, &stats->out_pos, &entry->bytes_written);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scan_stats_add_io(ScanStats *const stats,
+  unsigned long int const bytes_read, unsigned long int const bytes_written)
+{
+  assert(stats != NULL);
+
+  if (scan_stats_is_enabled(stats))
+  {
+    ScanStatsEntry *const entry = &stats->file[stats->phase];
+    entry->bytes_read += bytes_read;
+    entry->bytes_written += bytes_written;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scan_stats_next_file(ScanStats *const stats, char const *const path)
+{
+  assert(stats != NULL);
+  assert(path != NULL);
+
+  if (!scan_stats_is_enabled(stats))
+  {
+    return;
+  }
+
+  for (size_t phase = 0; phase < stats->nphases; ++phase)
+  {
+    ScanStatsEntry *const entry = &stats->file[phase];
+    if (entry->calls == 0)
+    {
+      continue;
+    }
+
+    if (!format_record(&stats->rows, path, stats->phase_names[phase], entry))
+    {
+      /* Statistics are not worth failing the scan for */
+      DEBUGF("Not enough memory to record statistics for %s\n", path);
+    }
+
+    ScanStatsEntry *const total = &stats->total[phase];
+    total->calls += entry->calls;
+    total->time += entry->time;
+    total->bytes_read += entry->bytes_read;
+    total->bytes_written += entry->bytes_written;
+
+    *entry = (ScanStatsEntry){0};
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+bool scan_stats_dump(ScanStats *const stats)
+{
+  assert(stats != NULL);
+
+  if (!scan_stats_is_enabled(stats))
+  {
+    return true;
+  }
+
+  /* Record the totals after the statistics for each file */
+  for (size_t phase = 0; phase < stats->nphases; ++phase)
+  {
+    ScanStatsEntry const *const total = &stats->total[phase];
+    if (total->calls > 0 &&
+        !format_record(&stats->rows, "", stats->phase_names[phase], total))
+    {
+      return false;
+    }
+  }
+
+  _Optional FILE *const f = fopen(&*stats->csv_path, "a");
+  if (f == NULL)
+  {
+    DEBUGF("Failed to open %s\n", &*stats->csv_path);
+    return false;
+  }
+
+  bool success = !fseek(&*f, 0, SEEK_END);
+  if (success && ftell(&*f) == 0)
+  {
+    success = fputs("file,phase,calls,seconds,bytes_read,bytes_written\n",
+                    &*f) >= 0;
+  }
+
+  if (success)
+  {
+    success = fputs(stringbuffer_get_pointer(&stats->rows), &*f) >= 0;
+  }
+
+  if (fclose(&*f))
+  {
+    success = false;
+  }
+
+  DEBUGF("%s scan statistics to %s\n", success ? "Wrote" : "Failed to write",
+         &*stats->csv_path);
+  return success;
+}
@@ -0,0 +1,93 @@
+/*
+ *  SFToSpr - Star Fighter 3000 graphics converter
+ *  Per-phase statistics for a directory scan
+ *  Copyright (C) 2026 Christopher Bazley
+ */
+
+#ifndef SFTScanStats_h
+#define SFTScanStats_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "StringBuff.h"
+
+#if !defined(USE_OPTIONAL) && !defined(_Optional)
+#define _Optional
+#endif
+
+enum
+{
+  ScanStatsMaxPhases = 24, /* Most states that a scan can have */
+};
+
+typedef struct
+{
+  unsigned long int calls;
+  clock_t time;
+  unsigned long int bytes_read;
+  unsigned long int bytes_written;
+}
+ScanStatsEntry;
+
+/* Wall time, bytes read, bytes written and number of calls are accumulated
+   for each phase of a scan, both per file and in total. Nothing is recorded
+   unless a file name for the output was given. Bytes are counted as the
+   change in position of the input and output files. */
+typedef struct
+{
+  _Optional char *csv_path;
+  char const *const *phase_names;
+  size_t nphases;
+  size_t phase; /* being timed */
+  clock_t start;
+  long int in_pos, out_pos; /* when last counted */
+  StringBuffer rows; /* records for files already processed */
+  ScanStatsEntry file[ScanStatsMaxPhases];
+  ScanStatsEntry total[ScanStatsMaxPhases];
+}
+ScanStats;
+
+/* Initialize statistics for a scan with 'nphases' phases, named by the
+   corresponding elements of 'phase_names'. Statistics are only gathered
+   if 'csv_path' is a non-empty string. */
+void scan_stats_init(ScanStats *stats, _Optional char const *csv_path,
+  char const *const phase_names[], size_t nphases);
+
+/* Free any statistics not yet dumped. */
+void scan_stats_destroy(ScanStats *stats);
+
+/* Start or stop timing one call of the function for a phase. Stopping
+   also counts any bytes transferred since they were last counted. */
+void scan_stats_begin(ScanStats *stats, size_t phase);
+void scan_stats_end(ScanStats *stats, _Optional FILE *in,
+  _Optional FILE *out);
+
+/* Attribute bytes transferred since they were last counted to the phase
+   being timed. Must be called before closing either file and again after
+   closing it. A null pointer means that there is no file. */
+void scan_stats_count_io(ScanStats *stats, _Optional FILE *in,
+  _Optional FILE *out);
+
+/* Attribute bytes transferred other than through the input and output
+   files to the phase being timed. */
+void scan_stats_add_io(ScanStats *stats, unsigned long int bytes_read,
+  unsigned long int bytes_written);
+
+/* Finish the statistics for the file at 'path' and add them to the totals.
+   Nothing is recorded for a file for which no calls were timed. */
+void scan_stats_next_file(ScanStats *stats, char const *path);
+
+/* Append the statistics for each file and the totals to the output file
+   as comma-separated values, with a header if the file was empty. The
+   record of totals has an empty file name. Returns false on failure. */
+bool scan_stats_dump(ScanStats *stats);
+
+static inline bool scan_stats_is_enabled(ScanStats const *const stats)
+{
+  return stats->csv_path != NULL;
+}
+
+#endif
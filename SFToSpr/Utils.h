@@ -39,6 +39,9 @@ _Optional const _kernel_oserror *conv_error(SFError const err, char const *read_
 
 bool handle_error(SFError const err, char const *read_filename, char const *write_filename);
 
+/* Returns an upper bound on the compressed size of orig_size bytes, which
+   is 4 + (orig_size * 9 / 8). This is not an estimate: the data isn't
+   examined, so the actual compressed size is often much smaller. */
 int worst_comp_size(int orig_size);
 
 #endif
@@ -0,0 +1,251 @@
+/*
+ * SFToSpr test: output file names for batch conversion
+ * Copyright (C) 2026 Christopher Bazley
+ */
+
+#undef NDEBUG
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Macros.h"
+#include "Debug.h"
+#include "SFFormats.h"
+
+#include "Tests.h"
+#include "../BatchNames.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+enum
+{
+  StemSize = 64,
+  ManyNames = 1000,
+};
+
+static void check_stem(char const *const load_path,
+                       _Optional char const *const save_dir,
+                       char const *const expected)
+{
+  char stem[StemSize];
+  assert(batchnames_make_stem(stem, sizeof(stem), load_path, save_dir));
+  assert(!strcmp(stem, expected));
+}
+
+static void claim_stem(BatchNames *const names, char const *const load_path,
+                       _Optional char const *const save_dir,
+                       _Optional char const *const expected_owner)
+{
+  char stem[StemSize];
+  _Optional char const *prev_owner;
+
+  assert(batchnames_make_stem(stem, sizeof(stem), load_path, save_dir));
+  assert(batchnames_claim(names, stem, load_path, &prev_owner));
+  if (expected_owner)
+  {
+    assert(prev_owner);
+    assert(!strcmp(&*prev_owner, &*expected_owner));
+  }
+  else
+  {
+    assert(!prev_owner);
+  }
+}
+
+static void test_leaf(void)
+{
+  assert(!strcmp(batchnames_leaf("Sky,3fd"), "Sky,3fd"));
+  assert(!strcmp(batchnames_leaf("a/b/Sky,3fd"), "Sky,3fd"));
+  assert(!strcmp(batchnames_leaf("a\\Sky"), "Sky"));
+  assert(!strcmp(batchnames_leaf("a/"), ""));
+}
+
+static void test_strip_type(void)
+{
+  int file_type;
+
+  assert(batchnames_strip_type("Sky,3fd", &file_type) == 3);
+  assert(file_type == 0x3fd);
+  assert(batchnames_strip_type("Pic,FF9", &file_type) == 3);
+  assert(file_type == 0xff9);
+  assert(batchnames_strip_type("Sky", &file_type) == 3);
+  assert(file_type == FileType_Null);
+  assert(batchnames_strip_type(",fff", &file_type) == 4);
+  assert(file_type == FileType_Null);
+  assert(batchnames_strip_type("Sky,3fg", &file_type) == 7);
+  assert(file_type == FileType_Null);
+  assert(batchnames_strip_type("Sky,3fd", NULL) == 3);
+}
+
+static void test_mirror(void)
+{
+  static char const *const paths[][2] =
+  {
+    { "Sky", "Sky" },
+    { "a/b/Sky", "a/b/Sky" },
+    { "./a/Sky", "a/Sky" },
+    { "././Sky", "Sky" },
+    { ".\\a\\Sky", "a\\Sky" },
+    { "/a/Sky", "a/Sky" },
+    { "//a/./Sky", "a/./Sky" },
+    { "C:\\a\\Sky", "a\\Sky" },
+    { "c:Sky", "Sky" },
+    { ".Sky", ".Sky" },
+    { "a/..b/Sky..", "a/..b/Sky.." },
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE(paths); ++i)
+  {
+    _Optional char const *const sub_path = batchnames_mirror(paths[i][0]);
+    assert(sub_path);
+    assert(!strcmp(&*sub_path, paths[i][1]));
+  }
+
+  static char const *const outside[] =
+  {
+    "..", "../Sky", "a/../Sky", "a\\..\\Sky", "a/..", "/../Sky",
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE(outside); ++i)
+  {
+    assert(!batchnames_mirror(outside[i]));
+  }
+}
+
+static void test_make_stem(void)
+{
+  check_stem("Sky,3fd", NULL, "Sky");
+  check_stem("a/b/Sky,3fd", NULL, "a/b/Sky");
+  check_stem("../a/Sky,3fd", NULL, "../a/Sky");
+  check_stem("a/b/Sky,3fd", "out", "out/a/b/Sky");
+  check_stem("a/b/Sky", "out", "out/a/b/Sky");
+  check_stem("/a/Sky,3fd", "out", "out/a/Sky");
+  check_stem("./Sky,3fd", "out", "out/Sky");
+
+  char stem[8];
+  assert(batchnames_make_stem(stem, sizeof(stem), "Sky,3fd", "out"));
+  assert(!batchnames_make_stem(stem, sizeof(stem), "Sky1,3fd", "out"));
+  assert(!batchnames_make_stem(stem, sizeof(stem), "abcd/Sky1", NULL));
+  assert(!batchnames_make_stem(stem, sizeof(stem), "../Sky", "out"));
+}
+
+static void test_same_leaf_same_dir(void)
+{
+  /* Inputs in different directories map to different output files,
+     unless their paths differ only in ways that aren't mirrored */
+  BatchNames names;
+  batchnames_init(&names);
+  claim_stem(&names, "a/Sky,3fd", "out", NULL);
+  claim_stem(&names, "b/Sky,3fd", "out", NULL);
+  claim_stem(&names, "./a/Sky", "out", "a/Sky,3fd");
+  claim_stem(&names, "/b/Sky,ffd", "out", "b/Sky,3fd");
+  claim_stem(&names, "a/Sky2", "out", NULL);
+  batchnames_destroy(&names);
+}
+
+static void test_same_leaf_own_dir(void)
+{
+  /* Otherwise, only inputs in the same directory can clash */
+  BatchNames names;
+  batchnames_init(&names);
+  claim_stem(&names, "a/Sky,3fd", NULL, NULL);
+  claim_stem(&names, "b/Sky,3fd", NULL, NULL);
+  claim_stem(&names, "a/Sky", NULL, "a/Sky,3fd");
+  batchnames_destroy(&names);
+}
+
+static void test_different_types(void)
+{
+  /* A sprite file and a compressed file of the same name map to the same
+     output file, whatever its type */
+  BatchNames names;
+  batchnames_init(&names);
+  claim_stem(&names, "a/Sky,fff", NULL, NULL);
+  claim_stem(&names, "a/Sky,ffd", NULL, "a/Sky,fff");
+  claim_stem(&names, "a/Sky,ff9", NULL, "a/Sky,fff");
+  batchnames_destroy(&names);
+}
+
+static void test_ignore_case(void)
+{
+  BatchNames names;
+  batchnames_init(&names);
+  claim_stem(&names, "a/Pic,fff", "out", NULL);
+  claim_stem(&names, "A/PIC,ffd", "out", "a/Pic,fff");
+  claim_stem(&names, "A/pic,fff", NULL, NULL);
+  claim_stem(&names, "a/pic,ffd", NULL, "A/pic,fff");
+  batchnames_destroy(&names);
+}
+
+static void test_many_names(void)
+{
+  /* Enough names to make the set grow several times */
+  BatchNames names;
+  batchnames_init(&names);
+
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    for (int i = 0; i < ManyNames; ++i)
+    {
+      char name[StemSize], owner[StemSize];
+      sprintf(name, "out/Sky%d", i);
+      sprintf(owner, "in%d/Sky%d,3fd", pass, i);
+
+      _Optional char const *prev_owner;
+      assert(batchnames_claim(&names, name, owner, &prev_owner));
+      if (pass == 0)
+      {
+        assert(!prev_owner);
+      }
+      else
+      {
+        char expected[StemSize];
+        sprintf(expected, "in0/Sky%d,3fd", i);
+        assert(prev_owner);
+        assert(!strcmp(&*prev_owner, expected));
+      }
+    }
+  }
+  assert(names.count == ManyNames);
+  batchnames_destroy(&names);
+}
+
+static void test_destroy_empty(void)
+{
+  BatchNames names;
+  batchnames_init(&names);
+  batchnames_destroy(&names);
+}
+
+void BatchNames_tests(void)
+{
+  static const struct
+  {
+    char const *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Leaf name", test_leaf },
+    { "Strip file type", test_strip_type },
+    { "Mirror path", test_mirror },
+    { "Make output name", test_make_stem },
+    { "Same leaf name in an output directory", test_same_leaf_same_dir },
+    { "Same leaf name in separate directories", test_same_leaf_own_dir },
+    { "Same name with different file types", test_different_types },
+    { "Names differing only in case", test_ignore_case },
+    { "Many names", test_many_names },
+    { "Destroy empty set", test_destroy_empty },
+  };
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); ++count)
+  {
+    DEBUGF("Test %zu/%zu : %s\n", 1 + count, ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+    Fortify_EnterScope();
+    unit_tests[count].test_func();
+    Fortify_LeaveScope();
+  }
+}
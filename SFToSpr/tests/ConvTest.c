@@ -32,6 +32,7 @@ enum
   PaintY0 = -31,
   PaintX1 = -27,
   PaintY1 = -6,
+  PlanetGap = 100,
 };
 
 static uint8_t const splash_anim_1[MapAnimFrameCount] = {0, 1, 2, 1},
@@ -270,6 +271,68 @@ static void check_nonextended_round_trip(
   check_bytes(source, source_size, result, (size_t)result_size);
 }
 
+static void check_buffered_round_trip(
+  void const *const source, size_t const source_size,
+  ToSpritesFn *const to_sprites, FromSpritesFn *const from_sprites,
+  ScanSpritesContext *const context)
+{
+  uint8_t sprites[BufferSize], result[BufferSize];
+  Reader reader;
+  Writer writer;
+  SpriteBitmapBuffer bitmaps;
+
+  assert(reader_mem_init(&reader, source, source_size));
+  assert(writer_mem_init(&writer, sprites, sizeof(sprites)));
+  assert(to_sprites(&reader, &writer) == SFError_OK);
+  long int const sprites_size = finish_writer(&writer);
+  reader_destroy(&reader);
+
+  sprite_bitmap_buffer_init(&bitmaps);
+  assert(reader_mem_init(&reader, sprites, (size_t)sprites_size));
+  assert(scan_sprite_file_buffered(&reader, context, &bitmaps) == SFError_OK);
+  reader_destroy(&reader);
+
+  /* Overwrite the sprite file to prove that it isn't read again */
+  memset(sprites, 0xff, (size_t)sprites_size);
+
+  assert(sprite_bitmap_buffer_reader_init(&reader, &bitmaps));
+  assert(writer_mem_init(&writer, result, sizeof(result)));
+  assert(from_sprites(&reader, &writer, context) == SFError_OK);
+  long int const result_size = finish_writer(&writer);
+  reader_destroy(&reader);
+  sprite_bitmap_buffer_destroy(&bitmaps);
+
+  check_bytes(source, source_size, result, (size_t)result_size);
+}
+
+static void check_sprite_bitmaps(uint8_t const *const sprites,
+                                  long int const sprites_size, int const count,
+                                  int const width, int const height,
+                                  bool const flipped)
+{
+  /* Compare each pixel with the source one at a time, which is slow
+     but obviously correct, unlike the block copy that produced it. */
+  long int const bitmap_size = WORD_ALIGN(width) * height;
+  long int const sprite_size = (sizeof(int32_t) * 11) + bitmap_size;
+  long int const first = sizeof(int32_t) * 3;
+  assert(sprites_size == first + (count * sprite_size));
+
+  for (int image = 0; image < count; ++image)
+  {
+    uint8_t const *const bitmap = sprites + first + (image * sprite_size) +
+                                  (sprite_size - bitmap_size);
+    for (int y = 0; y < height; ++y)
+    {
+      int const src_y = flipped ? height - 1 - y : y;
+      for (int x = 0; x < WORD_ALIGN(width); ++x)
+      {
+        uint8_t const expected = x < width ? pixel(image, x, src_y) : 0;
+        assert(bitmap[(y * WORD_ALIGN(width)) + x] == expected);
+      }
+    }
+  }
+}
+
 static void test_sizes(void)
 {
   MapTilesHeader tiles = {.last_tile_num = NumTiles - 1};
@@ -279,6 +342,50 @@ static void test_sizes(void)
   assert(sky_size() == 8 + SkyBitmapSize);
 }
 
+static void test_conversion_sizes(void)
+{
+  typedef long int MakeFn(void *, size_t);
+  typedef SFError SizeFn(Reader *, long int *);
+  static struct
+  {
+    MakeFn *make;
+    ToSpritesFn *convert;
+    SizeFn *get_size;
+  }
+  const conversions[] =
+  {
+    { make_tiles, tiles_to_sprites, tiles_to_sprites_size },
+    { make_tiles, tiles_to_sprites_ext, tiles_to_sprites_ext_size },
+    { make_tiles, tiles_to_csv, tiles_to_csv_size },
+    { make_planets, planets_to_sprites, planets_to_sprites_size },
+    { make_planets, planets_to_sprites_ext, planets_to_sprites_ext_size },
+    { make_planets, planets_to_csv, planets_to_csv_size },
+    { make_sky, sky_to_sprites, sky_to_sprites_size },
+    { make_sky, sky_to_sprites_ext, sky_to_sprites_ext_size },
+    { make_sky, sky_to_csv, sky_to_csv_size },
+  };
+
+  for (size_t i = 0; i < ARRAY_SIZE(conversions); ++i)
+  {
+    uint8_t source[BufferSize], result[BufferSize];
+    long int const source_size = conversions[i].make(source, sizeof(source));
+    Reader reader;
+    Writer writer;
+
+    assert(reader_mem_init(&reader, source, (size_t)source_size));
+    assert(writer_mem_init(&writer, result, sizeof(result)));
+    assert(conversions[i].convert(&reader, &writer) == SFError_OK);
+    long int const result_size = finish_writer(&writer);
+    reader_destroy(&reader);
+
+    long int size = -1;
+    assert(reader_mem_init(&reader, source, (size_t)source_size));
+    assert(conversions[i].get_size(&reader, &size) == SFError_OK);
+    reader_destroy(&reader);
+    assert(size == result_size);
+  }
+}
+
 static void test_sky_round_trip(void)
 {
   uint8_t source[BufferSize];
@@ -346,6 +453,204 @@ static void test_planets_nonextended_round_trip(void)
                                prepare_planets_context);
 }
 
+static void test_sky_buffered_round_trip(void)
+{
+  uint8_t source[BufferSize];
+  long int const source_size = make_sky(source, sizeof(source));
+  ScanSpritesContext context;
+  check_buffered_round_trip(source, (size_t)source_size, sky_to_sprites_ext,
+                            from_sky, &context);
+  assert(context.sky.count == 1);
+  assert(context.sky.got_hdr);
+}
+
+static void test_tiles_buffered_round_trip(void)
+{
+  uint8_t source[BufferSize];
+  long int const source_size = make_tiles(source, sizeof(source));
+  ScanSpritesContext context;
+  check_buffered_round_trip(source, (size_t)source_size, tiles_to_sprites_ext,
+                            from_tiles, &context);
+  assert(context.tiles.count == NumTiles);
+  assert(context.tiles.got_hdr);
+}
+
+static void test_planets_buffered_round_trip(void)
+{
+  uint8_t source[BufferSize];
+  long int const source_size = make_planets(source, sizeof(source));
+  ScanSpritesContext context;
+  check_buffered_round_trip(source, (size_t)source_size, planets_to_sprites_ext,
+                            from_planets, &context);
+  assert(context.planets.count == NumPlanets);
+  assert(context.planets.got_hdr);
+}
+
+static void test_tiles_sprite_pixels(void)
+{
+  uint8_t tiles_data[BufferSize], sprites[BufferSize];
+  long int const tiles_size = make_tiles(tiles_data, sizeof(tiles_data));
+  Reader reader;
+  Writer writer;
+
+  assert(reader_mem_init(&reader, tiles_data, (size_t)tiles_size));
+  assert(writer_mem_init(&writer, sprites, sizeof(sprites)));
+  assert(tiles_to_sprites(&reader, &writer) == SFError_OK);
+  long int const sprites_size = finish_writer(&writer);
+  reader_destroy(&reader);
+
+  check_sprite_bitmaps(sprites, sprites_size, NumTiles,
+                       MapTileWidth, MapTileHeight, true);
+}
+
+static void test_sky_sprite_pixels(void)
+{
+  uint8_t sky_data[BufferSize], sprites[BufferSize];
+  long int const sky_size = make_sky(sky_data, sizeof(sky_data));
+  Reader reader;
+  Writer writer;
+
+  assert(reader_mem_init(&reader, sky_data, (size_t)sky_size));
+  assert(writer_mem_init(&writer, sprites, sizeof(sprites)));
+  assert(sky_to_sprites(&reader, &writer) == SFError_OK);
+  long int const sprites_size = finish_writer(&writer);
+  reader_destroy(&reader);
+
+  check_sprite_bitmaps(sprites, sprites_size, 1, SkyWidth, SkyHeight, true);
+}
+
+static void test_planets_sprite_pixels(void)
+{
+  uint8_t planets_data[BufferSize], sprites[BufferSize];
+  long int const planets_size = make_planets(planets_data,
+                                             sizeof(planets_data));
+  Reader reader;
+  Writer writer;
+
+  assert(reader_mem_init(&reader, planets_data, (size_t)planets_size));
+  assert(writer_mem_init(&writer, sprites, sizeof(sprites)));
+  assert(planets_to_sprites(&reader, &writer) == SFError_OK);
+  long int const sprites_size = finish_writer(&writer);
+  reader_destroy(&reader);
+
+  check_sprite_bitmaps(sprites, sprites_size, NumPlanets,
+                       PlanetSprWidth, PlanetHeight, false);
+}
+
+static void test_planets_bad_images(void)
+{
+  uint8_t planets_data[BufferSize], sprites[BufferSize];
+  long int const planets_size = make_planets(planets_data,
+                                             sizeof(planets_data));
+  Reader reader;
+  Writer writer;
+
+  /* Make the last pixel of the second copy of the last planet differ */
+  planets_data[planets_size - 1] ^= 1;
+
+  assert(reader_mem_init(&reader, planets_data, (size_t)planets_size));
+  assert(writer_mem_init(&writer, sprites, sizeof(sprites)));
+  assert(planets_to_sprites(&reader, &writer) == SFError_BadImages);
+  (void)writer_destroy(&writer);
+  reader_destroy(&reader);
+}
+
+static void test_planets_out_of_order(void)
+{
+  uint8_t source[BufferSize], sprites[BufferSize], result[BufferSize];
+  uint8_t result_sprites[BufferSize];
+  long int const source_size = make_planets(source, sizeof(source));
+  int32_t const header_size = sizeof(int32_t) * 9;
+  Reader reader;
+  Writer writer;
+  ScanSpritesContext context;
+
+  assert(reader_mem_init(&reader, source, (size_t)source_size));
+  assert(writer_mem_init(&writer, sprites, sizeof(sprites)));
+  assert(planets_to_sprites_ext(&reader, &writer) == SFError_OK);
+  long int const sprites_size = finish_writer(&writer);
+  reader_destroy(&reader);
+
+  assert(reader_mem_init(&reader, sprites, (size_t)sprites_size));
+  assert(scan_sprite_file(&reader, &context) == SFError_OK);
+  reader_destroy(&reader);
+
+  /* Put the second planet first, each planet's second image before its
+     first, and leave a gap before the first planet */
+  PlanetsBitmapOffset *const offsets = context.planets.hdr.data_offsets;
+  offsets[1].image_B = header_size;
+  offsets[1].image_A = offsets[1].image_B + PlanetBitmapSize;
+  offsets[0].image_B = offsets[1].image_A + PlanetBitmapSize + PlanetGap;
+  offsets[0].image_A = offsets[0].image_B + PlanetBitmapSize;
+  long int const expected_size = source_size + PlanetGap;
+  assert(planets_size(&context.planets.hdr) == expected_size);
+
+  assert(reader_mem_init(&reader, sprites, (size_t)sprites_size));
+  assert(writer_mem_init(&writer, result, sizeof(result)));
+  assert(sprites_to_planets(&reader, &writer, &context.planets) == SFError_OK);
+  long int const result_size = finish_writer(&writer);
+  reader_destroy(&reader);
+  assert(result_size == expected_size);
+
+  assert(reader_mem_init(&reader, result, (size_t)result_size));
+  assert(!reader_fseek(&reader, sizeof(int32_t) * 5, SEEK_SET));
+  for (int planet = 0; planet < NumPlanets; ++planet)
+  {
+    int32_t image_a, image_b;
+    assert(reader_fread_int32(&image_a, &reader));
+    assert(reader_fread_int32(&image_b, &reader));
+    assert(image_a == offsets[planet].image_A);
+    assert(image_b == offsets[planet].image_B);
+
+    long int const src = header_size + (planet * 2 * PlanetBitmapSize);
+    check_bytes(source + src, PlanetBitmapSize,
+                result + image_a, PlanetBitmapSize);
+    check_bytes(source + src + PlanetBitmapSize, PlanetBitmapSize,
+                result + image_b, PlanetBitmapSize);
+  }
+  reader_destroy(&reader);
+
+  for (int i = 0; i < PlanetGap; ++i)
+  {
+    assert(result[offsets[0].image_B - PlanetGap + i] == 0);
+  }
+
+  /* The images must be read back from where they were written */
+  assert(reader_mem_init(&reader, result, (size_t)result_size));
+  assert(writer_mem_init(&writer, result_sprites, sizeof(result_sprites)));
+  assert(planets_to_sprites_ext(&reader, &writer) == SFError_OK);
+  long int const result_sprites_size = finish_writer(&writer);
+  reader_destroy(&reader);
+  check_bytes(sprites, (size_t)sprites_size,
+              result_sprites, (size_t)result_sprites_size);
+
+  /* Make the first planet's images overlap each other */
+  assert(writer_mem_init(&writer, result + sizeof(int32_t) * 5,
+                         sizeof(int32_t) * 2));
+  assert(writer_fwrite_int32(offsets[0].image_B + 1, &writer));
+  assert(writer_fwrite_int32(offsets[0].image_B, &writer));
+  finish_writer(&writer);
+
+  assert(reader_mem_init(&reader, result, (size_t)result_size));
+  assert(writer_mem_init(&writer, result_sprites, sizeof(result_sprites)));
+  assert(planets_to_sprites_ext(&reader, &writer) == SFError_BadDataOff);
+  (void)writer_destroy(&writer);
+  reader_destroy(&reader);
+
+  /* Make the first planet's images overlap the second planet's */
+  assert(writer_mem_init(&writer, result + sizeof(int32_t) * 5,
+                         sizeof(int32_t) * 2));
+  assert(writer_fwrite_int32(offsets[1].image_A, &writer));
+  assert(writer_fwrite_int32(offsets[1].image_A + PlanetBitmapSize, &writer));
+  finish_writer(&writer);
+
+  assert(reader_mem_init(&reader, result, (size_t)result_size));
+  assert(writer_mem_init(&writer, result_sprites, sizeof(result_sprites)));
+  assert(planets_to_sprites_ext(&reader, &writer) == SFError_BadDataOff);
+  (void)writer_destroy(&writer);
+  reader_destroy(&reader);
+}
+
 static void test_incremental_conversion(void)
 {
   uint8_t tiles_data[BufferSize];
@@ -408,6 +713,46 @@ static void test_incremental_conversion(void)
               result, (size_t)result_size);
 }
 
+static void test_budgeted_conversion(void)
+{
+  uint8_t tiles_data[BufferSize];
+  uint8_t expected_sprites[BufferSize], actual_sprites[BufferSize];
+  long int const tiles_data_size = make_tiles(tiles_data, sizeof(tiles_data));
+  Reader reader;
+  Writer writer;
+  TilesToSpritesIter iter;
+
+  assert(reader_mem_init(&reader, tiles_data, (size_t)tiles_data_size));
+  assert(writer_mem_init(&writer, expected_sprites, sizeof(expected_sprites)));
+  assert(tiles_to_sprites_ext(&reader, &writer) == SFError_OK);
+  long int const expected_size = finish_writer(&writer);
+  reader_destroy(&reader);
+
+  assert(reader_mem_init(&reader, tiles_data, (size_t)tiles_data_size));
+  assert(writer_mem_init(&writer, actual_sprites, sizeof(actual_sprites)));
+  assert(tiles_to_sprites_ext_init(&iter, &reader, &writer) == SFError_OK);
+
+  /* Time running out stops conversion after one item */
+  volatile bool time_up = true;
+  assert(convert_advance_budget(&iter.super, NumTiles, &time_up) == SFError_OK);
+  assert(iter.super.pos == 1);
+
+  time_up = false;
+  assert(convert_advance_budget(&iter.super, 1, &time_up) == SFError_OK);
+  assert(iter.super.pos == 2);
+
+  /* Completion is reported without another call */
+  assert(convert_advance_budget(&iter.super, NumTiles, NULL) == SFError_Done);
+  assert(iter.super.pos == NumTiles);
+  assert(convert_advance_budget(&iter.super, 1, NULL) == SFError_Done);
+  assert(iter.super.pos == NumTiles);
+
+  long int const actual_size = finish_writer(&writer);
+  reader_destroy(&reader);
+  check_bytes(expected_sprites, (size_t)expected_size,
+              actual_sprites, (size_t)actual_size);
+}
+
 static void test_sky_to_csv(void)
 {
   uint8_t sky_data[BufferSize], csv[256];
@@ -492,6 +837,41 @@ static void test_csv_to_planets(void)
   reader_destroy(&reader);
 }
 
+static void test_csv_commented_and_long(void)
+{
+  /* Longer than the old fixed-size buffer, with comments, blank lines,
+     CR LF line endings and more fields than are needed */
+  char csv[1024] = "# Paint offsets exported from SFToSpr\r\n\r\n";
+  size_t len = strlen(csv);
+  for (int i = 0; i < 200; ++i)
+  {
+    csv[len++] = ' ';
+  }
+  strcpy(csv + len, "-12, -31 ,7,8,9\r\n  # A comment, with commas\n\n"
+                    "-27x,-6\n# Extra record ignored\n-1,-1\n");
+  len = strlen(csv);
+  assert(len > 256);
+
+  Reader reader;
+  PlanetsHeader planets = {.last_image_num = NumPlanets - 1};
+  assert(reader_mem_init(&reader, csv, len));
+  assert(csv_to_planets(&reader, &planets) == SFError_OK);
+  assert(planets.paint_coords[0].x_offset == PaintX0);
+  assert(planets.paint_coords[0].y_offset == PaintY0);
+  assert(planets.paint_coords[1].x_offset == PaintX1);
+  assert(planets.paint_coords[1].y_offset == PaintY1);
+  reader_destroy(&reader);
+
+  /* Numbers too big for an int saturate instead of overflowing */
+  static char const sky_csv[] = "99999999999999999999,-99999999999999999999";
+  SkyHeader sky = {0};
+  assert(reader_mem_init(&reader, sky_csv, strlen(sky_csv)));
+  assert(csv_to_sky(&reader, &sky) == SFError_ForceSky);
+  assert(sky.render_offset > RenderOffset);
+  assert(sky.min_stars_height < StarsHeight);
+  reader_destroy(&reader);
+}
+
 static void test_scan_truncated_sprite_area(void)
 {
   uint8_t sprite_data[1] = {0};
@@ -544,6 +924,7 @@ void Conv_tests(void)
   unit_tests[] =
   {
     { "File sizes", test_sizes },
+    { "Conversion output sizes", test_conversion_sizes },
     { "Sky extended sprite round trip", test_sky_round_trip },
     { "Map tile extended sprite round trip", test_tiles_round_trip },
     { "Planet extended sprite round trip", test_planets_round_trip },
@@ -552,13 +933,23 @@ void Conv_tests(void)
       test_tiles_nonextended_round_trip },
     { "Planet non-extended sprite round trip",
       test_planets_nonextended_round_trip },
+    { "Sky buffered sprite round trip", test_sky_buffered_round_trip },
+    { "Map tile buffered sprite round trip", test_tiles_buffered_round_trip },
+    { "Planet buffered sprite round trip", test_planets_buffered_round_trip },
+    { "Map tile sprite pixels", test_tiles_sprite_pixels },
+    { "Sky sprite pixels", test_sky_sprite_pixels },
+    { "Planet sprite pixels", test_planets_sprite_pixels },
+    { "Planet images that differ", test_planets_bad_images },
+    { "Planet images out of order", test_planets_out_of_order },
     { "Incremental map tile conversion", test_incremental_conversion },
+    { "Budgeted map tile conversion", test_budgeted_conversion },
     { "Convert sky to CSV", test_sky_to_csv },
     { "Apply CSV to sky header", test_csv_to_sky },
     { "Convert map tiles to CSV", test_tiles_to_csv },
     { "Apply CSV to map tile header", test_csv_to_tiles },
     { "Convert planets to CSV", test_planets_to_csv },
     { "Apply CSV to planet header", test_csv_to_planets },
+    { "Apply long commented CSV", test_csv_commented_and_long },
     { "Scan truncated sprite area", test_scan_truncated_sprite_area },
     { "Convert truncated sky", test_convert_truncated_sky },
     { "Scan negative sprite count", test_scan_negative_sprite_count },
@@ -0,0 +1,413 @@
+/*
+ * SFToSpr benchmark: Fednet (GKey) compression of game files
+ * Copyright (C) 2026 Christopher Bazley
+ */
+
+/* All four tools compress and decompress game files through the GKey
+   reader and writer with the same history size. This program measures the
+   speed and compression ratio of those paths for representative files of
+   each type that the tools handle, so that regressions can be caught and
+   batch jobs sized. It is not run as part of the test suite because its
+   results depend on the host. */
+
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define HAVE_GETRUSAGE
+#endif
+
+#include "Macros.h"
+#include "Debug.h"
+#include "ReaderMem.h"
+#include "WriterMem.h"
+#include "ReaderGKey.h"
+#include "WriterGKey.h"
+
+#include "../SFgfxconv.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+enum
+{
+  FednetHistoryLog2 = 9, /* Base 2 logarithm of the history size used by
+                            the compression algorithm */
+  NumTiles = MapTileMax + 1,
+  NumPlanets = PlanetMax + 1,
+  ColMapSize = 320, /* Largest colour map handled by SFColours */
+  BlockSize = 4, /* Size of areas of similar colour in generated images */
+  NoiseMask = 3, /* Range of variation within such an area */
+  MinRepeats = 8,
+  WorstBitsPerChar = 9,
+  MaxFiles = 32,
+};
+
+/* Each measurement is repeated until this much processor time has elapsed */
+static double const MinSeconds = 0.5;
+
+typedef struct
+{
+  char const *name;
+  _Optional uint8_t *data;
+  long int size;
+}
+BenchFile;
+
+static unsigned long int rand_state = 1;
+
+static unsigned int next_rand(void)
+{
+  /* A fixed generator so that results are repeatable on every platform */
+  rand_state = rand_state * 1103515245ul + 12345ul;
+  return (unsigned int)(rand_state >> 16) & 0x7fffu;
+}
+
+static uint8_t pixel(int const image, int const x, int const y)
+{
+  /* Game graphics have areas of similar colour rather than random noise */
+  int const bx = x / BlockSize, by = y / BlockSize;
+  return (uint8_t)(((image * 37 + bx * 5 + by * 3) & ~NoiseMask) |
+                   (next_rand() & NoiseMask));
+}
+
+static long int finish_writer(Writer *const writer)
+{
+  assert(!writer_ferror(writer));
+  long int const len = writer_destroy(writer);
+  assert(len >= 0);
+  return len;
+}
+
+static void write_bitmap(Writer *const writer, int const image,
+  int const width, int const height)
+{
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < WORD_ALIGN(width); ++x)
+    {
+      assert(writer_fputc(x < width ? pixel(image, x, y) : 0, writer) != EOF);
+    }
+  }
+}
+
+static long int make_tiles(void *const buffer, size_t const size)
+{
+  static uint8_t const anims[MapAnimFrameCount * 2 + MapAnimTriggerCount] = {
+    0, 1, 2, 1, 2, 1, 0, 2, 3, 9, 27, 81
+  };
+
+  Writer writer;
+  assert(writer_mem_init(&writer, buffer, size));
+  assert(writer_fwrite_int32(NumTiles - 1, &writer));
+  assert(writer_fwrite(anims, sizeof(anims), 1, &writer) == 1);
+  for (int tile = 0; tile < NumTiles; ++tile)
+  {
+    write_bitmap(&writer, tile, MapTileWidth, MapTileHeight);
+  }
+  return finish_writer(&writer);
+}
+
+static long int make_planets(void *const buffer, size_t const size)
+{
+  int32_t const header_size = sizeof(int32_t) * (1 + (NumPlanets * 4));
+
+  Writer writer;
+  assert(writer_mem_init(&writer, buffer, size));
+  assert(writer_fwrite_int32(NumPlanets - 1, &writer));
+  for (int planet = 0; planet < NumPlanets; ++planet)
+  {
+    assert(writer_fwrite_int32(-PlanetWidth / 2, &writer));
+    assert(writer_fwrite_int32(-PlanetHeight / 2, &writer));
+  }
+  for (int planet = 0; planet < NumPlanets; ++planet)
+  {
+    int32_t const image_a = header_size + (planet * 2 * PlanetBitmapSize);
+    assert(writer_fwrite_int32(image_a, &writer));
+    assert(writer_fwrite_int32(image_a + PlanetBitmapSize, &writer));
+  }
+  for (int planet = 0; planet < NumPlanets; ++planet)
+  {
+    /* Both images of each pair are views of the same planet */
+    write_bitmap(&writer, planet, PlanetWidth, PlanetHeight);
+    write_bitmap(&writer, planet, PlanetWidth, PlanetHeight);
+  }
+  return finish_writer(&writer);
+}
+
+static long int make_sky(void *const buffer, size_t const size)
+{
+  Writer writer;
+  assert(writer_mem_init(&writer, buffer, size));
+  assert(writer_fwrite_int32(SkyHeight * 2, &writer));
+  assert(writer_fwrite_int32(-SkyHeight, &writer));
+  for (int y = 0; y < SkyHeight; ++y)
+  {
+    /* Skies are bands of colour graded from the horizon upwards */
+    uint8_t const colour = (uint8_t)(y * 2 / 3);
+    for (int x = 0; x < WORD_ALIGN(SkyWidth); ++x)
+    {
+      assert(writer_fputc(colour, &writer) != EOF);
+    }
+  }
+  return finish_writer(&writer);
+}
+
+static long int make_colmap(void *const buffer, size_t const size)
+{
+  Writer writer;
+  assert(writer_mem_init(&writer, buffer, size));
+  for (int i = 0; i < ColMapSize; ++i)
+  {
+    /* Colour maps mostly map each colour to a similar one */
+    assert(writer_fputc((i + (int)(next_rand() & NoiseMask)) & 0xff,
+                        &writer) != EOF);
+  }
+  return finish_writer(&writer);
+}
+
+static long int worst_comp_size(long int const size)
+{
+  return sizeof(int32_t) + ((size * WorstBitsPerChar) + CHAR_BIT - 1) / CHAR_BIT;
+}
+
+static long int compress(uint8_t const *const src, long int const src_size,
+  uint8_t *const dst, long int const dst_size)
+{
+  Writer writer, gkwriter;
+  assert(writer_mem_init(&writer, dst, (size_t)dst_size));
+  assert(writer_gkey_init_from(&gkwriter, FednetHistoryLog2, src_size,
+                               &writer));
+  assert(writer_fwrite(src, (size_t)src_size, 1, &gkwriter) == 1);
+  (void)finish_writer(&gkwriter);
+  return finish_writer(&writer);
+}
+
+static void decompress(uint8_t const *const src, long int const src_size,
+  uint8_t *const dst, long int const dst_size)
+{
+  Reader reader, gkreader;
+  assert(reader_mem_init(&reader, src, (size_t)src_size));
+  assert(reader_gkey_init_from(&gkreader, FednetHistoryLog2, &reader));
+  assert(reader_fread(dst, (size_t)dst_size, 1, &gkreader) == 1);
+  assert(reader_fgetc(&gkreader) == EOF);
+  assert(!reader_ferror(&gkreader));
+  reader_destroy(&gkreader);
+  reader_destroy(&reader);
+}
+
+static double mb_per_sec(long int const size, unsigned long int const repeats,
+  clock_t const ticks)
+{
+  double const seconds = (double)ticks / CLOCKS_PER_SEC;
+  return seconds > 0 ? ((double)size * repeats) / (seconds * 1024 * 1024) : 0;
+}
+
+static bool bench_file(BenchFile const *const file)
+{
+  assert(file != NULL);
+  assert(file->data != NULL);
+
+  long int const max_size = worst_comp_size(file->size);
+  _Optional uint8_t *const comp = malloc((size_t)max_size);
+  _Optional uint8_t *const decomp = malloc((size_t)file->size + 1);
+  if (!comp || !decomp)
+  {
+    free(comp);
+    free(decomp);
+    fprintf(stderr, "Not enough free memory for %s\n", file->name);
+    return false;
+  }
+
+  unsigned long int comp_repeats = 0;
+  long int comp_size = 0;
+  clock_t const comp_start = clock();
+  clock_t comp_ticks;
+  do
+  {
+    comp_size = compress(&*file->data, file->size, &*comp, max_size);
+    ++comp_repeats;
+    comp_ticks = clock() - comp_start;
+  }
+  while (comp_repeats < MinRepeats ||
+         comp_ticks < (clock_t)(MinSeconds * CLOCKS_PER_SEC));
+
+  unsigned long int decomp_repeats = 0;
+  clock_t const decomp_start = clock();
+  clock_t decomp_ticks;
+  do
+  {
+    decompress(&*comp, comp_size, &*decomp, file->size);
+    ++decomp_repeats;
+    decomp_ticks = clock() - decomp_start;
+  }
+  while (decomp_repeats < MinRepeats ||
+         decomp_ticks < (clock_t)(MinSeconds * CLOCKS_PER_SEC));
+
+  bool const same = !memcmp(&*decomp, &*file->data, (size_t)file->size);
+
+  printf("%-12s %9ld %9ld %6.1f%% %11.2f %11.2f%s\n", file->name,
+         file->size, comp_size,
+         file->size > 0 ? (comp_size * 100.0) / file->size : 0.0,
+         mb_per_sec(file->size, comp_repeats, comp_ticks),
+         mb_per_sec(file->size, decomp_repeats, decomp_ticks),
+         same ? "" : " MISMATCH");
+
+  free(comp);
+  free(decomp);
+  return same;
+}
+
+static bool load_file(BenchFile *const file, char const *const path)
+{
+  /* Files named on the command line are measured as they are, so they
+     should be decompressed game files. */
+  assert(file != NULL);
+  assert(path != NULL);
+
+  *file = (BenchFile){.name = path};
+
+  FILE *const f = fopen(path, "rb");
+  if (!f)
+  {
+    fprintf(stderr, "Failed to open %s\n", path);
+    return false;
+  }
+
+  bool success = false;
+  if (!fseek(f, 0, SEEK_END))
+  {
+    long int const size = ftell(f);
+    if (size >= 0 && !fseek(f, 0, SEEK_SET))
+    {
+      file->data = malloc(size > 0 ? (size_t)size : 1);
+      if (file->data &&
+          (size == 0 || fread(&*file->data, (size_t)size, 1, f) == 1))
+      {
+        file->size = size;
+        success = true;
+      }
+    }
+  }
+  fclose(f);
+
+  if (!success)
+  {
+    fprintf(stderr, "Failed to read %s\n", path);
+  }
+  return success;
+}
+
+static bool make_file(BenchFile *const file, char const *const name,
+  long int (*const make)(void *, size_t), long int const size)
+{
+  assert(file != NULL);
+  assert(name != NULL);
+  assert(make != NULL);
+
+  *file = (BenchFile){.name = name};
+  file->data = malloc((size_t)size);
+  if (!file->data)
+  {
+    fprintf(stderr, "Not enough free memory for %s\n", name);
+    return false;
+  }
+  file->size = make(&*file->data, (size_t)size);
+  return true;
+}
+
+static void print_peak_memory(void)
+{
+#ifdef HAVE_GETRUSAGE
+  struct rusage usage;
+  if (!getrusage(RUSAGE_SELF, &usage))
+  {
+#ifdef __APPLE__
+    long int const kib = usage.ru_maxrss / 1024; /* reported in bytes */
+#else
+    long int const kib = usage.ru_maxrss; /* reported in kilobytes */
+#endif
+    printf("Peak memory: %ld KiB\n", kib);
+    return;
+  }
+#endif
+  printf("Peak memory: not available on this platform\n");
+}
+
+int main(int argc, char *argv[])
+{
+  static const struct
+  {
+    char const *name;
+    long int (*make)(void *, size_t);
+    long int size;
+  }
+  generated[] =
+  {
+    { "Tiles", make_tiles,
+      sizeof(int32_t) + MapAnimFrameCount * 2 + MapAnimTriggerCount +
+      (long)NumTiles * MapTileBitmapSize },
+    { "Planets", make_planets,
+      sizeof(int32_t) * (1 + NumPlanets * 4) +
+      (long)NumPlanets * 2 * PlanetBitmapSize },
+    { "Sky", make_sky, sizeof(int32_t) * 2 + SkyBitmapSize },
+    { "ColourMap", make_colmap, ColMapSize },
+  };
+
+  BenchFile files[MaxFiles];
+  size_t nfiles = 0;
+
+  /* Refuse rather than silently benchmark fewer files than were named */
+  size_t const max_args = ARRAY_SIZE(files) - ARRAY_SIZE(generated);
+  if ((size_t)(argc - 1) > max_args)
+  {
+    fprintf(stderr, "Too many files (no more than %zu allowed)\n", max_args);
+    return EXIT_FAILURE;
+  }
+
+  for (size_t i = 0; i < ARRAY_SIZE(generated); ++i)
+  {
+    if (!make_file(&files[nfiles], generated[i].name, generated[i].make,
+                   generated[i].size))
+    {
+      return EXIT_FAILURE;
+    }
+    ++nfiles;
+  }
+
+  for (int arg = 1; arg < argc; ++arg)
+  {
+    assert(nfiles < ARRAY_SIZE(files));
+    if (!load_file(&files[nfiles], argv[arg]))
+    {
+      return EXIT_FAILURE;
+    }
+    ++nfiles;
+  }
+
+  printf("%-12s %9s %9s %7s %11s %11s\n", "File", "Bytes", "Packed",
+         "Ratio", "Comp MB/s", "Decomp MB/s");
+
+  bool success = true;
+  for (size_t i = 0; i < nfiles; ++i)
+  {
+    if (!bench_file(&files[i]))
+    {
+      success = false;
+    }
+    free(files[i].data);
+  }
+
+  print_peak_memory();
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -83,6 +83,8 @@ int main(int argc, char *argv[])
   test_groups[] =
   {
     { "Conv", Conv_tests },
+    { "BatchNames", BatchNames_tests },
+    { "ScanStats", ScanStats_tests },
 #ifdef ACORN_C
     { "App", App_tests },
 #endif
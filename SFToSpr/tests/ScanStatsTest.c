@@ -0,0 +1,205 @@
+/*
+ * SFToSpr test: per-phase statistics for a directory scan
+ * Copyright (C) 2026 Christopher Bazley
+ */
+
+#undef NDEBUG
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Macros.h"
+#include "Debug.h"
+
+#include "Tests.h"
+#include "../ScanStats.h"
+
+#ifdef USE_OPTIONAL
+#include "Optional.h"
+#endif
+
+#define CSV_PATH "ScanStatsTest"
+
+enum
+{
+  Phase_Open,
+  Phase_Convert,
+  Phase_Close,
+  Phase_Unused,
+  MaxLineLen = 255,
+  InputSize = 10,
+  SecondsField = 3,
+};
+
+static char const *const phase_names[] =
+{
+  [Phase_Open] = "Open",
+  [Phase_Convert] = "Convert",
+  [Phase_Close] = "Close",
+  [Phase_Unused] = "Unused",
+};
+
+static void remove_field(char *const line, int const field)
+{
+  /* Remove a field that can't be predicted, such as a time */
+  char *start = line;
+  for (int i = 0; i < field; ++i)
+  {
+    start = strchr(start, ',');
+    assert(start != NULL);
+    ++start;
+  }
+
+  _Optional char *const end = strchr(start, ',');
+  assert(end != NULL);
+  memmove(start, &*end + 1, strlen(&*end + 1) + 1);
+}
+
+static void check_csv(char const *const expected[], size_t const nlines)
+{
+  _Optional FILE *const f = fopen(CSV_PATH, "r");
+  assert(f != NULL);
+
+  for (size_t i = 0; i < nlines; ++i)
+  {
+    char line[MaxLineLen + 1];
+    assert(fgets(line, sizeof(line), &*f) != NULL);
+    remove_field(line, SecondsField);
+    DEBUGF("%s", line);
+    assert(!strcmp(line, expected[i]));
+  }
+  assert(fgetc(&*f) == EOF);
+  assert(!ferror(&*f));
+  fclose(&*f);
+}
+
+static void record_first_scan(void)
+{
+  ScanStats stats;
+  scan_stats_init(&stats, CSV_PATH, phase_names, ARRAY_SIZE(phase_names));
+  assert(scan_stats_is_enabled(&stats));
+
+  _Optional FILE *const in = tmpfile();
+  assert(in != NULL);
+  for (int i = 0; i < InputSize; ++i)
+  {
+    assert(fputc(i, &*in) == i);
+  }
+  rewind(&*in);
+
+  char buf[InputSize];
+
+  /* Bytes read from the input file and reported separately */
+  scan_stats_begin(&stats, Phase_Open);
+  assert(fread(buf, 4, 1, &*in) == 1);
+  scan_stats_end(&stats, in, NULL);
+
+  scan_stats_begin(&stats, Phase_Convert);
+  assert(fread(buf, InputSize - 4, 1, &*in) == 1);
+  scan_stats_add_io(&stats, 0, 100);
+  scan_stats_end(&stats, in, NULL);
+  scan_stats_next_file(&stats, "a");
+
+  fclose(&*in);
+
+  /* Two calls for the same phase */
+  scan_stats_begin(&stats, Phase_Convert);
+  scan_stats_add_io(&stats, 1, 2);
+  scan_stats_end(&stats, NULL, NULL);
+  scan_stats_begin(&stats, Phase_Convert);
+  scan_stats_add_io(&stats, 3, 4);
+  scan_stats_end(&stats, NULL, NULL);
+  scan_stats_next_file(&stats, "b");
+
+  /* No calls */
+  scan_stats_next_file(&stats, "c");
+
+  assert(scan_stats_dump(&stats));
+  scan_stats_destroy(&stats);
+}
+
+static void record_second_scan(void)
+{
+  ScanStats stats;
+  scan_stats_init(&stats, CSV_PATH, phase_names, ARRAY_SIZE(phase_names));
+
+  scan_stats_begin(&stats, Phase_Close);
+  scan_stats_end(&stats, NULL, NULL);
+  scan_stats_next_file(&stats, "d");
+
+  assert(scan_stats_dump(&stats));
+  scan_stats_destroy(&stats);
+}
+
+static void test_dump(void)
+{
+  static char const *const expected[] =
+  {
+    "file,phase,calls,bytes_read,bytes_written\n",
+    "\"a\",Open,1,4,0\n",
+    "\"a\",Convert,1,6,100\n",
+    "\"b\",Convert,2,4,6\n",
+    "\"\",Open,1,4,0\n",
+    "\"\",Convert,3,10,106\n",
+    /* Appended without another header */
+    "\"d\",Close,1,0,0\n",
+    "\"\",Close,1,0,0\n",
+  };
+
+  remove(CSV_PATH);
+
+  record_first_scan();
+  check_csv(expected, ARRAY_SIZE(expected) - 2);
+
+  record_second_scan();
+  check_csv(expected, ARRAY_SIZE(expected));
+
+  assert(!remove(CSV_PATH));
+}
+
+static void test_disabled(void)
+{
+  static _Optional char const *const paths[] = {NULL, ""};
+
+  remove(CSV_PATH);
+
+  for (size_t i = 0; i < ARRAY_SIZE(paths); ++i)
+  {
+    ScanStats stats;
+    scan_stats_init(&stats, paths[i], phase_names, ARRAY_SIZE(phase_names));
+    assert(!scan_stats_is_enabled(&stats));
+
+    scan_stats_begin(&stats, Phase_Open);
+    scan_stats_add_io(&stats, 1, 2);
+    scan_stats_end(&stats, NULL, NULL);
+    scan_stats_next_file(&stats, "a");
+
+    assert(scan_stats_dump(&stats));
+    scan_stats_destroy(&stats);
+  }
+
+  assert(fopen(CSV_PATH, "r") == NULL);
+}
+
+void ScanStats_tests(void)
+{
+  static const struct
+  {
+    char const *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Dump statistics as CSV", test_dump },
+    { "Statistics disabled", test_disabled },
+  };
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); ++count)
+  {
+    DEBUGF("Test %zu/%zu : %s\n", 1 + count, ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+    Fortify_EnterScope();
+    unit_tests[count].test_func();
+    Fortify_LeaveScope();
+  }
+}
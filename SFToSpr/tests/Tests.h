@@ -7,6 +7,8 @@
 #define Tests_h
 
 void Conv_tests(void);
+void BatchNames_tests(void);
+void ScanStats_tests(void);
 void App_tests(void);
 
 #ifdef FORTIFY